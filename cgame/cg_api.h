@@ -236,6 +236,14 @@ typedef struct cgImport_s {
 	char		*(*Sys_GetClipboardData) (void);
 	int			(*Sys_Milliseconds) (void);
 	void		(*Sys_SendKeyEvents) (void);
+
+	// Anything added to cgImport_t goes down here, the client fills the
+	// table in by name but a cgame module reads it by offset
+	void		(*CL_LoadPhase) (char *name);
+
+	// Many CM_BoxTrace calls at once, out[i] answers reqs[i]. Only clips
+	// against the world or reqs[i].headNode, never against entities.
+	void		(*CM_BoxTraceBatch) (const traceReq_t *reqs, trace_t *out, int numReqs);
 } cgImport_t;
 
 typedef cgExport_t (*GetCGameAPI_t) (cgImport_t);
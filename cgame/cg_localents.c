@@ -45,6 +45,7 @@ typedef struct localEnt_s {
 	qBool				privBoolParms[3];
 	int					privIntParms[3];
 
+	int					traceNum;		// into cg_leTraces this frame, -1 if none
 	qBool				remove;
 } localEnt_t;
 
@@ -52,6 +53,9 @@ static localEnt_t	*cg_freeLEnts;
 static localEnt_t	cg_leHeadNode, cg_leList[MAX_LENTS];
 static int			cg_numLEnts;
 
+static traceReq_t	cg_leTraceReqs[MAX_LENTS];
+static trace_t		cg_leTraces[MAX_LENTS];
+
 /*
 =============================================================================
 
@@ -104,6 +108,54 @@ static void LE_ColorUpdate (localEnt_t *le)
 }
 
 
+/*
+===============
+LE_BrassMove
+
+Moves brass that is still in flight and queues its collision trace, all of
+them are run in one batch before LE_BrassThink.
+===============
+*/
+static qBool LE_BrassMove (localEnt_t *le, traceReq_t *req)
+{
+	float		time, time2;
+
+	// Check if time is up
+	if (cg.realTime >= le->time+(cg_brassTime->floatVal*1000)) {
+		le->remove = qTrue;
+		return qFalse;
+	}
+
+	if (le->privIntParms[0] != 0)
+		return qFalse;
+
+	// Run a frame
+	time = (cg.realTime - le->time) * 0.001f;
+	time2 = time * time;
+
+	// Copy origin to old
+	Vec3Copy (le->refEnt.origin, le->refEnt.oldOrigin);
+
+	// Move angles
+	Vec3MA (le->angles, cg.refreshFrameTime, le->avel, le->angles);
+	Angles_Matrix3 (le->angles, le->refEnt.axis);
+
+	// Scale velocity and add gravity
+	le->refEnt.origin[0] = le->org[0] + le->velocity[0] * time;
+	le->refEnt.origin[1] = le->org[1] + le->velocity[1] * time;
+	le->refEnt.origin[2] = le->org[2] + le->velocity[2] * time - le->pubParms[0] * time2;
+
+	// World only, same as CG_PMTrace without entities
+	Vec3Copy (le->refEnt.oldOrigin, req->start);
+	Vec3Copy (le->refEnt.origin, req->end);
+	Vec3Copy (le->mins, req->mins);
+	Vec3Copy (le->maxs, req->maxs);
+	req->headNode = 0;
+	req->contentMask = MASK_PLAYERSOLID;
+	return qTrue;
+}
+
+
 /*
 ===============
 LE_BrassThink
@@ -114,65 +166,40 @@ privFloatParms[0-2]: last angle (used when privIntParms[0] is >= 1)
 privIntParms[0]: 0 = run, 1-3 = interpolate, 4 = set angle, 5 = rest
 ===============
 */
-static void LE_BrassThink (localEnt_t *le)
+static void LE_BrassThink (localEnt_t *le, trace_t *tr)
 {
-	trace_t		tr;
-	float		time, time2;
 	vec3_t		normal, perpNormal;
 	vec3_t		perpPos;
 	vec3_t		angles;
 
-	// Check if time is up
-	if (cg.realTime >= le->time+(cg_brassTime->floatVal*1000)) {
-		le->remove = qTrue;
-		return;
-	}
-
 	// Check if we stopped moving
 	switch (le->privIntParms[0]) {
 	case 0:
-		// Run a frame
-		time = (cg.realTime - le->time) * 0.001f;
-		time2 = time * time;
-
-		// Copy origin to old
-		Vec3Copy (le->refEnt.origin, le->refEnt.oldOrigin);
-
-		// Move angles
-		Vec3MA (le->angles, cg.refreshFrameTime, le->avel, le->angles);
-		Angles_Matrix3 (le->angles, le->refEnt.axis);
-
-		// Scale velocity and add gravity
-		le->refEnt.origin[0] = le->org[0] + le->velocity[0] * time;
-		le->refEnt.origin[1] = le->org[1] + le->velocity[1] * time;
-		le->refEnt.origin[2] = le->org[2] + le->velocity[2] * time - le->pubParms[0] * time2;
-
 		// Check for collision
-		CG_PMTrace (&tr, le->refEnt.oldOrigin, le->mins, le->maxs, le->refEnt.origin, qFalse);
-		if (tr.allSolid || tr.startSolid) {
+		if (tr->allSolid || tr->startSolid) {
 			le->remove = qTrue;
 			return;
 		}
 
-		if (tr.fraction != 1.0f) {
-			Vec3Copy (tr.endPos, le->refEnt.origin);
+		if (tr->fraction != 1.0f) {
+			Vec3Copy (tr->endPos, le->refEnt.origin);
 
 			// Check if it's time to stop
-			LE_ClipVelocity (le->velocity, tr.plane.normal, le->velocity, 1.0f + (frand () * 0.5f));
-			if (tr.plane.normal[2] > 0.7f) {
+			LE_ClipVelocity (le->velocity, tr->plane.normal, le->velocity, 1.0f + (frand () * 0.5f));
+			if (tr->plane.normal[2] > 0.7f) {
 				// Play crash sound
 				if (le->type == LE_SGSHELL)
-					cgi.Snd_StartSound (tr.endPos, 0, 0, cgMedia.sfx.sgShell[(rand()&1)], 1, ATTN_NORM, 0);
+					cgi.Snd_StartSound (tr->endPos, 0, 0, cgMedia.sfx.sgShell[(rand()&1)], 1, ATTN_NORM, 0);
 				else
-					cgi.Snd_StartSound (tr.endPos, 0, 0, cgMedia.sfx.mgShell[(rand()&1)], 1, ATTN_NORM, 0);
+					cgi.Snd_StartSound (tr->endPos, 0, 0, cgMedia.sfx.mgShell[(rand()&1)], 1, ATTN_NORM, 0);
 
 				// Store current angles
 				Vec3Copy (le->angles, le->privFloatParms);
 
 				// Orient flat and rotate randomly on the plane
-				VectorNormalizef (tr.plane.normal, normal);
+				VectorNormalizef (tr->plane.normal, normal);
 				PerpendicularVector (normal, perpNormal);
-				ProjectPointOnPlane (perpPos, tr.endPos, perpNormal);
+				ProjectPointOnPlane (perpPos, tr->endPos, perpNormal);
 				RotatePointAroundVector (le->angles, perpNormal, perpPos, frand()*360);
 
 				// Found our new home
@@ -354,18 +381,38 @@ CG_AddLocalEnts
 void CG_AddLocalEnts (void)
 {
 	localEnt_t	*le, *next, *hNode;
+	int			numTraces;
 
+	// Move everything and gather the collision traces
 	hNode = &cg_leHeadNode;
-	for (le=hNode->prev ; le!=hNode ; le=next) {
-		next = le->prev;
+	numTraces = 0;
+	for (le=hNode->prev ; le!=hNode ; le=le->prev) {
+		le->traceNum = -1;
 
-		// Run physics and other per-frame things
 		switch (le->type) {
 		case LE_MGSHELL:
 		case LE_SGSHELL:
-			LE_BrassThink (le);
+			if (LE_BrassMove (le, &cg_leTraceReqs[numTraces]))
+				le->traceNum = numTraces++;
 			break;
 		}
+	}
+
+	if (numTraces)
+		cgi.CM_BoxTraceBatch (cg_leTraceReqs, cg_leTraces, numTraces);
+
+	for (le=hNode->prev ; le!=hNode ; le=next) {
+		next = le->prev;
+
+		// Run physics and other per-frame things
+		if (!le->remove) {
+			switch (le->type) {
+			case LE_MGSHELL:
+			case LE_SGSHELL:
+				LE_BrassThink (le, (le->traceNum != -1) ? &cg_leTraces[le->traceNum] : NULL);
+				break;
+			}
+		}
 
 		// Remove if desired
 		if (le->remove) {
@@ -917,57 +917,68 @@ void CG_MapInit (void)
 		// Map media
 		cg_curLoadRange = 30;
 		CG_MapMediaInit ();
+		cgi.CL_LoadPhase ("cgame map media");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Model media
 		cg_curLoadRange = 10;
 		CG_ModelMediaInit ();
+		cgi.CL_LoadPhase ("cgame models");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Pic media
 		cg_curLoadRange = 10;
 		CG_PicMediaInit ();
+		cgi.CL_LoadPhase ("cgame pics");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Effect media
 		cg_curLoadRange = 15;
 		CG_FXMediaInit ();
+		cgi.CL_LoadPhase ("cgame effects");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Sound media
 		cg_curLoadRange = 15;
 		CG_SoundMediaInit ();
+		cgi.CL_LoadPhase ("cgame sounds");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Gloom media
 		cg_curLoadRange = 20;
 		CG_CacheGloomMedia ();
+		cgi.CL_LoadPhase ("cgame gloom media");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 	}
 	else {
 		// Map media
 		cg_curLoadRange = 35;
 		CG_MapMediaInit ();
+		cgi.CL_LoadPhase ("cgame map media");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Model media
 		cg_curLoadRange = 10;
 		CG_ModelMediaInit ();
+		cgi.CL_LoadPhase ("cgame models");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Pic media
 		cg_curLoadRange = 15;
 		CG_PicMediaInit ();
+		cgi.CL_LoadPhase ("cgame pics");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Effect media
 		cg_curLoadRange = 20;
 		CG_FXMediaInit ();
+		cgi.CL_LoadPhase ("cgame effects");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 
 		// Sound media
 		cg_curLoadRange = 20;
 		CG_SoundMediaInit ();
+		cgi.CL_LoadPhase ("cgame sounds");
 		CG_LoadingPercent (percent += cg_curLoadRange);
 	}
 
@@ -483,7 +483,8 @@ static void CreditsMenu_Init (void)
 	}
 
 	m_creditsMenu.fileBuffer = NULL;
-	count = cgi.FS_LoadFile ("credits", (void **)&m_creditsMenu.fileBuffer, NULL);
+	// Terminated so we get a private copy, the lines get split in place below
+	count = cgi.FS_LoadFile ("credits", (void **)&m_creditsMenu.fileBuffer, "\n");
 
 	// kthx problem with using credits selection and having a file? test me!
 	if (m_creditsMenu.fileBuffer && count > 0) {
@@ -28,6 +28,123 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 static cgExport_t		*cge;
 
+/*
+=============================================================================
+
+	LOAD TIMING
+
+	Wall-clock time and memory allocations of each step between "precache"
+	and the end of registration, shown by the "loadtime" command.
+=============================================================================
+*/
+
+#define MAX_LOAD_PHASES		32
+
+typedef struct loadPhase_s {
+	char		name[32];
+	uint32		msec;
+	uint32		numAllocs;			// Mem_Alloc calls
+	uint32		numSysAllocs;		// of those, how many reached the system
+} loadPhase_t;
+
+static loadPhase_t	cl_loadPhases[MAX_LOAD_PHASES];
+static uint32		cl_numLoadPhases;
+static uint32		cl_loadStartTime;
+static uint32		cl_loadPhaseTime;
+static uint32		cl_loadPhaseAllocs;
+static uint32		cl_loadPhaseSysAllocs;
+static qBool		cl_loadTiming;
+static uint32		cl_loadPrefetched;
+static uint32		cl_loadPrefetchHits;
+static char			cl_loadMapName[MAX_QPATH];
+
+/*
+===============
+CL_BeginLoadTimer
+===============
+*/
+void CL_BeginLoadTimer (void)
+{
+	cl_numLoadPhases = 0;
+	cl_loadStartTime = cl_loadPhaseTime = Sys_UMilliseconds ();
+	Mem_AllocCounts (&cl_loadPhaseAllocs, &cl_loadPhaseSysAllocs);
+	cl_loadTiming = qTrue;
+	cl_loadPrefetched = 0;
+	cl_loadPrefetchHits = 0;
+	cl_loadMapName[0] = '\0';
+}
+
+
+/*
+===============
+CL_LoadPhase
+
+Ends the current phase, the time since the last mark is filed under name.
+===============
+*/
+void CL_LoadPhase (char *name)
+{
+	loadPhase_t	*phase;
+	uint32		time, numAllocs, numSysAllocs;
+
+	if (!cl_loadTiming || cl_numLoadPhases >= MAX_LOAD_PHASES)
+		return;
+
+	time = Sys_UMilliseconds ();
+	Mem_AllocCounts (&numAllocs, &numSysAllocs);
+	phase = &cl_loadPhases[cl_numLoadPhases++];
+	Q_strncpyz (phase->name, name, sizeof (phase->name));
+	phase->msec = time - cl_loadPhaseTime;
+	phase->numAllocs = numAllocs - cl_loadPhaseAllocs;
+	phase->numSysAllocs = numSysAllocs - cl_loadPhaseSysAllocs;
+	cl_loadPhaseTime = time;
+	cl_loadPhaseAllocs = numAllocs;
+	cl_loadPhaseSysAllocs = numSysAllocs;
+}
+
+
+/*
+===============
+CL_LoadPrefetched
+===============
+*/
+void CL_LoadPrefetched (uint32 numFiles)
+{
+	cl_loadPrefetched += numFiles;
+}
+
+
+/*
+===============
+CL_LoadTime_f
+===============
+*/
+void CL_LoadTime_f (void)
+{
+	uint32	i, numAllocs, numSysAllocs;
+
+	if (!cl_numLoadPhases) {
+		Com_Printf (0, "No map has been loaded yet.\n");
+		return;
+	}
+
+	Com_Printf (0, "Load times for %s:\n", cl_loadMapName[0] ? cl_loadMapName : "unknown map");
+	Com_Printf (0, "phase                              msec  allocs  system\n");
+	Com_Printf (0, "-------------------------------- ------ ------- -------\n");
+	for (i=0, numAllocs=0, numSysAllocs=0 ; i<cl_numLoadPhases ; i++) {
+		if (i & 1)
+			Com_Printf (0, S_COLOR_GREY);
+		Com_Printf (0, "%-32s %6u %7u %7u\n", cl_loadPhases[i].name, cl_loadPhases[i].msec, cl_loadPhases[i].numAllocs, cl_loadPhases[i].numSysAllocs);
+		numAllocs += cl_loadPhases[i].numAllocs;
+		numSysAllocs += cl_loadPhases[i].numSysAllocs;
+	}
+	Com_Printf (0, "--------------------------------------------------------\n");
+	Com_Printf (0, "Total: %ums, %i job worker(s), %u/%u prefetched files used\n",
+		cl_loadPhaseTime-cl_loadStartTime, Job_NumWorkers (), cl_loadPrefetchHits, cl_loadPrefetched);
+	Com_Printf (0, "%u allocations, %u from the system (mem_fastPools %i)\n",
+		numAllocs, numSysAllocs, Cvar_GetIntegerValue ("mem_fastPools"));
+}
+
 /*
 =============================================================================
 
@@ -53,34 +170,50 @@ void CL_CGModule_LoadMap (void)
 
 	initTime = Sys_UMilliseconds ();
 
+	// Not started by "precache", time it from here
+	if (!cl_loadTiming)
+		CL_BeginLoadTimer ();
+	CL_LoadPhase ("download checks");
+	Q_strncpyz (cl_loadMapName, cl.configStrings[CS_MODELS+1], sizeof (cl_loadMapName));
+
 	// Update connection info
 	CL_CGModule_UpdateConnectInfo ();
 
 	// Begin registration
 	GUI_BeginRegistration ();
-	R_BeginRegistration ();
+	if (!cls.headless) {
+		R_BeginRegistration ();
+		R_GetRefConfig (&cls.refConfig);
+	}
 	Snd_BeginRegistration ();
 
-	R_GetRefConfig (&cls.refConfig);
-
 	CL_ImageMediaInit ();
 	CL_SoundMediaInit ();
 	SCR_UpdateScreen ();
+	CL_LoadPhase ("client media");
 
 	// Load the map and media in CGame
 	cge->LoadMap (cl.playerNum, cls.serverProtocol, cls.protocolMinorVersion, cl.attractLoop, cl.strafeHack, &cls.refConfig);
 
 	// Touch before registration ends
-	R_MediaInit ();
+	if (!cls.headless)
+		R_MediaInit ();
+	CL_LoadPhase ("refresh media");
 
 	// Start the cd track
 	CDAudio_Play (atoi (cl.configStrings[CS_CDTRACK]), qTrue);
 
 	// The subsystems can now free unneeded stuff
 	GUI_EndRegistration ();
-	R_EndRegistration ();
+	if (!cls.headless)
+		R_EndRegistration ();
 	Snd_EndRegistration ();
 
+	// Release what was read ahead but never asked for
+	cl_loadPrefetchHits = FS_FlushPrefetch ();
+	CL_LoadPhase ("end registration");
+	cl_loadTiming = qFalse;
+
 	// Clear notify lines
 	CL_ClearNotifyLines ();
 
@@ -539,6 +672,92 @@ static void CGI_R_RenderScene (refDef_t *rd)
 
 // ==========================================================================
 
+/*
+	With cl_headless there's no renderer behind these. CGame builds its scenes
+	as usual and they go nowhere, so demobench can time that without a GPU.
+*/
+static void CGI_NullR_AddDecal (refDecal_t *decal, bvec4_t color, float materialTime) { }
+static void CGI_NullR_AddEntity (refEntity_t *ent) { }
+static void CGI_NullR_AddPoly (refPoly_t *poly) { }
+static void CGI_NullR_AddLight (vec3_t org, float intensity, float r, float g, float b) { }
+static void CGI_NullR_AddLightStyle (int style, float r, float g, float b) { }
+static void CGI_NullR_ClearScene (void) { }
+static qBool CGI_NullR_CullBox (vec3_t mins, vec3_t maxs, int clipFlags) { return qFalse; }
+static qBool CGI_NullR_CullSphere (const vec3_t origin, const float radius, int clipFlags) { return qFalse; }
+static struct font_s *CGI_NullR_RegisterFont (char *name) { return NULL; }
+static void CGI_NullR_GetFontDimensions (struct font_s *font, float xScale, float yScale, uint32 flags, vec2_t dest) { dest[0] = 8 * xScale; dest[1] = 8 * yScale; }
+static void CGI_NullR_DrawChar (struct font_s *font, float x, float y, float xScale, float yScale, uint32 flags, int num, vec4_t color) { }
+static size_t CGI_NullR_DrawString (struct font_s *font, float x, float y, float xScale, float yScale, uint32 flags, char *string, vec4_t color) { return 0; }
+static size_t CGI_NullR_DrawStringLen (struct font_s *font, float x, float y, float xScale, float yScale, uint32 flags, char *string, size_t len, vec4_t color) { return 0; }
+static void CGI_NullR_DrawPic (struct material_s *mat, float matTime, float x, float y, int w, int h, float s1, float t1, float s2, float t2, vec4_t color) { }
+static void CGI_NullR_DrawFill (float x, float y, int w, int h, vec4_t color) { }
+static void CGI_NullR_GetRefConfig (refConfig_t *outConfig) { *outConfig = cls.refConfig; }
+static void CGI_NullR_GetImageSize (struct material_s *mat, int *width, int *height) { if (width) *width = 64; if (height) *height = 64; }
+static qBool CGI_NullR_CreateDecal (refDecal_t *d, struct material_s *material, vec3_t origin, vec4_t subUVs, vec3_t direction, float angle, float size) { return qFalse; }
+static qBool CGI_NullR_FreeDecal (refDecal_t *d) { return qFalse; }
+static void CGI_NullR_RegisterMap (char *mapName) { }
+static struct refModel_s *CGI_NullR_RegisterModel (char *name) { return NULL; }
+static void CGI_NullR_ModelBounds (struct refModel_s *model, vec3_t mins, vec3_t maxs) { Vec3Clear (mins); Vec3Clear (maxs); }
+static void CGI_NullR_RenderScene (refDef_t *rd) { cl.refDef = *rd; }
+static void CGI_NullR_BeginFrame (float cameraSeparation) { }
+static void CGI_NullR_EndFrame (void) { }
+static struct material_s *CGI_NullR_RegisterMaterial (char *name) { return NULL; }
+static void CGI_NullR_LightPoint (vec3_t point, vec3_t light) { Vec3Set (light, 1, 1, 1); }
+static void CGI_NullR_TransformVectorToScreen (refDef_t *rd, vec3_t in, vec2_t out) { out[0] = out[1] = 0; }
+static void CGI_NullR_SetSky (char *name, float rotate, vec3_t axis) { }
+
+/*
+===============
+CGI_NullRefresh
+===============
+*/
+static void CGI_NullRefresh (cgImport_t *cgi)
+{
+	cgi->R_AddDecal					= CGI_NullR_AddDecal;
+	cgi->R_AddEntity				= CGI_NullR_AddEntity;
+	cgi->R_AddPoly					= CGI_NullR_AddPoly;
+	cgi->R_AddLight					= CGI_NullR_AddLight;
+	cgi->R_AddLightStyle			= CGI_NullR_AddLightStyle;
+
+	cgi->R_ClearScene				= CGI_NullR_ClearScene;
+
+	cgi->R_CullBox					= CGI_NullR_CullBox;
+	cgi->R_CullSphere				= CGI_NullR_CullSphere;
+
+	cgi->R_RegisterFont				= CGI_NullR_RegisterFont;
+	cgi->R_GetFontDimensions		= CGI_NullR_GetFontDimensions;
+	cgi->R_DrawChar					= CGI_NullR_DrawChar;
+	cgi->R_DrawString				= CGI_NullR_DrawString;
+	cgi->R_DrawStringLen			= CGI_NullR_DrawStringLen;
+
+	cgi->R_DrawPic					= CGI_NullR_DrawPic;
+	cgi->R_DrawFill					= CGI_NullR_DrawFill;
+
+	cgi->R_GetRefConfig				= CGI_NullR_GetRefConfig;
+	cgi->R_GetImageSize				= CGI_NullR_GetImageSize;
+
+	cgi->R_CreateDecal				= CGI_NullR_CreateDecal;
+	cgi->R_FreeDecal				= CGI_NullR_FreeDecal;
+
+	cgi->R_RegisterMap				= CGI_NullR_RegisterMap;
+	cgi->R_RegisterModel			= CGI_NullR_RegisterModel;
+	cgi->R_ModelBounds				= CGI_NullR_ModelBounds;
+
+	cgi->R_RenderScene				= CGI_NullR_RenderScene;
+	cgi->R_BeginFrame				= CGI_NullR_BeginFrame;
+	cgi->R_EndFrame					= CGI_NullR_EndFrame;
+
+	cgi->R_LightPoint				= CGI_NullR_LightPoint;
+	cgi->R_TransformVectorToScreen	= CGI_NullR_TransformVectorToScreen;
+	cgi->R_SetSky					= CGI_NullR_SetSky;
+
+	cgi->R_RegisterPic				= CGI_NullR_RegisterMaterial;
+	cgi->R_RegisterPoly				= CGI_NullR_RegisterMaterial;
+	cgi->R_RegisterSkin				= CGI_NullR_RegisterMaterial;
+}
+
+// ==========================================================================
+
 /*
 ===============
 CGI_Alloc
@@ -628,6 +847,7 @@ void CL_CGameAPI_Init (void)
 
 	cgi.CL_ForwardCmdToServer		= CL_ForwardCmdToServer;
 	cgi.CL_ResetServerCount			= CL_ResetServerCount;
+	cgi.CL_LoadPhase				= CL_LoadPhase;
 
 	cgi.CM_BoxTrace					= CM_BoxTrace;
 	cgi.CM_HeadnodeForBox			= CM_HeadnodeForBox;
@@ -637,6 +857,7 @@ void CL_CGameAPI_Init (void)
 	cgi.CM_PointContents			= CM_PointContents;
 	cgi.CM_Trace					= CM_Trace;
 	cgi.CM_TransformedBoxTrace		= CM_TransformedBoxTrace;
+	cgi.CM_BoxTraceBatch			= CM_BoxTraceBatch;
 	cgi.CM_TransformedPointContents = CM_TransformedPointContents;
 
 	cgi.Cmd_AddCommand				= CGI_Cmd_AddCommand;
@@ -776,6 +997,9 @@ void CL_CGameAPI_Init (void)
 	cgi.R_RegisterPoly				= R_RegisterPoly;
 	cgi.R_RegisterSkin				= R_RegisterSkin;
 
+	if (cls.headless)
+		CGI_NullRefresh (&cgi);
+
 	cgi.Snd_RegisterSound			= Snd_RegisterSound;
 	cgi.Snd_StartLocalSound			= Snd_StartLocalSound;
 	cgi.Snd_StartSound				= Snd_StartSound;
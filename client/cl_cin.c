@@ -292,8 +292,8 @@ CIN_LoadPCX
 */
 static qBool CIN_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *height)
 {
-	byte		*raw;
-	pcxHeader_t	*pcx;
+	byte		*buffer, *raw;
+	pcxHeader_t	*pcx, header;
 	int			x, y, fileLen;
 	int			dataByte, runLength;
 	byte		*out, *pix;
@@ -304,12 +304,13 @@ static qBool CIN_LoadPCX (char *name, byte **pic, byte **palette, int *width, in
 		*palette = NULL;
 
 	// Load the file
-	fileLen = FS_LoadFile (name, (void **)&raw, NULL);
-	if (!raw || fileLen <= 0)
+	fileLen = FS_LoadFile (name, (void **)&buffer, NULL);
+	if (!buffer || fileLen <= 0)
 		return qFalse;
 
-	// Parse the PCX file
-	pcx = (pcxHeader_t *)raw;
+	// Parse the PCX file, swapping a copy since the buffer may be a read-only pack view
+	header = *(pcxHeader_t *)buffer;
+	pcx = &header;
 
 	pcx->xMin = LittleShort (pcx->xMin);
 	pcx->yMin = LittleShort (pcx->yMin);
@@ -320,7 +321,7 @@ static qBool CIN_LoadPCX (char *name, byte **pic, byte **palette, int *width, in
 	pcx->bytesPerLine = LittleShort (pcx->bytesPerLine);
 	pcx->paletteType = LittleShort (pcx->paletteType);
 
-	raw = &pcx->data;
+	raw = &((pcxHeader_t *)buffer)->data;
 
 	// Sanity checks
 	if (pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1) {
@@ -346,7 +347,7 @@ static qBool CIN_LoadPCX (char *name, byte **pic, byte **palette, int *width, in
 
 	if (palette) {
 		*palette = Mem_PoolAlloc (768, cl_cinSysPool, 0);
-		memcpy (*palette, (byte *)pcx + fileLen - 768, 768);
+		memcpy (*palette, buffer + fileLen - 768, 768);
 	}
 
 	if (width)
@@ -370,7 +371,7 @@ static qBool CIN_LoadPCX (char *name, byte **pic, byte **palette, int *width, in
 		}
 	}
 
-	if (raw - (byte *)pcx > fileLen) {
+	if (raw - buffer > fileLen) {
 		Com_DevPrintf (PRNT_WARNING, "CIN_LoadPCX: PCX file %s was malformed", name);
 		Mem_Free (out);
 		out = NULL;
@@ -388,7 +389,7 @@ static qBool CIN_LoadPCX (char *name, byte **pic, byte **palette, int *width, in
 
 	if (!pic)
 		Mem_Free (out);
-	FS_FreeFile (pcx);
+	FS_FreeFile (buffer);
 
 	return qTrue;
 }
@@ -292,6 +292,123 @@ void CL_WriteDemoPacketEntities (const frame_t *from, frame_t *to, netMsg_t *msg
 }
 
 
+/*
+====================
+CL_WriteDemoMessage
+
+Writes a message prefixed by its length, counting the bytes for the index
+====================
+*/
+static void CL_WriteDemoMessage (byte *data, int length)
+{
+	int		swLen;
+
+	swLen = LittleLong (length);
+	FS_Write (&swLen, sizeof (swLen), cls.demoFile);
+	if (length)
+		FS_Write (data, length, cls.demoFile);
+
+	cls.demoBytes += sizeof (swLen) + length;
+}
+
+
+/*
+====================
+CL_WriteDemoKeyframe
+
+Indexes the message about to be written, which holds a non-delta frame.
+The whole configstring table goes in a message of its own first, empty slots
+cleared, so seeking here doesn't depend on anything skipped or left behind.
+====================
+*/
+static void CL_WriteDemoKeyframe (void)
+{
+	byte		buf_data[MAX_SV_USABLEMSG];
+	netMsg_t	buf;
+	int			i;
+
+	cls.demoKeyframe = qFalse;
+	if (cls.numDemoKeys == DEMO_MAX_KEYS) {
+		Com_DevPrintf (PRNT_WARNING, "CL_WriteDemoKeyframe: index full, the rest of the demo won't be seekable\n");
+		cls.demoIndexing = qFalse;
+		return;
+	}
+
+	cls.demoKeys[cls.numDemoKeys].time = cls.demoTime;
+	cls.demoKeys[cls.numDemoKeys].offset = cls.demoBytes;
+	cls.numDemoKeys++;
+
+	MSG_Init (&buf, buf_data, sizeof (buf_data));
+	for (i=0 ; i<MAX_CFGSTRINGS ; i++) {
+		if (buf.curSize + (int)strlen (cl.configStrings[i]) + 32 > buf.maxSize) {
+			CL_WriteDemoMessage (buf.data, (int) buf.curSize);
+			buf.curSize = 0;
+		}
+
+		MSG_WriteByte (&buf, SVC_CONFIGSTRING);
+		MSG_WriteShort (&buf, i);
+		MSG_WriteString (&buf, cl.configStrings[i]);
+	}
+
+	if (buf.curSize)
+		CL_WriteDemoMessage (buf.data, (int) buf.curSize);
+}
+
+
+/*
+====================
+CL_DemoFrameParsed
+
+Keeps the recorded time running and asks the server for a non-delta frame
+every demo_keyframes seconds, the same way recording begins.
+====================
+*/
+void CL_DemoFrameParsed (void)
+{
+	if (!cls.demoIndexing || !cl.frame.valid)
+		return;
+
+	// Frame numbers only ever count up within a level
+	if (cls.demoLastFrame && cl.frame.serverFrame > cls.demoLastFrame)
+		cls.demoTime += (cl.frame.serverFrame - cls.demoLastFrame) * 100;
+	cls.demoLastFrame = cl.frame.serverFrame;
+
+	if (cls.demoKeyframeDue) {
+		// Frames after this one only delta from it or later, as nothing
+		// else has been acknowledged since the request went out
+		if (cl.frame.deltaFrame <= 0) {
+			cls.demoKeyframeDue = qFalse;
+			cls.demoKeyframe = qTrue;
+			cls.demoLastKeyTime = cls.demoTime;
+		}
+		return;
+	}
+
+	if (cls.demoTime - cls.demoLastKeyTime >= cl_demoKeyframes->floatVal * 1000)
+		cls.demoKeyframeDue = qTrue;
+}
+
+
+/*
+====================
+CL_DemoMapChanged
+
+The index only covers the level recording began on, a seek past a
+serverdata message would miss the level load.
+====================
+*/
+void CL_DemoMapChanged (void)
+{
+	if (!cls.demoIndexing)
+		return;
+
+	Com_DevPrintf (0, "Level changed, demo keyframes stop here\n");
+	cls.demoIndexing = qFalse;
+	cls.demoKeyframeDue = qFalse;
+	cls.demoKeyframe = qFalse;
+}
+
+
 /*
 ====================
 CL_WriteDemoMessageChunk
@@ -306,8 +423,6 @@ void CL_WriteDemoMessageChunk (byte *buffer, size_t length, qBool forceFlush)
 
 	if (forceFlush) {
 		if (!cls.demoWaiting) {
-			int	swLen;
-
 			if (cl.demoBuffer.overFlowed) {
 				Com_DevPrintf (0, "Dropped demo frame, maximum message size exceeded: %i > %i\n", cl.demoBuffer.curSize, cl.demoBuffer.maxSize);
 
@@ -316,9 +431,9 @@ void CL_WriteDemoMessageChunk (byte *buffer, size_t length, qBool forceFlush)
 				MSG_WriteByte (&cl.demoBuffer, SVC_NOP);
 			}
 
-			swLen = LittleLong ((int) cl.demoBuffer.curSize);
-			FS_Write (&swLen, sizeof (swLen), cls.demoFile);
-			FS_Write (cl.demoFrame, cl.demoBuffer.curSize, cls.demoFile);
+			if (cls.demoKeyframe)
+				CL_WriteDemoKeyframe ();
+			CL_WriteDemoMessage (cl.demoFrame, (int) cl.demoBuffer.curSize);
 		}
 		MSG_Clear (&cl.demoBuffer);
 	}
@@ -332,21 +447,52 @@ void CL_WriteDemoMessageChunk (byte *buffer, size_t length, qBool forceFlush)
 ====================
 CL_WriteDemoMessageFull
 
-Dumps the current net message, prefixed by the length
+Dumps a whole server message, prefixed by the length
 This is only used for ORIGINAL_PROTOCOL_VERSION
 ====================
 */
-void CL_WriteDemoMessageFull (void)
+void CL_WriteDemoMessageFull (byte *data, int length)
 {
-	int		len, swLen;
-
-	// The first eight bytes are just packet sequencing stuff
-	len = (int) cls.netMessage.curSize - 8;
-	swLen = LittleLong (len);
-	if (swLen) {
-		FS_Write (&swLen, sizeof (swLen), cls.demoFile);
-		FS_Write (cls.netMessage.data+8, len, cls.demoFile);
+	if (length <= 0)
+		return;
+
+	if (cls.demoKeyframe)
+		CL_WriteDemoKeyframe ();
+	CL_WriteDemoMessage (data, length);
+}
+
+
+/*
+====================
+CL_SplitDemoMessage
+
+A fragmented reliable can be far larger than a demo message, and only a
+client that took fragments could be sent it whole on playback. It's written
+as a run of ordinary messages instead, cut at command boundaries. Called at
+the start of each command parsed from it, then with its end.
+====================
+*/
+void CL_SplitDemoMessage (size_t cmdOfs, qBool end)
+{
+	byte	*data = cls.netMessage.data;
+
+	if (cmdOfs - cls.demoSplitStart > MAX_SV_USABLEMSG) {
+		if (cls.demoSplitLast > cls.demoSplitStart) {
+			CL_WriteDemoMessageFull (data + cls.demoSplitStart, (int)(cls.demoSplitLast - cls.demoSplitStart));
+			cls.demoSplitStart = cls.demoSplitLast;
+		}
+
+		// A lone command that big can't be cut, it goes out as it is
+		if (cmdOfs - cls.demoSplitStart > MAX_SV_USABLEMSG) {
+			Com_Printf (PRNT_WARNING, "WARNING: %i byte demo message, older clients can't play it back\n", (int)(cmdOfs - cls.demoSplitStart));
+			CL_WriteDemoMessageFull (data + cls.demoSplitStart, (int)(cmdOfs - cls.demoSplitStart));
+			cls.demoSplitStart = cmdOfs;
+		}
 	}
+	cls.demoSplitLast = cmdOfs;
+
+	if (end)
+		CL_WriteDemoMessageFull (data + cls.demoSplitStart, (int)(cmdOfs - cls.demoSplitStart));
 }
 
 
@@ -359,7 +505,7 @@ qBool CL_StartDemoRecording (char *name)
 {
 	byte				buf_data[MAX_SV_USABLEMSG];
 	netMsg_t			buf;
-	int					i, len;
+	int					i;
 	entityStateOld_t	*ent, temp;
 	entityStateOld_t	nullstate;
 
@@ -370,6 +516,9 @@ qBool CL_StartDemoRecording (char *name)
 		return qFalse;
 	}
 
+	// Keep the disk out of the frame
+	FS_SetAsyncWrite (cls.demoFile);
+
 	cls.demoRecording = qTrue;
 
 	if (cls.serverProtocol == ENHANCED_PROTOCOL_VERSION) {
@@ -380,6 +529,16 @@ qBool CL_StartDemoRecording (char *name)
 
 	// Don't start saving messages until a non-delta compressed message is received
 	cls.demoWaiting = qTrue;
+	cls.demoBytes = 0;
+
+	// The first frame is the first keyframe
+	cls.demoIndexing = (cl_demoKeyframes->floatVal > 0);
+	cls.demoKeyframeDue = cls.demoIndexing;
+	cls.demoKeyframe = qFalse;
+	cls.demoTime = 0;
+	cls.demoLastFrame = 0;
+	cls.demoLastKeyTime = 0;
+	cls.numDemoKeys = 0;
 
 	// Write out messages to hold the startup information
 	MSG_Init (&buf, buf_data, sizeof (buf_data));
@@ -398,9 +557,7 @@ qBool CL_StartDemoRecording (char *name)
 		if (cl.configStrings[i][0]) {
 			if (buf.curSize + (int)strlen (cl.configStrings[i]) + 32 > buf.maxSize) {
 				// write it out
-				len = LittleLong ((int) buf.curSize);
-				FS_Write (&len, sizeof (len), cls.demoFile);
-				FS_Write (buf.data, buf.curSize, cls.demoFile);
+				CL_WriteDemoMessage (buf.data, (int) buf.curSize);
 				buf.curSize = 0;
 			}
 
@@ -421,9 +578,7 @@ qBool CL_StartDemoRecording (char *name)
 
 		if (buf.curSize + 64 > buf.maxSize) {
 			// Write it out
-			len = LittleLong ((int) buf.curSize);
-			FS_Write (&len, sizeof (len), cls.demoFile);
-			FS_Write (buf.data, buf.curSize, cls.demoFile);
+			CL_WriteDemoMessage (buf.data, (int) buf.curSize);
 			buf.curSize = 0;
 		}
 
@@ -435,9 +590,7 @@ qBool CL_StartDemoRecording (char *name)
 	MSG_WriteString (&buf, "precache\n");
 
 	// Write it to the demo file
-	len = LittleLong ((int) buf.curSize);
-	FS_Write (&len, sizeof (len), cls.demoFile);
-	FS_Write (buf.data, buf.curSize, cls.demoFile);
+	CL_WriteDemoMessage (buf.data, (int) buf.curSize);
 
 	// The rest of the demo file will be individual frames
 	return qTrue;
@@ -451,11 +604,28 @@ CL_StopDemoRecording
 */
 void CL_StopDemoRecording (void)
 {
-	int		len;
+	int		len, i;
 
 	// Write to file
 	len = -1;
 	FS_Write (&len, sizeof (len), cls.demoFile);
+
+	// Players stop at the -1, the index goes behind it
+	if (cls.numDemoKeys) {
+		for (i=0 ; i<cls.numDemoKeys ; i++) {
+			cls.demoKeys[i].time = LittleLong (cls.demoKeys[i].time);
+			cls.demoKeys[i].offset = LittleLong (cls.demoKeys[i].offset);
+		}
+		FS_Write (cls.demoKeys, sizeof (demoIndex_t) * cls.numDemoKeys, cls.demoFile);
+
+		len = LittleLong (cls.numDemoKeys);
+		FS_Write (&len, sizeof (len), cls.demoFile);
+		len = LittleLong (DEMO_INDEX_MAGIC);
+		FS_Write (&len, sizeof (len), cls.demoFile);
+
+		Com_DevPrintf (0, "Indexed %i demo keyframes\n", cls.numDemoKeys);
+		cls.numDemoKeys = 0;
+	}
 	FS_CloseFile (cls.demoFile);
 
 	if (cls.serverProtocol == ENHANCED_PROTOCOL_VERSION) {
@@ -468,3 +638,150 @@ void CL_StopDemoRecording (void)
 	cls.demoFile = 0;
 	cls.demoRecording = qFalse;
 }
+
+/*
+=============================================================================
+
+	DEMO BENCHMARK
+
+=============================================================================
+*/
+
+clDemoBench_t	cl_demoBench;
+
+static byte		*cl_demoBenchFile;
+
+/*
+================
+CL_DemoBenchLine
+================
+*/
+static void CL_DemoBenchLine (char *name, uint32 time, uint32 calls)
+{
+	Com_Printf (0, "%-24s %9.2fms %8u calls %8.2fus/call\n",
+		name, time / 1000.0f, calls, calls ? (float)time / (float)calls : 0.0f);
+}
+
+
+/*
+================
+CL_DemoBench_f
+
+Feeds a demo straight through the client parser as fast as it will go. With
+cl_headless each new frame is also handed to cgame to build its scene.
+================
+*/
+void CL_DemoBench_f (void)
+{
+	char		name[MAX_OSPATH];
+	byte		*data;
+	int			fileLen, offset, len;
+	int			lastFrame;
+	uint32		startTime, loadTime, totalTime;
+	uint32		mapCheckSum;
+
+	if (Cmd_Argc () != 2) {
+		Com_Printf (0, "usage: demobench <demoname>\n");
+		return;
+	}
+	if (Com_ClientState () != CA_DISCONNECTED) {
+		Com_Printf (PRNT_WARNING, "demobench: disconnect first\n");
+		return;
+	}
+
+	// A drop in the middle of the last run leaves this behind
+	if (cl_demoBenchFile) {
+		FS_FreeFile (cl_demoBenchFile);
+		cl_demoBenchFile = NULL;
+	}
+
+	Q_snprintfz (name, sizeof (name), "demos/%s", Cmd_Argv (1));
+	Com_DefaultExtension (name, ".dm2", sizeof (name));
+	fileLen = FS_LoadFile (name, (void **)&cl_demoBenchFile, NULL);
+	if (!cl_demoBenchFile || fileLen <= 0) {
+		Com_Printf (PRNT_ERROR, "demobench: couldn't load %s\n", name);
+		return;
+	}
+	data = cl_demoBenchFile;
+
+	memset (&cl_demoBench, 0, sizeof (cl_demoBench));
+	cl_demoBench.active = qTrue;
+
+	// Not connected to anything, the disconnect at the end goes to loopback
+	CL_SetState (CA_CONNECTED);
+	cls.netChan.remoteAddress.naType = NA_LOOPBACK;
+
+	Com_Printf (0, "Benchmarking %s (%i bytes)%s...\n", name, fileLen, cls.headless ? "" : ", not building scenes without cl_headless");
+
+	lastFrame = -1;
+	loadTime = 0;
+	startTime = Sys_UMicroseconds ();
+	for (offset=0 ; offset+4<=fileLen ; offset+=len) {
+		uint32	parseStart;
+
+		memcpy (&len, data+offset, 4);
+		len = LittleLong (len);
+		offset += 4;
+		if (len == -1)
+			break;
+		if (len <= 0 || len > NETCHAN_MAX_BULK || offset+len > fileLen) {
+			Com_Printf (PRNT_WARNING, "demobench: bad message length %i at offset %i, stopping\n", len, offset-4);
+			break;
+		}
+
+		// Parsed in place, reassembled reliables are recorded larger than a packet
+		MSG_Init (&cls.netMessage, data+offset, len);
+		cls.netMessage.curSize = len;
+		MSG_BeginReading (&cls.netMessage);
+
+		parseStart = Sys_UMicroseconds ();
+		CL_ParseServerMessage ();
+		cl_demoBench.parseTime += Sys_UMicroseconds () - parseStart;
+		MSG_Init (&cls.netMessage, cls.netBuffer, sizeof (cls.netBuffer));
+		cl_demoBench.numMessages++;
+
+		// The same steps "precache" would take, kept out of the totals
+		if (cl_demoBench.precache) {
+			uint32	loadStart = Sys_UMicroseconds ();
+
+			cl_demoBench.precache = qFalse;
+			CM_LoadMap (cl.configStrings[CS_MODELS+1], qTrue, &mapCheckSum);
+			CL_CGModule_LoadMap ();
+			loadTime += Sys_UMicroseconds () - loadStart;
+		}
+
+		// Build the scene for every new frame, one server frame apart
+		if (cls.headless && cls.mapLoaded && cl.frame.valid && cl.frame.serverFrame != lastFrame) {
+			uint32	viewStart;
+
+			lastFrame = cl.frame.serverFrame;
+			cls.realTime += 100;
+			cls.netFrameTime = cls.trueNetFrameTime = 0.1f;
+			cls.refreshFrameTime = cls.trueRefreshFrameTime = 0.1f;
+
+			viewStart = Sys_UMicroseconds ();
+			CL_CGModule_RenderView (0);
+			cl_demoBench.viewTime += Sys_UMicroseconds () - viewStart;
+			cl_demoBench.numViews++;
+		}
+	}
+	totalTime = Sys_UMicroseconds () - startTime - loadTime;
+
+	FS_FreeFile (cl_demoBenchFile);
+	cl_demoBenchFile = NULL;
+
+	// Report
+	if (!totalTime)
+		totalTime = 1;
+	Com_Printf (0, "%u messages, %u frames, %u entity deltas in %.2fms (level load of %.2fms not counted)\n",
+		cl_demoBench.numMessages, cl_demoBench.numFrames, cl_demoBench.numDeltas, totalTime / 1000.0f, loadTime / 1000.0f);
+	Com_Printf (0, "%.0f messages/sec, %.0f entities/sec\n",
+		cl_demoBench.numMessages * 1000000.0 / totalTime, cl_demoBench.numDeltas * 1000000.0 / totalTime);
+	CL_DemoBenchLine ("CL_ParseServerMessage", cl_demoBench.parseTime, cl_demoBench.numMessages);
+	CL_DemoBenchLine ("CL_ParsePacketEntities", cl_demoBench.packetTime, cl_demoBench.numFrames);
+	CL_DemoBenchLine ("CL_ParseDelta", cl_demoBench.deltaTime, cl_demoBench.numDeltas);
+	if (cls.headless)
+		CL_DemoBenchLine ("cgame RenderView", cl_demoBench.viewTime, cl_demoBench.numViews);
+
+	CL_Disconnect (qFalse);
+}
@@ -141,19 +141,13 @@ qBool CL_CheckOrDownloadFile (char *fileName)
 		Com_Printf (0, "Resuming %s\n", cls.download.name);
 
 		MSG_WriteByte (&cls.netChan.message, CLC_STRINGCMD);
-		if (cls.serverProtocol == ENHANCED_PROTOCOL_VERSION)
-			MSG_WriteString (&cls.netChan.message, Q_VarArgs ("download \"%s\" %i udp-zlib", cls.download.name, len));
-		else
-			MSG_WriteString (&cls.netChan.message, Q_VarArgs ("download \"%s\" %i", cls.download.name, len));
+		MSG_WriteString (&cls.netChan.message, Q_VarArgs ("download \"%s\" %i udp-zlib", cls.download.name, len));
 	}
 	else {
 		Com_Printf (0, "Downloading %s\n", cls.download.name);
 
 		MSG_WriteByte (&cls.netChan.message, CLC_STRINGCMD);
-		if (cls.serverProtocol == ENHANCED_PROTOCOL_VERSION)
-			MSG_WriteString (&cls.netChan.message, Q_VarArgs ("download \"%s\" 0 udp-zlib", cls.download.name));
-		else
-			MSG_WriteString (&cls.netChan.message, Q_VarArgs ("download \"%s\"", cls.download.name));
+		MSG_WriteString (&cls.netChan.message, Q_VarArgs ("download \"%s\" 0 udp-zlib", cls.download.name));
 	}
 
 	cls.forcePacket = qTrue;
@@ -253,11 +247,19 @@ void CL_ParseDownload (qBool compressed)
 		CL_DownloadFileName (oldName, sizeof (oldName), cls.download.tempName);
 		CL_DownloadFileName (newName, sizeof (newName), cls.download.name);
 		rn = rename (oldName, newName);
-		if (rn)
+		if (rn) {
 			Com_Printf (PRNT_ERROR, "Failed to rename!\n");
-		else
+		}
+		else {
 			Com_Printf (0, "Download of %s completed\n", newName);
 
+			// Let the file index know about it
+			if (cl_downloadToBase->intVal)
+				FS_InvalidateIndex ();
+			else
+				FS_AddLooseFile (cls.download.name);
+		}
+
 		cls.download.file = NULL;
 		cls.download.percent = 0;
 		cls.download.name[0] = '\0';
@@ -285,6 +287,84 @@ void CL_ResetDownload (void)
 }
 
 
+/*
+==============
+CL_PrefetchMedia
+
+Hands the media named in the configstrings to the job workers, so that
+it's read and decoded by the time the cgame registers it.
+==============
+*/
+void CL_PrefetchMedia (void)
+{
+	char	*name;
+	uint32	numFiles;
+	int		i;
+
+	if (!Job_NumWorkers ())
+		return;
+
+	numFiles = 0;
+
+	// Models, except inline and view weapon models
+	for (i=2 ; i<MAX_CS_MODELS && cl.configStrings[CS_MODELS+i][0] ; i++) {
+		name = cl.configStrings[CS_MODELS+i];
+		if (name[0] == '*' || name[0] == '#')
+			continue;
+
+		FS_PrefetchFile (name);
+		numFiles++;
+	}
+
+	// Sounds, except sexed sounds
+	for (i=1 ; i<MAX_CS_SOUNDS && cl.configStrings[CS_SOUNDS+i][0] ; i++) {
+		name = cl.configStrings[CS_SOUNDS+i];
+		if (name[0] == '*')
+			continue;
+
+		if (name[0] == '#')
+			FS_PrefetchFile (name+1);
+		else
+			FS_PrefetchFile (Q_VarArgs ("sound/%s", name));
+		numFiles++;
+	}
+
+	// Pics, named the way CG_RegisterPic does
+	for (i=1 ; i<MAX_CS_IMAGES && cl.configStrings[CS_IMAGES+i][0] ; i++) {
+		name = cl.configStrings[CS_IMAGES+i];
+		if (name[0] == '/' || name[0] == '\\')
+			R_PrefetchImage (name+1);
+		else
+			R_PrefetchImage (Q_VarArgs ("pics/%s.tga", name));
+		numFiles++;
+	}
+
+	CL_LoadPrefetched (numFiles);
+}
+
+
+/*
+==============
+CL_PrefetchMapTextures
+
+The wall textures are known once the collision map is loaded.
+==============
+*/
+void CL_PrefetchMapTextures (void)
+{
+	int		numTexInfo, i;
+
+	if (!Job_NumWorkers ())
+		return;
+
+	numTexInfo = CM_NumTexInfo ();
+	for (i=0 ; i<numTexInfo ; i++)
+		R_PrefetchImage (Q_VarArgs ("textures/%s.wal", CM_SurfRName (i)));
+
+	CL_LoadPrefetched (numTexInfo);
+}
+
+
 /*
 ==============
 CL_RequestNextDownload
@@ -535,11 +615,14 @@ void CL_RequestNextDownload (void)
 	if (cl_downloadCheck == ENV_CNT) {
 		cl_downloadCheck++;
 
+		CL_LoadPhase ("precache checks");
 		CM_LoadMap (cl.configStrings[CS_MODELS+1], qTrue, &mapCheckSum);
 		if (mapCheckSum != (uint32) atoi(cl.configStrings[CS_MAPCHECKSUM])) {
 			Com_Error (ERR_DROP, "Local map version differs from server: %i != '%s'", mapCheckSum, cl.configStrings[CS_MAPCHECKSUM]);
 			return;
 		}
+		CL_LoadPhase ("collision map");
+		CL_PrefetchMapTextures ();
 	}
 
 	//
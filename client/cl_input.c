@@ -649,7 +649,7 @@ void CL_SendCmd (void)
 	** Let the server know what the last frame we got was,
 	** so the next message can be delta compressed
 	*/
-	if (cl_nodelta->intVal || !cl.frame.valid || cls.demoWaiting)
+	if (cl_nodelta->intVal || !cl.frame.valid || cls.demoWaiting || cls.demoKeyframeDue)
 		MSG_WriteLong (&buf, -1);	// no compression
 	else
 		MSG_WriteLong (&buf, cl.frame.serverFrame);
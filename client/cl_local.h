@@ -210,6 +210,22 @@ typedef struct clientStatic_s {
 	fileHandle_t		demoFile;
 	qBool				demoRecording;
 	qBool				demoWaiting;				// don't record until a non-delta message is received
+	int					demoBytes;					// written so far, for keyframe offsets
+
+	// a fragmented reliable being cut into demo messages, see CL_SplitDemoMessage
+	qBool				demoSplitting;
+	size_t				demoSplitStart;				// first byte not yet written
+	size_t				demoSplitLast;				// start of the last command parsed
+
+	// keyframe index, see demo_keyframes
+	qBool				demoIndexing;				// off once full or the map changes
+	qBool				demoKeyframeDue;			// asking the server for a non-delta frame
+	qBool				demoKeyframe;				// the message being parsed holds one
+	int					demoTime;					// msec recorded
+	uint32				demoLastFrame;
+	int					demoLastKeyTime;
+	int					numDemoKeys;
+	demoIndex_t			demoKeys[DEMO_MAX_KEYS];
 
 	//
 	// cgame information
@@ -221,10 +237,37 @@ typedef struct clientStatic_s {
 	// video settings
 	//
 	refConfig_t			refConfig;
+	qBool				headless;					// no video or sound, see cl_headless
 } clientStatic_t;
 
 extern clientStatic_t	cls;
 
+/*
+=============================================================================
+
+	DEMO BENCHMARK
+
+	Totals gathered by demobench, times are in microseconds
+=============================================================================
+*/
+
+typedef struct clDemoBench_s {
+	qBool				active;
+	qBool				precache;					// the demo asked for the level to load
+
+	uint32				numMessages;
+	uint32				numFrames;
+	uint32				numDeltas;
+	uint32				numViews;
+
+	uint32				parseTime;					// CL_ParseServerMessage
+	uint32				packetTime;					// CL_ParsePacketEntities
+	uint32				deltaTime;					// CL_ParseDelta
+	uint32				viewTime;					// cgame RenderView
+} clDemoBench_t;
+
+extern clDemoBench_t	cl_demoBench;
+
 /*
 =============================================================================
 
@@ -250,6 +293,8 @@ extern cVar_t	*cl_stereo_separation;
 extern cVar_t	*cl_lightlevel;
 extern cVar_t	*cl_paused;
 extern cVar_t	*cl_timedemo;
+extern cVar_t	*cl_demoKeyframes;
+extern cVar_t	*cl_headless;
 
 extern cVar_t	*freelook;
 extern cVar_t	*lookspring;
@@ -301,6 +346,11 @@ qBool		CL_ACAPI_Init (void);
 // cl_cgapi.c
 //
 
+void		CL_BeginLoadTimer (void);
+void		CL_LoadPhase (char *name);
+void		CL_LoadPrefetched (uint32 numFiles);
+void		CL_LoadTime_f (void);
+
 void		CL_CGModule_LoadMap (void);
 
 void		CL_CGModule_UpdateConnectInfo (void);
@@ -374,7 +424,13 @@ void		CL_DrawConsole (void);
 void		CL_WriteDemoPlayerstate (frame_t *from, frame_t *to, netMsg_t *msg);
 void		CL_WriteDemoPacketEntities (const frame_t *from, frame_t *to, netMsg_t *msg);
 void		CL_WriteDemoMessageChunk (byte *buffer, size_t length, qBool forceFlush);
-void		CL_WriteDemoMessageFull (void);
+void		CL_WriteDemoMessageFull (byte *data, int length);
+void		CL_SplitDemoMessage (size_t cmdOfs, qBool end);
+
+void		CL_DemoFrameParsed (void);
+void		CL_DemoMapChanged (void);
+
+void		CL_DemoBench_f (void);
 
 qBool		CL_StartDemoRecording (char *name);
 void		CL_StopDemoRecording (void);
@@ -390,6 +446,9 @@ void		CL_ParseDownload (qBool compressed);
 void		CL_ResetDownload (void);
 void		CL_RequestNextDownload (void);
 
+void		CL_PrefetchMedia (void);
+void		CL_PrefetchMapTextures (void);
+
 #ifdef CL_HTTPDL
 void		CL_HTTPDL_Init (void);
 void		CL_HTTPDL_SetServer (char *url);
@@ -42,6 +42,8 @@ cVar_t	*cl_shownet;
 cVar_t	*cl_stereo_separation;
 
 cVar_t	*cl_timedemo;
+cVar_t	*cl_demoKeyframes;
+cVar_t	*cl_headless;
 cVar_t	*cl_timeout;
 cVar_t	*cl_timestamp;
 
@@ -193,7 +195,7 @@ static void CL_SendConnectPacket (int useProtocol)
 		Netchan_OutOfBandPrint (NS_CLIENT, &adr, "connect %i %i %i \"%s\" %u\n",
 			cls.serverProtocol, port, cls.challenge, Cvar_BitInfo (CVAR_USERINFO), msgLen);
 	else
-		Netchan_OutOfBandPrint (NS_CLIENT, &adr, "connect %i %i %i \"%s\"\n",
+		Netchan_OutOfBandPrint (NS_CLIENT, &adr, "connect %i %i %i \"%s\" fragments\n",
 			cls.serverProtocol, port, cls.challenge, Cvar_BitInfo (CVAR_USERINFO));
 }
 
@@ -312,6 +314,8 @@ void CL_Disconnect (qBool openMenu)
 
 	cls.connectCount = 0;
 	cls.connectTime = -99999;	// CL_CheckForResend () will fire immediately
+	cl_demoBench.active = qFalse;
+	cls.demoSplitting = qFalse;
 
 	CIN_StopCinematic ();
 
@@ -324,6 +328,10 @@ void CL_Disconnect (qBool openMenu)
 	Netchan_Transmit (&cls.netChan, 11, final);
 	Netchan_Transmit (&cls.netChan, 11, final);
 	Netchan_Transmit (&cls.netChan, 11, final);
+	Netchan_Release (&cls.netChan);
+
+	// A drop while parsing a zpacket or fragment leaves netMessage pointing at it
+	MSG_Init (&cls.netMessage, cls.netBuffer, sizeof (cls.netBuffer));
 
 	// Stop download
 	if (cls.download.file) {
@@ -397,8 +405,15 @@ static void CL_ClientConnect_CP (void)
 
 	Com_DevPrintf (0, "client_connect: new\n");
 
+	Netchan_Release (&cls.netChan);
 	Netchan_Setup (NS_CLIENT, &cls.netChan, &cls.netFrom, cls.serverProtocol, cls.quakePort, 0);
 
+	// The server agreed to send reliables larger than a packet
+	for (i=1 ; i<Cmd_Argc() ; i++) {
+		if (!strcmp (Cmd_Argv (i), "fragments"))
+			cls.netChan.fragments = qTrue;
+	}
+
 	// Parse arguments (R1Q2 enhanced protocol only)
 	if (cls.serverProtocol == ENHANCED_PROTOCOL_VERSION) {
 		buff = NET_AdrToString (&cls.netChan.remoteAddress);
@@ -637,6 +652,10 @@ CL_ImageMediaInit
 */
 void CL_ImageMediaInit (void)
 {
+	// Nothing to register them with
+	if (cls.headless)
+		return;
+
 	clMedia.cinMaterial			= R_RegisterPic ("***r_cinTexture***");
 	clMedia.consoleMaterial		= R_RegisterPic ("pics/conback.tga");
 	clMedia.whiteTexture		= R_RegisterPic ("***r_whiteTexture***");
@@ -815,6 +834,8 @@ CL_ReadPackets
 */
 static void CL_ReadPackets (void)
 {
+	size_t	payloadOfs;
+
 	while (NET_GetPacket (NS_CLIENT, &cls.netFrom, &cls.netMessage)) {
 		// Remote command packet
 		if (*(int *)cls.netMessage.data == -1) {
@@ -843,11 +864,35 @@ static void CL_ReadPackets (void)
 		if (cls.netChan.gotReliable && Com_ClientState() == CA_CONNECTED)
 			cls.forcePacket = qTrue;
 
+		// Past the sequencing, and the fragment piece if there was one
+		payloadOfs = cls.netMessage.readCount;
+
+		// A fragmented reliable just completed, it goes ahead of the rest of the packet
+		if (cls.netChan.fragmentReady) {
+			netMsg_t	old;
+
+			old = cls.netMessage;
+			MSG_Init (&cls.netMessage, cls.netChan.fragmentBuff, cls.netChan.fragmentLength);
+			cls.netMessage.curSize = cls.netChan.fragmentLength;
+
+			// Recorded as ordinary sized messages ahead of the rest of the packet
+			cls.demoSplitting = (cls.demoRecording && !cls.demoWaiting && cls.serverProtocol == ORIGINAL_PROTOCOL_VERSION);
+			cls.demoSplitStart = cls.demoSplitLast = 0;
+			CL_ParseServerMessage ();
+			if (cls.demoSplitting)
+				CL_SplitDemoMessage (cls.netMessage.curSize, qTrue);
+			cls.demoSplitting = qFalse;
+			cls.netMessage = old;
+
+			Netchan_FreeFragments (&cls.netChan);
+		}
+
 		CL_ParseServerMessage ();
 
 		// We don't know if it is ok to save a demo message until after we have parsed the frame
+		// A packet that only carried a fragment piece has nothing left to save
 		if (cls.demoRecording && !cls.demoWaiting && cls.serverProtocol == ORIGINAL_PROTOCOL_VERSION)
-			CL_WriteDemoMessageFull ();
+			CL_WriteDemoMessageFull (cls.netMessage.data + payloadOfs, (int)(cls.netMessage.curSize - payloadOfs));
 	}
 
 	// Check timeout
@@ -871,11 +916,15 @@ CL_SendCommand
 */
 static void CL_SendCommand (void)
 {
+	NET_BeginSendBatch (NS_CLIENT);
+
 	// Send client packet to server
 	CL_SendCmd ();
 
 	// Resend a connection request if necessary
 	CL_CheckForResend ();
+
+	NET_FlushSendBatch (NS_CLIENT);
 }
 
 
@@ -988,8 +1037,8 @@ void CL_Frame (int msec)
 #endif
 	}
 
-	// Render the display
-	if (refreshFrame) {
+	// Render the display, there's nothing to render to when headless
+	if (refreshFrame && !cls.headless) {
 		refreshDelta = 0;
 
 		// Stuff that does not need to happen a lot
@@ -1264,11 +1313,17 @@ before allowing the client into the server
 */
 static void CL_Precache_f (void)
 {
+	// Start reading media while the map loads
+	CL_BeginLoadTimer ();
+	CL_PrefetchMedia ();
+
 	// Yet another hack to let old demos work the old precache sequence
 	if (Cmd_Argc () < 2) {
 		uint32	mapCheckSum;	// For detecting cheater maps
 
 		CM_LoadMap (cl.configStrings[CS_MODELS+1], qTrue, &mapCheckSum);
+		CL_LoadPhase ("collision map");
+		CL_PrefetchMapTextures ();
 		CL_CGModule_LoadMap ();
 		return;
 	}
@@ -1635,6 +1690,7 @@ static void CL_WriteConfig (void)
 
 	fprintf (f, "\n\0");
 	fclose (f);
+	FS_AddLooseFile ((Cmd_Argc () == 2) ? Cmd_Argv (1) : "eglcfg.cfg");
 	Com_Printf (0, "Saved to %s\n", path);
 }
 
@@ -1665,6 +1721,8 @@ static void CL_Register (void)
 	cl_stereo_separation	= Cvar_Register ("cl_stereo_separation",	"0.4",		CVAR_ARCHIVE);
 
 	cl_timedemo				= Cvar_Register ("timedemo",				"0",		CVAR_CHEAT);
+	cl_demoKeyframes		= Cvar_Register ("demo_keyframes",			"0",		CVAR_ARCHIVE);
+	cl_headless				= Cvar_Register ("cl_headless",				"0",		CVAR_READONLY);
 	cl_timeout				= Cvar_Register ("cl_timeout",				"120",		0);
 	cl_timestamp			= Cvar_Register ("cl_timestamp",			"0",		CVAR_ARCHIVE);
 
@@ -1704,7 +1762,9 @@ static void CL_Register (void)
 	Cmd_AddCommand ("changing",			CL_Changing_f,			"");
 	Cmd_AddCommand ("connect",			CL_Connect_f,			"Connects to a server");
 	Cmd_AddCommand ("cmd",				CL_ForwardToServer_f,	"Forwards a command to the server");
+	Cmd_AddCommand ("demobench",		CL_DemoBench_f,			"Times parsing a demo and building its scenes, nothing is drawn");
 	Cmd_AddCommand ("disconnect",		CL_Disconnect_f,		"Disconnects from the current server");
+	Cmd_AddCommand ("loadtime",			CL_LoadTime_f,			"Shows how long each step of the last map load took");
 	Cmd_AddCommand ("download",			CL_Download_f,			"Manually download a file from the server");
 	Cmd_AddCommand ("exit",				CL_Quit_f,				"Exits");
 	Cmd_AddCommand ("pause",			CL_Pause_f,				"Pauses the game");
@@ -1750,8 +1810,16 @@ void CL_ClientInit (void)
 	cl_guiSysPool = Mem_CreatePool ("Client: GUI system");
 	cl_soundSysPool = Mem_CreatePool ("Client: Sound system");
 
-	// Initialize video/sound
-	VID_Init (&cls.refConfig);
+	// Initialize video/sound, cl_headless can only be set from the command line
+	cls.headless = (cl_headless->intVal != 0);
+	if (cls.headless) {
+		Com_Printf (0, "Running headless, no video or sound\n");
+		cls.refConfig.vidWidth = 640;
+		cls.refConfig.vidHeight = 480;
+		R_HeadlessInit ();
+	}
+	else
+		VID_Init (&cls.refConfig);
 
 	// Initialize the net buffer
 	MSG_Init (&cls.netMessage, cls.netBuffer, sizeof (cls.netBuffer));
@@ -1771,14 +1839,16 @@ void CL_ClientInit (void)
 
 	// Load client media
 	CL_MediaInit ();
-	GUI_Init ();
-	CL_CGModule_MainMenu ();
+	if (!cls.headless) {
+		GUI_Init ();
+		CL_CGModule_MainMenu ();
+	}
 
 	// Touch memory
 	Mem_TouchGlobal ();
 
-	// Ready!
-	cls.disableScreen = qFalse;
+	// Ready! A headless client never draws
+	cls.disableScreen = cls.headless;
 }
 
 
@@ -1810,5 +1880,7 @@ void CL_ClientShutdown (qBool error)
 	Snd_Shutdown ();
 
 	IN_Shutdown ();
+	if (cls.headless)
+		R_HeadlessShutdown ();
 	VID_Shutdown ();
 }
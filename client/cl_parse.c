@@ -376,7 +376,15 @@ static void CL_DeltaEntity (frame_t *newFrame, int newNum, entityState_t *old, i
 	cl.parseEntities++;
 	newFrame->numEntities++;
 
-	CL_ParseDelta (old, state, newNum, bits);
+	if (cl_demoBench.active) {
+		uint32	startTime = Sys_UMicroseconds ();
+
+		CL_ParseDelta (old, state, newNum, bits);
+		cl_demoBench.deltaTime += Sys_UMicroseconds () - startTime;
+		cl_demoBench.numDeltas++;
+	}
+	else
+		CL_ParseDelta (old, state, newNum, bits);
 	CL_CGModule_NewPacketEntityState (newNum, *state);
 }
 static void CL_ParsePacketEntities (const frame_t *oldFrame, frame_t *newFrame)
@@ -602,7 +610,15 @@ static void CL_ParseFrame (int extraBits)
 		if (cmd != SVC_PACKETENTITIES)
 			Com_Error (ERR_DROP, "CL_ParseFrame: not packetentities");
 	}
-	CL_ParsePacketEntities (oldFrame, &cl.frame);
+	if (cl_demoBench.active) {
+		uint32	startTime = Sys_UMicroseconds ();
+
+		CL_ParsePacketEntities (oldFrame, &cl.frame);
+		cl_demoBench.packetTime += Sys_UMicroseconds () - startTime;
+		cl_demoBench.numFrames++;
+	}
+	else
+		CL_ParsePacketEntities (oldFrame, &cl.frame);
 
 	// Translate for demos
 	if (cls.demoRecording && cls.serverProtocol != ORIGINAL_PROTOCOL_VERSION) {
@@ -639,6 +655,8 @@ static void CL_ParseFrame (int extraBits)
 
 	// Save the frame off in the backup array for later delta comparisons
 	cl.frames[cl.frame.serverFrame & UPDATE_MASK] = cl.frame;
+	if (cls.demoRecording)
+		CL_DemoFrameParsed ();
 	if (cl.frame.valid) {
 		// Getting a valid frame message ends the connection process
 		if (Com_ClientState () != CA_ACTIVE)
@@ -669,6 +687,12 @@ static qBool CL_ParseServerData (void)
 
 	Com_DevPrintf (0, "Serverdata packet received.\n");
 
+	// Let a demo being recorded catch up while the level loads
+	if (cls.demoRecording) {
+		FS_FlushFile (cls.demoFile);
+		CL_DemoMapChanged ();
+	}
+
 	// Wipe the clientState_t struct
 	CL_ClearState ();
 	CL_SetState (CA_CONNECTED);
@@ -793,6 +817,10 @@ static void CL_ParseConfigString (void)
 		Com_Error (ERR_DROP, "CL_ParseConfigString: bad num");
 	str = MSG_ReadString (&cls.netMessage);
 
+	// Demo keyframes repeat the whole table, nothing to redo for what didn't change
+	if (cl.attractLoop && !strcmp (cl.configStrings[num], str))
+		return;
+
 	strcpy (cl.configStrings[num], str);
 
 	// We do need to know some of these here...
@@ -907,7 +935,8 @@ void CL_ParseZPacket (void)
 	compressedLen = MSG_ReadShort (&cls.netMessage);
 	uncompressedLen = MSG_ReadShort (&cls.netMessage);
 
-	if (cls.serverProtocol != ENHANCED_PROTOCOL_VERSION)
+	// Original protocol servers only send these inside a fragmented reliable
+	if (cls.serverProtocol != ENHANCED_PROTOCOL_VERSION && !cls.netChan.fragments)
 		Com_Error (ERR_DROP, "CL_ParseZPacket: SVC_ZPACKET -requires- ENHANCED_PROTOCOL_VERSION");
 
 	if (uncompressedLen <= 0)
@@ -915,8 +944,9 @@ void CL_ParseZPacket (void)
 	if (compressedLen <= 0)
 		Com_Error (ERR_DROP, "CL_ParseZPacket: compressedLen <= 0");
 
-	buff_in = Mem_Alloc (compressedLen);
-	buff_out = Mem_Alloc (uncompressedLen);
+	// Frame scratch, freed in reverse so the arena takes the space straight back
+	buff_in = Mem_PoolAlloc (compressedLen, com_frameArena, 0);
+	buff_out = Mem_PoolAlloc (uncompressedLen, com_frameArena, 0);
 
 	MSG_ReadData (&cls.netMessage, buff_in, compressedLen);
 
@@ -930,8 +960,8 @@ void CL_ParseZPacket (void)
 
 	cls.netMessage = old;
 
-	Mem_Free (buff_in);
 	Mem_Free (buff_out);
+	Mem_Free (buff_in);
 
 	Com_DevPrintf (0, "Got a ZPacket, %d->%d\n", uncompressedLen + 4, compressedLen);
 }
@@ -969,6 +999,9 @@ void CL_ParseServerMessage (void)
 		}
 
 		oldReadCount = cls.netMessage.readCount;
+		if (cls.demoSplitting)
+			CL_SplitDemoMessage (oldReadCount, qFalse);
+
 		cmd = MSG_ReadByte (&cls.netMessage);
 		if (cmd == -1) {
 			CL_ShowSVCString ("END OF MESSAGE");
@@ -988,12 +1021,16 @@ void CL_ParseServerMessage (void)
 			break;
 
 		case SVC_DISCONNECT:
+			if (cl_demoBench.active)
+				break;	// demobench stops at the end of the file
 			cls.connectCount = 0;
 			CL_WriteDemoMessageChunk (cls.netMessage.data + oldReadCount, cls.netMessage.readCount - oldReadCount, qFalse);
 			Com_Error (ERR_DISCONNECT, "Server disconnected\n");
 			break;
 
 		case SVC_RECONNECT:
+			if (cl_demoBench.active)
+				break;
 			Com_Printf (0, "Server disconnected, reconnecting\n");
 			if (cls.download.file) {
 				// ZOID, close download
@@ -1062,14 +1099,20 @@ void CL_ParseServerMessage (void)
 		case SVC_STUFFTEXT:
 			s = MSG_ReadString (&cls.netMessage);
 			Com_DevPrintf (0, "stufftext: %s\n", s);
-			if (!cl.attractLoop || !strcmp (s, "precache\n"))
+			if (cl_demoBench.active) {
+				// demobench loads the level itself, nothing else gets run
+				if (!strcmp (s, "precache\n"))
+					cl_demoBench.precache = qTrue;
+			}
+			else if (!cl.attractLoop || !strcmp (s, "precache\n"))
 				Cbuf_AddText (s);
 			else
 				Com_DevPrintf (PRNT_WARNING, "WARNING: Demo tried to execute command '%s', ignored.\n", s);
 			break;
 
 		case SVC_SERVERDATA:
-			Cbuf_Execute ();	// Make sure any stuffed commands are done
+			if (!cl_demoBench.active)
+				Cbuf_Execute ();	// Make sure any stuffed commands are done
 			if (!CL_ParseServerData ()) {
 				CL_CGModule_EndServerMessage ();
 				return;
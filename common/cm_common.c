@@ -42,10 +42,16 @@ int						cm_numTraces;
 int						cm_numBrushTraces;
 int						cm_numPointContents;
 
+cmTraceContext_t		cm_mainTraceContext;
+static int				cm_mapSequence;
+
 cVar_t					*flushmap;
 cVar_t					*cm_noAreas;
 cVar_t					*cm_noCurves;
 cVar_t					*cm_showTrace;
+cVar_t					*cm_visCacheMB;
+
+static cVar_t			*cm_traceBatchJobs;
 
 /*
 =============================================================================
@@ -104,6 +110,8 @@ cBspModel_t *CM_LoadMap (char *name, qBool clientLoad, uint32 *checksum)
 	cm_noAreas		= Cvar_Register ("cm_noAreas",		"0",		CVAR_CHEAT);
 	cm_noCurves		= Cvar_Register ("cm_noCurves",		"0",		CVAR_CHEAT);
 	cm_showTrace	= Cvar_Register ("cm_showTrace",	"0",		0);
+	cm_traceBatchJobs	= Cvar_Register ("cm_traceBatchJobs",	"32",	CVAR_ARCHIVE);
+	cm_visCacheMB		= Cvar_Register ("cm_visCacheMB",		"32",	CVAR_ARCHIVE);
 
 	Com_NormalizePath (fixedName, sizeof (fixedName), name);
 	if (fixedName[0])	// Demos will pass a NULL name, don't need to append an extension to that...
@@ -153,8 +161,9 @@ cBspModel_t *CM_LoadMap (char *name, qBool clientLoad, uint32 *checksum)
 	cm_bspType = descr->type;
 	Q_strncpyz (cm_mapName, fixedName, sizeof (cm_mapName));
 
-	// Free the buffer
+	// Free the buffer and whatever the loader only needed while loading
 	FS_FreeFile (buffer);
+	Mem_FreePool (com_loadArena);
 
 	// Check integrity and return
 	Mem_CheckPoolIntegrity (com_cmodelSysPool);
@@ -170,6 +179,8 @@ CM_UnloadMap
 void CM_UnloadMap (void)
 {
 	Mem_FreePool (com_cmodelSysPool);
+	Mem_FreePool (com_loadArena);	// left over if the last load was dropped
+	cm_mapSequence++;	// Trace context stamps went with the pool
 
 	if (cm_bspType == BSP_TYPE_Q3)
 		CM_Q3BSP_UnloadMap ();
@@ -369,6 +380,81 @@ int	CM_TransformedPointContents (vec3_t p, int headNode, vec3_t origin, vec3_t a
 	return CM_Q2BSP_TransformedPointContents (p, headNode, origin, angles);
 }
 
+/*
+=============================================================================
+
+	TRACE CONTEXTS
+
+=============================================================================
+*/
+
+/*
+==================
+CM_AllocTraceContext
+==================
+*/
+cmTraceContext_t *CM_AllocTraceContext (void)
+{
+	return Mem_PoolAlloc (sizeof (cmTraceContext_t), com_genericPool, 0);
+}
+
+
+/*
+==================
+CM_FreeTraceContext
+==================
+*/
+void CM_FreeTraceContext (cmTraceContext_t *ctx)
+{
+	if (!ctx || ctx == &cm_mainTraceContext)
+		return;
+
+	// Stamps from an older map were released along with com_cmodelSysPool
+	if (ctx->mapSequence == cm_mapSequence) {
+		if (ctx->brushChecks)
+			Mem_Free (ctx->brushChecks);
+		if (ctx->patchChecks)
+			Mem_Free (ctx->patchChecks);
+	}
+	Mem_Free (ctx);
+}
+
+
+/*
+==================
+CM_BeginTraceContext
+
+Called at the top of each trace to get a fresh stamp. The stamp arrays are
+sized to the loaded map and thrown away when it changes.
+==================
+*/
+void CM_BeginTraceContext (cmTraceContext_t *ctx, int numBrushes, int numPatches)
+{
+	if (ctx->mapSequence != cm_mapSequence || ctx->numBrushChecks < numBrushes || ctx->numPatchChecks < numPatches) {
+		if (ctx->mapSequence == cm_mapSequence) {
+			if (ctx->brushChecks)
+				Mem_Free (ctx->brushChecks);
+			if (ctx->patchChecks)
+				Mem_Free (ctx->patchChecks);
+		}
+
+		ctx->mapSequence = cm_mapSequence;
+		ctx->brushChecks = Mem_PoolAlloc (sizeof (int) * max (numBrushes, 1), com_cmodelSysPool, 0);
+		ctx->numBrushChecks = numBrushes;
+		ctx->patchChecks = Mem_PoolAlloc (sizeof (int) * max (numPatches, 1), com_cmodelSysPool, 0);
+		ctx->numPatchChecks = numPatches;
+		ctx->checkCount = 0;
+	}
+
+	ctx->checkCount++;
+	if (ctx->checkCount <= 0) {
+		// Wrapped, old stamps could alias new ones
+		memset (ctx->brushChecks, 0, sizeof (int) * max (ctx->numBrushChecks, 1));
+		memset (ctx->patchChecks, 0, sizeof (int) * max (ctx->numPatchChecks, 1));
+		ctx->checkCount = 1;
+	}
+}
+
 /*
 =============================================================================
 
@@ -403,6 +489,194 @@ void CM_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins
 	CM_Q2BSP_TransformedBoxTrace (out, start, end, mins, maxs, headNode, brushMask, origin, angles);
 }
 
+trace_t CM_ContextBoxTrace (cmTraceContext_t *ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask)
+{
+	if (cm_bspType == BSP_TYPE_Q3)
+		return CM_Q3BSP_ContextBoxTrace (ctx, start, end, mins, maxs, headNode, brushMask);
+	return CM_Q2BSP_ContextBoxTrace (ctx, start, end, mins, maxs, headNode, brushMask);
+}
+
+void CM_ContextTransformedBoxTrace (cmTraceContext_t *ctx, trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles)
+{
+	if (!out)
+		return;
+
+	if (cm_bspType == BSP_TYPE_Q3) {
+		CM_Q3BSP_ContextTransformedBoxTrace (ctx, out, start, end, mins, maxs, headNode, brushMask, origin, angles);
+		return;
+	}
+	CM_Q2BSP_ContextTransformedBoxTrace (ctx, out, start, end, mins, maxs, headNode, brushMask, origin, angles);
+}
+
+/*
+=============================================================================
+
+	BATCHED TRACING
+
+=============================================================================
+*/
+
+#define CM_MAX_BATCH_JOBS	16
+
+typedef struct traceSortKey_s {
+	uint32				key;
+	int					index;
+} traceSortKey_t;
+
+typedef struct traceBatch_s {
+	cmTraceContext_t	*ctx;
+	const traceReq_t	*reqs;
+	trace_t				*out;
+	int					*indexes;
+	byte				*sides;
+	int					numReqs;
+} traceBatch_t;
+
+static traceSortKey_t	*cm_batchOrder;
+static int				*cm_batchIndexes;
+static byte				*cm_batchSides;
+static int				cm_batchOrderSize;
+static cmTraceContext_t	*cm_batchContexts[CM_MAX_BATCH_JOBS];
+
+/*
+==================
+CM_TraceSortKey
+
+Morton order of the move's midpoint on a 64 unit grid, so that requests that
+end up next to each other in the sort also walk the same part of the tree
+==================
+*/
+static uint32 CM_TraceSortKey (const traceReq_t *req)
+{
+	uint32	key, axis[3];
+	int		i, bit, v;
+
+	for (i=0 ; i<3 ; i++) {
+		v = ((int)((req->start[i] + req->end[i]) * 0.5f) + 32768) >> 6;
+		axis[i] = (uint32)clamp (v, 0, 1023);
+	}
+
+	key = 0;
+	for (bit=0 ; bit<10 ; bit++) {
+		key |= ((axis[0] >> bit) & 1) << (bit*3);
+		key |= ((axis[1] >> bit) & 1) << (bit*3+1);
+		key |= ((axis[2] >> bit) & 1) << (bit*3+2);
+	}
+
+	return key;
+}
+
+static int CM_TraceSortCmp (const void *a, const void *b)
+{
+	const traceSortKey_t	*k1 = (const traceSortKey_t *)a;
+	const traceSortKey_t	*k2 = (const traceSortKey_t *)b;
+
+	if (k1->key != k2->key)
+		return (k1->key < k2->key) ? -1 : 1;
+	return k1->index - k2->index;
+}
+
+
+/*
+==================
+CM_TraceBatchJob
+
+Q2 maps walk the run down the tree together, Q3 maps trace it one by one.
+==================
+*/
+static void CM_TraceBatchJob (void *arg)
+{
+	traceBatch_t		*batch = (traceBatch_t *)arg;
+	const traceReq_t	*req;
+	int					i;
+
+	if (cm_bspType == BSP_TYPE_Q2) {
+		CM_Q2BSP_BoxTraceBatch (batch->ctx, batch->reqs, batch->out, batch->indexes, batch->sides, batch->numReqs);
+		return;
+	}
+
+	for (i=0 ; i<batch->numReqs ; i++) {
+		req = &batch->reqs[batch->indexes[i]];
+		batch->out[batch->indexes[i]] = CM_ContextBoxTrace (batch->ctx,
+			(float *)req->start, (float *)req->end, (float *)req->mins, (float *)req->maxs,
+			req->headNode, req->contentMask);
+	}
+}
+
+
+/*
+==================
+CM_BoxTraceBatch
+
+Requests are sorted spatially so that each run of them shares as much of its
+walk down the tree as it can, and keeps the same brushes and stamp array hot.
+Large batches are split into contiguous runs of the sorted order and handed
+to the job pool, one trace context per run.
+==================
+*/
+void CM_BoxTraceBatch (const traceReq_t *reqs, trace_t *out, int numReqs)
+{
+	traceBatch_t	batches[CM_MAX_BATCH_JOBS];
+	jobList_t		jobs;
+	int				numJobs, perJob, first;
+	int				i;
+
+	if (!reqs || !out || numReqs <= 0)
+		return;
+
+	// Sort
+	if (numReqs > cm_batchOrderSize) {
+		if (cm_batchOrder) {
+			Mem_Free (cm_batchOrder);
+			Mem_Free (cm_batchIndexes);
+			Mem_Free (cm_batchSides);
+		}
+		cm_batchOrderSize = (numReqs + 255) & ~255;
+		cm_batchOrder = Mem_PoolAlloc (sizeof (traceSortKey_t) * cm_batchOrderSize, com_genericPool, 0);
+		cm_batchIndexes = Mem_PoolAlloc (sizeof (int) * cm_batchOrderSize, com_genericPool, 0);
+		cm_batchSides = Mem_PoolAlloc (cm_batchOrderSize, com_genericPool, 0);
+	}
+	for (i=0 ; i<numReqs ; i++) {
+		cm_batchOrder[i].key = CM_TraceSortKey (&reqs[i]);
+		cm_batchOrder[i].index = i;
+	}
+	qsort (cm_batchOrder, numReqs, sizeof (traceSortKey_t), CM_TraceSortCmp);
+	for (i=0 ; i<numReqs ; i++)
+		cm_batchIndexes[i] = cm_batchOrder[i].index;
+
+	// Decide how far to fan out
+	numJobs = 1;
+	if (cm_traceBatchJobs && cm_traceBatchJobs->intVal > 0 && Job_NumWorkers () > 0) {
+		numJobs = numReqs / cm_traceBatchJobs->intVal;
+		numJobs = clamp (numJobs, 1, min (Job_NumWorkers () + 1, CM_MAX_BATCH_JOBS));
+	}
+
+	perJob = (numReqs + numJobs - 1) / numJobs;
+	memset (&jobs, 0, sizeof (jobs));
+	for (i=0, first=0 ; i<numJobs && first<numReqs ; i++, first+=perJob) {
+		if (i == 0) {
+			batches[i].ctx = &cm_mainTraceContext;
+		}
+		else {
+			if (!cm_batchContexts[i])
+				cm_batchContexts[i] = CM_AllocTraceContext ();
+			batches[i].ctx = cm_batchContexts[i];
+		}
+		batches[i].reqs = reqs;
+		batches[i].out = out;
+		batches[i].indexes = cm_batchIndexes + first;
+		batches[i].sides = cm_batchSides + first;
+		batches[i].numReqs = min (perJob, numReqs - first);
+
+		// The first run stays on this thread
+		if (i)
+			Job_Add (&jobs, CM_TraceBatchJob, &batches[i]);
+	}
+
+	CM_TraceBatchJob (&batches[0]);
+	Job_Wait (&jobs);
+}
+
 /*
 =============================================================================
 
@@ -411,6 +685,44 @@ void CM_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins
 =============================================================================
 */
 
+/*
+==================
+CM_VisOr / CM_VisAnd
+
+dest |= src and dest &= src over numBytes of a vis row, a 64-bit word at a
+time when both rows are aligned for it
+==================
+*/
+void CM_VisOr (byte *dest, const byte *src, int numBytes)
+{
+	int		i, words;
+
+	i = 0;
+	if (!(((size_t)dest | (size_t)src) & 7)) {
+		words = numBytes >> 3;
+		for ( ; i<words ; i++)
+			((uint64 *)dest)[i] |= ((const uint64 *)src)[i];
+		i <<= 3;
+	}
+	for ( ; i<numBytes ; i++)
+		dest[i] |= src[i];
+}
+
+void CM_VisAnd (byte *dest, const byte *src, int numBytes)
+{
+	int		i, words;
+
+	i = 0;
+	if (!(((size_t)dest | (size_t)src) & 7)) {
+		words = numBytes >> 3;
+		for ( ; i<words ; i++)
+			((uint64 *)dest)[i] &= ((const uint64 *)src)[i];
+		i <<= 3;
+	}
+	for ( ; i<numBytes ; i++)
+		dest[i] &= src[i];
+}
+
 byte *CM_ClusterPVS (int cluster)
 {
 	if (cm_bspType == BSP_TYPE_Q3)
@@ -23,6 +23,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include "common.h"
 
+// Batched plane tests use SSE2 when the compiler targets it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define CM_SSE2
+# include <emmintrin.h>
+#endif
+
 #define MAX_CM_CMODELS		1024		// Must be >= Q2BSP_MAX_MODELS and >= Q3BSP_MAX_MODELS
 
 typedef struct cBspModel_s {
@@ -51,6 +57,47 @@ extern cVar_t				*flushmap;
 extern cVar_t				*cm_noAreas;
 extern cVar_t				*cm_noCurves;
 extern cVar_t				*cm_showTrace;
+extern cVar_t				*cm_visCacheMB;
+
+/*
+=============================================================================
+
+	TRACE CONTEXTS
+
+=============================================================================
+*/
+
+typedef struct cmLeafList_s {
+	int						count;
+	int						maxCount;
+	int						*list;
+	float					*mins, *maxs;
+	int						topNode;
+} cmLeafList_t;
+
+struct cmTraceContext_s {
+	trace_t					trace;
+	vec3_t					start, end;
+	vec3_t					mins, maxs;
+	vec3_t					startMins, startMaxs;	// Q3BSP
+	vec3_t					endMins, endMaxs;		// Q3BSP
+	vec3_t					absMins, absMaxs;		// Q3BSP
+	vec3_t					extents;
+	int						contents;
+	qBool					isPoint;				// Optimized case
+
+	// Multi-check avoidance, stamped per context instead of on the brushes
+	int						checkCount;
+	int						mapSequence;
+	int						*brushChecks;
+	int						numBrushChecks;
+	int						*patchChecks;
+	int						numPatchChecks;
+};
+
+extern cmTraceContext_t		cm_mainTraceContext;
+
+void		CM_BeginTraceContext (cmTraceContext_t *ctx, int numBrushes, int numPatches);
 
 /*
 =============================================================================
@@ -84,7 +131,10 @@ int			CM_Q2BSP_TransformedPointContents (vec3_t p, int headNode, vec3_t origin,
 
 trace_t		CM_Q2BSP_Trace (vec3_t start, vec3_t end, float size, int contentMask);
 trace_t		CM_Q2BSP_BoxTrace (vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask);
+trace_t		CM_Q2BSP_ContextBoxTrace (cmTraceContext_t *ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask);
+void		CM_Q2BSP_BoxTraceBatch (cmTraceContext_t *ctx, const traceReq_t *reqs, trace_t *out, int *indexes, byte *sides, int numReqs);
 void		CM_Q2BSP_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles);
+void		CM_Q2BSP_ContextTransformedBoxTrace (cmTraceContext_t *ctx, trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles);
 
 byte		*CM_Q2BSP_ClusterPVS (int cluster);
 byte		*CM_Q2BSP_ClusterPHS (int cluster);
@@ -128,7 +178,9 @@ int			CM_Q3BSP_TransformedPointContents (vec3_t p, int headNode, vec3_t origin,
 
 trace_t		CM_Q3BSP_Trace (vec3_t start, vec3_t end, float size, int contentMask);
 trace_t		CM_Q3BSP_BoxTrace (vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask);
+trace_t		CM_Q3BSP_ContextBoxTrace (cmTraceContext_t *ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask);
 void		CM_Q3BSP_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles);
+void		CM_Q3BSP_ContextTransformedBoxTrace (cmTraceContext_t *ctx, trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles);
 
 byte		*CM_Q3BSP_ClusterPVS (int cluster);
 byte		*CM_Q3BSP_ClusterPHS (int cluster);
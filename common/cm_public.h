@@ -59,8 +59,24 @@ trace_t		CM_Trace (vec3_t start, vec3_t end, float size,  int contentMask);
 trace_t		CM_BoxTrace (vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,  int headNode, int brushMask);
 void		CM_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles);
 
+// Trace contexts let several threads sweep the same map at once; the calls
+// above all share one context and are main-thread only
+typedef struct cmTraceContext_s cmTraceContext_t;
+
+cmTraceContext_t *CM_AllocTraceContext (void);
+void		CM_FreeTraceContext (cmTraceContext_t *ctx);
+trace_t		CM_ContextBoxTrace (cmTraceContext_t *ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask);
+void		CM_ContextTransformedBoxTrace (cmTraceContext_t *ctx, trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles);
+
+// Runs many independent traces at once, out[i] answers reqs[i]. These are
+// CM_BoxTrace calls: world or headNode only, entities are never clipped.
+// Main-thread only, and box hull requests all see the last CM_HeadnodeForBox
+void		CM_BoxTraceBatch (const traceReq_t *reqs, trace_t *out, int numReqs);
+
 byte		*CM_ClusterPVS (int cluster);
 byte		*CM_ClusterPHS (int cluster);
+void		CM_VisOr (byte *dest, const byte *src, int numBytes);
+void		CM_VisAnd (byte *dest, const byte *src, int numBytes);
 
 int			CM_PointLeafnum (vec3_t p);
 
@@ -567,6 +567,7 @@ cBspModel_t *CM_Q2BSP_LoadMap (uint32 *buffer)
 	CM_Q2BSP_LoadEntityString	(&header.lumps[Q2BSP_LUMP_ENTITIES]);
 
 	CM_Q2BSP_InitBoxHull ();
+	CM_Q2BSP_BuildVisCache ();
 	CM_Q2BSP_PrepMap ();
 
 	return &cm_mapCModels[0];
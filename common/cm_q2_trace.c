@@ -24,7 +24,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include "cm_q2_local.h"
 
-static int				cm_q2_checkCount;
 static int				cm_q2_floodValid;
 
 static cBspPlane_t		*cm_q2_boxPlanes;
@@ -32,21 +31,9 @@ static int				cm_q2_boxHeadNode;
 static cQ2BspBrush_t	*cm_q2_boxBrush;
 static cQ2BspLeaf_t		*cm_q2_boxLeaf;
 
-static int				cm_q2_leafCount, cm_q2_leafMaxCount;
-static int				*cm_q2_leafList;
-static float			*cm_q2_leafMins, *cm_q2_leafMaxs;
-static int				cm_q2_leafTopNode;
-
 // 1/32 epsilon to keep floating point happy
 #define DIST_EPSILON	(0.03125f)
 
-static trace_t			cm_q2_currentTrace;
-static vec3_t			cm_q2_traceStart, cm_q2_traceEnd;
-static vec3_t			cm_q2_traceMins, cm_q2_traceMaxs;
-static vec3_t			cm_q2_traceExtents;
-static int				cm_q2_traceContents;
-static qBool			cm_q2_traceIsPoint;		// optimized case
-
 /*
 =============================================================================
 
@@ -243,7 +230,7 @@ CM_Q2BSP_BoxLeafnums
 Fills in a list of all the leafs touched
 =============
 */
-static void CM_Q2BSP_BoxLeafnums_r (int nodeNum)
+static void CM_Q2BSP_BoxLeafnums_r (cmLeafList_t *ll, int nodeNum)
 {
 	cBspPlane_t		*plane;
 	cQ2BspNode_t	*node;
@@ -251,25 +238,25 @@ static void CM_Q2BSP_BoxLeafnums_r (int nodeNum)
 
 	for ( ; ; ) {
 		if (nodeNum < 0) {
-			if (cm_q2_leafCount >= cm_q2_leafMaxCount)
+			if (ll->count >= ll->maxCount)
 				return;
 
-			cm_q2_leafList[cm_q2_leafCount++] = -1 - nodeNum;
+			ll->list[ll->count++] = -1 - nodeNum;
 			return;
 		}
 	
 		node = &cm_q2_nodes[nodeNum];
 		plane = node->plane;
-		s = BOX_ON_PLANE_SIDE (cm_q2_leafMins, cm_q2_leafMaxs, plane);
+		s = BOX_ON_PLANE_SIDE (ll->mins, ll->maxs, plane);
 		if (s == 1)
 			nodeNum = node->children[0];
 		else if (s == 2)
 			nodeNum = node->children[1];
 		else {
 			// Go down both
-			if (cm_q2_leafTopNode == -1)
-				cm_q2_leafTopNode = nodeNum;
-			CM_Q2BSP_BoxLeafnums_r (node->children[0]);
+			if (ll->topNode == -1)
+				ll->topNode = nodeNum;
+			CM_Q2BSP_BoxLeafnums_r (ll, node->children[0]);
 			nodeNum = node->children[1];
 		}
 	}
@@ -283,19 +270,21 @@ CM_Q2BSP_BoxLeafnumsHeadNode
 */
 static int CM_Q2BSP_BoxLeafnumsHeadNode (vec3_t mins, vec3_t maxs, int *list, int listSize, int headNode, int *topNode)
 {
-	cm_q2_leafList = list;
-	cm_q2_leafCount = 0;
-	cm_q2_leafMaxCount = listSize;
-	cm_q2_leafMins = mins;
-	cm_q2_leafMaxs = maxs;
-	cm_q2_leafTopNode = -1;
+	cmLeafList_t	ll;
+
+	ll.list = list;
+	ll.count = 0;
+	ll.maxCount = listSize;
+	ll.mins = mins;
+	ll.maxs = maxs;
+	ll.topNode = -1;
 
-	CM_Q2BSP_BoxLeafnums_r (headNode);
+	CM_Q2BSP_BoxLeafnums_r (&ll, headNode);
 
 	if (topNode)
-		*topNode = cm_q2_leafTopNode;
+		*topNode = ll.topNode;
 
-	return cm_q2_leafCount;
+	return ll.count;
 }
 
 
@@ -373,7 +362,7 @@ int	CM_Q2BSP_TransformedPointContents (vec3_t p, int headNode, vec3_t origin, ve
 CM_Q2BSP_ClipBoxToBrush
 ================
 */
-static void CM_Q2BSP_ClipBoxToBrush (cQ2BspBrush_t *brush)
+static void CM_Q2BSP_ClipBoxToBrush (cmTraceContext_t *ctx, cQ2BspBrush_t *brush)
 {
 	int					i, j;
 	cBspPlane_t			*p, *clipPlane;
@@ -400,15 +389,15 @@ static void CM_Q2BSP_ClipBoxToBrush (cQ2BspBrush_t *brush)
 		p = side->plane;
 
 		// FIXME: special case for axial
-		if (!cm_q2_traceIsPoint) {
+		if (!ctx->isPoint) {
 			// general box case
 			// push the plane out apropriately for mins/maxs
 			// FIXME: use signBits into 8 way lookup for each mins/maxs
 			for (j=0 ; j<3 ; j++) {
 				if (p->normal[j] < 0)
-					ofs[j] = cm_q2_traceMaxs[j];
+					ofs[j] = ctx->maxs[j];
 				else
-					ofs[j] = cm_q2_traceMins[j];
+					ofs[j] = ctx->mins[j];
 			}
 			dist = DotProduct (ofs, p->normal);
 			dist = p->dist - dist;
@@ -418,8 +407,8 @@ static void CM_Q2BSP_ClipBoxToBrush (cQ2BspBrush_t *brush)
 			dist = p->dist;
 		}
 
-		dot1 = DotProduct (cm_q2_traceStart, p->normal) - dist;
-		dot2 = DotProduct (cm_q2_traceEnd, p->normal) - dist;
+		dot1 = DotProduct (ctx->start, p->normal) - dist;
+		dot2 = DotProduct (ctx->end, p->normal) - dist;
 
 		if (dot2 > 0)
 			getOut = qTrue;	// Endpoint is not in solid
@@ -454,20 +443,20 @@ static void CM_Q2BSP_ClipBoxToBrush (cQ2BspBrush_t *brush)
 
 	if (!startOut) {
 		// Original point was inside brush
-		cm_q2_currentTrace.startSolid = qTrue;
+		ctx->trace.startSolid = qTrue;
 		if (!getOut)
-			cm_q2_currentTrace.allSolid = qTrue;
+			ctx->trace.allSolid = qTrue;
 		return;
 	}
 
-	if (enterFrac < leaveFrac && enterFrac > -1 && enterFrac < cm_q2_currentTrace.fraction) {
+	if (enterFrac < leaveFrac && enterFrac > -1 && enterFrac < ctx->trace.fraction) {
 		if (enterFrac < 0)
 			enterFrac = 0;
 
-		cm_q2_currentTrace.fraction = enterFrac;
-		cm_q2_currentTrace.plane = *clipPlane;
-		cm_q2_currentTrace.surface = leadSide->surface;
-		cm_q2_currentTrace.contents = brush->contents;
+		ctx->trace.fraction = enterFrac;
+		ctx->trace.plane = *clipPlane;
+		ctx->trace.surface = leadSide->surface;
+		ctx->trace.contents = brush->contents;
 	}
 }
 
@@ -477,7 +466,7 @@ static void CM_Q2BSP_ClipBoxToBrush (cQ2BspBrush_t *brush)
 CM_Q2BSP_ClipBoxes
 ================
 */
-static void CM_Q2BSP_ClipBoxes (int leafNum)
+static void CM_Q2BSP_ClipBoxes (cmTraceContext_t *ctx, int leafNum)
 {
 	cQ2BspLeaf_t	*leaf;
 	cQ2BspBrush_t	*brush;
@@ -485,7 +474,7 @@ static void CM_Q2BSP_ClipBoxes (int leafNum)
 	int				k;
 
 	leaf = &cm_q2_leafs[leafNum];
-	if (!(leaf->contents & cm_q2_traceContents))
+	if (!(leaf->contents & ctx->contents))
 		return;
 
 	// Trace line against all brushes in the leaf
@@ -493,14 +482,14 @@ static void CM_Q2BSP_ClipBoxes (int leafNum)
 		brushNum = cm_q2_leafBrushes[leaf->firstLeafBrush+k];
 		brush = &cm_q2_brushes[brushNum];
 
-		if (brush->checkCount == cm_q2_checkCount)
+		if (ctx->brushChecks[brushNum] == ctx->checkCount)
 			continue;	// Already checked this brush in another leaf
-		brush->checkCount = cm_q2_checkCount;
-		if (!(brush->contents & cm_q2_traceContents))
+		ctx->brushChecks[brushNum] = ctx->checkCount;
+		if (!(brush->contents & ctx->contents))
 			continue;
 
-		CM_Q2BSP_ClipBoxToBrush (brush);
-		if (!cm_q2_currentTrace.fraction)
+		CM_Q2BSP_ClipBoxToBrush (ctx, brush);
+		if (!ctx->trace.fraction)
 			return;
 	}
 }
@@ -511,7 +500,7 @@ static void CM_Q2BSP_ClipBoxes (int leafNum)
 CM_Q2BSP_TestBoxInBrush
 ================
 */
-static void CM_Q2BSP_TestBoxInBrush (cQ2BspBrush_t *brush)
+static void CM_Q2BSP_TestBoxInBrush (cmTraceContext_t *ctx, cQ2BspBrush_t *brush)
 {
 	int					i, j;
 	vec3_t				ofs;
@@ -531,13 +520,13 @@ static void CM_Q2BSP_TestBoxInBrush (cQ2BspBrush_t *brush)
 		// FIXME: use signBits into 8 way lookup for each mins/maxs
 		for (j=0 ; j<3 ; j++) {
 			if (p->normal[j] < 0)
-				ofs[j] = cm_q2_traceMaxs[j];
+				ofs[j] = ctx->maxs[j];
 			else
-				ofs[j] = cm_q2_traceMins[j];
+				ofs[j] = ctx->mins[j];
 		}
 
 		dist = p->dist - DotProduct (ofs, p->normal);
-		dot = DotProduct (cm_q2_traceStart, p->normal) - dist;
+		dot = DotProduct (ctx->start, p->normal) - dist;
 
 		// If completely in front of face, no intersection
 		if (dot > 0)
@@ -545,9 +534,9 @@ static void CM_Q2BSP_TestBoxInBrush (cQ2BspBrush_t *brush)
 	}
 
 	// Inside this brush
-	cm_q2_currentTrace.startSolid = cm_q2_currentTrace.allSolid = qTrue;
-	cm_q2_currentTrace.fraction = 0;
-	cm_q2_currentTrace.contents = brush->contents;
+	ctx->trace.startSolid = ctx->trace.allSolid = qTrue;
+	ctx->trace.fraction = 0;
+	ctx->trace.contents = brush->contents;
 }
 
 
@@ -556,7 +545,7 @@ static void CM_Q2BSP_TestBoxInBrush (cQ2BspBrush_t *brush)
 CM_Q2BSP_TestBoxes
 ================
 */
-static void CM_Q2BSP_TestBoxes (int leafNum)
+static void CM_Q2BSP_TestBoxes (cmTraceContext_t *ctx, int leafNum)
 {
 	cQ2BspLeaf_t	*leaf;
 	cQ2BspBrush_t	*brush;
@@ -564,7 +553,7 @@ static void CM_Q2BSP_TestBoxes (int leafNum)
 	int				k;
 
 	leaf = &cm_q2_leafs[leafNum];
-	if (!(leaf->contents & cm_q2_traceContents))
+	if (!(leaf->contents & ctx->contents))
 		return;
 
 	// Trace line against all brushes in the leaf
@@ -572,14 +561,14 @@ static void CM_Q2BSP_TestBoxes (int leafNum)
 		brushNum = cm_q2_leafBrushes[leaf->firstLeafBrush+k];
 		brush = &cm_q2_brushes[brushNum];
 
-		if (brush->checkCount == cm_q2_checkCount)
+		if (ctx->brushChecks[brushNum] == ctx->checkCount)
 			continue;	// Already checked this brush in another leaf
-		brush->checkCount = cm_q2_checkCount;
-		if (!(brush->contents & cm_q2_traceContents))
+		ctx->brushChecks[brushNum] = ctx->checkCount;
+		if (!(brush->contents & ctx->contents))
 			continue;
 
-		CM_Q2BSP_TestBoxInBrush (brush);
-		if (!cm_q2_currentTrace.fraction)
+		CM_Q2BSP_TestBoxInBrush (ctx, brush);
+		if (!ctx->trace.fraction)
 			return;
 	}
 }
@@ -590,7 +579,7 @@ static void CM_Q2BSP_TestBoxes (int leafNum)
 CM_Q2BSP_RecursiveHullCheck
 ==================
 */
-static void CM_Q2BSP_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static void CM_Q2BSP_RecursiveHullCheck (cmTraceContext_t *ctx, int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 {
 	cQ2BspNode_t	*node;
 	cBspPlane_t		*plane;
@@ -601,12 +590,12 @@ static void CM_Q2BSP_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p
 	vec3_t			mid;
 	float			midf;
 
-	if (cm_q2_currentTrace.fraction <= p1f)
+	if (ctx->trace.fraction <= p1f)
 		return;		// already hit something nearer
 
 	// if < 0, we are in a leaf node
 	if (num < 0) {
-		CM_Q2BSP_ClipBoxes (-1-num);
+		CM_Q2BSP_ClipBoxes (ctx, -1-num);
 		return;
 	}
 
@@ -620,26 +609,26 @@ static void CM_Q2BSP_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p
 	if (plane->type < 3) {
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = cm_q2_traceExtents[plane->type];
+		offset = ctx->extents[plane->type];
 	}
 	else {
 		t1 = DotProduct (plane->normal, p1) - plane->dist;
 		t2 = DotProduct (plane->normal, p2) - plane->dist;
-		if (cm_q2_traceIsPoint)
+		if (ctx->isPoint)
 			offset = 0;
 		else
-			offset = fabs (cm_q2_traceExtents[0]*plane->normal[0])
-				+ fabs (cm_q2_traceExtents[1]*plane->normal[1])
-				+ fabs (cm_q2_traceExtents[2]*plane->normal[2]);
+			offset = fabs (ctx->extents[0]*plane->normal[0])
+				+ fabs (ctx->extents[1]*plane->normal[1])
+				+ fabs (ctx->extents[2]*plane->normal[2]);
 	}
 
 	// see which sides we need to consider
 	if (t1 >= offset && t2 >= offset) {
-		CM_Q2BSP_RecursiveHullCheck (node->children[0], p1f, p2f, p1, p2);
+		CM_Q2BSP_RecursiveHullCheck (ctx, node->children[0], p1f, p2f, p1, p2);
 		return;
 	}
 	if (t1 < -offset && t2 < -offset) {
-		CM_Q2BSP_RecursiveHullCheck (node->children[1], p1f, p2f, p1, p2);
+		CM_Q2BSP_RecursiveHullCheck (ctx, node->children[1], p1f, p2f, p1, p2);
 		return;
 	}
 
@@ -668,7 +657,7 @@ static void CM_Q2BSP_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p
 	for (i=0 ; i<3 ; i++)
 		mid[i] = p1[i] + frac * (p2[i] - p1[i]);
 
-	CM_Q2BSP_RecursiveHullCheck (node->children[side], p1f, midf, p1, mid);
+	CM_Q2BSP_RecursiveHullCheck (ctx, node->children[side], p1f, midf, p1, mid);
 
 	// go past the node
 	frac2 = clamp (frac2, 0, 1);
@@ -676,7 +665,7 @@ static void CM_Q2BSP_RecursiveHullCheck (int num, float p1f, float p2f, vec3_t p
 	for (i=0 ; i<3 ; i++)
 		mid[i] = p1[i] + frac2 * (p2[i] - p1[i]);
 
-	CM_Q2BSP_RecursiveHullCheck (node->children[side^1], midf, p2f, mid, p2);
+	CM_Q2BSP_RecursiveHullCheck (ctx, node->children[side^1], midf, p2f, mid, p2);
 }
 
 // ==========================================================================
@@ -699,35 +688,39 @@ trace_t CM_Q2BSP_Trace (vec3_t start, vec3_t end, float size, int contentMask)
 
 /*
 ==================
-CM_Q2BSP_BoxTrace
+CM_Q2BSP_SweepFrom
+
+The sweep starts at sweepNode, which is headNode unless the caller already
+knows the whole move lies on one side of every plane above it.
 ==================
 */
-trace_t CM_Q2BSP_BoxTrace (vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask)
+static trace_t CM_Q2BSP_SweepFrom (cmTraceContext_t *ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int sweepNode, int brushMask)
 {
-	cm_q2_checkCount++;	// For multi-check avoidance
 	cm_numTraces++;		// For statistics, may be zeroed
 
 	// Fill in a default trace
-	cm_q2_currentTrace.allSolid = qFalse;
-	cm_q2_currentTrace.contents = 0;
-	Vec3Clear (cm_q2_currentTrace.endPos);
-	cm_q2_currentTrace.ent = NULL;
-	cm_q2_currentTrace.fraction = 1;
-	cm_q2_currentTrace.plane.dist = 0;
-	Vec3Clear (cm_q2_currentTrace.plane.normal);
-	cm_q2_currentTrace.plane.signBits = 0;
-	cm_q2_currentTrace.plane.type = 0;
-	cm_q2_currentTrace.startSolid = qFalse;
-	cm_q2_currentTrace.surface = &cm_q2_nullSurface;
+	ctx->trace.allSolid = qFalse;
+	ctx->trace.contents = 0;
+	Vec3Clear (ctx->trace.endPos);
+	ctx->trace.ent = NULL;
+	ctx->trace.fraction = 1;
+	ctx->trace.plane.dist = 0;
+	Vec3Clear (ctx->trace.plane.normal);
+	ctx->trace.plane.signBits = 0;
+	ctx->trace.plane.type = 0;
+	ctx->trace.startSolid = qFalse;
+	ctx->trace.surface = &cm_q2_nullSurface;
 
 	if (!cm_q2_numNodes)	// Map not loaded
-		return cm_q2_currentTrace;
+		return ctx->trace;
 
-	cm_q2_traceContents = brushMask;
-	Vec3Copy (start, cm_q2_traceStart);
-	Vec3Copy (end, cm_q2_traceEnd);
-	Vec3Copy (mins, cm_q2_traceMins);
-	Vec3Copy (maxs, cm_q2_traceMaxs);
+	CM_BeginTraceContext (ctx, cm_q2_numBrushes+1, 0);	// For multi-check avoidance
+
+	ctx->contents = brushMask;
+	Vec3Copy (start, ctx->start);
+	Vec3Copy (end, ctx->end);
+	Vec3Copy (mins, ctx->mins);
+	Vec3Copy (maxs, ctx->maxs);
 
 	// Check for position test special case
 	if (Vec3Compare (start, end)) {
@@ -745,45 +738,314 @@ trace_t CM_Q2BSP_BoxTrace (vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, i
 
 		numLeafs = CM_Q2BSP_BoxLeafnumsHeadNode (c1, c2, leafs, 1024, headNode, &topNode);
 		for (i=0 ; i<numLeafs ; i++) {
-			CM_Q2BSP_TestBoxes (leafs[i]);
-			if (cm_q2_currentTrace.allSolid)
+			CM_Q2BSP_TestBoxes (ctx, leafs[i]);
+			if (ctx->trace.allSolid)
 				break;
 		}
-		Vec3Copy (start, cm_q2_currentTrace.endPos);
-		return cm_q2_currentTrace;
+		Vec3Copy (start, ctx->trace.endPos);
+		return ctx->trace;
 	}
 
 	// Check for point special case
 	if (Vec3Compare (mins, vec3Origin) && Vec3Compare (maxs, vec3Origin)) {
-		cm_q2_traceIsPoint = qTrue;
-		Vec3Clear (cm_q2_traceExtents);
+		ctx->isPoint = qTrue;
+		Vec3Clear (ctx->extents);
 	}
 	else {
-		cm_q2_traceIsPoint = qFalse;
-		cm_q2_traceExtents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		cm_q2_traceExtents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		cm_q2_traceExtents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		ctx->isPoint = qFalse;
+		ctx->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		ctx->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		ctx->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 	}
 
 	// General sweeping through world
-	CM_Q2BSP_RecursiveHullCheck (headNode, 0, 1, start, end);
+	CM_Q2BSP_RecursiveHullCheck (ctx, sweepNode, 0, 1, start, end);
 
-	if (cm_q2_currentTrace.fraction == 1) {
-		Vec3Copy (end, cm_q2_currentTrace.endPos);
+	if (ctx->trace.fraction == 1) {
+		Vec3Copy (end, ctx->trace.endPos);
 	}
 	else {
-		cm_q2_currentTrace.endPos[0] = start[0] + cm_q2_currentTrace.fraction * (end[0] - start[0]);
-		cm_q2_currentTrace.endPos[1] = start[1] + cm_q2_currentTrace.fraction * (end[1] - start[1]);
-		cm_q2_currentTrace.endPos[2] = start[2] + cm_q2_currentTrace.fraction * (end[2] - start[2]);
+		ctx->trace.endPos[0] = start[0] + ctx->trace.fraction * (end[0] - start[0]);
+		ctx->trace.endPos[1] = start[1] + ctx->trace.fraction * (end[1] - start[1]);
+		ctx->trace.endPos[2] = start[2] + ctx->trace.fraction * (end[2] - start[2]);
 	}
 
-	return cm_q2_currentTrace;
+	return ctx->trace;
 }
 
 
 /*
 ==================
-CM_Q2BSP_TransformedBoxTrace
+CM_Q2BSP_ContextBoxTrace
+
+Everything the sweep touches lives in the context, so any number of these may
+run at once as long as each caller brings its own context.
+==================
+*/
+trace_t CM_Q2BSP_ContextBoxTrace (cmTraceContext_t *ctx, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask)
+{
+	return CM_Q2BSP_SweepFrom (ctx, start, end, mins, maxs, headNode, headNode, brushMask);
+}
+
+/*
+=============================================================================
+
+	BATCHED SWEEPS
+
+	The requests walk down the tree together. At each node every request in
+	the group is tested against the plane, the ones wholly on one side carry
+	on down that child as a group, and the ones that straddle it drop out and
+	finish alone from that node. A move that stays on one side of every plane
+	above a node reaches it with the same fractions and end points either way,
+	so the results match CM_Q2BSP_ContextBoxTrace exactly.
+
+=============================================================================
+*/
+
+enum {
+	BATCH_FRONT,
+	BATCH_BACK,
+	BATCH_SPLIT
+};
+
+typedef struct q2TraceBatch_s {
+	cmTraceContext_t	*ctx;
+	const traceReq_t	*reqs;
+	trace_t				*out;
+	qBool				allPoints;
+} q2TraceBatch_t;
+
+/*
+==================
+CM_Q2BSP_BatchSide
+
+Same tests as CM_Q2BSP_RecursiveHullCheck makes before it splits a move.
+==================
+*/
+static byte CM_Q2BSP_BatchSide (const traceReq_t *req, cBspPlane_t *plane)
+{
+	float	t1, t2, offset;
+	vec3_t	extents;
+	int		i;
+
+	for (i=0 ; i<3 ; i++)
+		extents[i] = -req->mins[i] > req->maxs[i] ? -req->mins[i] : req->maxs[i];
+
+	if (plane->type < 3) {
+		t1 = req->start[plane->type] - plane->dist;
+		t2 = req->end[plane->type] - plane->dist;
+		offset = extents[plane->type];
+	}
+	else {
+		t1 = DotProduct (plane->normal, req->start) - plane->dist;
+		t2 = DotProduct (plane->normal, req->end) - plane->dist;
+		offset = fabs (extents[0]*plane->normal[0])
+			+ fabs (extents[1]*plane->normal[1])
+			+ fabs (extents[2]*plane->normal[2]);
+	}
+
+	if (t1 >= offset && t2 >= offset)
+		return BATCH_FRONT;
+	if (t1 < -offset && t2 < -offset)
+		return BATCH_BACK;
+	return BATCH_SPLIT;
+}
+
+
+#ifdef CM_SSE2
+/*
+==================
+CM_Q2BSP_BatchSides4
+
+Four point moves against one plane. The products are summed in the same
+order DotProduct uses, so the sides agree with CM_Q2BSP_BatchSide.
+==================
+*/
+static void CM_Q2BSP_BatchSides4 (const q2TraceBatch_t *batch, cBspPlane_t *plane, const int *indexes, byte *sides)
+{
+	const traceReq_t	*r0 = &batch->reqs[indexes[0]];
+	const traceReq_t	*r1 = &batch->reqs[indexes[1]];
+	const traceReq_t	*r2 = &batch->reqs[indexes[2]];
+	const traceReq_t	*r3 = &batch->reqs[indexes[3]];
+	__m128				t1, t2, n, dist, zero;
+	int					front, back, i;
+
+	dist = _mm_set1_ps (plane->dist);
+	if (plane->type < 3) {
+		i = plane->type;
+		t1 = _mm_set_ps (r3->start[i], r2->start[i], r1->start[i], r0->start[i]);
+		t2 = _mm_set_ps (r3->end[i], r2->end[i], r1->end[i], r0->end[i]);
+	}
+	else {
+		n = _mm_set1_ps (plane->normal[0]);
+		t1 = _mm_mul_ps (_mm_set_ps (r3->start[0], r2->start[0], r1->start[0], r0->start[0]), n);
+		t2 = _mm_mul_ps (_mm_set_ps (r3->end[0], r2->end[0], r1->end[0], r0->end[0]), n);
+		n = _mm_set1_ps (plane->normal[1]);
+		t1 = _mm_add_ps (t1, _mm_mul_ps (_mm_set_ps (r3->start[1], r2->start[1], r1->start[1], r0->start[1]), n));
+		t2 = _mm_add_ps (t2, _mm_mul_ps (_mm_set_ps (r3->end[1], r2->end[1], r1->end[1], r0->end[1]), n));
+		n = _mm_set1_ps (plane->normal[2]);
+		t1 = _mm_add_ps (t1, _mm_mul_ps (_mm_set_ps (r3->start[2], r2->start[2], r1->start[2], r0->start[2]), n));
+		t2 = _mm_add_ps (t2, _mm_mul_ps (_mm_set_ps (r3->end[2], r2->end[2], r1->end[2], r0->end[2]), n));
+	}
+	t1 = _mm_sub_ps (t1, dist);
+	t2 = _mm_sub_ps (t2, dist);
+
+	zero = _mm_setzero_ps ();
+	front = _mm_movemask_ps (_mm_and_ps (_mm_cmpge_ps (t1, zero), _mm_cmpge_ps (t2, zero)));
+	back = _mm_movemask_ps (_mm_and_ps (_mm_cmplt_ps (t1, zero), _mm_cmplt_ps (t2, zero)));
+
+	for (i=0 ; i<4 ; i++) {
+		if (front & (1<<i))
+			sides[i] = BATCH_FRONT;
+		else if (back & (1<<i))
+			sides[i] = BATCH_BACK;
+		else
+			sides[i] = BATCH_SPLIT;
+	}
+}
+#endif
+
+
+/*
+==================
+CM_Q2BSP_BatchFinish
+==================
+*/
+static void CM_Q2BSP_BatchFinish (const q2TraceBatch_t *batch, int index, int sweepNode)
+{
+	const traceReq_t	*req = &batch->reqs[index];
+
+	batch->out[index] = CM_Q2BSP_SweepFrom (batch->ctx,
+		(float *)req->start, (float *)req->end, (float *)req->mins, (float *)req->maxs,
+		req->headNode, sweepNode, req->contentMask);
+}
+
+
+/*
+==================
+CM_Q2BSP_BatchHullCheck_r
+
+indexes and sides are the same slice, partitioned in place into the front
+group, the ones that split here, and the back group.
+==================
+*/
+static void CM_Q2BSP_BatchHullCheck_r (const q2TraceBatch_t *batch, int num, int *indexes, byte *sides, int numIndexes)
+{
+	cQ2BspNode_t	*node;
+	int				lo, mid, hi;
+	int				i, tempIndex;
+	byte			tempSide;
+
+	while (numIndexes) {
+		// Nothing left to share
+		if (num < 0 || numIndexes == 1) {
+			for (i=0 ; i<numIndexes ; i++)
+				CM_Q2BSP_BatchFinish (batch, indexes[i], num);
+			return;
+		}
+
+		node = cm_q2_nodes + num;
+
+		i = 0;
+#ifdef CM_SSE2
+		if (batch->allPoints) {
+			for ( ; i+4<=numIndexes ; i+=4)
+				CM_Q2BSP_BatchSides4 (batch, node->plane, indexes + i, sides + i);
+		}
+#endif
+		for ( ; i<numIndexes ; i++)
+			sides[i] = CM_Q2BSP_BatchSide (&batch->reqs[indexes[i]], node->plane);
+
+		// Front to the start, back to the end, splits in between
+		lo = mid = 0;
+		hi = numIndexes;
+		while (mid < hi) {
+			if (sides[mid] == BATCH_SPLIT) {
+				mid++;
+				continue;
+			}
+
+			if (sides[mid] == BATCH_FRONT) {
+				tempIndex = indexes[lo]; indexes[lo] = indexes[mid]; indexes[mid] = tempIndex;
+				tempSide = sides[lo]; sides[lo] = sides[mid]; sides[mid] = tempSide;
+				lo++;
+				mid++;
+			}
+			else {
+				hi--;
+				tempIndex = indexes[hi]; indexes[hi] = indexes[mid]; indexes[mid] = tempIndex;
+				tempSide = sides[hi]; sides[hi] = sides[mid]; sides[mid] = tempSide;
+			}
+		}
+
+		for (i=lo ; i<hi ; i++)
+			CM_Q2BSP_BatchFinish (batch, indexes[i], num);
+
+		CM_Q2BSP_BatchHullCheck_r (batch, node->children[1], indexes + hi, sides + hi, numIndexes - hi);
+
+		// Front group carries on here
+		num = node->children[0];
+		numIndexes = lo;
+	}
+}
+
+
+/*
+==================
+CM_Q2BSP_BoxTraceBatch
+
+out[indexes[i]] answers reqs[indexes[i]]. Only world sweeps share the walk,
+position tests and box hull or inline model requests are traced one by one.
+indexes and sides are scratch, and get reordered.
+==================
+*/
+void CM_Q2BSP_BoxTraceBatch (cmTraceContext_t *ctx, const traceReq_t *reqs, trace_t *out, int *indexes, byte *sides, int numReqs)
+{
+	q2TraceBatch_t		batch;
+	const traceReq_t	*req;
+	int					numShared, tempIndex;
+	int					i;
+
+	batch.ctx = ctx;
+	batch.reqs = reqs;
+	batch.out = out;
+	batch.allPoints = qTrue;
+
+	// Set the ones that can't share aside
+	numShared = 0;
+	for (i=0 ; i<numReqs ; i++) {
+		req = &reqs[indexes[i]];
+		if (!cm_q2_numNodes || req->headNode || Vec3Compare (req->start, req->end)) {
+			CM_Q2BSP_BatchFinish (&batch, indexes[i], req->headNode);
+			continue;
+		}
+
+		if (!Vec3Compare (req->mins, vec3Origin) || !Vec3Compare (req->maxs, vec3Origin))
+			batch.allPoints = qFalse;
+
+		tempIndex = indexes[numShared];
+		indexes[numShared++] = indexes[i];
+		indexes[i] = tempIndex;
+	}
+
+	CM_Q2BSP_BatchHullCheck_r (&batch, 0, indexes, sides, numShared);
+}
+
+
+/*
+==================
+CM_Q2BSP_BoxTrace
+==================
+*/
+trace_t CM_Q2BSP_BoxTrace (vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask)
+{
+	return CM_Q2BSP_ContextBoxTrace (&cm_mainTraceContext, start, end, mins, maxs, headNode, brushMask);
+}
+
+
+/*
+==================
+CM_Q2BSP_ContextTransformedBoxTrace
 
 Handles offseting and rotation of the end points for moving and rotating entities
 ==================
@@ -791,7 +1053,7 @@ Handles offseting and rotation of the end points for moving and rotating entitie
 #ifdef _WIN32
 #pragma optimize ("", off)
 #endif
-void CM_Q2BSP_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles)
+void CM_Q2BSP_ContextTransformedBoxTrace (cmTraceContext_t *ctx, trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles)
 {
 	vec3_t		start_l, end_l;
 	vec3_t		forward, right, up;
@@ -823,7 +1085,7 @@ void CM_Q2BSP_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_
 	}
 
 	// Sweep the box through the model
-	*out = CM_Q2BSP_BoxTrace (start_l, end_l, mins, maxs, headNode, brushMask);
+	*out = CM_Q2BSP_ContextBoxTrace (ctx, start_l, end_l, mins, maxs, headNode, brushMask);
 
 	if (rotated && out->fraction != 1.0) {
 		// FIXME: figure out how to do this with existing angles
@@ -844,14 +1106,49 @@ void CM_Q2BSP_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_
 #pragma optimize ("", on)
 #endif
 
+
+/*
+==================
+CM_Q2BSP_TransformedBoxTrace
+==================
+*/
+void CM_Q2BSP_TransformedBoxTrace (trace_t *out, vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs, int headNode, int brushMask, vec3_t origin, vec3_t angles)
+{
+	CM_Q2BSP_ContextTransformedBoxTrace (&cm_mainTraceContext, out, start, end, mins, maxs, headNode, brushMask, origin, angles);
+}
+
 /*
 =============================================================================
 
 	PVS / PHS
 
+	Rows are decompressed once at load time into a [cluster][PVS/PHS] matrix
+	when it fits in cm_visCacheMB, otherwise into a small LRU of recently
+	used rows. Either way rows are padded out to whole 64-bit words.
+
 =============================================================================
 */
 
+#define CM_VIS_LRU_ROWS		256
+#define CM_VIS_LRU_HASH		64		// must be a power of two
+
+typedef struct cQ2VisRow_s {
+	int						key;		// (cluster << 1) | vis type, -1 when unused
+	byte					*row;
+
+	struct cQ2VisRow_s		*hashNext;
+	struct cQ2VisRow_s		*prev, *next;
+} cQ2VisRow_t;
+
+static int				cm_q2_visRowBytes;
+static byte				*cm_q2_visMatrix;
+static cQ2VisRow_t		*cm_q2_visRows;
+static cQ2VisRow_t		*cm_q2_visHash[CM_VIS_LRU_HASH];
+static cQ2VisRow_t		cm_q2_visLRU;		// Most recently used follows the head
+
+static uint64			cm_q2_noVisRow[Q2BSP_MAX_VIS/8];
+static uint64			cm_q2_allVisRow[Q2BSP_MAX_VIS/8];
+
 /*
 ===================
 CM_Q2BSP_DecompressVis
@@ -896,6 +1193,129 @@ static void CM_Q2BSP_DecompressVis (byte *in, byte *out)
 }
 
 
+/*
+===================
+CM_Q2BSP_BuildVisCache
+
+Called once the leafs and visibility lump are in
+===================
+*/
+void CM_Q2BSP_BuildVisCache (void)
+{
+	size_t		matrixSize;
+	byte		*buffer;
+	int			i;
+
+	memset (cm_q2_allVisRow, 0xff, sizeof (cm_q2_allVisRow));
+
+	cm_q2_visMatrix = NULL;
+	cm_q2_visRows = NULL;
+	memset (cm_q2_visHash, 0, sizeof (cm_q2_visHash));
+	cm_q2_visLRU.prev = cm_q2_visLRU.next = &cm_q2_visLRU;
+
+	if (!cm_q2_numVisibility || !cm_q2_visData->numClusters)
+		return;
+
+	cm_q2_visRowBytes = ((cm_q2_numClusters + 63) >> 6) << 3;
+	matrixSize = (size_t)cm_q2_visData->numClusters * 2 * cm_q2_visRowBytes;
+
+	// Decompress everything up front if it fits
+	if (cm_visCacheMB->intVal > 0 && matrixSize <= ((size_t)cm_visCacheMB->intVal << 20)) {
+		buffer = Mem_PoolAlloc (matrixSize + 7, com_cmodelSysPool, 0);
+		cm_q2_visMatrix = (byte *)(((size_t)buffer + 7) & ~7);
+
+		for (i=0 ; i<cm_q2_visData->numClusters ; i++) {
+			CM_Q2BSP_DecompressVis ((byte *)cm_q2_visData + cm_q2_visData->bitOfs[i][Q2BSP_VIS_PVS], cm_q2_visMatrix + ((i<<1) + Q2BSP_VIS_PVS) * cm_q2_visRowBytes);
+			CM_Q2BSP_DecompressVis ((byte *)cm_q2_visData + cm_q2_visData->bitOfs[i][Q2BSP_VIS_PHS], cm_q2_visMatrix + ((i<<1) + Q2BSP_VIS_PHS) * cm_q2_visRowBytes);
+		}
+
+		Com_DevPrintf (0, "CM_Q2BSP_BuildVisCache: %i clusters, %iKB decompressed\n", cm_q2_visData->numClusters, (int)(matrixSize >> 10));
+		return;
+	}
+
+	// Too big, keep a window of recently used rows instead
+	buffer = Mem_PoolAlloc (sizeof (cQ2VisRow_t) * CM_VIS_LRU_ROWS + cm_q2_visRowBytes * CM_VIS_LRU_ROWS + 7, com_cmodelSysPool, 0);
+	cm_q2_visRows = (cQ2VisRow_t *)buffer;
+	buffer = (byte *)((((size_t)(cm_q2_visRows + CM_VIS_LRU_ROWS)) + 7) & ~7);
+
+	for (i=0 ; i<CM_VIS_LRU_ROWS ; i++) {
+		cm_q2_visRows[i].key = -1;
+		cm_q2_visRows[i].row = buffer + i * cm_q2_visRowBytes;
+
+		cm_q2_visRows[i].next = cm_q2_visLRU.next;
+		cm_q2_visRows[i].prev = &cm_q2_visLRU;
+		cm_q2_visLRU.next->prev = &cm_q2_visRows[i];
+		cm_q2_visLRU.next = &cm_q2_visRows[i];
+	}
+
+	Com_DevPrintf (0, "CM_Q2BSP_BuildVisCache: %i clusters, caching %i of %i rows\n", cm_q2_visData->numClusters, CM_VIS_LRU_ROWS, cm_q2_visData->numClusters * 2);
+}
+
+
+/*
+===================
+CM_Q2BSP_VisRow
+
+Rows from the matrix stay put for the life of the map. LRU rows stay valid
+for at least CM_VIS_LRU_ROWS-1 further lookups.
+===================
+*/
+static byte *CM_Q2BSP_VisRow (int cluster, int visType)
+{
+	cQ2VisRow_t	*vr, **prev;
+	int			key;
+
+	if (cluster < 0 || !cm_q2_visData)
+		return (byte *)cm_q2_noVisRow;
+	if (!cm_q2_numVisibility)
+		return (byte *)cm_q2_allVisRow;
+	if (cluster >= cm_q2_visData->numClusters)
+		return (byte *)cm_q2_noVisRow;
+
+	if (cm_q2_visMatrix)
+		return cm_q2_visMatrix + ((cluster<<1) + visType) * cm_q2_visRowBytes;
+
+	// Find it in the LRU
+	key = (cluster<<1) | visType;
+	for (vr=cm_q2_visHash[key & (CM_VIS_LRU_HASH-1)] ; vr ; vr=vr->hashNext) {
+		if (vr->key == key)
+			break;
+	}
+
+	if (!vr) {
+		// Recycle the least recently used row
+		vr = cm_q2_visLRU.prev;
+		if (vr->key != -1) {
+			for (prev=&cm_q2_visHash[vr->key & (CM_VIS_LRU_HASH-1)] ; *prev ; prev=&(*prev)->hashNext) {
+				if (*prev == vr) {
+					*prev = vr->hashNext;
+					break;
+				}
+			}
+		}
+
+		vr->key = key;
+		vr->hashNext = cm_q2_visHash[key & (CM_VIS_LRU_HASH-1)];
+		cm_q2_visHash[key & (CM_VIS_LRU_HASH-1)] = vr;
+
+		CM_Q2BSP_DecompressVis ((byte *)cm_q2_visData + cm_q2_visData->bitOfs[cluster][visType], vr->row);
+	}
+
+	// Move to the front
+	if (cm_q2_visLRU.next != vr) {
+		vr->prev->next = vr->next;
+		vr->next->prev = vr->prev;
+
+		vr->next = cm_q2_visLRU.next;
+		vr->prev = &cm_q2_visLRU;
+		cm_q2_visLRU.next->prev = vr;
+		cm_q2_visLRU.next = vr;
+	}
+
+	return vr->row;
+}
+
+
 /*
 ===================
 CM_Q2BSP_ClusterPVS
@@ -903,13 +1323,7 @@ CM_Q2BSP_ClusterPVS
 */
 byte *CM_Q2BSP_ClusterPVS (int cluster)
 {
-	static byte		pvsRow[Q2BSP_MAX_VIS];
-
-	if (cluster == -1 || !cm_q2_visData)
-		memset (pvsRow, 0, (cm_q2_numClusters + 7) >> 3);
-	else
-		CM_Q2BSP_DecompressVis ((byte *)cm_q2_visData + cm_q2_visData->bitOfs[cluster][Q2BSP_VIS_PVS], pvsRow);
-	return pvsRow;
+	return CM_Q2BSP_VisRow (cluster, Q2BSP_VIS_PVS);
 }
 
 
@@ -920,13 +1334,7 @@ CM_Q2BSP_ClusterPHS
 */
 byte *CM_Q2BSP_ClusterPHS (int cluster)
 {
-	static byte		phsRow[Q2BSP_MAX_VIS];
-
-	if (cluster == -1 || !cm_q2_visData)
-		memset (phsRow, 0, (cm_q2_numClusters + 7) >> 3);
-	else
-		CM_Q2BSP_DecompressVis ((byte *)cm_q2_visData + cm_q2_visData->bitOfs[cluster][Q2BSP_VIS_PHS], phsRow);
-	return phsRow;
+	return CM_Q2BSP_VisRow (cluster, Q2BSP_VIS_PHS);
 }
 
 /*
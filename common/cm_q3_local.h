@@ -85,7 +85,6 @@ typedef struct cbrush_s {
 	int					contents;
 	int					numSides;
 	int					firstBrushSide;
-	int					checkCount;		// to avoid repeated testings
 } cbrush_t;
 
 typedef struct cpatch_s {
@@ -95,7 +94,6 @@ typedef struct cpatch_s {
 	cbrush_t			*brushes;
 
 	cBspSurface_t		*surface;
-	int					checkCount;		// to avoid repeated testings
 } cpatch_t;
 
 typedef struct careaportal_s {
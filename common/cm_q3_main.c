@@ -556,7 +556,7 @@ static void CM_Q3BSP_LoadVertexes (dQ3BspLump_t *l)
 	cm_q3_numVertexes = l->fileLen / sizeof (*in);
 	if (cm_q3_numVertexes > MAX_Q3BSP_CM_VERTEXES)
 		Com_Error (ERR_DROP, "CM_Q3BSP_LoadVertexes: Map has too many vertexes");
-	cm_q3_mapVerts = out = Mem_Alloc (cm_q3_numVertexes * sizeof (*out));
+	cm_q3_mapVerts = out = Mem_PoolAlloc (cm_q3_numVertexes * sizeof (*out), com_loadArena, 0);
 
 	// Byte swap
 	for (i=0 ; i<cm_q3_numVertexes ; i++, in++) {
@@ -587,7 +587,7 @@ static void CM_Q3BSP_LoadFaces (dQ3BspLump_t *l)
 	cm_q3_numFaces = l->fileLen / sizeof (*in);
 	if (cm_q3_numFaces > MAX_Q3BSP_CM_FACES)
 		Com_Error (ERR_DROP, "CM_Q3BSP_LoadFaces: Map has too many faces");
-	cm_q3_mapFaces = out = Mem_Alloc (cm_q3_numFaces * sizeof (*out));
+	cm_q3_mapFaces = out = Mem_PoolAlloc (cm_q3_numFaces * sizeof (*out), com_loadArena, 0);
 
 	// Byte swap
 	for (i=0 ; i<cm_q3_numFaces ; i++, in++, out++) {
@@ -623,7 +623,7 @@ static void CM_Q3BSP_LoadLeafFaces (dQ3BspLump_t *l)
 	cm_q3_numLeafFaces = l->fileLen / sizeof(*in);
 	if (cm_q3_numLeafFaces > MAX_Q3BSP_CM_LEAFFACES) 
 		Com_Error (ERR_DROP, "CM_Q3BSP_LoadLeafFaces: Map has too many leaffaces"); 
-	cm_q3_leafFaces = out = Mem_Alloc (cm_q3_numLeafFaces*sizeof(*out));
+	cm_q3_leafFaces = out = Mem_PoolAlloc (cm_q3_numLeafFaces*sizeof(*out), com_loadArena, 0);
 
 	// Byte swap
 	for (i=0 ; i<cm_q3_numLeafFaces ; i++) {
@@ -1132,12 +1132,10 @@ cBspModel_t *CM_Q3BSP_LoadMap (uint32 *buffer)
 
 	CM_Q3BSP_CalcPHS ();
 
-	if (cm_q3_mapVerts)
-		Mem_Free (cm_q3_mapVerts);
-	if (cm_q3_mapFaces)
-		Mem_Free (cm_q3_mapFaces);
-	if (cm_q3_leafFaces)
-		Mem_Free (cm_q3_leafFaces);
+	// Only needed to build the patches, CM_LoadMap frees com_loadArena
+	cm_q3_mapVerts = NULL;
+	cm_q3_mapFaces = NULL;
+	cm_q3_leafFaces = NULL;
 
 	return &cm_mapCModels[0];
 }
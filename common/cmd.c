@@ -47,6 +47,7 @@ qBool				com_cmdWait;
 static int			com_cmdArgc;
 static char			*com_cmdArgv[MAX_STRING_TOKENS];
 static char			com_cmdArgs[MAX_STRING_CHARS];
+static struct memPool_s	*com_cmdArgArena;	// holds com_cmdArgv, freed whole on each tokenize
 
 // ==========================================================================
 
@@ -219,11 +220,9 @@ $Cvars will be expanded unless they are in a quoted token
 void Cmd_TokenizeString (char *text, qBool macroExpand)
 {
 	char	*token;
-	int		i;
 
 	// Clear the args from the last string
-	for (i=0 ; i<com_cmdArgc ; i++)
-		Mem_Free (com_cmdArgv[i]);
+	Mem_FreePool (com_cmdArgArena);
 
 	com_cmdArgc = 0;
 	com_cmdArgs[0] = 0;
@@ -277,7 +276,7 @@ void Cmd_TokenizeString (char *text, qBool macroExpand)
 			return;
 
 		if (com_cmdArgc < MAX_STRING_TOKENS) {
-			com_cmdArgv[com_cmdArgc] = Mem_PoolStrDup (token, com_cmdSysPool, 0);
+			com_cmdArgv[com_cmdArgc] = Mem_PoolStrDup (token, com_cmdArgArena, 0);
 			com_cmdArgc++;
 		}
 	}
@@ -633,6 +632,7 @@ void Cmd_Init (void)
 {
 	memset (com_cmdFuncList, 0, sizeof (cmdFunc_t) * MAX_CMDFUNCS);
 	memset (com_cmdHashTree, 0, sizeof (com_cmdHashTree));
+	com_cmdArgArena = Mem_CreateArena ("Common: Command arguments", 4096);
 
 	Cmd_AddCommand ("cmdlist",		Cmd_List_f,		"Prints out a list of commands");
 	Cmd_AddCommand ("echo",			Cmd_Echo_f,		"Echos text to the console");
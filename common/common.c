@@ -42,6 +42,7 @@ static qBool	com_initialized;
 static FILE		*com_logFile;
 static uint32	com_numErrors;
 static uint32	com_numWarnings;
+static void		*com_printLock;
 
 struct memPool_s	*com_aliasSysPool;
 struct memPool_s	*com_cmdSysPool;
@@ -49,6 +50,9 @@ struct memPool_s	*com_cmodelSysPool;
 struct memPool_s	*com_cvarSysPool;
 struct memPool_s	*com_fileSysPool;
 struct memPool_s	*com_genericPool;
+struct memPool_s	*com_frameArena;
+struct memPool_s	*com_loadArena;
+struct memPool_s	*com_netSysPool;
 
 /*
 ============================================================================
@@ -185,6 +189,10 @@ console messages to the appropriate targets.
 */
 void Com_ConPrint (comPrint_t flags, char *string)
 {
+	// Job workers may print too
+	if (com_printLock)
+		Sys_LockMutex (com_printLock);
+
 	// Tallying purposes
 	if (flags & PRNT_ERROR)
 		com_numErrors++;
@@ -198,6 +206,8 @@ void Com_ConPrint (comPrint_t flags, char *string)
 			*com_redirectBuffer = 0;
 		}
 		strcat (com_redirectBuffer, string);
+		if (com_printLock)
+			Sys_UnlockMutex (com_printLock);
 		return;
 	}
 
@@ -226,6 +236,9 @@ void Com_ConPrint (comPrint_t flags, char *string)
 		if (logfile->intVal > 1)
 			fflush (com_logFile);	// force it to save every time
 	}
+
+	if (com_printLock)
+		Sys_UnlockMutex (com_printLock);
 }
 
 
@@ -658,12 +671,16 @@ void Com_Init (int argc, char **argv)
 
 	// Memory init
 	Mem_Init ();
+	com_printLock = Sys_CreateMutex ();
 	com_aliasSysPool = Mem_CreatePool ("Common: Alias system");
 	com_cmdSysPool = Mem_CreatePool ("Common: Command system");
 	com_cmodelSysPool = Mem_CreatePool ("Common: Collision model");
 	com_cvarSysPool = Mem_CreatePool ("Common: Cvar system");
 	com_fileSysPool = Mem_CreatePool ("Common: File system");
 	com_genericPool = Mem_CreatePool ("Generic");
+	com_frameArena = Mem_CreateArena ("Common: Frame scratch", 65536);
+	com_loadArena = Mem_CreateArena ("Common: Map load scratch", 1048576);
+	com_netSysPool = Mem_CreateSlabPool ("Common: Network buffers", 16384);
 
 	// Prepare enough of the subsystems to handle cvar and command buffer management
 	Com_InitArgv ((size_t) argc, argv);
@@ -751,6 +768,7 @@ void Com_Init (int argc, char **argv)
 #endif
 
 	// Init the rest of the sub-systems
+	Job_Init ();
 	NET_Init ();
 	Netchan_Init ();
 
@@ -803,6 +821,9 @@ void Com_Frame (int msec)
 	if (setjmp (abortframe))
 		return;			// an ERR_DROP was thrown
 
+	// Last frame's scratch memory
+	Mem_FreePool (com_frameArena);
+
 	if (fixedtime->floatVal)
 		msec = fixedtime->floatVal;
 	else if (timescale->floatVal) {
@@ -841,5 +862,6 @@ Com_Shutdown
 */
 void Com_Shutdown (void)
 {
+	Job_Shutdown ();
 	NET_Shutdown ();
 }
@@ -34,6 +34,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #include "cmd.h"
 #include "cvar.h"
 #include "memory.h"
+#include "jobs.h"
 #include "parse.h"
 
 #define EGL_VERSTR			"0.3.1"
@@ -47,6 +48,9 @@ extern struct memPool_s	*com_cmodelSysPool;
 extern struct memPool_s *com_cvarSysPool;
 extern struct memPool_s *com_fileSysPool;
 extern struct memPool_s *com_genericPool;
+extern struct memPool_s *com_frameArena;	// freed whole at the start of each frame
+extern struct memPool_s *com_loadArena;		// freed whole once a map is loaded
+extern struct memPool_s *com_netSysPool;
 
 // ==========================================================================
 
@@ -100,6 +104,7 @@ typedef enum libType_s {
 
 int			Sys_Milliseconds (void);
 uint32		Sys_UMilliseconds (void);
+uint32		Sys_UMicroseconds (void);	// for timing short spans, wraps every ~71 minutes
 
 void		Sys_Init (void);
 void		Sys_AppActivate (void);
@@ -114,6 +119,30 @@ void		Sys_Quit (qBool error);
 char		*Sys_GetClipboardData (void);
 
 void		Sys_Mkdir (char *path);
+int			Sys_FileTime (char *path);	// -1 if not present
+
+// read-only, copy-on-write view of an entire file, NULL on failure
+void		*Sys_MapFile (char *path, size_t *length, void **mapHandle);
+void		Sys_UnmapFile (void *base, size_t length, void *mapHandle);
+
+// threads and their synchronization, handles are opaque
+typedef void (*sysThreadFunc_t) (void *arg);
+
+void		*Sys_CreateThread (sysThreadFunc_t func, void *arg);
+void		Sys_JoinThread (void *thread);
+
+void		*Sys_CreateMutex (void);	// recursive
+void		Sys_DestroyMutex (void *mutex);
+void		Sys_LockMutex (void *mutex);
+void		Sys_UnlockMutex (void *mutex);
+
+void		*Sys_CreateSemaphore (int initialCount);
+void		Sys_DestroySemaphore (void *sem);
+void		Sys_PostSemaphore (void *sem);
+void		Sys_WaitSemaphore (void *sem);
+
+int			Sys_AtomicAdd (volatile int *value, int add);	// returns the previous value
+int			Sys_NumProcessors (void);
 
 // pass in an attribute mask of things you wish to REJECT
 char		*Sys_FindFirst (char *path, uint32 mustHave, uint32 cantHave);
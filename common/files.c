@@ -25,14 +25,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #include "../include/minizip/unzip.h"
 
 #define FS_MAX_PAKS			1024
-#define FS_MAX_HASHSIZE		1024
 #define FS_MAX_FILEINDICES	1024
+#define FS_MAX_MEMINFLATE	(8<<20)		// Larger compressed entries are streamed through minizip
+
+#define FS_LOOSE_SCRATCH	65536		// Starting size of the directory scan list, doubled while it fills
+#define FS_INDEX_HASHSIZE	32768
+#define FS_INDEX_SPARE		1024		// Room for files written after the index is built
+#define FS_MAX_PREFETCH		1024
+#define FS_PREFETCH_HASHSIZE	256
 
 cVar_t	*fs_basedir;
 cVar_t	*fs_cddir;
 cVar_t	*fs_game;
 cVar_t	*fs_gamedircvar;
 cVar_t	*fs_defaultPaks;
+cVar_t	*fs_writeRingKB;	// ring for FS_SetAsyncWrite, 0 writes in place
 
 /*
 =============================================================================
@@ -48,7 +55,10 @@ typedef struct mPackFile_s {
 	int						filePos;
 	int						fileLen;
 
-	struct mPackFile_s		*hashNext;
+	// Location of the raw data in the mapped package, -1 if it can't be addressed
+	int						mapOfs;
+	int						compLen;
+	qBool					deflated;
 } mPackFile_t;
 
 typedef struct mPack_s {
@@ -60,11 +70,18 @@ typedef struct mPack_s {
 	// Compressed
 	unzFile					*pkz;
 
+	// Mapped once at load, stored entries are served straight out of it
+	byte					*mapBase;
+	size_t					mapSize;
+	void					*mapHandle;
+
+	// One for the search path, plus one per view handed out of the mapping
+	int						refCount;
+	struct mPack_s			*retiredNext;
+
 	// Information
 	size_t					numFiles;
 	mPackFile_t				*files;
-
-	struct mPackFile_s		*fileHashTree[FS_MAX_HASHSIZE];
 } mPack_t;
 
 /*
@@ -87,6 +104,13 @@ typedef struct fsPath_s {
 	char					gamePath[MAX_OSPATH];
 	mPack_t					*package;
 
+	// Cached scan of a directory tree, full paths as returned by Sys_FindFiles
+	char					**looseFiles;
+	size_t					numLooseFiles;
+	char					**looseDirs;
+	size_t					numLooseDirs;
+
+	int						rank;				// Position in fs_searchPaths, 0 wins
 	struct fsPath_s			*next;
 } fsPath_t;
 
@@ -99,6 +123,37 @@ static fsPath_t	**fs_invSearchPaths;
 static size_t	fs_numInvSearchPaths;
 static fsPath_t	*fs_baseSearchPath;		// Without gamedirs
 
+static void		*fs_lock;				// Handles and the index are shared with job workers
+
+static mPack_t		*fs_retiredPacks;		// Dropped by FS_SetGamedir, still mapped for borrowed views
+
+/*
+=============================================================================
+
+	GLOBAL FILE INDEX
+
+	Every file reachable through the search path, mapped to the search path
+	that wins it. Rebuilt when the search path changes, and lazily after
+	FS_InvalidateIndex.
+=============================================================================
+*/
+
+typedef struct fsIndexEntry_s {
+	char					*name;				// Points into the pack or loose file list
+	fsPath_t				*searchPath;
+	mPackFile_t				*packFile;			// NULL for loose files
+
+	uint32					findStamp;			// Duplicate check for FS_FindFiles
+	struct fsIndexEntry_s	*hashNext;
+} fsIndexEntry_t;
+
+static fsIndexEntry_t	*fs_indexHashTree[FS_INDEX_HASHSIZE];
+static fsIndexEntry_t	*fs_indexEntries;
+static size_t			fs_numIndexEntries;
+static size_t			fs_maxIndexEntries;
+static qBool			fs_indexDirty = qTrue;
+static uint32			fs_indexFindStamp;
+
 /*
 =============================================================================
 
@@ -113,13 +168,48 @@ typedef struct fsHandleIndex_s {
 	qBool					inUse;
 	fsOpenMode_t			openMode;
 
-	// One of these is always NULL
+	// Only one of these is ever set
 	FILE					*regFile;
 	unzFile					*pkzFile;
+	byte					*memBase;
+
+	// Memory files (mapped pack entries, or inflated ones if memOwned)
+	size_t					memLen;
+	size_t					memPos;
+	qBool					memOwned;
+	struct mPack_s			*memPack;
+
+	// Writes handed to a writer thread, see FS_SetAsyncWrite
+	struct fsAsyncWriter_s	*async;
 } fsHandleIndex_t;
 
 static fsHandleIndex_t	fs_fileIndices[FS_MAX_FILEINDICES];
 
+/*
+=============================================================================
+
+	PREFETCHING
+
+	Files named ahead of time are read on the job workers, and handed over
+	by FS_LoadFile when the main thread gets around to asking for them.
+=============================================================================
+*/
+
+typedef struct fsPrefetch_s {
+	char					name[MAX_QPATH];
+	void					*buffer;
+	int						fileLen;
+	qBool					taken;
+
+	jobList_t				job;
+	struct fsPrefetch_s		*hashNext;
+} fsPrefetch_t;
+
+static fsPrefetch_t		fs_prefetch[FS_MAX_PREFETCH];
+static fsPrefetch_t		*fs_prefetchHashTree[FS_PREFETCH_HASHSIZE];
+static uint32			fs_numPrefetch;
+static uint32			fs_numPrefetchHits;
+
 /*
 =============================================================================
 
@@ -170,6 +260,36 @@ int FS_ZLibDecompress (byte *in, int inLen, byte *out, int outLen, int wbits)
 }
 
 
+/*
+================
+FS_InflateEntry
+
+Inflates a raw deflated pack entry, -1 if the data is corrupt.
+================
+*/
+static int FS_InflateEntry (byte *in, int inLen, byte *out, int outLen)
+{
+	z_stream	zs;
+	int			result;
+
+	memset (&zs, 0, sizeof (zs));
+	if (inflateInit2 (&zs, -MAX_WBITS) != Z_OK)
+		return -1;
+
+	zs.next_in = in;
+	zs.avail_in = inLen;
+	zs.next_out = out;
+	zs.avail_out = outLen;
+
+	result = inflate (&zs, Z_FINISH);
+	inflateEnd (&zs);
+
+	if (result != Z_STREAM_END || zs.total_out != (uLong)outLen)
+		return -1;
+	return (int)zs.total_out;
+}
+
+
 /*
 ================
 FS_ZLibCompressChunk
@@ -203,8 +323,10 @@ int FS_ZLibCompressChunk (byte *in, int inLen, byte *out, int outLen, int method
 		return 0;
 
 	result = deflate(&zs, Z_FINISH);
-	if (result != Z_STREAM_END)
+	if (result != Z_STREAM_END) {
+		deflateEnd (&zs);
 		return 0;
+	}
 
 	result = deflateEnd(&zs);
 	if (result != Z_OK)
@@ -294,6 +416,303 @@ void FS_CopyFile (char *src, char *dst)
 
 	fclose (f1);
 	fclose (f2);
+
+	// Copies are made with full paths, so just rescan
+	FS_InvalidateIndex ();
+}
+
+/*
+=============================================================================
+
+	FILE INDEX
+
+=============================================================================
+*/
+
+/*
+================
+FS_LooseName
+
+Strips the search path off of a cached loose file name.
+================
+*/
+static inline char *FS_LooseName (fsPath_t *searchPath, char *fullName)
+{
+	return fullName + strlen (searchPath->pathName) + 1;
+}
+
+
+/*
+================
+FS_IndexFind
+================
+*/
+static fsIndexEntry_t *FS_IndexFind (char *name)
+{
+	fsIndexEntry_t	*entry;
+
+	for (entry=fs_indexHashTree[Com_HashGeneric (name, FS_INDEX_HASHSIZE)] ; entry ; entry=entry->hashNext) {
+		if (!Q_stricmp (entry->name, name))
+			return entry;
+	}
+
+	return NULL;
+}
+
+
+/*
+================
+FS_IndexInsert
+
+Adds a file to the index, or takes the name over if the search path outranks the current owner.
+Returns qFalse if the index is full.
+================
+*/
+static qBool FS_IndexInsert (fsPath_t *searchPath, mPackFile_t *packFile, char *name)
+{
+	fsIndexEntry_t	*entry;
+	uint32			hashValue;
+
+	entry = FS_IndexFind (name);
+	if (entry) {
+		if (entry->searchPath->rank > searchPath->rank) {
+			entry->name = name;
+			entry->searchPath = searchPath;
+			entry->packFile = packFile;
+		}
+		return qTrue;
+	}
+
+	if (fs_numIndexEntries >= fs_maxIndexEntries)
+		return qFalse;
+
+	entry = &fs_indexEntries[fs_numIndexEntries++];
+	entry->name = name;
+	entry->searchPath = searchPath;
+	entry->packFile = packFile;
+	entry->findStamp = 0;
+
+	hashValue = Com_HashGeneric (name, FS_INDEX_HASHSIZE);
+	entry->hashNext = fs_indexHashTree[hashValue];
+	fs_indexHashTree[hashValue] = entry;
+	return qTrue;
+}
+
+
+/*
+================
+FS_ScanLoose
+
+Returns a right-sized copy of the scan results. The index is all lookups
+go by, so a scan that fills the scratch list is run again with a bigger one
+rather than leaving the rest out.
+================
+*/
+static char **FS_ScanLoose (char *path, char ***scratch, int *maxScratch, qBool dirs, size_t *numFound)
+{
+	char	**list;
+	int		num;
+
+	for ( ; ; ) {
+		num = Sys_FindFiles (path, "*", *scratch, *maxScratch, 0, qTrue, !dirs, dirs);
+		if (num < *maxScratch)
+			break;
+
+		FS_FreeFileList (*scratch, num);
+		Mem_Free (*scratch);
+		*maxScratch *= 2;
+		*scratch = Mem_PoolAlloc (sizeof (char *) * (*maxScratch), com_fileSysPool, 0);
+	}
+
+	*numFound = num;
+	if (num <= 0) {
+		*numFound = 0;
+		return NULL;
+	}
+
+	list = Mem_PoolAlloc (sizeof (char *) * num, com_fileSysPool, 0);
+	memcpy (list, *scratch, sizeof (char *) * num);
+	return list;
+}
+
+
+/*
+================
+FS_FreeIndex
+================
+*/
+static void FS_FreeIndex (void)
+{
+	fsPath_t	*searchPath;
+
+	for (searchPath=fs_searchPaths ; searchPath ; searchPath=searchPath->next) {
+		if (searchPath->looseFiles) {
+			FS_FreeFileList (searchPath->looseFiles, searchPath->numLooseFiles);
+			Mem_Free (searchPath->looseFiles);
+		}
+		if (searchPath->looseDirs) {
+			FS_FreeFileList (searchPath->looseDirs, searchPath->numLooseDirs);
+			Mem_Free (searchPath->looseDirs);
+		}
+
+		searchPath->looseFiles = searchPath->looseDirs = NULL;
+		searchPath->numLooseFiles = searchPath->numLooseDirs = 0;
+	}
+
+	if (fs_indexEntries)
+		Mem_Free (fs_indexEntries);
+	fs_indexEntries = NULL;
+	fs_numIndexEntries = fs_maxIndexEntries = 0;
+
+	memset (fs_indexHashTree, 0, sizeof (fs_indexHashTree));
+	fs_indexDirty = qTrue;
+}
+
+
+/*
+================
+FS_BuildIndex
+
+Scans the loose directories and merges them with the packages into one index.
+================
+*/
+static void FS_BuildIndex (void)
+{
+	fsPath_t	*searchPath;
+	mPackFile_t	*packFile;
+	char		**scratch;
+	int			maxScratch;
+	size_t		numFiles, i;
+	uint32		startTime;
+	int			rank;
+
+	startTime = Sys_UMilliseconds ();
+	FS_FreeIndex ();
+
+	// Rank the search path and cache the directory trees
+	maxScratch = FS_LOOSE_SCRATCH;
+	scratch = Mem_PoolAlloc (sizeof (char *) * maxScratch, com_fileSysPool, 0);
+	numFiles = 0;
+	for (rank=0, searchPath=fs_searchPaths ; searchPath ; searchPath=searchPath->next, rank++) {
+		searchPath->rank = rank;
+
+		if (searchPath->package) {
+			numFiles += searchPath->package->numFiles;
+			continue;
+		}
+
+		searchPath->looseFiles = FS_ScanLoose (searchPath->pathName, &scratch, &maxScratch, qFalse, &searchPath->numLooseFiles);
+		searchPath->looseDirs = FS_ScanLoose (searchPath->pathName, &scratch, &maxScratch, qTrue, &searchPath->numLooseDirs);
+		numFiles += searchPath->numLooseFiles;
+	}
+	Mem_Free (scratch);
+
+	fs_maxIndexEntries = numFiles + FS_INDEX_SPARE;
+	fs_indexEntries = Mem_PoolAlloc (sizeof (fsIndexEntry_t) * fs_maxIndexEntries, com_fileSysPool, 0);
+
+	// Highest ranking path first, so the first file in gets to keep the name
+	for (searchPath=fs_searchPaths ; searchPath ; searchPath=searchPath->next) {
+		if (searchPath->package) {
+			// Later duplicates in a single package win, same as the old per-package hash chains
+			packFile = searchPath->package->files + searchPath->package->numFiles;
+			for (i=0 ; i<searchPath->package->numFiles ; i++) {
+				packFile--;
+				FS_IndexInsert (searchPath, packFile, packFile->fileName);
+			}
+		}
+		else {
+			for (i=0 ; i<searchPath->numLooseFiles ; i++)
+				FS_IndexInsert (searchPath, NULL, FS_LooseName (searchPath, searchPath->looseFiles[i]));
+		}
+	}
+
+	fs_indexDirty = qFalse;
+	if (fs_developer->intVal)
+		Com_Printf (0, "FS_BuildIndex: %u files indexed in %ums\n", fs_numIndexEntries, Sys_UMilliseconds()-startTime);
+}
+
+
+/*
+================
+FS_IndexLookup
+
+The index is authoritative, a miss never touches the disk. Files written
+through the filesystem add themselves, anything else has to call
+FS_AddLooseFile or FS_InvalidateIndex.
+================
+*/
+static fsIndexEntry_t *FS_IndexLookup (char *name)
+{
+	if (fs_indexDirty)
+		FS_BuildIndex ();
+
+	return FS_IndexFind (name);
+}
+
+
+/*
+================
+FS_InvalidateIndex
+
+Call when files are added or removed behind the filesystem's back, the
+index is rebuilt on the next lookup.
+================
+*/
+void FS_InvalidateIndex (void)
+{
+	fs_indexDirty = qTrue;
+}
+
+
+/*
+================
+FS_AddLooseFile
+
+Adds a file that was just written to the game directory, without rescanning everything.
+================
+*/
+void FS_AddLooseFile (char *fileName)
+{
+	fsPath_t	*searchPath;
+	char		**newList;
+	size_t		i;
+
+	Sys_LockMutex (fs_lock);
+	if (fs_indexDirty) {
+		Sys_UnlockMutex (fs_lock);
+		return;
+	}
+
+	// Find the directory that writes go to
+	for (searchPath=fs_searchPaths ; searchPath ; searchPath=searchPath->next) {
+		if (!searchPath->package && !strcmp (searchPath->pathName, fs_gameDir))
+			break;
+	}
+	if (!searchPath) {
+		FS_InvalidateIndex ();
+		Sys_UnlockMutex (fs_lock);
+		return;
+	}
+
+	// Already known?
+	for (i=0 ; i<searchPath->numLooseFiles ; i++) {
+		if (!Q_stricmp (FS_LooseName (searchPath, searchPath->looseFiles[i]), fileName)) {
+			Sys_UnlockMutex (fs_lock);
+			return;
+		}
+	}
+
+	newList = Mem_PoolAlloc (sizeof (char *) * (searchPath->numLooseFiles+1), com_fileSysPool, 0);
+	if (searchPath->looseFiles) {
+		memcpy (newList, searchPath->looseFiles, sizeof (char *) * searchPath->numLooseFiles);
+		Mem_Free (searchPath->looseFiles);
+	}
+	newList[searchPath->numLooseFiles] = Mem_PoolStrDup (Q_VarArgs ("%s/%s", searchPath->pathName, fileName), com_fileSysPool, 0);
+	searchPath->looseFiles = newList;
+
+	if (!FS_IndexInsert (searchPath, NULL, FS_LooseName (searchPath, searchPath->looseFiles[searchPath->numLooseFiles++])))
+		FS_InvalidateIndex ();
+	Sys_UnlockMutex (fs_lock);
 }
 
 /*
@@ -348,6 +767,220 @@ static fsHandleIndex_t *FS_GetHandle (fileHandle_t fileNum)
 }
 
 
+/*
+=============================================================================
+
+	ASYNCHRONOUS WRITES
+
+	A write handle can be given a ring and a thread of its own, so that the
+	frame never waits on the disk while recording. The main thread only ever
+	moves the head and the writer only ever moves the tail, so neither side
+	takes a lock. The writer empties the ring in as few fwrites as the wrap
+	allows. When the ring is full the main thread waits for room rather than
+	drop part of the stream, and the stall is counted.
+=============================================================================
+*/
+
+typedef struct fsAsyncWriter_s {
+	byte					*ring;
+	uint32					ringSize;		// power of two
+	volatile int			head;			// bytes queued, only the main thread moves this
+	volatile int			tail;			// bytes written, only the writer moves this
+
+	FILE					*file;
+	void					*thread;
+	void					*wakeSem;		// posted when there's something for the writer
+	void					*roomSem;		// posted once a waiting main thread can go on
+	volatile int			waiting;
+	volatile int			shutdown;
+
+	int						numStalls;
+	size_t					numBytes;
+} fsAsyncWriter_t;
+
+/*
+=================
+FS_AsyncWriterThread
+=================
+*/
+static void FS_AsyncWriterThread (void *arg)
+{
+	fsAsyncWriter_t	*aw = (fsAsyncWriter_t *)arg;
+	uint32			avail, ofs, len;
+
+	for ( ; ; ) {
+		Sys_WaitSemaphore (aw->wakeSem);
+
+		// Write out everything queued so far
+		for ( ; ; ) {
+			avail = (uint32)(aw->head - aw->tail);
+			if (!avail)
+				break;
+
+			ofs = (uint32)aw->tail & (aw->ringSize-1);
+			len = min (avail, aw->ringSize - ofs);
+			fwrite (aw->ring + ofs, 1, len, aw->file);
+			Sys_AtomicAdd (&aw->tail, (int)len);
+		}
+		fflush (aw->file);
+
+		if (aw->waiting) {
+			aw->waiting = 0;
+			Sys_PostSemaphore (aw->roomSem);
+		}
+
+		if (aw->shutdown && aw->head == aw->tail)
+			break;
+	}
+}
+
+
+/*
+=================
+FS_AsyncWait
+
+Blocks the main thread until the writer has caught up
+=================
+*/
+static void FS_AsyncWait (fsAsyncWriter_t *aw)
+{
+	aw->waiting = 1;
+	Sys_PostSemaphore (aw->wakeSem);
+	Sys_WaitSemaphore (aw->roomSem);
+}
+
+
+/*
+=================
+FS_AsyncWrite
+=================
+*/
+static void FS_AsyncWrite (fsAsyncWriter_t *aw, byte *data, size_t size)
+{
+	uint32	room, ofs, len;
+
+	aw->numBytes += size;
+	while (size) {
+		room = aw->ringSize - (uint32)(aw->head - aw->tail);
+		if (!room) {
+			aw->numStalls++;
+			FS_AsyncWait (aw);
+			continue;
+		}
+
+		ofs = (uint32)aw->head & (aw->ringSize-1);
+		len = min (room, aw->ringSize - ofs);
+		len = min (len, (uint32)size);
+		memcpy (aw->ring + ofs, data, len);
+		Sys_AtomicAdd (&aw->head, (int)len);
+
+		data += len;
+		size -= len;
+	}
+
+	Sys_PostSemaphore (aw->wakeSem);
+}
+
+
+/*
+=================
+FS_AsyncFlush
+=================
+*/
+static void FS_AsyncFlush (fsAsyncWriter_t *aw)
+{
+	while (aw->head != aw->tail)
+		FS_AsyncWait (aw);
+}
+
+
+/*
+=================
+FS_AsyncStop
+=================
+*/
+static void FS_AsyncStop (fsHandleIndex_t *handle)
+{
+	fsAsyncWriter_t	*aw = handle->async;
+
+	aw->shutdown = 1;
+	Sys_PostSemaphore (aw->wakeSem);
+	Sys_JoinThread (aw->thread);
+
+	if (aw->numStalls)
+		Com_DevPrintf (PRNT_WARNING, "%s: disk fell behind %i times over %u bytes, a bigger ring would help\n",
+			handle->name, aw->numStalls, (uint32)aw->numBytes);
+
+	Sys_DestroySemaphore (aw->wakeSem);
+	Sys_DestroySemaphore (aw->roomSem);
+	Mem_Free (aw->ring);
+	Mem_Free (aw);
+	handle->async = NULL;
+}
+
+
+/*
+=================
+FS_SetAsyncWrite
+
+Hands every further FS_Write on a regular file opened for writing to a
+thread of its own, through a ring of fs_writeRingKB (rounded up to a power
+of two). Seeks, tells and closes wait for the ring to empty first.
+=================
+*/
+void FS_SetAsyncWrite (fileHandle_t fileNum)
+{
+	fsHandleIndex_t	*handle;
+	fsAsyncWriter_t	*aw;
+	uint32			size;
+
+	handle = FS_GetHandle (fileNum);
+	if (!handle->regFile || handle->async)
+		return;
+	if (handle->openMode == FS_MODE_READ_BINARY || fs_writeRingKB->intVal <= 0)
+		return;
+
+	for (size=4096 ; size<(uint32)fs_writeRingKB->intVal*1024 && size<(1<<28) ; size<<=1) ;
+
+	aw = Mem_Alloc (sizeof (fsAsyncWriter_t));
+	aw->ring = Mem_Alloc (size);
+	aw->ringSize = size;
+	aw->file = handle->regFile;
+	aw->wakeSem = Sys_CreateSemaphore (0);
+	aw->roomSem = Sys_CreateSemaphore (0);
+	aw->thread = Sys_CreateThread (FS_AsyncWriterThread, aw);
+	if (!aw->thread) {
+		// Just write in place
+		Sys_DestroySemaphore (aw->wakeSem);
+		Sys_DestroySemaphore (aw->roomSem);
+		Mem_Free (aw->ring);
+		Mem_Free (aw);
+		return;
+	}
+
+	handle->async = aw;
+}
+
+
+/*
+=================
+FS_FlushFile
+
+Waits for any writes still queued for the writer thread to reach the disk
+=================
+*/
+void FS_FlushFile (fileHandle_t fileNum)
+{
+	fsHandleIndex_t	*handle;
+
+	handle = FS_GetHandle (fileNum);
+	if (handle->async)
+		FS_AsyncFlush (handle->async);
+	else if (handle->regFile && handle->openMode != FS_MODE_READ_BINARY)
+		fflush (handle->regFile);
+}
+
+
 /*
 ============
 FS_FileLength
@@ -362,8 +995,13 @@ size_t FS_FileLength (fileHandle_t fileNum)
 
 	handle = FS_GetHandle (fileNum);
 	if (handle->regFile) {
+		if (handle->async)
+			FS_AsyncFlush (handle->async);
 		return __FileLen (handle->regFile);
 	}
+	else if (handle->memBase) {
+		return handle->memLen;
+	}
 	else if (handle->pkzFile) {
 		// FIXME
 		return 0;
@@ -387,10 +1025,14 @@ size_t FS_Tell (fileHandle_t fileNum)
 	fsHandleIndex_t	*handle;
 
 	handle = FS_GetHandle (fileNum);
+	if (handle->async)
+		FS_AsyncFlush (handle->async);
 	if (handle->regFile)
 		return ftell (handle->regFile);
 	else if (handle->pkzFile)
 		return unztell (handle->pkzFile);
+	else if (handle->memBase)
+		return handle->memPos;
 
 	// Shouldn't happen...
 	assert (0);
@@ -451,6 +1093,18 @@ size_t FS_Read (void *buffer, size_t len, fileHandle_t fileNum)
 
 		return len;
 	}
+	else if (handle->memBase) {
+		// Memory file
+		if (remaining > handle->memLen - handle->memPos)
+			remaining = handle->memLen - handle->memPos;
+
+		memcpy (buf, handle->memBase + handle->memPos, remaining);
+		handle->memPos += remaining;
+
+		if (remaining < len && fs_developer->intVal)
+			Com_Printf (0, "FS_Read: %u of %u bytes read from \"%s\"\n", (uint32)remaining, (uint32)len, handle->name);
+		return remaining;
+	}
 	else if (handle->pkzFile) {
 		// Zip file
 		while (remaining) {
@@ -517,6 +1171,12 @@ size_t FS_Write (void *buffer, size_t size, fileHandle_t fileNum)
 	if (size == 0)
 		Com_Error (ERR_FATAL, "FS_Write: size == 0");
 
+	// Queue it for the writer thread
+	if (handle->async) {
+		FS_AsyncWrite (handle->async, (byte *)buffer, size);
+		return size;
+	}
+
 	// Write
 	remaining = size;
 	buf = (byte *)buffer;
@@ -563,6 +1223,8 @@ void FS_Seek (fileHandle_t fileNum, long offset, fsSeekOrigin_t seekOrigin)
 	static byte		dummy[0x8000];
 
 	handle = FS_GetHandle (fileNum);
+	if (handle->async)
+		FS_AsyncFlush (handle->async);
 	if (handle->regFile) {
 		// Seek through a regular file
 		switch (seekOrigin) {
@@ -583,6 +1245,28 @@ void FS_Seek (fileHandle_t fileNum, long offset, fsSeekOrigin_t seekOrigin)
 			break;
 		}
 	}
+	else if (handle->memBase) {
+		// Seek through a memory file
+		switch (seekOrigin) {
+		case FS_SEEK_SET:
+			remaining = offset;
+			break;
+
+		case FS_SEEK_CUR:
+			remaining = offset + (int)handle->memPos;
+			break;
+
+		case FS_SEEK_END:
+			remaining = offset + (int)handle->memLen;
+			break;
+
+		default:
+			Com_Error (ERR_FATAL, "FS_Seek: bad origin (%i)", seekOrigin);
+			break;
+		}
+
+		handle->memPos = (size_t)clamp (remaining, 0, (int)handle->memLen);
+	}
 	else if (handle->pkzFile) {
 		// Seek through a zip
 		switch (seekOrigin) {
@@ -650,6 +1334,7 @@ static int FS_OpenFileAppend (fsHandleIndex_t *handle, qBool binary)
 	if (handle->regFile) {
 		if (fs_developer->intVal)
 			Com_Printf (0, "FS_OpenFileAppend: \"%s\"", path);
+		FS_AddLooseFile (handle->name);
 		return __FileLen (handle->regFile);
 	}
 
@@ -684,12 +1369,117 @@ static int FS_OpenFileWrite (fsHandleIndex_t *handle, qBool binary)
 	if (handle->regFile) {
 		if (fs_developer->intVal)
 			Com_Printf (0, "FS_OpenFileWrite: \"%s\"", path);
+		FS_AddLooseFile (handle->name);
 		return 0;
 	}
 
-	// Failed to open
-	if (fs_developer->intVal)
-		Com_Printf (0, "FS_OpenFileWrite: couldn't open \"%s\"", path);
+	// Failed to open
+	if (fs_developer->intVal)
+		Com_Printf (0, "FS_OpenFileWrite: couldn't open \"%s\"", path);
+	return -1;
+}
+
+
+/*
+===========
+FS_ReleasePack
+
+Drops a reference, and frees the package once it's neither on the search path
+nor borrowed from anymore.
+===========
+*/
+static void FS_ReleasePack (mPack_t *package)
+{
+	mPack_t	**prev;
+
+	Sys_LockMutex (fs_lock);
+	if (--package->refCount > 0) {
+		Sys_UnlockMutex (fs_lock);
+		return;
+	}
+
+	for (prev=&fs_retiredPacks ; *prev ; prev=&(*prev)->retiredNext) {
+		if (*prev == package) {
+			*prev = package->retiredNext;
+			break;
+		}
+	}
+	Sys_UnlockMutex (fs_lock);
+
+	Sys_UnmapFile (package->mapBase, package->mapSize, package->mapHandle);
+	Mem_Free (package->files);
+	Mem_Free (package);
+}
+
+
+/*
+===========
+FS_OpenPackFile
+
+Opens a file that lives inside of a package.
+===========
+*/
+static int FS_OpenPackFile (fsHandleIndex_t *handle, mPack_t *package, mPackFile_t *searchFile)
+{
+	if (package->mapBase && searchFile->mapOfs != -1) {
+		if (!searchFile->deflated) {
+			// Stored, hand out a view into the mapping
+			if (fs_developer->intVal)
+				Com_Printf (0, "FS_OpenFileRead: mapped file %s : %s\n", package->name, handle->name);
+
+			handle->memBase = package->mapBase + searchFile->mapOfs;
+			handle->memLen = searchFile->fileLen;
+			handle->memPack = package;
+			package->refCount++;
+			return searchFile->fileLen;
+		}
+		else if (searchFile->fileLen > 0 && searchFile->fileLen <= FS_MAX_MEMINFLATE) {
+			// Compressed, inflate straight from the mapping
+			if (fs_developer->intVal)
+				Com_Printf (0, "FS_OpenFileRead: mapped pkz file %s : %s\n", package->name, handle->name);
+
+			handle->memBase = Mem_PoolAlloc (searchFile->fileLen, com_fileSysPool, 0);
+			if (FS_InflateEntry (package->mapBase + searchFile->mapOfs, searchFile->compLen, handle->memBase, searchFile->fileLen) == -1) {
+				Com_Printf (PRNT_WARNING, "WARNING: FS_OpenFileRead: %s : %s is corrupt\n", package->name, handle->name);
+				Mem_Free (handle->memBase);
+				handle->memBase = NULL;
+				return -1;
+			}
+
+			handle->memLen = searchFile->fileLen;
+			handle->memOwned = qTrue;
+			return (int)handle->memLen;
+		}
+	}
+
+	if (package->pak) {
+		if (fs_developer->intVal)
+			Com_Printf (0, "FS_OpenFileRead: pack file %s : %s\n", package->name, handle->name);
+
+		// Open a new file on the pakfile
+		handle->regFile = fopen (package->name, "rb");
+		if (handle->regFile) {
+			fseek (handle->regFile, searchFile->filePos, SEEK_SET);
+			return searchFile->fileLen;
+		}
+	}
+	else if (package->pkz) {
+		if (fs_developer->intVal)
+			Com_Printf (0, "FS_OpenFileRead: pkz file %s : %s\n", package->name, handle->name);
+
+		handle->pkzFile = unzOpen (package->name);
+		if (handle->pkzFile) {
+			if (unzSetOffset (handle->pkzFile, searchFile->filePos) == UNZ_OK) {
+				if (unzOpenCurrentFile (handle->pkzFile) == UNZ_OK)
+					return searchFile->fileLen;
+			}
+
+			// Failed to locate/open
+			unzClose (handle->pkzFile);
+		}
+	}
+
+	Com_Error (ERR_FATAL, "FS_OpenFileRead: couldn't reopen \"%s\"", handle->name);
 	return -1;
 }
 
@@ -707,12 +1497,9 @@ a seperate file.
 qBool	fs_fileFromPak = qFalse;
 static int FS_OpenFileRead (fsHandleIndex_t *handle)
 {
-	fsPath_t		*searchPath;
+	fsIndexEntry_t	*entry;
 	char			netPath[MAX_OSPATH];
-	mPack_t			*package;
-	mPackFile_t		*searchFile;
 	fsLink_t		*link;
-	uint32			hashValue;
 
 	fs_fileFromPak = qFalse;
 	// Check for links first
@@ -734,65 +1521,28 @@ static int FS_OpenFileRead (fsHandleIndex_t *handle)
 		}
 	}
 
-	// Calculate hash value
-	hashValue = Com_HashFileName (handle->name, FS_MAX_HASHSIZE);
-
-	// Search through the path, one element at a time
-	for (searchPath=fs_searchPaths ; searchPath ; searchPath=searchPath->next) {
-		// Is the element a pak file?
-		if (searchPath->package) {
-			// Look through all the pak file elements
-			package = searchPath->package;
-
-			for (searchFile=package->fileHashTree[hashValue] ; searchFile ; searchFile=searchFile->hashNext) {
-				if (Q_stricmp (searchFile->fileName, handle->name))
-					continue;
-
-				// Found it!
-				fs_fileFromPak = qTrue;
+	// The index knows which search path wins, if any
+	entry = FS_IndexLookup (handle->name);
+	if (entry) {
+		if (entry->packFile) {
+			// Found it!
+			fs_fileFromPak = qTrue;
+			return FS_OpenPackFile (handle, entry->searchPath->package, entry->packFile);
+		}
 
-				if (package->pak) {
-					if (fs_developer->intVal)
-						Com_Printf (0, "FS_OpenFileRead: pack file %s : %s\n", package->name, handle->name);
-
-					// Open a new file on the pakfile
-					handle->regFile = fopen (package->name, "rb");
-					if (handle->regFile) {
-						fseek (handle->regFile, searchFile->filePos, SEEK_SET);
-						return searchFile->fileLen;
-					}
-				}
-				else if (package->pkz) {
-					if (fs_developer->intVal)
-						Com_Printf (0, "FS_OpenFileRead: pkz file %s : %s\n", package->name, handle->name);
-
-					handle->pkzFile = unzOpen (package->name);
-					if (handle->pkzFile) {
-						if (unzSetOffset (handle->pkzFile, searchFile->filePos) == UNZ_OK) {
-							if (unzOpenCurrentFile (handle->pkzFile) == UNZ_OK)
-								return searchFile->fileLen;
-						}
-
-						// Failed to locate/open
-						unzClose (handle->pkzFile);
-					}
-				}
+		// Check a file in the directory tree
+		Q_snprintfz (netPath, sizeof (netPath), "%s/%s", entry->searchPath->pathName, entry->name);
 
-				Com_Error (ERR_FATAL, "FS_OpenFileRead: couldn't reopen \"%s\"", handle->name);
-			}
+		handle->regFile = fopen (netPath, "rb");
+		if (handle->regFile) {
+			// Found it!
+			if (fs_developer->intVal)
+				Com_Printf (0, "FS_OpenFileRead: %s\n", netPath);
+			return __FileLen (handle->regFile);
 		}
-		else {
-			// Check a file in the directory tree
-			Q_snprintfz (netPath, sizeof (netPath), "%s/%s", searchPath->pathName, handle->name);
 
-			handle->regFile = fopen (netPath, "rb");
-			if (handle->regFile) {
-				// Found it!
-				if (fs_developer->intVal)
-					Com_Printf (0, "FS_OpenFileRead: %s\n", netPath);
-				return __FileLen (handle->regFile);
-			}
-		}
+		// Removed since the last scan
+		FS_InvalidateIndex ();
 	}
 
 	if (fs_developer->intVal)
@@ -812,6 +1562,7 @@ int FS_OpenFile (char *fileName, fileHandle_t *fileNum, fsOpenMode_t openMode)
 	fsHandleIndex_t	*handle;
 	int				fileSize = -1;
 
+	Sys_LockMutex (fs_lock);
 	*fileNum = FS_GetFreeHandle (&handle);
 
 	Q_strncpyz (handle->name, fileName, sizeof (handle->name));
@@ -848,6 +1599,7 @@ int FS_OpenFile (char *fileName, fileHandle_t *fileNum, fsOpenMode_t openMode)
 		*fileNum = 0;
 	}
 
+	Sys_UnlockMutex (fs_lock);
 	return fileSize;
 }
 
@@ -867,35 +1619,50 @@ void FS_CloseFile (fileHandle_t fileNum)
 		return;
 
 	// Close file/zip
+	if (handle->async)
+		FS_AsyncStop (handle);
 	if (handle->regFile)
 		fclose (handle->regFile);
 	else if (handle->pkzFile) {
 		unzCloseCurrentFile (handle->pkzFile);
 		unzClose (handle->pkzFile);
 	}
+	else if (handle->memBase) {
+		if (handle->memOwned)
+			Mem_Free (handle->memBase);
+		else if (handle->memPack)
+			FS_ReleasePack (handle->memPack);
+	}
 	else
 		assert (0);
 
 	// Clear handle
+	Sys_LockMutex (fs_lock);
 	handle->inUse = qFalse;
 	handle->name[0] = '\0';
 	handle->pkzFile = NULL;
 	handle->regFile = NULL;
+	handle->memBase = NULL;
+	handle->memLen = 0;
+	handle->memPos = 0;
+	handle->memOwned = qFalse;
+	handle->memPack = NULL;
+	Sys_UnlockMutex (fs_lock);
 }
 
 // ==========================================================================
 
 /*
 ============
-FS_LoadFile
+FS_LoadFileDirect
 
-Filename are reletive to the egl search path.
-A NULL buffer will just return the file length without loading.
--1 is returned if it wasn't found, 0 is returned if it's a blank file. In both cases a buffer is set to NULL.
+FS_LoadFile without the prefetch table. Prefetch jobs load through this, a job
+that found its own entry would wait on itself.
 ============
 */
-int FS_LoadFile (char *path, void **buffer, char *terminate)
+static int FS_LoadFileDirect (char *path, void **buffer, char *terminate)
 {
+	fsHandleIndex_t	*handle;
 	byte			*buf;
 	int				fileLen;
 	fileHandle_t	fileNum;
@@ -919,6 +1686,18 @@ int FS_LoadFile (char *path, void **buffer, char *terminate)
 		return fileLen;
 	}
 
+	// Memory files can be handed back without another copy
+	handle = FS_GetHandle (fileNum);
+	if (handle->memBase && !terminate) {
+		*buffer = handle->memBase;
+
+		// An inflated buffer or the view's package reference now belongs to the caller
+		handle->memOwned = qFalse;
+		handle->memPack = NULL;
+		FS_CloseFile (fileNum);
+		return fileLen;
+	}
+
 	// Allocate a local buffer
 	// If we're terminating, pad by one byte. Mem_PoolAlloc below will zero-fill...
 	if (terminate)
@@ -939,6 +1718,187 @@ int FS_LoadFile (char *path, void **buffer, char *terminate)
 }
 
 
+/*
+============
+FS_PrefetchJob
+============
+*/
+static void FS_PrefetchJob (void *arg)
+{
+	fsPrefetch_t	*entry = (fsPrefetch_t *)arg;
+
+	entry->fileLen = FS_LoadFileDirect (entry->name, &entry->buffer, NULL);
+}
+
+
+/*
+============
+FS_PrefetchFile
+
+Queues a file to be loaded on a job worker. Main thread only, and only for
+files the main thread loads itself.
+============
+*/
+void FS_PrefetchFile (char *path)
+{
+	fsPrefetch_t	*entry;
+	uint32			hash;
+
+	if (!path || !path[0] || strlen (path)+1 >= MAX_QPATH)
+		return;
+	if (fs_numPrefetch >= FS_MAX_PREFETCH)
+		return;
+
+	hash = Com_HashGeneric (path, FS_PREFETCH_HASHSIZE);
+	for (entry=fs_prefetchHashTree[hash] ; entry ; entry=entry->hashNext) {
+		if (!Q_stricmp (entry->name, path))
+			return;
+	}
+
+	Sys_LockMutex (fs_lock);
+
+	// Nothing to gain for files that aren't there
+	if (!FS_IndexLookup (path)) {
+		Sys_UnlockMutex (fs_lock);
+		return;
+	}
+
+	entry = &fs_prefetch[fs_numPrefetch];
+	Q_strncpyz (entry->name, path, sizeof (entry->name));
+	entry->buffer = NULL;
+	entry->fileLen = -1;
+	entry->taken = qFalse;
+	entry->job.numPending = 0;
+	entry->hashNext = fs_prefetchHashTree[hash];
+	fs_prefetchHashTree[hash] = entry;
+	fs_numPrefetch++;
+	Sys_UnlockMutex (fs_lock);
+
+	Job_Add (&entry->job, FS_PrefetchJob, entry);
+}
+
+
+/*
+============
+FS_TakePrefetch
+============
+*/
+static fsPrefetch_t *FS_TakePrefetch (char *path)
+{
+	fsPrefetch_t	*entry;
+	uint32			hash;
+
+	hash = Com_HashGeneric (path, FS_PREFETCH_HASHSIZE);
+
+	Sys_LockMutex (fs_lock);
+	for (entry=fs_prefetchHashTree[hash] ; entry ; entry=entry->hashNext) {
+		if (!entry->taken && !Q_stricmp (entry->name, path))
+			break;
+	}
+	if (entry) {
+		entry->taken = qTrue;
+		fs_numPrefetchHits++;
+	}
+	Sys_UnlockMutex (fs_lock);
+
+	if (entry)
+		Job_Wait (&entry->job);
+	return entry;
+}
+
+
+/*
+============
+FS_FlushPrefetch
+
+Waits for outstanding prefetches and releases whatever nobody asked for.
+Returns the number of files that were used.
+============
+*/
+uint32 FS_FlushPrefetch (void)
+{
+	fsPrefetch_t	*entry;
+	uint32			numHits;
+	uint32			i;
+
+	for (i=0, entry=fs_prefetch ; i<fs_numPrefetch ; i++, entry++) {
+		Job_Wait (&entry->job);
+		if (!entry->taken && entry->buffer)
+			FS_FreeFile (entry->buffer);
+	}
+
+	Sys_LockMutex (fs_lock);
+	numHits = fs_numPrefetchHits;
+	fs_numPrefetch = 0;
+	fs_numPrefetchHits = 0;
+	memset (fs_prefetchHashTree, 0, sizeof (fs_prefetchHashTree));
+	Sys_UnlockMutex (fs_lock);
+	return numHits;
+}
+
+// ==========================================================================
+
+/*
+============
+FS_MappedPackage
+
+Returns the package the buffer points into, including ones FS_SetGamedir has
+already dropped from the search path.
+============
+*/
+static mPack_t *FS_MappedPackage (void *buffer)
+{
+	fsPath_t	*searchPath;
+	mPack_t		*package;
+
+	for (searchPath=fs_searchPaths ; searchPath ; searchPath=searchPath->next) {
+		package = searchPath->package;
+		if (!package || !package->mapBase)
+			continue;
+
+		if ((byte *)buffer >= package->mapBase && (byte *)buffer < package->mapBase+package->mapSize)
+			return package;
+	}
+
+	for (package=fs_retiredPacks ; package ; package=package->retiredNext) {
+		if ((byte *)buffer >= package->mapBase && (byte *)buffer < package->mapBase+package->mapSize)
+			return package;
+	}
+
+	return NULL;
+}
+
+
+/*
+============
+FS_LoadFile
+
+Filename are reletive to the egl search path.
+A NULL buffer will just return the file length without loading.
+-1 is returned if it wasn't found, 0 is returned if it's a blank file. In both cases a buffer is set to NULL.
+
+Without a terminator, files stored in a mapped package are returned as a borrowed
+view into the mapping. The mapping is read-only, so copy anything that has to be
+modified in place, and release the buffer with FS_FreeFile.
+============
+*/
+int FS_LoadFile (char *path, void **buffer, char *terminate)
+{
+	fsPrefetch_t	*prefetch;
+
+	// Already loaded ahead of time?
+	if (buffer && !terminate && fs_numPrefetch) {
+		prefetch = FS_TakePrefetch (path);
+		if (prefetch) {
+			*buffer = prefetch->buffer;
+			return prefetch->fileLen;
+		}
+	}
+
+	return FS_LoadFileDirect (path, buffer, terminate);
+}
+
+
 /*
 =============
 _FS_FreeFile
@@ -946,8 +1906,22 @@ _FS_FreeFile
 */
 void _FS_FreeFile (void *buffer, const char *fileName, const int fileLine)
 {
-	if (buffer)
-		_Mem_Free (buffer, fileName, fileLine);
+	mPack_t	*package;
+
+	if (!buffer)
+		return;
+
+	// Borrowed views hold a reference on their package
+	Sys_LockMutex (fs_lock);
+	package = FS_MappedPackage (buffer);
+	if (package) {
+		FS_ReleasePack (package);
+		Sys_UnlockMutex (fs_lock);
+		return;
+	}
+	Sys_UnlockMutex (fs_lock);
+
+	_Mem_Free (buffer, fileName, fileLine);
 }
 
 // ==========================================================================
@@ -962,9 +1936,28 @@ Just like calling FS_LoadFile with a NULL buffer.
 */
 int FS_FileExists (char *path)
 {
+	fsIndexEntry_t	*entry;
+	fsLink_t		*link;
 	int				fileLen;
 	fileHandle_t	fileNum;
 
+	// Packed files don't need to be opened, and misses never touch the disk
+	for (link=fs_fileLinks ; link ; link=link->next) {
+		if (!strncmp (path, link->from, link->fromLength))
+			break;
+	}
+	if (!link) {
+		Sys_LockMutex (fs_lock);
+		entry = FS_IndexLookup (path);
+		fileLen = entry ? 0 : -1;
+		if (entry && entry->packFile)
+			fileLen = entry->packFile->fileLen > 0 ? entry->packFile->fileLen : -1;
+		Sys_UnlockMutex (fs_lock);
+
+		if (!entry || entry->packFile)
+			return fileLen;
+	}
+
 	// Look for it in the filesystem or pack files
 	fileLen = FS_OpenFile (path, &fileNum, FS_MODE_READ_BINARY);
 	if (!fileNum || fileLen <= 0)
@@ -975,6 +1968,43 @@ int FS_FileExists (char *path)
 	return fileLen;
 }
 
+
+/*
+============
+FS_FileTime
+
+Modification time of whatever the search path resolves the file to, a
+packed file reports the time of its package. -1 if it doesn't exist.
+============
+*/
+int FS_FileTime (char *path)
+{
+	fsIndexEntry_t	*entry;
+	fsLink_t		*link;
+	char			netPath[MAX_OSPATH];
+
+	for (link=fs_fileLinks ; link ; link=link->next) {
+		if (!strncmp (path, link->from, link->fromLength)) {
+			Q_snprintfz (netPath, sizeof (netPath), "%s%s", link->to, path+link->fromLength);
+			return Sys_FileTime (netPath);
+		}
+	}
+
+	Sys_LockMutex (fs_lock);
+	entry = FS_IndexLookup (path);
+	if (!entry)
+		netPath[0] = '\0';
+	else if (entry->packFile)
+		Q_strncpyz (netPath, entry->searchPath->package->name, sizeof (netPath));
+	else
+		Q_snprintfz (netPath, sizeof (netPath), "%s/%s", entry->searchPath->pathName, entry->name);
+	Sys_UnlockMutex (fs_lock);
+
+	if (!netPath[0])
+		return -1;
+	return Sys_FileTime (netPath);
+}
+
 /*
 =============================================================================
 
@@ -1001,7 +2031,6 @@ mPack_t *FS_LoadPAK (char *fileName, qBool complain)
 	FILE				*handle;
 	static dPackFile_t	info[PAK_MAX_FILES];
 	size_t				i, numFiles;
-	uint32				hashValue;
 
 	// Open
 	handle = fopen (fileName, "rb");
@@ -1044,6 +2073,8 @@ mPack_t *FS_LoadPAK (char *fileName, qBool complain)
 	outPack->pak = handle;
 	outPack->numFiles = numFiles;
 	outPack->files = outPackFile;
+	outPack->mapBase = Sys_MapFile (fileName, &outPack->mapSize, &outPack->mapHandle);
+	outPack->refCount = 1;
 
 	// Parse the directory
 	for (i=0 ; i<numFiles ; i++) {
@@ -1051,21 +2082,58 @@ mPack_t *FS_LoadPAK (char *fileName, qBool complain)
 		outPackFile->filePos = LittleLong (info[i].filePos);
 		outPackFile->fileLen = LittleLong (info[i].fileLen);
 
-		// Link it into the hash tree
-		hashValue = Com_HashFileName (outPackFile->fileName, FS_MAX_HASHSIZE);
-
-		outPackFile->hashNext = outPack->fileHashTree[hashValue];
-		outPack->fileHashTree[hashValue] = outPackFile;
+		// PAK files are never compressed
+		outPackFile->compLen = outPackFile->fileLen;
+		outPackFile->deflated = qFalse;
+		if (outPack->mapBase && outPackFile->filePos >= 0 && outPackFile->fileLen >= 0
+		&& (size_t)outPackFile->filePos + outPackFile->fileLen <= outPack->mapSize)
+			outPackFile->mapOfs = outPackFile->filePos;
+		else
+			outPackFile->mapOfs = -1;
 
 		// Next
 		outPackFile++;
 	}
 
-	Com_Printf (0, "FS_LoadPAK: loaded \"%s\"\n", fileName);
+	Com_Printf (0, "FS_LoadPAK: loaded \"%s\"%s\n", fileName, outPack->mapBase ? " (mapped)" : "");
 	return outPack;
 }
 
 
+/*
+=================
+FS_PKZDataOffset
+
+Follows a central directory record to the start of the entry's raw data in the mapping.
+Returns -1 if the entry can't be addressed directly.
+=================
+*/
+static int FS_PKZDataOffset (mPack_t *pkz, uLong centralPos, uLong compLen)
+{
+	byte	*entry, *local;
+	uint32	localOfs, dataOfs;
+
+	if (centralPos + 46 > pkz->mapSize)
+		return -1;
+	entry = pkz->mapBase + centralPos;
+	if (entry[0] != 'P' || entry[1] != 'K' || entry[2] != 1 || entry[3] != 2)
+		return -1;
+
+	localOfs = entry[42] | (entry[43]<<8) | (entry[44]<<16) | (entry[45]<<24);
+	if (localOfs + 30 > pkz->mapSize)
+		return -1;
+	local = pkz->mapBase + localOfs;
+	if (local[0] != 'P' || local[1] != 'K' || local[2] != 3 || local[3] != 4)
+		return -1;
+
+	dataOfs = localOfs + 30 + (local[26] | (local[27]<<8)) + (local[28] | (local[29]<<8));
+	if ((int)dataOfs < 0 || dataOfs + compLen > pkz->mapSize)
+		return -1;
+
+	return (int)dataOfs;
+}
+
+
 /*
 =================
 FS_LoadPKZ
@@ -1081,7 +2149,6 @@ mPack_t *FS_LoadPKZ (char *fileName, qBool complain)
 	char			name[MAX_QPATH];
 	int				status;
 	int				numFiles;
-	uint32			hashValue;
 
 	// Open
 	handle = unzOpen (fileName);
@@ -1116,6 +2183,8 @@ mPack_t *FS_LoadPKZ (char *fileName, qBool complain)
 	outPkz->pkz = handle;
 	outPkz->numFiles = numFiles;
 	outPkz->files = outPkzFile;
+	outPkz->mapBase = Sys_MapFile (fileName, &outPkz->mapSize, &outPkz->mapHandle);
+	outPkz->refCount = 1;
 
 	status = unzGoToFirstFile (handle);
 
@@ -1126,11 +2195,13 @@ mPack_t *FS_LoadPKZ (char *fileName, qBool complain)
 		outPkzFile->filePos = unzGetOffset (handle);
 		outPkzFile->fileLen = info.uncompressed_size;
 
-		// Link it into the hash tree
-		hashValue = Com_HashFileName (outPkzFile->fileName, FS_MAX_HASHSIZE);
-
-		outPkzFile->hashNext = outPkz->fileHashTree[hashValue];
-		outPkz->fileHashTree[hashValue] = outPkzFile;
+		// Only plain stored/deflated entries can be read out of the mapping
+		outPkzFile->compLen = info.compressed_size;
+		outPkzFile->deflated = (info.compression_method == Z_DEFLATED);
+		if (outPkz->mapBase && !(info.flag & 1) && (info.compression_method == 0 || info.compression_method == Z_DEFLATED))
+			outPkzFile->mapOfs = FS_PKZDataOffset (outPkz, outPkzFile->filePos, info.compressed_size);
+		else
+			outPkzFile->mapOfs = -1;
 
 		// Next
 		outPkzFile++;
@@ -1138,7 +2209,7 @@ mPack_t *FS_LoadPKZ (char *fileName, qBool complain)
 		status = unzGoToNextFile (handle);
 	}
 
-	Com_Printf (0, "FS_LoadPKZ: loaded \"%s\"\n", fileName);
+	Com_Printf (0, "FS_LoadPKZ: loaded \"%s\"%s\n", fileName, outPkz->mapBase ? " (mapped)" : "");
 	return outPkz;
 }
 
@@ -1287,10 +2358,17 @@ void FS_SetGamedir (char *dir, qBool firstTime)
 		return;
 	}
 
+	// Nothing may still be reading from the packages about to be released
+	Job_WaitAll ();
+	FS_FlushPrefetch ();
+
 	// Free old inverted paths
 	if (fs_invSearchPaths)
 		Mem_Free (fs_invSearchPaths);
 
+	// The index points into the packages about to be released
+	FS_FreeIndex ();
+
 	// Free up any current game dir info
 	for ( ; fs_searchPaths != fs_baseSearchPath ; fs_searchPaths=next) {
 		next = fs_searchPaths->next;
@@ -1302,9 +2380,15 @@ void FS_SetGamedir (char *dir, qBool firstTime)
 				fclose (package->pak);
 			else if (package->pkz)
 				unzClose (package->pkz);
-
-			Mem_Free (package->files);
-			Mem_Free (package);
+			package->pak = NULL;
+			package->pkz = NULL;
+
+			// Stays mapped until the last borrowed view is freed
+			Sys_LockMutex (fs_lock);
+			package->retiredNext = fs_retiredPacks;
+			fs_retiredPacks = package;
+			FS_ReleasePack (package);
+			Sys_UnlockMutex (fs_lock);
 		}
 
 		Mem_Free (fs_searchPaths);
@@ -1341,6 +2425,8 @@ void FS_SetGamedir (char *dir, qBool firstTime)
 		i--;
 	}
 
+	FS_BuildIndex ();
+
 	if (!firstTime) {
 		Com_Printf (0, "----------------------------------------\n");
 		Com_Printf (0, "init time: %ums\n", Sys_UMilliseconds()-initTime);
@@ -1392,22 +2478,57 @@ void FS_ExecAutoexec (void)
 =============================================================================
 */
 
+/*
+================
+FS_FindFileMatch
+================
+*/
+static qBool FS_FindFileMatch (char *name, char *filter, char *extension)
+{
+	char	ext[MAX_QEXT];
+
+	// Match extension
+	if (extension) {
+		Com_FileExtension (name, ext, sizeof (ext));
+
+		// Filter or compare
+		if (strchr (extension, '*')) {
+			if (!Q_WildcardMatch (extension, ext, 1))
+				return qFalse;
+		}
+		else {
+			if (Q_stricmp (extension, ext))
+				return qFalse;
+		}
+	}
+
+	// Match filter
+	if (filter) {
+		if (!Q_WildcardMatch (filter, name, 1))
+			return qFalse;
+	}
+
+	return qTrue;
+}
+
+
 /*
 ================
 FS_FindFiles
+
+Works from the index and the cached directory scans, so the disk is never touched.
 ================
 */
 size_t FS_FindFiles (char *path, char *filter, char *extension, char **fileList, size_t maxFiles, qBool addGameDir, qBool recurse)
 {
-	fsPath_t	*search;
-	mPackFile_t	*packFile;
-	mPack_t		*pack;
-	size_t		fileCount;
-	char		*name;
-	char		dir[MAX_OSPATH];
-	char		ext[MAX_QEXT];
-	static char	*dirFiles[FS_MAX_FINDFILES];
-	size_t		dirCount, i, j, k;
+	fsIndexEntry_t	*entry;
+	fsPath_t		*search;
+	mPackFile_t		*packFile;
+	mPack_t			*pack;
+	size_t			fileCount;
+	char			*name;
+	char			dir[MAX_OSPATH];
+	size_t			pathLen, i, j, k;
 
 	// Sanity check
 	if (maxFiles > FS_MAX_FINDFILES) {
@@ -1415,6 +2536,12 @@ size_t FS_FindFiles (char *path, char *filter, char *extension, char **fileList,
 		maxFiles = FS_MAX_FINDFILES;
 	}
 
+	Sys_LockMutex (fs_lock);
+	if (fs_indexDirty)
+		FS_BuildIndex ();
+	fs_indexFindStamp++;
+	pathLen = strlen (path);
+
 	// Search through the path, one element at a time
 	fileCount = 0;
 	for (k=0 ; k<fs_numInvSearchPaths ; k++) {
@@ -1434,89 +2561,91 @@ size_t FS_FindFiles (char *path, char *filter, char *extension, char **fileList,
 				else if (!strstr (packFile->fileName, path))
 					continue;
 
-				// Match extension
-				if (extension) {
-					Com_FileExtension (packFile->fileName, ext, sizeof (ext));
-
-					// Filter or compare
-					if (strchr (extension, '*')) {
-						if (!Q_WildcardMatch (extension, ext, 1))
-							continue;
-					}
-					else {
-						if (Q_stricmp (extension, ext))
-							continue;
-					}
-				}
-
-				// Match filter
-				if (filter) {
-					if (!Q_WildcardMatch (filter, packFile->fileName, 1))
-						continue;
-				}
+				if (!FS_FindFileMatch (packFile->fileName, filter, extension))
+					continue;
 
-				// Found something
+				// Found something, ignore duplicates
 				name = packFile->fileName;
-				if (fileCount < maxFiles) {
-					// Ignore duplicates
-					for (j=0 ; j<fileCount ; j++) {
-						if (!Q_stricmp (fileList[j], name))
-							break;
-					}
-
-					if (j == fileCount) {
-						if (addGameDir)
-							fileList[fileCount++] = Mem_PoolStrDup (Q_VarArgs ("%s/%s", search->gamePath, name), com_fileSysPool, 0);
-						else
-							fileList[fileCount++] = Mem_PoolStrDup (name, com_fileSysPool, 0);
-					}
-				}
+				entry = FS_IndexFind (name);
+				if (fileCount >= maxFiles || !entry || entry->findStamp == fs_indexFindStamp)
+					continue;
+				entry->findStamp = fs_indexFindStamp;
+
+				if (addGameDir)
+					fileList[fileCount++] = Mem_PoolStrDup (Q_VarArgs ("%s/%s", search->gamePath, name), com_fileSysPool, 0);
+				else
+					fileList[fileCount++] = Mem_PoolStrDup (name, com_fileSysPool, 0);
 			}
 		}
 		else {
-			// Directory tree
-			Q_snprintfz (dir, sizeof (dir), "%s/%s", search->pathName, path);
+			// Directory tree, from the cached scan
+			for (i=0 ; i<search->numLooseFiles ; i++) {
+				name = FS_LooseName (search, search->looseFiles[i]);
 
-			if (extension) {
-				Q_snprintfz (ext, sizeof (ext), "*.%s", extension);
-				dirCount = Sys_FindFiles (dir, ext, dirFiles, FS_MAX_FINDFILES, 0, recurse, qTrue, qFalse);
-			}
-			else {
-				dirCount = Sys_FindFiles (dir, "*", dirFiles, FS_MAX_FINDFILES, 0, recurse, qTrue, qTrue);
+				// Match path
+				if (!recurse) {
+					Com_FilePath (name, dir, sizeof (dir));
+					if (Q_stricmp (path, dir))
+						continue;
+				}
+				else if (pathLen && (Q_strnicmp (name, path, pathLen) || name[pathLen] != '/'))
+					continue;
+
+				if (!FS_FindFileMatch (name, filter, extension))
+					continue;
+
+				// Found something, ignore duplicates
+				entry = FS_IndexFind (name);
+				if (fileCount >= maxFiles || !entry || entry->findStamp == fs_indexFindStamp)
+					continue;
+				entry->findStamp = fs_indexFindStamp;
+
+				if (addGameDir)
+					fileList[fileCount++] = Mem_PoolStrDup (Q_VarArgs ("%s/%s", search->gamePath, name), com_fileSysPool, 0);
+				else
+					fileList[fileCount++] = Mem_PoolStrDup (name, com_fileSysPool, 0);
 			}
 
-			for (i=0 ; i<dirCount ; i++) {
-				// Match filter
-				if (filter) {
-					if (!Q_WildcardMatch (filter, dirFiles[i]+strlen(search->pathName)+1, 1)) {
-						Mem_Free (dirFiles[i]);
+			// Directories are only listed when not looking for an extension
+			if (extension)
+				continue;
+
+			for (i=0 ; i<search->numLooseDirs ; i++) {
+				name = FS_LooseName (search, search->looseDirs[i]);
+
+				// Match path
+				if (!recurse) {
+					Com_FilePath (name, dir, sizeof (dir));
+					if (Q_stricmp (path, dir))
 						continue;
-					}
 				}
+				else if (pathLen && (Q_strnicmp (name, path, pathLen) || name[pathLen] != '/'))
+					continue;
+
+				if (!FS_FindFileMatch (name, filter, NULL))
+					continue;
 
 				// Found something
-				name = dirFiles[i] + strlen (search->pathName) + 1;
-
-				if (fileCount < maxFiles) {
-					// Ignore duplicates
-					for (j=0 ; j<fileCount ; j++) {
-						if (!Q_stricmp (fileList[j], name))
-							break;
-					}
-
-					if (j == fileCount) {
-						if (addGameDir)
-							fileList[fileCount++] = Mem_PoolStrDup (Q_VarArgs ("%s/%s", search->gamePath, name), com_fileSysPool, 0);
-						else
-							fileList[fileCount++] = Mem_PoolStrDup (name, com_fileSysPool, 0);
-					}
+				if (fileCount >= maxFiles)
+					continue;
+
+				// Ignore duplicates
+				for (j=0 ; j<fileCount ; j++) {
+					if (!Q_stricmp (fileList[j], name))
+						break;
 				}
 
-				Mem_Free (dirFiles[i]);
+				if (j == fileCount) {
+					if (addGameDir)
+						fileList[fileCount++] = Mem_PoolStrDup (Q_VarArgs ("%s/%s", search->gamePath, name), com_fileSysPool, 0);
+					else
+						fileList[fileCount++] = Mem_PoolStrDup (name, com_fileSysPool, 0);
+				}
 			}
 		}
 	}
 
+	Sys_UnlockMutex (fs_lock);
 	return fileCount;
 }
 
@@ -1664,7 +2793,7 @@ static void FS_Path_f (void)
 			Com_Printf (0, "----------\n");
 
 		if (s->package)
-			Com_Printf (0, "%s (%i files)\n", s->package->name, s->package->numFiles);
+			Com_Printf (0, "%s (%i files%s)\n", s->package->name, s->package->numFiles, s->package->mapBase ? ", mapped" : "");
 		else
 			Com_Printf (0, "%s\n", s->pathName);
 	}
@@ -1672,6 +2801,20 @@ static void FS_Path_f (void)
 	Com_Printf (0, "\nLinks:\n");
 	for (l=fs_fileLinks ; l ; l=l->next)
 		Com_Printf (0, "%s : %s\n", l->from, l->to);
+
+	Com_Printf (0, "\n%u indexed files%s\n", fs_numIndexEntries, fs_indexDirty ? " (rescan pending)" : "");
+}
+
+
+/*
+============
+FS_RescanFiles_f
+============
+*/
+static void FS_RescanFiles_f (void)
+{
+	FS_BuildIndex ();
+	Com_Printf (0, "%u files indexed\n", fs_numIndexEntries);
 }
 
 /*
@@ -1696,16 +2839,20 @@ void FS_Init (void)
 	initTime = Sys_UMilliseconds ();
 	Com_Printf (0, "\n------- Filesystem Initialization ------\n");
 
+	fs_lock = Sys_CreateMutex ();
+
 	// Register commands/cvars
 	Cmd_AddCommand ("link",			FS_Link_f,			"");
 	Cmd_AddCommand ("listHandles",	FS_ListHandles_f,	"Lists active files");
 	Cmd_AddCommand ("path",			FS_Path_f,			"");
+	Cmd_AddCommand ("rescanFiles",	FS_RescanFiles_f,	"Rescans the search path for added or removed files");
 
 	fs_basedir		= Cvar_Register ("basedir",			".",	CVAR_READONLY);
 	fs_cddir		= Cvar_Register ("cddir",			"",		CVAR_READONLY);
 	fs_game			= Cvar_Register ("game",			"",		CVAR_LATCH_SERVER|CVAR_SERVERINFO|CVAR_RESET_GAMEDIR);
 	fs_gamedircvar	= Cvar_Register ("gamedir",			"",		CVAR_SERVERINFO|CVAR_READONLY);
 	fs_defaultPaks	= Cvar_Register ("fs_defaultPaks",	"1",	CVAR_ARCHIVE);
+	fs_writeRingKB	= Cvar_Register ("fs_writeRingKB",	"1024",	CVAR_ARCHIVE);
 
 	// Load pak files
 	if (fs_cddir->string[0])
@@ -1733,6 +2880,8 @@ void FS_Init (void)
 
 			i--;
 		}
+
+		FS_BuildIndex ();
 	}
 
 	Com_Printf (0, "----------------------------------------\n");
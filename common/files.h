@@ -741,10 +741,20 @@ void		FS_Seek (fileHandle_t fileNum, long offset, fsSeekOrigin_t seekOrigin);
 int			FS_OpenFile (char *fileName, fileHandle_t *fileNum, fsOpenMode_t openMode);
 void		FS_CloseFile (fileHandle_t fileNum);
 
+void		FS_SetAsyncWrite (fileHandle_t fileNum);
+void		FS_FlushFile (fileHandle_t fileNum);
+
 int			FS_LoadFile (char *path, void **buffer, char *terminate);
 void		_FS_FreeFile (void *buffer, const char *fileName, const int fileLine);
 
 int			FS_FileExists (char *path);
+int			FS_FileTime (char *path);
+
+void		FS_InvalidateIndex (void);
+void		FS_AddLooseFile (char *fileName);
+
+void		FS_PrefetchFile (char *path);
+uint32		FS_FlushPrefetch (void);
 
 char		*FS_Gamedir (void);
 void		FS_SetGamedir (char *dir, qBool firstTime);
@@ -0,0 +1,286 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+//
+// jobs.c
+// Worker thread pool, see jobs.h
+//
+
+#include "common.h"
+
+#define MAX_JOBS			4096		// must be a power of two
+#define MAX_JOB_THREADS		16
+
+typedef struct job_s {
+	jobFunc_t		func;
+	void			*arg;
+	jobList_t		*list;
+} job_t;
+
+static job_t		job_queue[MAX_JOBS];
+static uint32		job_head;
+static uint32		job_tail;
+
+static void			*job_lock;
+static void			*job_wakeSem;		// posted once per queued job
+static void			*job_doneSem;		// posted once per finished job
+
+static volatile int	job_numPending;		// across every list
+
+static void			*job_threads[MAX_JOB_THREADS];
+static int			job_numThreads;
+static volatile int	job_shutdown;
+
+static cVar_t		*com_jobThreads;
+
+/*
+=============================================================================
+
+	QUEUE
+
+=============================================================================
+*/
+
+/*
+================
+Job_Pop
+================
+*/
+static qBool Job_Pop (job_t *job)
+{
+	Sys_LockMutex (job_lock);
+	if (job_head == job_tail) {
+		Sys_UnlockMutex (job_lock);
+		return qFalse;
+	}
+
+	*job = job_queue[job_tail];
+	job_tail = (job_tail+1) & (MAX_JOBS-1);
+	Sys_UnlockMutex (job_lock);
+	return qTrue;
+}
+
+
+/*
+================
+Job_Run
+================
+*/
+static inline void Job_Run (job_t *job)
+{
+	job->func (job->arg);
+	Sys_AtomicAdd (&job->list->numPending, -1);
+	Sys_AtomicAdd (&job_numPending, -1);
+}
+
+
+/*
+================
+Job_WorkerThread
+================
+*/
+static void Job_WorkerThread (void *arg)
+{
+	job_t	job;
+
+	for ( ; ; ) {
+		Sys_WaitSemaphore (job_wakeSem);
+		if (job_shutdown)
+			break;
+
+		if (Job_Pop (&job)) {
+			Job_Run (&job);
+			Sys_PostSemaphore (job_doneSem);
+		}
+	}
+}
+
+
+/*
+================
+Job_Add
+
+Without workers, or with a full queue, the job is run right away.
+================
+*/
+void Job_Add (jobList_t *list, jobFunc_t func, void *arg)
+{
+	job_t	job;
+	uint32	next;
+
+	job.func = func;
+	job.arg = arg;
+	job.list = list;
+	Sys_AtomicAdd (&list->numPending, 1);
+	Sys_AtomicAdd (&job_numPending, 1);
+
+	if (job_numThreads) {
+		Sys_LockMutex (job_lock);
+		next = (job_head+1) & (MAX_JOBS-1);
+		if (next != job_tail) {
+			job_queue[job_head] = job;
+			job_head = next;
+			Sys_UnlockMutex (job_lock);
+
+			Sys_PostSemaphore (job_wakeSem);
+			return;
+		}
+		Sys_UnlockMutex (job_lock);
+	}
+
+	Job_Run (&job);
+}
+
+
+/*
+================
+Job_Wait
+
+Runs queued jobs until every job in the list has finished. Only the main thread waits.
+================
+*/
+void Job_Wait (jobList_t *list)
+{
+	job_t	job;
+
+	while (list->numPending > 0) {
+		if (Job_Pop (&job)) {
+			Job_Run (&job);
+			continue;
+		}
+
+		// The rest are running on the workers
+		Sys_WaitSemaphore (job_doneSem);
+	}
+}
+
+
+/*
+================
+Job_WaitAll
+
+Waits for the workers to go idle, whichever list their jobs belong to.
+================
+*/
+void Job_WaitAll (void)
+{
+	job_t	job;
+
+	while (job_numPending > 0) {
+		if (Job_Pop (&job)) {
+			Job_Run (&job);
+			continue;
+		}
+
+		Sys_WaitSemaphore (job_doneSem);
+	}
+}
+
+
+/*
+================
+Job_Done
+================
+*/
+qBool Job_Done (jobList_t *list)
+{
+	return (list->numPending <= 0) ? qTrue : qFalse;
+}
+
+
+/*
+================
+Job_NumWorkers
+================
+*/
+int Job_NumWorkers (void)
+{
+	return job_numThreads;
+}
+
+/*
+=============================================================================
+
+	INIT / SHUTDOWN
+
+=============================================================================
+*/
+
+/*
+================
+Job_Init
+================
+*/
+void Job_Init (void)
+{
+	int		numThreads;
+
+	com_jobThreads = Cvar_Register ("com_jobThreads", "-1", CVAR_ARCHIVE);
+
+	job_lock = Sys_CreateMutex ();
+	job_wakeSem = Sys_CreateSemaphore (0);
+	job_doneSem = Sys_CreateSemaphore (0);
+	job_head = job_tail = 0;
+	job_shutdown = 0;
+
+	// -1 leaves one processor for the main thread
+	numThreads = com_jobThreads->intVal;
+	if (numThreads < 0)
+		numThreads = Sys_NumProcessors () - 1;
+	numThreads = clamp (numThreads, 0, MAX_JOB_THREADS);
+
+	for (job_numThreads=0 ; job_numThreads<numThreads ; job_numThreads++) {
+		job_threads[job_numThreads] = Sys_CreateThread (Job_WorkerThread, NULL);
+		if (!job_threads[job_numThreads])
+			break;
+	}
+
+	Com_Printf (0, "Job workers: %i\n", job_numThreads);
+}
+
+
+/*
+================
+Job_Shutdown
+================
+*/
+void Job_Shutdown (void)
+{
+	job_t	job;
+	int		i;
+
+	if (!job_lock)
+		return;
+
+	// Finish anything left over, then release the workers
+	while (Job_Pop (&job))
+		Job_Run (&job);
+
+	job_shutdown = 1;
+	for (i=0 ; i<job_numThreads ; i++)
+		Sys_PostSemaphore (job_wakeSem);
+	for (i=0 ; i<job_numThreads ; i++)
+		Sys_JoinThread (job_threads[i]);
+	job_numThreads = 0;
+
+	Sys_DestroySemaphore (job_wakeSem);
+	Sys_DestroySemaphore (job_doneSem);
+	Sys_DestroyMutex (job_lock);
+	job_wakeSem = job_doneSem = job_lock = NULL;
+}
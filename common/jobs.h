@@ -0,0 +1,38 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+//
+// jobs.h
+// Worker thread pool. Jobs are counted in lists so whoever queued them can wait on them
+//
+
+typedef void (*jobFunc_t) (void *arg);
+
+typedef struct jobList_s {
+	volatile int	numPending;
+} jobList_t;
+
+void		Job_Add (jobList_t *list, jobFunc_t func, void *arg);
+void		Job_Wait (jobList_t *list);
+void		Job_WaitAll (void);
+qBool		Job_Done (jobList_t *list);
+int			Job_NumWorkers (void);
+
+void		Job_Init (void);
+void		Job_Shutdown (void);
@@ -20,14 +20,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 //
 // memory.c
 // Memory handling with sentinel checking and pools with tags for grouped free'ing
-// FIXME TODO: other neat features like maximum size, hunk management?
+// Arena pools bump allocate and are only released whole, slab pools serve
+// small allocations out of fixed size classes
+// FIXME TODO: other neat features like maximum size?
 //
 
 #include "common.h"
+#include <stddef.h>
 
 #define MEM_HEAD_SENTINEL_TOP	0xFEBDFAED
 #define MEM_HEAD_SENTINEL_BOT	0xD0BAF0FF
 #define MEM_FOOT_SENTINEL		0xF00DF00D
+#define MEM_ARENA_SENTINEL		0xA2E7A5E1
+#define MEM_SLAB_SENTINEL		0x5EAB5EAB
+#define MEM_SLAB_FREE_SENTINEL	0xF2EEF2EE
 
 typedef struct memBlockFoot_s {
 	uint32				sentinel;					// For memory integrity checking
@@ -36,35 +42,101 @@ typedef struct memBlockFoot_s {
 typedef struct memBlock_s {
 	struct memBlock_s	*next;
 
-	uint32				topSentinel;				// For memory integrity checking
-
 	struct memPool_s	*pool;						// Owner pool
-	int					tagNum;						// For group free
 	size_t				size;						// Size of allocation including this header
 
 	const char			*allocFile;					// File the memory was allocated in
-	int					allocLine;					// Line the memory was allocated at
 
 	void				*memPointer;				// pointer to allocated memory
 	size_t				memSize;					// Size minus the header
 
 	memBlockFoot_t		*footer;					// Allocated in the space AFTER the block to check for overflow
 
-	uint32				botSentinel;				// For memory integrity checking
+	uint32				topSentinel;				// For memory integrity checking
+	int					tagNum;						// For group free
+	int					allocLine;					// Line the memory was allocated at
+
+	uint32				botSentinel;				// For memory integrity checking, must be last
 } memBlock_t;
 
+/*
+	Arena and slab memory carries this instead of a memBlock_t. The sentinel
+	sits right before the memory just like botSentinel does, which is how
+	_Mem_Free tells them apart.
+*/
+typedef struct memChunk_s {
+	void				*owner;						// Slab class, or the pool for arenas
+	int					tagNum;						// For group free, arenas keep the slot size here
+	uint32				sentinel;					// Must be last
+} memChunk_t;
+
+#define MEM_CHUNK_HEAD		((sizeof (memChunk_t) + 15) & ~15)
+#define MEM_CHUNK(ptr)		((memChunk_t *)((byte *)(ptr) - sizeof (memChunk_t)))
+
+typedef struct memArenaBlock_s {
+	struct memArenaBlock_s	*next;
+
+	size_t				size;						// Usable bytes after the header
+	size_t				used;
+} memArenaBlock_t;
+
+#define MEM_ARENA_BLOCKHEAD	((sizeof (memArenaBlock_t) + 15) & ~15)
+
+typedef struct memSlabPage_s {
+	struct memSlabPage_s	*next;
+
+	uint32				numSlots;
+} memSlabPage_t;
+
+#define MEM_SLAB_PAGEHEAD	((sizeof (memSlabPage_t) + 15) & ~15)
+#define MEM_SLAB_PAGESIZE	65536
+#define MEM_SLAB_MINSIZE	32
+#define MEM_SLAB_MAXCLASSES	10						// 32B to 16KB
+
+typedef struct memSlabClass_s {
+	struct memPool_s	*pool;
+
+	size_t				size;						// Largest allocation this class serves
+	size_t				slotSize;					// Plus the chunk header
+
+	memSlabPage_t		*pages;
+	void				*freeList;					// Each free slot holds the next one
+
+	uint32				numSlots;
+	uint32				numFree;
+} memSlabClass_t;
+
+typedef enum memPoolType_s {
+	MEMPOOL_HEAP,									// Every allocation is its own block
+	MEMPOOL_ARENA,									// Bump allocated, only released whole
+	MEMPOOL_SLAB									// Small allocations come out of size classes
+} memPoolType_t;
+
 #define MEM_MAX_POOLCOUNT	32
 #define MEM_MAX_POOLNAME	64
 
 typedef struct memPool_s {
 	char				name[MEM_MAX_POOLNAME];		// Name of pool
 	qBool				inUse;						// Slot in use?
+	memPoolType_t		type;
 
 	memBlock_t			*blocks;					// Allocated blocks
 
 	size_t				blockCount;					// Total allocated blocks
 	size_t				byteCount;					// Total allocated bytes
 
+	uint32				numAllocs;					// Mem_Alloc calls over the pool's life
+	uint32				numChunks;					// Arena/slab allocations handed out
+	size_t				chunkBytes;					// Their size including headers
+	size_t				reservedBytes;				// Held from the system for them
+
+	memArenaBlock_t		*arenaBlocks;
+	memArenaBlock_t		*arenaCurrent;				// Where the next bump comes from
+	size_t				arenaBlockSize;
+
+	memSlabClass_t		slabClasses[MEM_SLAB_MAXCLASSES];
+	uint32				numSlabClasses;
+
 	const char			*createFile;				// File this pool was created on
 	int					createLine;					// Line this pool was created on
 } memPool_t;
@@ -72,6 +144,13 @@ typedef struct memPool_s {
 static memPool_t	m_poolList[MEM_MAX_POOLCOUNT];
 static uint32		m_numPools;
 
+static void			*m_memLock;		// block lists are shared with the job workers
+
+static uint32		m_numAllocs;	// Mem_Alloc calls
+static uint32		m_numSysAllocs;	// of those, how many went to the system
+
+static cVar_t		*mem_fastPools;
+
 memPool_t			*m_genericPool;
 
 /*
@@ -139,6 +218,8 @@ memPool_t *_Mem_CreatePool (const char *name, const char *fileName, const int fi
 	}
 
 	// Store values
+	memset (pool, 0, sizeof (memPool_t));
+	pool->type = MEMPOOL_HEAP;
 	pool->blocks = NULL;
 	pool->blockCount = 0;
 	pool->byteCount = 0;
@@ -150,11 +231,64 @@ memPool_t *_Mem_CreatePool (const char *name, const char *fileName, const int fi
 }
 
 
+/*
+========================
+_Mem_CreateArena
+
+Allocations are bumped out of blockSize blocks. Mem_Free only takes back the
+most recent one, everything else goes when the pool is freed whole.
+========================
+*/
+memPool_t *_Mem_CreateArena (const char *name, size_t blockSize, const char *fileName, const int fileLine)
+{
+	memPool_t	*pool;
+
+	pool = _Mem_CreatePool (name, fileName, fileLine);
+	pool->type = MEMPOOL_ARENA;
+	pool->arenaBlockSize = (blockSize + 15) & ~15;
+	return pool;
+}
+
+
+/*
+========================
+_Mem_CreateSlabPool
+
+Allocations up to maxSlabSize come out of power of two size classes, anything
+larger is a normal block.
+========================
+*/
+memPool_t *_Mem_CreateSlabPool (const char *name, size_t maxSlabSize, const char *fileName, const int fileLine)
+{
+	memPool_t		*pool;
+	memSlabClass_t	*slab;
+	size_t			size;
+
+	pool = _Mem_CreatePool (name, fileName, fileLine);
+	if (pool->type == MEMPOOL_SLAB)
+		return pool;
+
+	pool->type = MEMPOOL_SLAB;
+	for (size=MEM_SLAB_MINSIZE ; pool->numSlabClasses<MEM_SLAB_MAXCLASSES ; size<<=1) {
+		slab = &pool->slabClasses[pool->numSlabClasses++];
+		slab->pool = pool;
+		slab->size = size;
+		slab->slotSize = MEM_CHUNK_HEAD + size;
+
+		if (size >= maxSlabSize)
+			break;
+	}
+
+	return pool;
+}
+
+
 /*
 ========================
 _Mem_DeletePool
 ========================
 */
+static void Mem_ReleaseChunks (memPool_t *pool, qBool keepBlocks);
 size_t _Mem_DeletePool (struct memPool_s *pool, const char *fileName, const int fileLine)
 {
 	size_t	size;
@@ -164,6 +298,11 @@ size_t _Mem_DeletePool (struct memPool_s *pool, const char *fileName, const int
 
 	// Release all allocated memory
 	size = _Mem_FreePool (pool, fileName, fileLine);
+	if (m_memLock)
+		Sys_LockMutex (m_memLock);
+	Mem_ReleaseChunks (pool, qFalse);
+	if (m_memLock)
+		Sys_UnlockMutex (m_memLock);
 
 	// Simple, yes?
 	pool->inUse = qFalse;
@@ -173,6 +312,268 @@ size_t _Mem_DeletePool (struct memPool_s *pool, const char *fileName, const int
 }
 
 
+/*
+==============================================================================
+
+	ARENA AND SLAB CHUNKS
+
+	All of these are called with m_memLock held.
+==============================================================================
+*/
+
+/*
+========================
+Mem_ArenaAlloc
+========================
+*/
+static void *Mem_ArenaAlloc (memPool_t *pool, size_t size, const char *fileName, const int fileLine)
+{
+	memArenaBlock_t	*block;
+	memChunk_t		*chunk;
+	size_t			slotSize, blockSize;
+	byte			*data;
+
+	slotSize = MEM_CHUNK_HEAD + ((size + 15) & ~15);
+
+	// Blocks kept from before the last reset are used up first
+	for (block=pool->arenaCurrent ; block ; block=block->next) {
+		if (block->used + slotSize <= block->size)
+			break;
+	}
+
+	if (!block) {
+		blockSize = max (pool->arenaBlockSize, slotSize);
+		block = calloc (1, MEM_ARENA_BLOCKHEAD + blockSize);
+		if (!block)
+			Com_Error (ERR_FATAL, "Mem_Alloc: failed on allocation of a %u byte arena block\n" "alloc: %s:#%i", (uint32)blockSize, fileName, fileLine);
+		m_numSysAllocs++;
+
+		block->size = blockSize;
+		if (pool->arenaCurrent) {
+			block->next = pool->arenaCurrent->next;
+			pool->arenaCurrent->next = block;
+		}
+		else {
+			block->next = pool->arenaBlocks;
+			pool->arenaBlocks = block;
+		}
+		pool->reservedBytes += MEM_ARENA_BLOCKHEAD + blockSize;
+	}
+	pool->arenaCurrent = block;
+
+	// Bump
+	data = (byte *)block + MEM_ARENA_BLOCKHEAD + block->used + MEM_CHUNK_HEAD;
+	block->used += slotSize;
+	memset (data, 0, size);
+
+	chunk = MEM_CHUNK (data);
+	chunk->owner = pool;
+	chunk->tagNum = (int)slotSize;
+	chunk->sentinel = MEM_ARENA_SENTINEL;
+
+	pool->numChunks++;
+	pool->chunkBytes += slotSize;
+	return data;
+}
+
+
+/*
+========================
+Mem_ArenaFree
+
+Only the last allocation can be given back, which covers scratch buffers
+that are freed in the reverse order they were taken.
+========================
+*/
+static size_t Mem_ArenaFree (memChunk_t *chunk, const void *ptr)
+{
+	memPool_t		*pool;
+	memArenaBlock_t	*block;
+	size_t			slotSize;
+
+	pool = (memPool_t *)chunk->owner;
+	block = pool->arenaCurrent;
+	slotSize = (size_t)chunk->tagNum;
+	if (!block || (byte *)ptr - MEM_CHUNK_HEAD + slotSize != (byte *)block + MEM_ARENA_BLOCKHEAD + block->used)
+		return 0;
+
+	block->used -= slotSize;
+	pool->numChunks--;
+	pool->chunkBytes -= slotSize;
+	return slotSize;
+}
+
+
+/*
+========================
+Mem_SlabNewPage
+========================
+*/
+static void Mem_SlabNewPage (memSlabClass_t *slab, const char *fileName, const int fileLine)
+{
+	memSlabPage_t	*page;
+	memChunk_t		*chunk;
+	uint32			numSlots, i;
+	size_t			pageSize;
+	byte			*data;
+
+	numSlots = (uint32)max (MEM_SLAB_PAGESIZE / slab->slotSize, 4);
+	pageSize = MEM_SLAB_PAGEHEAD + numSlots * slab->slotSize;
+	page = calloc (1, pageSize);
+	if (!page)
+		Com_Error (ERR_FATAL, "Mem_Alloc: failed on allocation of a %u byte slab page\n" "alloc: %s:#%i", (uint32)pageSize, fileName, fileLine);
+	m_numSysAllocs++;
+
+	page->numSlots = numSlots;
+	page->next = slab->pages;
+	slab->pages = page;
+	slab->numSlots += numSlots;
+	slab->numFree += numSlots;
+	slab->pool->reservedBytes += pageSize;
+
+	// Thread the slots on backwards so they're handed out in address order
+	data = (byte *)page + MEM_SLAB_PAGEHEAD + (numSlots-1) * slab->slotSize + MEM_CHUNK_HEAD;
+	for (i=0 ; i<numSlots ; i++, data-=slab->slotSize) {
+		chunk = MEM_CHUNK (data);
+		chunk->owner = slab;
+		chunk->sentinel = MEM_SLAB_FREE_SENTINEL;
+
+		*(void **)data = slab->freeList;
+		slab->freeList = data;
+	}
+}
+
+
+/*
+========================
+Mem_SlabAlloc
+========================
+*/
+static void *Mem_SlabAlloc (memPool_t *pool, size_t size, const int tagNum, const char *fileName, const int fileLine)
+{
+	memSlabClass_t	*slab;
+	memChunk_t		*chunk;
+	byte			*data;
+
+	// The caller made sure the last class is big enough
+	for (slab=pool->slabClasses ; slab->size<size ; slab++) ;
+
+	if (!slab->freeList)
+		Mem_SlabNewPage (slab, fileName, fileLine);
+
+	data = slab->freeList;
+	slab->freeList = *(void **)data;
+	slab->numFree--;
+	memset (data, 0, size);
+
+	chunk = MEM_CHUNK (data);
+	chunk->tagNum = tagNum;
+	chunk->sentinel = MEM_SLAB_SENTINEL;
+
+	pool->numChunks++;
+	pool->chunkBytes += slab->slotSize;
+	return data;
+}
+
+
+/*
+========================
+Mem_SlabFree
+========================
+*/
+static size_t Mem_SlabFree (memChunk_t *chunk, void *ptr)
+{
+	memSlabClass_t	*slab;
+
+	slab = (memSlabClass_t *)chunk->owner;
+	chunk->sentinel = MEM_SLAB_FREE_SENTINEL;
+
+	*(void **)ptr = slab->freeList;
+	slab->freeList = ptr;
+	slab->numFree++;
+
+	slab->pool->numChunks--;
+	slab->pool->chunkBytes -= slab->slotSize;
+	return slab->slotSize;
+}
+
+
+/*
+========================
+Mem_SlabFreeTag
+========================
+*/
+static size_t Mem_SlabFreeTag (memPool_t *pool, const int tagNum)
+{
+	memSlabClass_t	*slab;
+	memSlabPage_t	*page;
+	memChunk_t		*chunk;
+	size_t			size;
+	uint32			i, j;
+	byte			*data;
+
+	size = 0;
+	for (i=0, slab=pool->slabClasses ; i<pool->numSlabClasses ; slab++, i++) {
+		for (page=slab->pages ; page ; page=page->next) {
+			data = (byte *)page + MEM_SLAB_PAGEHEAD + MEM_CHUNK_HEAD;
+			for (j=0 ; j<page->numSlots ; j++, data+=slab->slotSize) {
+				chunk = MEM_CHUNK (data);
+				if (chunk->sentinel == MEM_SLAB_SENTINEL && chunk->tagNum == tagNum)
+					size += Mem_SlabFree (chunk, data);
+			}
+		}
+	}
+
+	return size;
+}
+
+
+/*
+========================
+Mem_ReleaseChunks
+
+Takes back every arena and slab allocation in the pool at once. Arenas keep
+their regular sized blocks for reuse unless keepBlocks is false.
+========================
+*/
+static void Mem_ReleaseChunks (memPool_t *pool, qBool keepBlocks)
+{
+	memArenaBlock_t	*block, **prevBlock;
+	memSlabClass_t	*slab;
+	memSlabPage_t	*page, *nextPage;
+	uint32			i;
+
+	prevBlock = &pool->arenaBlocks;
+	while ((block = *prevBlock) != NULL) {
+		if (!keepBlocks || block->size != pool->arenaBlockSize) {
+			*prevBlock = block->next;
+			pool->reservedBytes -= MEM_ARENA_BLOCKHEAD + block->size;
+			free (block);
+			continue;
+		}
+
+		block->used = 0;
+		prevBlock = &block->next;
+	}
+	pool->arenaCurrent = pool->arenaBlocks;
+
+	for (i=0, slab=pool->slabClasses ; i<pool->numSlabClasses ; slab++, i++) {
+		for (page=slab->pages ; page ; page=nextPage) {
+			nextPage = page->next;
+			pool->reservedBytes -= MEM_SLAB_PAGEHEAD + page->numSlots * slab->slotSize;
+			free (page);
+		}
+
+		slab->pages = NULL;
+		slab->freeList = NULL;
+		slab->numSlots = 0;
+		slab->numFree = 0;
+	}
+
+	pool->numChunks = 0;
+	pool->chunkBytes = 0;
+}
+
 /*
 ==============================================================================
 
@@ -197,6 +598,32 @@ size_t _Mem_Free (const void *ptr, const char *fileName, const int fileLine)
 	if (!ptr)
 		return 0;
 
+	// Arena and slab memory
+	switch (((const uint32 *)ptr)[-1]) {
+	case MEM_ARENA_SENTINEL:
+		if (m_memLock)
+			Sys_LockMutex (m_memLock);
+		size = Mem_ArenaFree (MEM_CHUNK (ptr), ptr);
+		if (m_memLock)
+			Sys_UnlockMutex (m_memLock);
+		return size;
+
+	case MEM_SLAB_SENTINEL:
+		if (m_memLock)
+			Sys_LockMutex (m_memLock);
+		size = Mem_SlabFree (MEM_CHUNK (ptr), (void *)ptr);
+		if (m_memLock)
+			Sys_UnlockMutex (m_memLock);
+		return size;
+
+	case MEM_SLAB_FREE_SENTINEL:
+		Com_Error (ERR_FATAL,
+			"Mem_Free: slab memory freed twice\n"
+			"free: %s:#%i",
+			fileName, fileLine);
+		break;
+	}
+
 	// Check sentinels
 	mem = (memBlock_t *)((byte *)ptr - sizeof (memBlock_t));
 	if (mem->topSentinel != MEM_HEAD_SENTINEL_TOP) {
@@ -229,6 +656,8 @@ size_t _Mem_Free (const void *ptr, const char *fileName, const int fileLine)
 	}
 
 	// Decrement counters
+	if (m_memLock)
+		Sys_LockMutex (m_memLock);
 	mem->pool->blockCount--;
 	mem->pool->byteCount -= mem->size;
 	size = mem->size;
@@ -246,6 +675,8 @@ size_t _Mem_Free (const void *ptr, const char *fileName, const int fileLine)
 		}
 		prev = &search->next;
 	}
+	if (m_memLock)
+		Sys_UnlockMutex (m_memLock);
 
 	// Free it
 	free (mem);
@@ -267,13 +698,21 @@ size_t _Mem_FreeTag (struct memPool_s *pool, const int tagNum, const char *fileN
 
 	if (!pool)
 		return 0;
+	if (pool->type == MEMPOOL_ARENA && pool->numChunks)
+		Com_Error (ERR_FATAL, "Mem_FreeTag: arena pool '%s' can only be freed whole\n" "free: %s:#%i", pool->name, fileName, fileLine);
 
 	size = 0;
+	if (m_memLock)
+		Sys_LockMutex (m_memLock);
 	for (mem=pool->blocks; mem ; mem=next) {
 		next = mem->next;
 		if (mem->tagNum == tagNum)
 			size += _Mem_Free (mem->memPointer, fileName, fileLine);
 	}
+	if (pool->type == MEMPOOL_SLAB)
+		size += Mem_SlabFreeTag (pool, tagNum);
+	if (m_memLock)
+		Sys_UnlockMutex (m_memLock);
 
 	return size;
 }
@@ -283,7 +722,7 @@ size_t _Mem_FreeTag (struct memPool_s *pool, const int tagNum, const char *fileN
 ========================
 _Mem_FreePool
 
-Free all items within a pool
+Free all items within a pool, this is how arenas get reset
 ========================
 */
 size_t _Mem_FreePool (struct memPool_s *pool, const char *fileName, const int fileLine)
@@ -295,10 +734,18 @@ size_t _Mem_FreePool (struct memPool_s *pool, const char *fileName, const int fi
 		return 0;
 
 	size = 0;
+	if (m_memLock)
+		Sys_LockMutex (m_memLock);
 	for (mem=pool->blocks ; mem ; mem=next) {
 		next = mem->next;
 		size += _Mem_Free (mem->memPointer, fileName, fileLine);
 	}
+	if (pool->type != MEMPOOL_HEAP) {
+		size += pool->chunkBytes;
+		Mem_ReleaseChunks (pool, qTrue);
+	}
+	if (m_memLock)
+		Sys_UnlockMutex (m_memLock);
 
 	assert (pool->blockCount == 0);
 	assert (pool->byteCount == 0);
@@ -329,6 +776,25 @@ void *_Mem_Alloc (size_t size, struct memPool_s *pool, const int tagNum, const c
 	if (size > 0x40000000)
 		Com_Error (ERR_FATAL, "Mem_Alloc: Attempted allocation of '%i' bytes!\n" "alloc: %s:#%i\n", size, fileName, fileLine);
 
+	// Arena and slab pools, unless mem_fastPools is off to compare against
+	if (pool->type != MEMPOOL_HEAP && (!mem_fastPools || mem_fastPools->intVal)) {
+		void	*ptr = NULL;
+
+		if (m_memLock)
+			Sys_LockMutex (m_memLock);
+		m_numAllocs++;
+		pool->numAllocs++;
+		if (pool->type == MEMPOOL_ARENA)
+			ptr = Mem_ArenaAlloc (pool, size, fileName, fileLine);
+		else if (size <= pool->slabClasses[pool->numSlabClasses-1].size)
+			ptr = Mem_SlabAlloc (pool, size, tagNum, fileName, fileLine);
+		if (m_memLock)
+			Sys_UnlockMutex (m_memLock);
+
+		if (ptr)
+			return ptr;
+	}
+
 	// Add header and round to cacheline
 	size = (size + sizeof (memBlock_t) + sizeof (memBlockFoot_t) + 31) & ~31;
 	mem = calloc (1, size);
@@ -337,6 +803,13 @@ void *_Mem_Alloc (size_t size, struct memPool_s *pool, const int tagNum, const c
 		Com_Error (ERR_FATAL, "Mem_Alloc: failed on allocation of %i bytes\n" "alloc: %s:#%i", size, fileName, fileLine);
 
 	// For integrity checking and stats
+	if (m_memLock)
+		Sys_LockMutex (m_memLock);
+	m_numSysAllocs++;
+	if (pool->type == MEMPOOL_HEAP || (mem_fastPools && !mem_fastPools->intVal)) {
+		m_numAllocs++;
+		pool->numAllocs++;
+	}
 	pool->blockCount++;
 	pool->byteCount += size;
 
@@ -358,6 +831,8 @@ void *_Mem_Alloc (size_t size, struct memPool_s *pool, const int tagNum, const c
 	// Link it in to the appropriate pool
 	mem->next = pool->blocks;
 	pool->blocks = mem;
+	if (m_memLock)
+		Sys_UnlockMutex (m_memLock);
 
 	return mem->memPointer;
 }
@@ -398,7 +873,7 @@ size_t _Mem_PoolSize (struct memPool_s *pool)
 	if (!pool)
 		return 0;
 
-	return pool->byteCount;
+	return pool->byteCount + pool->reservedBytes;
 }
 
 
@@ -409,8 +884,13 @@ _Mem_TagSize
 */
 size_t _Mem_TagSize (struct memPool_s *pool, const int tagNum)
 {
-	memBlock_t	*mem;
-	size_t		size;
+	memBlock_t		*mem;
+	memSlabClass_t	*slab;
+	memSlabPage_t	*page;
+	memChunk_t		*chunk;
+	size_t			size;
+	uint32			i, j;
+	byte			*data;
 
 	if (!pool)
 		return 0;
@@ -421,6 +901,17 @@ size_t _Mem_TagSize (struct memPool_s *pool, const int tagNum)
 			size += mem->size;
 	}
 
+	for (i=0, slab=pool->slabClasses ; i<pool->numSlabClasses ; slab++, i++) {
+		for (page=slab->pages ; page ; page=page->next) {
+			data = (byte *)page + MEM_SLAB_PAGEHEAD + MEM_CHUNK_HEAD;
+			for (j=0 ; j<page->numSlots ; j++, data+=slab->slotSize) {
+				chunk = MEM_CHUNK (data);
+				if (chunk->sentinel == MEM_SLAB_SENTINEL && chunk->tagNum == tagNum)
+					size += slab->slotSize;
+			}
+		}
+	}
+
 	return size;
 }
 
@@ -432,8 +923,13 @@ _Mem_ChangeTag
 */
 size_t _Mem_ChangeTag (struct memPool_s *pool, const int tagFrom, const int tagTo)
 {
-	memBlock_t	*mem;
-	uint32		numChanged;
+	memBlock_t		*mem;
+	memSlabClass_t	*slab;
+	memSlabPage_t	*page;
+	memChunk_t		*chunk;
+	uint32			numChanged;
+	uint32			i, j;
+	byte			*data;
 
 	if (!pool)
 		return 0;
@@ -446,6 +942,19 @@ size_t _Mem_ChangeTag (struct memPool_s *pool, const int tagFrom, const int tagT
 		}
 	}
 
+	for (i=0, slab=pool->slabClasses ; i<pool->numSlabClasses ; slab++, i++) {
+		for (page=slab->pages ; page ; page=page->next) {
+			data = (byte *)page + MEM_SLAB_PAGEHEAD + MEM_CHUNK_HEAD;
+			for (j=0 ; j<page->numSlots ; j++, data+=slab->slotSize) {
+				chunk = MEM_CHUNK (data);
+				if (chunk->sentinel == MEM_SLAB_SENTINEL && chunk->tagNum == tagFrom) {
+					chunk->tagNum = tagTo;
+					numChanged++;
+				}
+			}
+		}
+	}
+
 	return numChanged;
 }
 
@@ -503,6 +1012,36 @@ void _Mem_CheckPoolIntegrity (struct memPool_s *pool, const char *fileName, cons
 		Com_Error (ERR_FATAL, "Mem_CheckPoolIntegrity: bad block count\n" "check: %s:#%i", fileName, fileLine);
 	if (pool->byteCount != size)
 		Com_Error (ERR_FATAL, "Mem_CheckPoolIntegrity: bad pool size\n" "check: %s:#%i", fileName, fileLine);
+
+	// Every slab slot header has to be intact, an overflow runs into the next
+	if (pool->type == MEMPOOL_SLAB) {
+		memSlabClass_t	*slab;
+		memSlabPage_t	*page;
+		memChunk_t		*chunk;
+		uint32			i, j;
+		byte			*data;
+
+		for (i=0, slab=pool->slabClasses, blocks=0 ; i<pool->numSlabClasses ; slab++, i++) {
+			for (page=slab->pages ; page ; page=page->next) {
+				data = (byte *)page + MEM_SLAB_PAGEHEAD + MEM_CHUNK_HEAD;
+				for (j=0 ; j<page->numSlots ; j++, data+=slab->slotSize) {
+					chunk = MEM_CHUNK (data);
+					if (chunk->owner != slab || (chunk->sentinel != MEM_SLAB_SENTINEL && chunk->sentinel != MEM_SLAB_FREE_SENTINEL)) {
+						Com_Error (ERR_FATAL,
+							"Mem_CheckPoolIntegrity: bad slab chunk sentinel [buffer overflow]\n"
+							"pool: %s\n"
+							"check: %s:#%i",
+							pool->name, fileName, fileLine);
+					}
+					if (chunk->sentinel == MEM_SLAB_SENTINEL)
+						blocks++;
+				}
+			}
+		}
+
+		if (pool->numChunks != blocks)
+			Com_Error (ERR_FATAL, "Mem_CheckPoolIntegrity: bad slab chunk count\n" "check: %s:#%i", fileName, fileLine);
+	}
 }
 
 
@@ -583,6 +1122,22 @@ void _Mem_TouchGlobal (const char *fileName, const int fileLine)
 	Com_DevPrintf (0, "Mem_TouchGlobal: %u pools touched in %ims\n", num, Sys_UMilliseconds()-startTime);
 }
 
+
+/*
+========================
+Mem_AllocCounts
+
+For comparing before and after something, like a map load.
+========================
+*/
+void Mem_AllocCounts (uint32 *numAllocs, uint32 *numSysAllocs)
+{
+	if (numAllocs)
+		*numAllocs = m_numAllocs;
+	if (numSysAllocs)
+		*numSysAllocs = m_numSysAllocs;
+}
+
 /*
 ==============================================================================
 
@@ -650,12 +1205,31 @@ static void Mem_Stats_f (void)
 
 		Com_Printf (0, "----------------------------------------\n");
 		Com_Printf (0, "Total: %i blocks, %i bytes (%6.3fMB)\n", i, totalBytes, totalBytes/1048576.0f);
+
+		if (best->type == MEMPOOL_ARENA) {
+			memArenaBlock_t	*block;
+			size_t			used;
+
+			for (i=0, used=0, block=best->arenaBlocks ; block ; block=block->next, i++)
+				used += block->used;
+			Com_Printf (0, "Arena: %i blocks, %i/%i bytes used, %i allocations\n", i, used, best->reservedBytes, best->numChunks);
+		}
+		else if (best->type == MEMPOOL_SLAB) {
+			memSlabClass_t	*slab;
+
+			Com_Printf (0, "slab size   used   free\n");
+			for (i=0, slab=best->slabClasses ; i<best->numSlabClasses ; slab++, i++) {
+				if (i & 1)
+					Com_Printf (0, S_COLOR_GREY);
+				Com_Printf (0, "%8iB %6i %6i\n", slab->size, slab->numSlots-slab->numFree, slab->numFree);
+			}
+		}
 		return;
 	}
 
 	Com_Printf (0, "Memory stats:\n");
-	Com_Printf (0, "    blocks size                  name\n");
-	Com_Printf (0, "--- ------ ---------- ---------- --------\n");
+	Com_Printf (0, "    blocks size                  allocs   name\n");
+	Com_Printf (0, "--- ------ ---------- ---------- -------- --------\n");
 
 	totalBlocks = 0;
 	totalBytes = 0;
@@ -668,14 +1242,17 @@ static void Mem_Stats_f (void)
 		if (poolNum & 1)
 			Com_Printf (0, S_COLOR_GREY);
 
-		Com_Printf (0, "#%2i %6i %9iB (%6.3fMB) %s\n", poolNum, pool->blockCount, pool->byteCount, pool->byteCount/1048576.0f, pool->name);
+		Com_Printf (0, "#%2i %6i %9iB (%6.3fMB) %8u %s%s\n",
+			poolNum, pool->blockCount+pool->numChunks, pool->byteCount+pool->reservedBytes, (pool->byteCount+pool->reservedBytes)/1048576.0f,
+			pool->numAllocs, (pool->type == MEMPOOL_ARENA) ? "[arena] " : (pool->type == MEMPOOL_SLAB) ? "[slab] " : "", pool->name);
 
-		totalBlocks += pool->blockCount;
-		totalBytes += pool->byteCount;
+		totalBlocks += pool->blockCount + pool->numChunks;
+		totalBytes += pool->byteCount + pool->reservedBytes;
 	}
 
 	Com_Printf (0, "----------------------------------------\n");
 	Com_Printf (0, "Total: %i pools, %i blocks, %i bytes (%6.3fMB)\n", i, totalBlocks, totalBytes, totalBytes/1048576.0f);
+	Com_Printf (0, "%u allocations, %u of them from the system\n", m_numAllocs, m_numSysAllocs);
 }
 
 /*
@@ -693,6 +1270,8 @@ Mem_Register
 */
 void Mem_Register (void)
 {
+	mem_fastPools = Cvar_Register ("mem_fastPools", "1", 0);
+
 	Cmd_AddCommand ("memcheck",		Mem_Check_f,		"Checks global memory integrity");
 	Cmd_AddCommand ("memstats",		Mem_Stats_f,		"Prints out current internal memory statistics");
 }
@@ -705,4 +1284,9 @@ Mem_Init
 */
 void Mem_Init (void)
 {
+	// _Mem_Free looks right before the memory to tell blocks from chunks
+	if (sizeof (memBlock_t) != offsetof (memBlock_t, botSentinel) + sizeof (uint32))
+		Sys_Error ("Mem_Init: memBlock_t has padding after botSentinel");
+
+	m_memLock = Sys_CreateMutex ();
 }
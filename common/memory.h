@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 // constants
 #define Mem_CreatePool(name)							_Mem_CreatePool((name),__FILE__,__LINE__)
+#define Mem_CreateArena(name,blockSize)					_Mem_CreateArena((name),(blockSize),__FILE__,__LINE__)
+#define Mem_CreateSlabPool(name,maxSlabSize)			_Mem_CreateSlabPool((name),(maxSlabSize),__FILE__,__LINE__)
 #define Mem_DeletePool(pool)							_Mem_DeletePool((pool),__FILE__,__LINE__)
 
 #define Mem_Free(ptr)									_Mem_Free((ptr),__FILE__,__LINE__)
@@ -45,6 +47,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 // functions
 struct memPool_s *_Mem_CreatePool (const char *name, const char *fileName, const int fileLine);
+struct memPool_s *_Mem_CreateArena (const char *name, size_t blockSize, const char *fileName, const int fileLine);
+struct memPool_s *_Mem_CreateSlabPool (const char *name, size_t maxSlabSize, const char *fileName, const int fileLine);
 size_t		_Mem_DeletePool (struct memPool_s *pool, const char *fileName, const int fileLine);
 
 size_t		_Mem_Free (const void *ptr, const char *fileName, const int fileLine);
@@ -63,5 +67,7 @@ void		_Mem_CheckGlobalIntegrity (const char *fileName, const int fileLine);
 void		_Mem_TouchPool (struct memPool_s *pool, const char *fileName, const int fileLine);
 void		_Mem_TouchGlobal (const char *fileName, const int fileLine);
 
+void		Mem_AllocCounts (uint32 *numAllocs, uint32 *numSysAllocs);
+
 void		Mem_Register (void);
 void		Mem_Init (void);
@@ -62,6 +62,15 @@ reliable acknowledgement numbers provides protection against malicious
 address spoofing.
 
 
+When both ends agree to it at connect, a reliable message too large for one
+packet can be queued with Netchan_QueueBulk. It goes out as a burst of
+fragments with bit 30 of the sequence set, each carrying the total length
+and its index. The last fragment also carries the unreliable part. The
+receiver only flips its reliable bit once every fragment has arrived, so a
+lost fragment is caught and the whole burst resent exactly like a dropped
+reliable. Fragments from a resend fill in the gaps of the first burst.
+
+
 The qport field is a workaround for bad address translating routers that
 sometimes remap the client's source port on a packet during gameplay.
 
@@ -200,13 +209,176 @@ static inline qBool Netchan_NeedReliable (netChan_t *chan)
 		return qTrue;
 
 	// If the reliable transmit buffer is empty, copy the current message out
-	if (!chan->reliableLength && chan->message.curSize)
+	if (!chan->reliableLength && (chan->message.curSize || chan->bulkBuff))
 		return qTrue;
 
 	return qFalse;
 }
 
 
+/*
+===============
+Netchan_BeginPacket
+================
+*/
+static void Netchan_BeginPacket (netChan_t *chan, netMsg_t *send, byte *sendBuf, qBool sendReliable, qBool fragment)
+{
+	uint32		w1, w2;
+
+	if (chan->protocol == ENHANCED_PROTOCOL_VERSION)
+		MSG_Init (send, sendBuf, MAX_CL_MSGLEN);
+	else
+		MSG_Init (send, sendBuf, MAX_SV_MSGLEN);
+
+	w1 = (chan->outgoingSequence & ~(1<<31)) | (sendReliable<<31);
+	w2 = (chan->incomingSequence & ~(1<<31)) | (chan->incomingReliableSequence<<31);
+	if (chan->fragments)
+		w1 = (w1 & ~(1<<30)) | (fragment<<30);
+
+	chan->outgoingSequence++;
+	chan->lastSent = Sys_Milliseconds ();
+
+	MSG_WriteLong (send, w1);
+	MSG_WriteLong (send, w2);
+
+	// Send the qport if we are a client
+	if (chan->sock == NS_CLIENT) {
+		if (chan->protocol != ENHANCED_PROTOCOL_VERSION)
+			MSG_WriteShort (send, chan->qPort);
+		else if (chan->qPort)
+			MSG_WriteByte (send, chan->qPort & 0xff);
+	}
+}
+
+
+/*
+===============
+Netchan_QueueBulk
+
+Queues a reliable that can be larger than a packet. Whatever is already in
+the message goes ahead of it, and whatever is written afterwards follows it.
+Returns qFalse if the channel can't fragment or it's too big, the caller
+should fall back to smaller reliables.
+================
+*/
+qBool Netchan_QueueBulk (netChan_t *chan, byte *data, size_t length)
+{
+	size_t	total;
+	byte	*buff;
+
+	if (!chan->fragments)
+		return qFalse;
+
+	total = chan->bulkLength + chan->message.curSize + length;
+	if (total > NETCHAN_MAX_BULK)
+		return qFalse;
+
+	buff = Mem_PoolAlloc (total, com_netSysPool, 0);
+	if (chan->bulkBuff) {
+		memcpy (buff, chan->bulkBuff, chan->bulkLength);
+		Mem_Free (chan->bulkBuff);
+	}
+	memcpy (buff + chan->bulkLength, chan->message.data, chan->message.curSize);
+	memcpy (buff + chan->bulkLength + chan->message.curSize, data, length);
+
+	chan->bulkBuff = buff;
+	chan->bulkLength = total;
+	MSG_Clear (&chan->message);
+	return qTrue;
+}
+
+
+/*
+===============
+Netchan_ReadFragment
+
+Returns qTrue once the last missing piece of a reliable has arrived
+================
+*/
+static qBool Netchan_ReadFragment (netChan_t *chan, netMsg_t *msg)
+{
+	size_t	total, ofs, length;
+	int		index, numFragments;
+
+	total = (size_t)MSG_ReadLong (msg);
+	index = MSG_ReadShort (msg);
+
+	numFragments = (int)((total + NETCHAN_FRAGMENT_SIZE - 1) / NETCHAN_FRAGMENT_SIZE);
+	if (!total || total > NETCHAN_MAX_BULK || index < 0 || index >= numFragments) {
+		Com_Printf (PRNT_WARNING, "%s: bad fragment %i of %u bytes\n", NET_AdrToString (&chan->remoteAddress), index, (uint32)total);
+		msg->readCount = msg->curSize;
+		return qFalse;
+	}
+
+	ofs = (size_t)index * NETCHAN_FRAGMENT_SIZE;
+	length = min (total - ofs, NETCHAN_FRAGMENT_SIZE);
+	if (msg->readCount + length > msg->curSize) {
+		msg->readCount = msg->curSize;
+		return qFalse;
+	}
+
+	// A different size means the sender moved on to another message
+	if (!chan->fragmentBuff || chan->fragmentReady || chan->fragmentLength != total) {
+		Netchan_FreeFragments (chan);
+		chan->fragmentBuff = Mem_PoolAlloc (total, com_netSysPool, 0);
+		chan->fragmentLength = total;
+		chan->fragmentsLeft = numFragments;
+	}
+
+	if (!chan->fragmentSeen[index]) {
+		MSG_ReadData (msg, chan->fragmentBuff + ofs, length);
+		chan->fragmentSeen[index] = qTrue;
+		chan->fragmentsLeft--;
+	}
+	else
+		msg->readCount += length;
+
+	return (chan->fragmentsLeft == 0);
+}
+
+
+/*
+===============
+Netchan_FreeFragments
+
+Called once a reassembled reliable has been parsed
+================
+*/
+void Netchan_FreeFragments (netChan_t *chan)
+{
+	if (chan->fragmentBuff)
+		Mem_Free (chan->fragmentBuff);
+
+	chan->fragmentBuff = NULL;
+	chan->fragmentLength = 0;
+	chan->fragmentsLeft = 0;
+	chan->fragmentReady = qFalse;
+	memset (chan->fragmentSeen, 0, sizeof (chan->fragmentSeen));
+}
+
+
+/*
+===============
+Netchan_Release
+
+Frees anything the channel allocated, before it's cleared or reused
+================
+*/
+void Netchan_Release (netChan_t *chan)
+{
+	Netchan_FreeFragments (chan);
+
+	if (chan->bulkBuff)
+		Mem_Free (chan->bulkBuff);
+	if (chan->reliableBulk)
+		Mem_Free (chan->reliableBulk);
+
+	chan->bulkBuff = NULL;
+	chan->bulkLength = 0;
+	chan->reliableBulk = NULL;
+}
+
+
 /*
 ===============
 Netchan_Transmit
@@ -222,7 +394,9 @@ int Netchan_Transmit (netChan_t *chan, size_t length, byte *data)
 	netMsg_t	send;
 	byte		sendBuf[MAX_CL_MSGLEN];
 	qBool		sendReliable;
-	uint32		w1, w2;
+	byte		*reliable;
+	size_t		fragOfs, fragLen;
+	int			fragNum, numFragments, lastFragment;
 
 	// Check for message overflow
 	if (chan->message.overFlowed || chan->message.curSize >= MAX_CL_MSGLEN) {
@@ -232,41 +406,82 @@ int Netchan_Transmit (netChan_t *chan, size_t length, byte *data)
 	}
 
 	sendReliable = Netchan_NeedReliable (chan);
-
-	if (!chan->reliableLength && chan->message.curSize) {
-		memcpy (chan->reliableBuff, chan->messageBuff, chan->message.curSize);
-		chan->reliableLength = chan->message.curSize;
-		chan->message.curSize = 0;
-		chan->reliableSequence ^= 1;
+	chan->lastSentSize = 0;
+
+	if (!chan->reliableLength) {
+		if (chan->bulkBuff) {
+			chan->reliableBulk = chan->bulkBuff;
+			chan->reliableLength = chan->bulkLength;
+			chan->bulkBuff = NULL;
+			chan->bulkLength = 0;
+			chan->reliableSequence ^= 1;
+			chan->fragmentNext = 0;
+		}
+		else if (chan->message.curSize) {
+			memcpy (chan->reliableBuff, chan->messageBuff, chan->message.curSize);
+			chan->reliableLength = chan->message.curSize;
+			chan->message.curSize = 0;
+			chan->reliableSequence ^= 1;
+		}
+	}
+	reliable = chan->reliableBulk ? chan->reliableBulk : chan->reliableBuff;
+
+	// A reliable too large for one packet goes out in passes over its pieces,
+	// at most NETCHAN_FRAGMENT_BURST of them per call so a resend can't flood
+	// the link. A pass that's underway carries on, a finished one is only
+	// started over once the far end shows it's missing something.
+	fragOfs = fragLen = 0;
+	fragNum = lastFragment = 0;
+	if (chan->reliableBulk) {
+		numFragments = (int)((chan->reliableLength + NETCHAN_FRAGMENT_SIZE - 1) / NETCHAN_FRAGMENT_SIZE);
+		if (chan->fragmentNext > 0 && chan->fragmentNext < numFragments)
+			sendReliable = qTrue;
+		else if (sendReliable)
+			chan->fragmentNext = 0;
+
+		if (sendReliable) {
+			fragNum = chan->fragmentNext;
+			lastFragment = min (fragNum + NETCHAN_FRAGMENT_BURST, numFragments) - 1;
+			chan->fragmentNext = lastFragment + 1;
+
+			// All but the last piece of the burst go out on their own
+			for ( ; ; fragNum++) {
+				fragOfs = (size_t)fragNum * NETCHAN_FRAGMENT_SIZE;
+				fragLen = min (chan->reliableLength - fragOfs, NETCHAN_FRAGMENT_SIZE);
+				if (fragNum == lastFragment)
+					break;
+
+				Netchan_BeginPacket (chan, &send, sendBuf, qTrue, qTrue);
+				MSG_WriteLong (&send, (int)chan->reliableLength);
+				MSG_WriteShort (&send, fragNum);
+				MSG_WriteRaw (&send, reliable + fragOfs, fragLen);
+
+				if (NET_SendPacket (chan->sock, send.curSize, send.data, &chan->remoteAddress) == -1)
+					return -1;
+				chan->lastSentSize += send.curSize;
+
+				if (showpackets->intVal)
+					Com_Printf (0, "send %4i : s=%i fragment=%i/%i\n",
+						send.curSize,
+						chan->outgoingSequence - 1,
+						fragNum,
+						numFragments);
+			}
+		}
 	}
 
 	// Write the packet header
-	if (chan->protocol == ENHANCED_PROTOCOL_VERSION)
-		MSG_Init (&send, sendBuf, MAX_CL_MSGLEN);
-	else
-		MSG_Init (&send, sendBuf, MAX_SV_MSGLEN);
-
-	w1 = (chan->outgoingSequence & ~(1<<31)) | (sendReliable<<31);
-	w2 = (chan->incomingSequence & ~(1<<31)) | (chan->incomingReliableSequence<<31);
-
-	chan->outgoingSequence++;
-	chan->lastSent = Sys_Milliseconds ();
-
-	MSG_WriteLong (&send, w1);
-	MSG_WriteLong (&send, w2);
-
-	// Send the qport if we are a client
-	if (chan->sock == NS_CLIENT) {
-		if (chan->protocol != ENHANCED_PROTOCOL_VERSION)
-			MSG_WriteShort (&send, chan->qPort);
-		else if (chan->qPort)
-			MSG_WriteByte (&send, chan->qPort & 0xff);
-	}
+	Netchan_BeginPacket (chan, &send, sendBuf, sendReliable, (sendReliable && chan->reliableBulk));
 
 	// Copy the reliable message to the packet first
 	if (sendReliable) {
-		if (chan->reliableLength)
-			MSG_WriteRaw (&send, chan->reliableBuff, chan->reliableLength);
+		if (chan->reliableBulk) {
+			MSG_WriteLong (&send, (int)chan->reliableLength);
+			MSG_WriteShort (&send, fragNum);
+			MSG_WriteRaw (&send, reliable + fragOfs, fragLen);
+		}
+		else if (chan->reliableLength)
+			MSG_WriteRaw (&send, reliable, chan->reliableLength);
 		chan->lastReliableSequence = chan->outgoingSequence;
 	}
 
@@ -281,6 +496,7 @@ int Netchan_Transmit (netChan_t *chan, size_t length, byte *data)
 	// Send the datagram
 	if (NET_SendPacket (chan->sock, send.curSize, send.data, &chan->remoteAddress) == -1)
 		return -1;
+	chan->lastSentSize += send.curSize;
 
 	if (showpackets->intVal) {
 		if (sendReliable)
@@ -314,6 +530,7 @@ qBool Netchan_Process (netChan_t *chan, netMsg_t *msg)
 {
 	uint32		sequence, sequenceAck;
 	uint32		reliableAck, reliableMessage;
+	qBool		fragment;
 
 	MSG_BeginReading (msg);
 
@@ -335,6 +552,16 @@ qBool Netchan_Process (netChan_t *chan, netMsg_t *msg)
 	sequence &= ~(1<<31);
 	sequenceAck &= ~(1<<31);
 
+	fragment = qFalse;
+	if (chan->fragments) {
+		fragment = (sequence >> 30) & 1;
+		sequence &= ~(1<<30);
+
+		// Only the server sends these
+		if (fragment && (chan->sock != NS_CLIENT || !reliableMessage))
+			return qFalse;
+	}
+
 	if (showpackets->intVal) {
 		if (reliableMessage)
 			Com_Printf (0, "recv %4i : s=%i reliable=%i ack=%i rack=%i\n",
@@ -373,14 +600,26 @@ qBool Netchan_Process (netChan_t *chan, netMsg_t *msg)
 
 	// If the current outgoing reliable message has been acknowledged,
 	// clear the buffer to make way for the next
-	if (reliableAck == chan->reliableSequence)
+	if (reliableAck == chan->reliableSequence) {
 		chan->reliableLength = 0;	// it has been received
+		if (chan->reliableBulk) {
+			Mem_Free (chan->reliableBulk);
+			chan->reliableBulk = NULL;
+		}
+	}
 	
 	// If this message contains a reliable message, bump incoming_ReliableSequence
 	chan->incomingSequence = sequence;
 	chan->incomingAcknowledged = sequenceAck;
 	chan->incomingReliableAcknowledged = reliableAck;
-	if (reliableMessage)
+	if (fragment) {
+		// Not acknowledged until the last piece is in
+		if (Netchan_ReadFragment (chan, msg)) {
+			chan->fragmentReady = qTrue;
+			chan->incomingReliableSequence ^= 1;
+		}
+	}
+	else if (reliableMessage)
 		chan->incomingReliableSequence ^= 1;
 
 	// The message can now be read from the current message pointer
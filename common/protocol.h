@@ -211,6 +211,28 @@ int		MSG_ReadShort (netMsg_t *src);
 char	*MSG_ReadString (netMsg_t *src);
 char	*MSG_ReadStringLine (netMsg_t *src);
 
+/*
+=============================================================================
+
+	DEMOS
+
+=============================================================================
+*/
+
+/*
+** Demos recorded with demo_keyframes still end their messages with a -1
+** length, which is where players stop reading. Behind it is an index of
+** the non-delta keyframes, read back from the end of the file:
+**	demoIndex_t[numKeys], int numKeys, int DEMO_INDEX_MAGIC
+*/
+#define DEMO_INDEX_MAGIC	(('X'<<24)+('D'<<16)+('I'<<8)+'K')		// "KIDX"
+#define DEMO_MAX_KEYS		8192
+
+typedef struct demoIndex_s {
+	int			time;			// msec since the first frame in the demo
+	int			offset;			// file offset of the length ahead of the keyframe
+} demoIndex_t;
+
 /*
 =============================================================================
 
@@ -233,19 +255,6 @@ char	*MSG_ReadStringLine (netMsg_t *src);
 #define MAX_CL_MSGLEN		4096
 #define MAX_CL_USABLEMSG	(MAX_CL_MSGLEN - PACKET_HEADER)
 
-typedef struct netStats_s {
-	qBool			initialized;
-	uint32			initTime;
-
-	uint32			sizeIn;
-	uint32			sizeOut;
-
-	uint32			packetsIn;
-	uint32			packetsOut;
-} netStats_t;
-
-extern netStats_t	netStats;
-
 typedef enum netAdrType_s {
 	NA_LOOPBACK,
 	NA_BROADCAST,
@@ -261,6 +270,34 @@ typedef enum netSrc_s {
 	NS_MAX
 } netSrc_t;
 
+// Socket syscalls, rolled over per frame by NET_FlushSendBatch on that socket
+typedef struct netSockStats_s {
+	uint32			numFrames;
+	uint32			recvCalls;
+	uint32			sendCalls;
+	uint32			frameRecvCalls;
+	uint32			frameSendCalls;
+	uint32			lastRecvCalls;
+	uint32			lastSendCalls;
+	uint32			peakRecvCalls;
+	uint32			peakSendCalls;
+} netSockStats_t;
+
+typedef struct netStats_s {
+	qBool			initialized;
+	uint32			initTime;
+
+	uint32			sizeIn;
+	uint32			sizeOut;
+
+	uint32			packetsIn;
+	uint32			packetsOut;
+
+	netSockStats_t	sock[NS_MAX];
+} netStats_t;
+
+extern netStats_t	netStats;
+
 typedef enum netConfig_s {
 	NET_NONE,
 
@@ -320,10 +357,20 @@ netConfig_t NET_Config (netConfig_t openFlags);
 qBool		NET_GetPacket (netSrc_t sock, netAdr_t *fromAddr, netMsg_t *message);
 int			NET_SendPacket (netSrc_t sock, size_t length, void *data, netAdr_t *to);
 
+// Packets sent between Begin and Flush may be queued and handed to the OS in one call
+void		NET_BeginSendBatch (netSrc_t sock);
+void		NET_FlushSendBatch (netSrc_t sock);
+
 char		*NET_AdrToString (netAdr_t *a);
 qBool		NET_StringToAdr (char *s, netAdr_t *a);
 void		NET_Sleep (int msec);
 
+// Reliables larger than a packet, only between ends that agree to it at connect
+#define NETCHAN_FRAGMENT_SIZE	1024
+#define NETCHAN_MAX_FRAGMENTS	256
+#define NETCHAN_MAX_BULK		(NETCHAN_FRAGMENT_SIZE*NETCHAN_MAX_FRAGMENTS)
+#define NETCHAN_FRAGMENT_BURST	16		// most pieces put out by one Netchan_Transmit
+
 typedef struct netChan_s {
 	qBool		fatalError;
 
@@ -333,6 +380,7 @@ typedef struct netChan_s {
 
 	int			lastReceived;					// for timeouts
 	int			lastSent;						// for retransmits
+	size_t		lastSentSize;					// bytes put out by the last Netchan_Transmit, for rate estimation
 
 	netAdr_t	remoteAddress;
 	uint16		qPort;							// qport value to write when transmitting
@@ -356,6 +404,19 @@ typedef struct netChan_s {
 	// Message is copied to this buffer when it is first transfered
 	size_t		reliableLength;
 	byte		reliableBuff[MAX_CL_USABLEMSG];	// unacked reliable message
+
+	// Fragmented reliables, see Netchan_QueueBulk
+	qBool		fragments;						// both ends agreed to them at connect
+	byte		*bulkBuff;						// queued behind the reliable in flight
+	size_t		bulkLength;
+	byte		*reliableBulk;					// in flight in place of reliableBuff
+	int			fragmentNext;					// next piece of reliableBulk in the current pass
+
+	byte		*fragmentBuff;					// reassembly of an incoming one
+	size_t		fragmentLength;
+	int			fragmentsLeft;
+	byte		fragmentSeen[NETCHAN_MAX_FRAGMENTS];
+	qBool		fragmentReady;					// fragmentBuff holds a whole reliable to parse
 } netChan_t;
 
 void		Netchan_Init (void);
@@ -365,3 +426,7 @@ int			Netchan_Transmit (netChan_t *chan, size_t length, byte *data);
 void		Netchan_OutOfBand (netSrc_t netSocket, netAdr_t *adr, size_t length, byte *data);
 void		Netchan_OutOfBandPrint (netSrc_t netSocket, netAdr_t *adr, char *format, ...);
 qBool		Netchan_Process (netChan_t *chan, netMsg_t *msg);
+
+qBool		Netchan_QueueBulk (netChan_t *chan, byte *data, size_t length);
+void		Netchan_FreeFragments (netChan_t *chan);
+void		Netchan_Release (netChan_t *chan);
@@ -79,6 +79,65 @@ void AI_SetSightClient (void)
 	}
 }
 
+/*
+=================
+AI_TraceSightClient
+
+Every idle monster looks for level.sight_client with visible() in
+FindTarget, so those traces are made here all at once through
+gi.TraceBatch. visible() uses the answer as long as neither end has moved
+since.
+=================
+*/
+void AI_TraceSightClient (void)
+{
+	static traceReq_t	reqs[MAX_CS_EDICTS];
+	static edict_t		*passEnts[MAX_CS_EDICTS];
+	static trace_t		traces[MAX_CS_EDICTS];
+	edict_t				*ent, *client;
+	int					numReqs, i;
+
+	client = level.sight_client;
+	if (!client)
+		return;
+
+	numReqs = 0;
+	for (i=game.maxclients+1, ent=&g_edicts[i] ; i<globals.numEdicts && numReqs<MAX_CS_EDICTS ; i++, ent++)
+	{
+		if (!ent->inUse || !(ent->svFlags & SVF_MONSTER) || ent->health <= 0)
+			continue;
+		if (ent->enemy || (ent->monsterinfo.aiflags & AI_GOOD_GUY))
+			continue;
+		if (client->light_level <= 5 || range (ent, client) == RANGE_FAR)
+			continue;	// FindTarget gives up before looking
+
+		Vec3Copy (ent->s.origin, reqs[numReqs].start);
+		reqs[numReqs].start[2] += ent->viewheight;
+		Vec3Copy (client->s.origin, reqs[numReqs].end);
+		reqs[numReqs].end[2] += client->viewheight;
+		Vec3Clear (reqs[numReqs].mins);
+		Vec3Clear (reqs[numReqs].maxs);
+		reqs[numReqs].headNode = 0;
+		reqs[numReqs].contentMask = MASK_OPAQUE;
+		passEnts[numReqs] = ent;
+		numReqs++;
+	}
+	if (!numReqs)
+		return;
+
+	gi.TraceBatch (reqs, passEnts, traces, numReqs);
+
+	for (i=0 ; i<numReqs ; i++)
+	{
+		ent = passEnts[i];
+		ent->monsterinfo.sight_target = client;
+		ent->monsterinfo.sight_framenum = level.framenum;
+		Vec3Copy (reqs[i].start, ent->monsterinfo.sight_spot1);
+		Vec3Copy (reqs[i].end, ent->monsterinfo.sight_spot2);
+		ent->monsterinfo.sight_visible = (traces[i].fraction == 1.0);
+	}
+}
+
 //============================================================================
 
 /*
@@ -294,6 +353,14 @@ qBool visible (edict_t *self, edict_t *other)
 	spot1[2] += self->viewheight;
 	Vec3Copy (other->s.origin, spot2);
 	spot2[2] += other->viewheight;
+
+	// already traced along with every other monster this frame?
+	if (self->monsterinfo.sight_target == other
+		&& self->monsterinfo.sight_framenum == level.framenum
+		&& Vec3Compare (spot1, self->monsterinfo.sight_spot1)
+		&& Vec3Compare (spot2, self->monsterinfo.sight_spot2))
+		return self->monsterinfo.sight_visible;
+
 	trace = gi.trace (spot1, vec3Origin, vec3Origin, spot2, self, MASK_OPAQUE);
 	
 	if (trace.fraction == 1.0)
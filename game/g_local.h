@@ -437,6 +437,13 @@ typedef struct
 
 	int			power_armor_type;
 	int			power_armor_power;
+
+	// sight check against level.sight_client, traced with everyone else's
+	// at the start of the frame, see AI_TraceSightClient
+	edict_t		*sight_target;
+	int			sight_framenum;
+	vec3_t		sight_spot1, sight_spot2;
+	qBool		sight_visible;
 } monsterinfo_t;
 
 
@@ -691,6 +698,7 @@ void BecomeExplosion1(edict_t *self);
 // g_ai.c
 //
 void AI_SetSightClient (void);
+void AI_TraceSightClient (void);
 
 void ai_stand (edict_t *self, float dist);
 void ai_move (edict_t *self, float dist);
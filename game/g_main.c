@@ -403,6 +403,7 @@ void G_RunFrame (void)
 
 	// choose a client for monsters to target this frame
 	AI_SetSightClient ();
+	AI_TraceSightClient ();
 
 	// exit intermissions
 
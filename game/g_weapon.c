@@ -126,116 +126,125 @@ qBool fire_hit (edict_t *self, vec3_t aim, int damage, int kick)
 
 /*
 =================
-fire_lead
+fire_lead_aim
 
-This is an internal support routine used for bullet/pellet based weapons.
+Picks where a round goes, spread around aimdir.
 =================
 */
-static void fire_lead (edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick, int te_impact, int hspread, int vspread, int mod)
+static void fire_lead_aim (vec3_t start, vec3_t aimdir, int hspread, int vspread, vec3_t end)
 {
-	trace_t		tr;
 	vec3_t		dir;
 	vec3_t		forward, right, up;
-	vec3_t		end;
 	float		r;
 	float		u;
-	vec3_t		water_start;
-	qBool	water = qFalse;
-	int			content_mask = MASK_SHOT | MASK_WATER;
 
-	tr = gi.trace (self->s.origin, NULL, NULL, start, self, MASK_SHOT);
-	if (!(tr.fraction < 1.0))
-	{
-		VecToAngles (aimdir, dir);
-		Angles_Vectors (dir, forward, right, up);
+	VecToAngles (aimdir, dir);
+	Angles_Vectors (dir, forward, right, up);
 
-		r = crandom()*hspread;
-		u = crandom()*vspread;
-		Vec3MA (start, 8192, forward, end);
-		Vec3MA (end, r, right, end);
-		Vec3MA (end, u, up, end);
+	r = crandom()*hspread;
+	u = crandom()*vspread;
+	Vec3MA (start, 8192, forward, end);
+	Vec3MA (end, r, right, end);
+	Vec3MA (end, u, up, end);
+}
 
-		if (gi.pointcontents (start) & MASK_WATER)
-		{
-			water = qTrue;
-			Vec3Copy (start, water_start);
-			content_mask &= ~MASK_WATER;
-		}
 
-		tr = gi.trace (start, NULL, NULL, end, self, content_mask);
+/*
+=================
+fire_lead_water
 
-		// see if we hit water
-		if (tr.contents & MASK_WATER)
-		{
-			int		color;
+Splashes a round that hit water and traces the rest of its way.
+=================
+*/
+static void fire_lead_water (edict_t *self, vec3_t start, vec3_t end, trace_t *tr, qBool *water, vec3_t water_start, int hspread, int vspread)
+{
+	vec3_t		dir;
+	vec3_t		forward, right, up;
+	float		r;
+	float		u;
+	int			color;
 
-			water = qTrue;
-			Vec3Copy (tr.endPos, water_start);
+	if (!(tr->contents & MASK_WATER))
+		return;
 
-			if (!Vec3Compare (start, tr.endPos))
-			{
-				if (tr.contents & CONTENTS_WATER)
-				{
-					if (strcmp(tr.surface->name, "*brwater") == 0)
-						color = SPLASH_BROWN_WATER;
-					else
-						color = SPLASH_BLUE_WATER;
-				}
-				else if (tr.contents & CONTENTS_SLIME)
-					color = SPLASH_SLIME;
-				else if (tr.contents & CONTENTS_LAVA)
-					color = SPLASH_LAVA;
-				else
-					color = SPLASH_UNKNOWN;
-
-				if (color != SPLASH_UNKNOWN)
-				{
-					gi.WriteByte (SVC_TEMP_ENTITY);
-					gi.WriteByte (TE_SPLASH);
-					gi.WriteByte (8);
-					gi.WritePosition (tr.endPos);
-					gi.WriteDir (tr.plane.normal);
-					gi.WriteByte (color);
-					gi.multicast (tr.endPos, MULTICAST_PVS);
-				}
+	*water = qTrue;
+	Vec3Copy (tr->endPos, water_start);
 
-				// change bullet's course when it enters water
-				Vec3Subtract (end, start, dir);
-				VecToAngles (dir, dir);
-				Angles_Vectors (dir, forward, right, up);
-				r = crandom()*hspread*2;
-				u = crandom()*vspread*2;
-				Vec3MA (water_start, 8192, forward, end);
-				Vec3MA (end, r, right, end);
-				Vec3MA (end, u, up, end);
-			}
+	if (!Vec3Compare (start, tr->endPos))
+	{
+		if (tr->contents & CONTENTS_WATER)
+		{
+			if (strcmp(tr->surface->name, "*brwater") == 0)
+				color = SPLASH_BROWN_WATER;
+			else
+				color = SPLASH_BLUE_WATER;
+		}
+		else if (tr->contents & CONTENTS_SLIME)
+			color = SPLASH_SLIME;
+		else if (tr->contents & CONTENTS_LAVA)
+			color = SPLASH_LAVA;
+		else
+			color = SPLASH_UNKNOWN;
 
-			// re-trace ignoring water this time
-			tr = gi.trace (water_start, NULL, NULL, end, self, MASK_SHOT);
+		if (color != SPLASH_UNKNOWN)
+		{
+			gi.WriteByte (SVC_TEMP_ENTITY);
+			gi.WriteByte (TE_SPLASH);
+			gi.WriteByte (8);
+			gi.WritePosition (tr->endPos);
+			gi.WriteDir (tr->plane.normal);
+			gi.WriteByte (color);
+			gi.multicast (tr->endPos, MULTICAST_PVS);
 		}
+
+		// change bullet's course when it enters water
+		Vec3Subtract (end, start, dir);
+		VecToAngles (dir, dir);
+		Angles_Vectors (dir, forward, right, up);
+		r = crandom()*hspread*2;
+		u = crandom()*vspread*2;
+		Vec3MA (water_start, 8192, forward, end);
+		Vec3MA (end, r, right, end);
+		Vec3MA (end, u, up, end);
 	}
 
+	// re-trace ignoring water this time
+	*tr = gi.trace (water_start, NULL, NULL, end, self, MASK_SHOT);
+}
+
+
+/*
+=================
+fire_lead_impact
+
+Damage or a puff where a round stopped, and its bubble trail.
+=================
+*/
+static void fire_lead_impact (edict_t *self, vec3_t aimdir, trace_t *tr, qBool water, vec3_t water_start, int damage, int kick, int te_impact, int mod)
+{
+	vec3_t		dir;
+
 	// send gun puff / flash
-	if (!((tr.surface) && (tr.surface->flags & SURF_TEXINFO_SKY)))
+	if (!((tr->surface) && (tr->surface->flags & SURF_TEXINFO_SKY)))
 	{
-		if (tr.fraction < 1.0)
+		if (tr->fraction < 1.0)
 		{
-			if (tr.ent->takedamage)
+			if (tr->ent->takedamage)
 			{
-				T_Damage (tr.ent, self, self, aimdir, tr.endPos, tr.plane.normal, damage, kick, DAMAGE_BULLET, mod);
+				T_Damage (tr->ent, self, self, aimdir, tr->endPos, tr->plane.normal, damage, kick, DAMAGE_BULLET, mod);
 			}
 			else
 			{
-				if (strncmp (tr.surface->name, "sky", 3) != 0)
+				if (strncmp (tr->surface->name, "sky", 3) != 0)
 				{
 					gi.WriteByte (SVC_TEMP_ENTITY);
 					gi.WriteByte (te_impact);
-					gi.WritePosition (tr.endPos);
-					gi.WriteDir (tr.plane.normal);
-					gi.multicast (tr.endPos, MULTICAST_PVS);
+					gi.WritePosition (tr->endPos);
+					gi.WriteDir (tr->plane.normal);
+					gi.multicast (tr->endPos, MULTICAST_PVS);
 
 					if (self->client)
-						PlayerNoise(self, tr.endPos, PNOISE_IMPACT);
+						PlayerNoise(self, tr->endPos, PNOISE_IMPACT);
 				}
 			}
 		}
@@ -246,26 +255,63 @@ static void fire_lead (edict_t *self, vec3_t start, vec3_t aimdir, int damage, i
 	{
 		vec3_t	pos;
 
-		Vec3Subtract (tr.endPos, water_start, dir);
+		Vec3Subtract (tr->endPos, water_start, dir);
 		VectorNormalizef (dir, dir);
-		Vec3MA (tr.endPos, -2, dir, pos);
+		Vec3MA (tr->endPos, -2, dir, pos);
 		if (gi.pointcontents (pos) & MASK_WATER)
-			Vec3Copy (pos, tr.endPos);
+			Vec3Copy (pos, tr->endPos);
 		else
-			tr = gi.trace (pos, NULL, NULL, water_start, tr.ent, MASK_WATER);
+			*tr = gi.trace (pos, NULL, NULL, water_start, tr->ent, MASK_WATER);
 
-		Vec3Add (water_start, tr.endPos, pos);
+		Vec3Add (water_start, tr->endPos, pos);
 		Vec3Scale (pos, 0.5, pos);
 
 		gi.WriteByte (SVC_TEMP_ENTITY);
 		gi.WriteByte (TE_BUBBLETRAIL);
 		gi.WritePosition (water_start);
-		gi.WritePosition (tr.endPos);
+		gi.WritePosition (tr->endPos);
 		gi.multicast (pos, MULTICAST_PVS);
 	}
 }
 
 
+/*
+=================
+fire_lead
+
+This is an internal support routine used for bullet/pellet based weapons.
+=================
+*/
+static void fire_lead (edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick, int te_impact, int hspread, int vspread, int mod)
+{
+	trace_t		tr;
+	vec3_t		end;
+	vec3_t		water_start;
+	qBool	water = qFalse;
+	int			content_mask = MASK_SHOT | MASK_WATER;
+
+	tr = gi.trace (self->s.origin, NULL, NULL, start, self, MASK_SHOT);
+	if (!(tr.fraction < 1.0))
+	{
+		fire_lead_aim (start, aimdir, hspread, vspread, end);
+
+		if (gi.pointcontents (start) & MASK_WATER)
+		{
+			water = qTrue;
+			Vec3Copy (start, water_start);
+			content_mask &= ~MASK_WATER;
+		}
+
+		tr = gi.trace (start, NULL, NULL, end, self, content_mask);
+
+		// see if we hit water
+		fire_lead_water (self, start, end, &tr, &water, water_start, hspread, vspread);
+	}
+
+	fire_lead_impact (self, aimdir, &tr, water, water_start, damage, kick, te_impact, mod);
+}
+
+
 /*
 =================
 fire_bullet
@@ -285,14 +331,74 @@ void fire_bullet (edict_t *self, vec3_t start, vec3_t aimdir, int damage, int ki
 fire_shotgun
 
 Shoots shotgun pellets.  Used by shotgun and super shotgun.
+
+The pellets all leave from the same spot, so that's checked once and their
+paths are traced together through gi.TraceBatch. Damage is still dealt one
+pellet at a time, a pellet whose target an earlier one gibbed or removed is
+traced again.
 =================
 */
+#define MAX_PELLET_BATCH	32
+
 void fire_shotgun (edict_t *self, vec3_t start, vec3_t aimdir, int damage, int kick, int hspread, int vspread, int count, int mod)
 {
-	int		i;
+	traceReq_t	reqs[MAX_PELLET_BATCH];
+	edict_t		*passEnts[MAX_PELLET_BATCH];
+	trace_t		traces[MAX_PELLET_BATCH];
+	trace_t		tr;
+	vec3_t		water_start;
+	qBool		start_water, water;
+	int			content_mask = MASK_SHOT | MASK_WATER;
+	int			i, num;
 
-	for (i = 0; i < count; i++)
-		fire_lead (self, start, aimdir, damage, kick, TE_SHOTGUN, hspread, vspread, mod);
+	tr = gi.trace (self->s.origin, NULL, NULL, start, self, MASK_SHOT);
+	if (tr.fraction < 1.0)
+	{
+		for (i = 0; i < count; i++)
+		{
+			traces[0] = tr;
+			fire_lead_impact (self, aimdir, &traces[0], qFalse, water_start, damage, kick, TE_SHOTGUN, mod);
+		}
+		return;
+	}
+
+	start_water = (gi.pointcontents (start) & MASK_WATER) ? qTrue : qFalse;
+	if (start_water)
+		content_mask &= ~MASK_WATER;
+
+	while (count > 0)
+	{
+		num = min (count, MAX_PELLET_BATCH);
+		for (i = 0; i < num; i++)
+		{
+			Vec3Copy (start, reqs[i].start);
+			fire_lead_aim (start, aimdir, hspread, vspread, reqs[i].end);
+			Vec3Clear (reqs[i].mins);
+			Vec3Clear (reqs[i].maxs);
+			reqs[i].headNode = 0;
+			reqs[i].contentMask = content_mask;
+			passEnts[i] = self;
+		}
+
+		gi.TraceBatch (reqs, passEnts, traces, num);
+
+		for (i = 0; i < num; i++)
+		{
+			tr = traces[i];
+			if (tr.ent && tr.ent != g_edicts && (!tr.ent->inUse || tr.ent->solid == SOLID_NOT))
+				tr = gi.trace (start, NULL, NULL, reqs[i].end, self, content_mask);
+
+			water = start_water;
+			if (water)
+				Vec3Copy (start, water_start);
+
+			// see if we hit water
+			fire_lead_water (self, start, reqs[i].end, &tr, &water, water_start, hspread, vspread);
+			fire_lead_impact (self, aimdir, &tr, water, water_start, damage, kick, TE_SHOTGUN, mod);
+		}
+
+		count -= num;
+	}
 }
 
 
@@ -169,6 +169,19 @@ typedef struct gameImport_s {
 	void	(*AddCommandString) (char *text);
 
 	void	(*DebugGraph) (float value, int color);
+
+	//
+	// game modules built before these were added find everything above by
+	// position, so new imports only ever go on the end
+	//
+
+	// world-only traces in bulk, out[i] answers reqs[i]. entities are never
+	// clipped and trace_t.ent is always NULL
+	void	(*BoxTraceBatch) (const traceReq_t *reqs, trace_t *out, int numReqs);
+
+	// trace in bulk, entities included, passEnts[i] is reqs[i]'s passEnt and
+	// passEnts may be NULL. headNode must be 0
+	void	(*TraceBatch) (const traceReq_t *reqs, edict_t **passEnts, trace_t *out, int numReqs);
 } gameImport_t;
 
 //
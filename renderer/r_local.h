@@ -36,6 +36,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #include <GL/gl.h>
 #include <math.h>
 
+// Vertex kernels use SSE2 when the compiler targets it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define R_SSE2
+# include <emmintrin.h>
+#endif
+
 #include "r_public.h"
 #include "r_typedefs.h"
 #include "rb_qgl.h"
@@ -659,6 +665,8 @@ typedef struct refStats_s {
 	// Alias Models
 	uint32				aliasElements;
 	uint32				aliasPolys;
+	uint32				aliasPoses;
+	uint32				aliasPoseHits;
 
 	// Batching
 	uint32				meshBatches;
@@ -688,6 +696,10 @@ typedef struct refStats_s {
 	uint32				timeSortList;
 	uint32				timeDrawList;
 
+	uint32				timeSortListMicro;
+	uint32				sortedMeshes;
+	uint32				sortPasses;
+
 	uint32				timeMarkLeaves;
 	uint32				timeMarkLights;
 	uint32				timeRecurseWorld;
@@ -703,6 +715,7 @@ typedef struct refRegist_s {
 	uint32				fontsTouched;
 
 	// Images
+	uint32				imagesPrefetched;
 	uint32				imagesReleased;
 	uint32				imagesResampled;
 	uint32				imagesSeaked;
@@ -772,6 +785,7 @@ typedef struct refInfo_s {
 	image_t				*fogTexture;		// fog texture for q3 bsp
 
 	// Memory management
+	struct memPool_s	*aliasPoseArena;
 	struct memPool_s	*decalSysPool;
 	struct memPool_s	*fontSysPool;
 	struct memPool_s	*genericPool;
@@ -852,11 +866,13 @@ extern cVar_t	*r_flareSize;
 extern cVar_t	*r_fontScale;
 extern cVar_t	*r_fullbright;
 extern cVar_t	*r_hwGamma;
+extern cVar_t	*r_lerpCache;
 extern cVar_t	*r_lerpmodels;
 extern cVar_t	*r_lightlevel;	// FIXME: This is a HACK to get the client's light level
 extern cVar_t	*r_lmMaxBlockSize;
 extern cVar_t	*r_lmModulate;
 extern cVar_t	*r_lmPacking;
+extern cVar_t	*r_modelCache;
 extern cVar_t	*r_noCull;
 extern cVar_t	*r_noRefresh;
 extern cVar_t	*r_noVis;
@@ -871,6 +887,7 @@ extern cVar_t	*r_swapInterval;
 extern cVar_t	*r_textureBits;
 extern cVar_t	*r_times;
 extern cVar_t	*r_vertexLighting;
+extern cVar_t	*r_worldVBO;
 extern cVar_t	*r_zFarAbs;
 extern cVar_t	*r_zFarMin;
 extern cVar_t	*r_zNear;
@@ -919,6 +936,11 @@ void		Matrix4_Multiply_Vector (const mat4x4_t m, const vec4_t v, vec4_t out);
 qBool		RB_BackendOverflow (int numVerts, int numIndexes);
 qBool		RB_InvalidMesh (const mesh_t *mesh);
 void		RB_PushMesh (mesh_t *mesh, meshFeatures_t meshFeatures);
+qBool		RB_WorldVBOOverflow (void);
+void		RB_PushWorldVBOMesh (int firstIndex, int numIndexes, int firstVert, int numVerts, meshFeatures_t meshFeatures);
+
+void		RB_BatchInit (void);
+void		RB_BatchShutdown (void);
 
 //
 // rf_init.c
@@ -946,6 +968,8 @@ void		RB_LockArrays (int numVerts);
 void		RB_UnlockArrays (void);
 void		RB_ResetPointers (void);
 
+qBool		RB_WorldVBOMaterial (const material_t *mat);
+
 void		RB_RenderMeshBuffer (meshBuffer_t *mb, qBool shadowPass);
 void		RB_FinishRendering (void);
 
@@ -1081,6 +1105,9 @@ void		R_AddQ2BrushModel (refEntity_t *ent);
 void		R_AddQ3BrushModel (refEntity_t *ent);
 void		R_AddWorldToList (void);
 
+void		R_BuildWorldVBO (refModel_t *model);
+void		R_ReleaseWorldVBO (void);
+
 void		R_WorldInit (void);
 void		R_WorldShutdown (void);
 
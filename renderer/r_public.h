@@ -152,6 +152,7 @@ size_t		R_DrawStringLen (struct font_s *font, float x, float y, float xScale, fl
 // rf_image.c
 //
 
+void		R_PrefetchImage (char *name);
 qBool		R_UpdateTexture (char *name, byte *data, int width, int height);
 void		R_GetImageSize (struct material_s *mat, int *width, int *height);
 
@@ -169,6 +170,8 @@ typedef enum {
 } rInit_t;
 rInit_t		R_Init (void);
 void		R_Shutdown (qBool full);
+void		R_HeadlessInit (void);
+void		R_HeadlessShutdown (void);
 
 //
 // rf_light.c
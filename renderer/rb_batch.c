@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include "rb_local.h"
 
+static void	*cmd_pushBench;
+
 /*
 =============
 RB_BackendOverflow
@@ -49,6 +51,43 @@ qBool RB_InvalidMesh (const mesh_t *mesh)
 }
 
 
+/*
+=============
+RB_RebaseIndexes
+
+Copies indexes while offsetting them into the batch, eight at a time where
+SSE2 is around.
+=============
+*/
+static inline void RB_RebaseIndexes (index_t *out, const index_t *in, int count, int base)
+{
+#ifdef R_SSE2
+	__m128i		vBase;
+
+	vBase = _mm_set1_epi32 (base);
+	for ( ; count>=8 ; count-=8, in+=8, out+=8) {
+		_mm_storeu_si128 ((__m128i *)out, _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *)in), vBase));
+		_mm_storeu_si128 ((__m128i *)(out+4), _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *)(in+4)), vBase));
+	}
+	if (count >= 4) {
+		_mm_storeu_si128 ((__m128i *)out, _mm_add_epi32 (_mm_loadu_si128 ((const __m128i *)in), vBase));
+		count -= 4;
+		in += 4;
+		out += 4;
+	}
+#else
+	for ( ; count>=4 ; count-=4, in+=4, out+=4) {
+		out[0] = in[0] + base;
+		out[1] = in[1] + base;
+		out[2] = in[2] + base;
+		out[3] = in[3] + base;
+	}
+#endif
+	for ( ; count>0 ; count--)
+		*out++ = *in++ + base;
+}
+
+
 /*
 =============
 RB_PushTriangleIndexes
@@ -89,13 +128,11 @@ static inline void RB_PushTriangleIndexes (index_t *indexes, int count, meshFeat
 		rb.numIndexes += count;
 		rb.inIndices = rb.batch.indices;
 
-		// The following code assumes that R_PushIndexes is fed with triangles
-		for ( ; count>0 ; count-=3, indexes+=3, currentIndex+=3) {
-			currentIndex[0] = rb.numVerts + indexes[0];
-			currentIndex[1] = rb.numVerts + indexes[1];
-			currentIndex[2] = rb.numVerts + indexes[2];
+		RB_RebaseIndexes (currentIndex, indexes, count, rb.numVerts);
 
 #if SHADOW_VOLUMES
+		// The following code assumes that R_PushIndexes is fed with triangles
+		for ( ; count>0 ; count-=3) {
 			if (neighbors) {
 				rb.curTrNeighbor[0] = numTris + neighbors[0];
 				rb.curTrNeighbor[1] = numTris + neighbors[1];
@@ -110,8 +147,8 @@ static inline void RB_PushTriangleIndexes (index_t *indexes, int count, meshFeat
 				trNormals++;
 				rb.curTrNormal += 3;
 			}
-#endif
 		}
+#endif
 	}
 }
 
@@ -145,8 +182,6 @@ RB_PushMesh
 */
 void RB_PushMesh (mesh_t *mesh, meshFeatures_t meshFeatures)
 {
-	int		i;
-
 	assert (mesh->numVerts);
 
 	rb.curMeshFeatures = meshFeatures;
@@ -167,23 +202,13 @@ void RB_PushMesh (mesh_t *mesh, meshFeatures_t meshFeatures)
 
 		// Vertexes and normals
 		if (meshFeatures & MF_DEFORMVS) {
-			if (mesh->vertexArray != rb.batch.vertices) {
-				for (i=0 ; i<mesh->numVerts ; i++) {
-					rb.batch.vertices[rb.numVerts+i][0] = mesh->vertexArray[i][0];
-					rb.batch.vertices[rb.numVerts+i][1] = mesh->vertexArray[i][1];
-					rb.batch.vertices[rb.numVerts+i][2] = mesh->vertexArray[i][2];
-				}
-			}
+			if (mesh->vertexArray != rb.batch.vertices)
+				memcpy (rb.batch.vertices, mesh->vertexArray, sizeof (vec3_t) * mesh->numVerts);
 			rb.inVertices = rb.batch.vertices;
 
 			if (meshFeatures & MF_NORMALS && mesh->normalsArray) {
-				if (mesh->normalsArray != rb.batch.normals) {
-					for (i=0 ; i<mesh->numVerts ; i++) {
-						rb.batch.normals[rb.numVerts+i][0] = mesh->normalsArray[i][0];
-						rb.batch.normals[rb.numVerts+i][1] = mesh->normalsArray[i][1];
-						rb.batch.normals[rb.numVerts+i][2] = mesh->normalsArray[i][2];
-					}
-				}
+				if (mesh->normalsArray != rb.batch.normals)
+					memcpy (rb.batch.normals, mesh->normalsArray, sizeof (vec3_t) * mesh->numVerts);
 				rb.inNormals = rb.batch.normals;
 			}
 		}
@@ -212,12 +237,7 @@ void RB_PushMesh (mesh_t *mesh, meshFeatures_t meshFeatures)
 
 		// Colors
 		if (meshFeatures & MF_COLORS && mesh->colorArray) {
-			for (i=0 ; i<mesh->numVerts ; i++) {
-				rb.batch.colors[rb.numVerts+i][0] = mesh->colorArray[i][0];
-				rb.batch.colors[rb.numVerts+i][1] = mesh->colorArray[i][1];
-				rb.batch.colors[rb.numVerts+i][2] = mesh->colorArray[i][2];
-				rb.batch.colors[rb.numVerts+i][3] = mesh->colorArray[i][3];
-			}
+			memcpy (rb.batch.colors, mesh->colorArray, sizeof (bvec4_t) * mesh->numVerts);
 			rb.inColors = rb.batch.colors;
 		}
 	}
@@ -225,90 +245,239 @@ void RB_PushMesh (mesh_t *mesh, meshFeatures_t meshFeatures)
 		ri.pc.meshBatches++;
 
 		// Vertexes and colors
+		memcpy (rb.batch.vertices[rb.numVerts], mesh->vertexArray, sizeof (vec3_t) * mesh->numVerts);
+		rb.inVertices = rb.batch.vertices;
+
 		if (meshFeatures & MF_COLORS && mesh->colorArray) {
-			for (i=0 ; i<mesh->numVerts ; i++) {
-				rb.batch.vertices[rb.numVerts+i][0] = mesh->vertexArray[i][0];
-				rb.batch.vertices[rb.numVerts+i][1] = mesh->vertexArray[i][1];
-				rb.batch.vertices[rb.numVerts+i][2] = mesh->vertexArray[i][2];
-
-				rb.batch.colors[rb.numVerts+i][0] = mesh->colorArray[i][0];
-				rb.batch.colors[rb.numVerts+i][1] = mesh->colorArray[i][1];
-				rb.batch.colors[rb.numVerts+i][2] = mesh->colorArray[i][2];
-				rb.batch.colors[rb.numVerts+i][3] = mesh->colorArray[i][3];
-			}
+			memcpy (rb.batch.colors[rb.numVerts], mesh->colorArray, sizeof (bvec4_t) * mesh->numVerts);
 			rb.inColors = rb.batch.colors;
 		}
-		else {
-			for (i=0 ; i<mesh->numVerts ; i++) {
-				rb.batch.vertices[rb.numVerts+i][0] = mesh->vertexArray[i][0];
-				rb.batch.vertices[rb.numVerts+i][1] = mesh->vertexArray[i][1];
-				rb.batch.vertices[rb.numVerts+i][2] = mesh->vertexArray[i][2];
-			}
-		}
-		rb.inVertices = rb.batch.vertices;
 
 		// Normals
 		if (meshFeatures & MF_NORMALS && mesh->normalsArray) {
-			for (i=0 ; i<mesh->numVerts ; i++) {
-				rb.batch.normals[rb.numVerts+i][0] = mesh->normalsArray[i][0];
-				rb.batch.normals[rb.numVerts+i][1] = mesh->normalsArray[i][1];
-				rb.batch.normals[rb.numVerts+i][2] = mesh->normalsArray[i][2];
-			}
+			memcpy (rb.batch.normals[rb.numVerts], mesh->normalsArray, sizeof (vec3_t) * mesh->numVerts);
 			rb.inNormals = rb.batch.normals;
 		}
 
 		// Texture coordinates
 		if (meshFeatures & MF_STCOORDS && mesh->coordArray) {
-			for (i=0 ; i<mesh->numVerts ; i++) {
-				rb.batch.coords[rb.numVerts+i][0] = mesh->coordArray[i][0];
-				rb.batch.coords[rb.numVerts+i][1] = mesh->coordArray[i][1];
-			}
+			memcpy (rb.batch.coords[rb.numVerts], mesh->coordArray, sizeof (vec2_t) * mesh->numVerts);
 			rb.inCoords = rb.batch.coords;
 		}
 
 		// Lightmap texture coordinates
 		if (meshFeatures & MF_LMCOORDS && mesh->lmCoordArray) {
-			for (i=0 ; i<mesh->numVerts ; i++) {
-				rb.batch.lmCoords[rb.numVerts+i][0] = mesh->lmCoordArray[i][0];
-				rb.batch.lmCoords[rb.numVerts+i][1] = mesh->lmCoordArray[i][1];
-			}
+			memcpy (rb.batch.lmCoords[rb.numVerts], mesh->lmCoordArray, sizeof (vec2_t) * mesh->numVerts);
 			rb.inLMCoords = rb.batch.lmCoords;
 		}
 
 		// STVectors
 		if (meshFeatures & MF_STVECTORS) {
-			if (mesh->sVectorsArray && mesh->tVectorsArray) {
-				for (i=0 ; i<mesh->numVerts ; i++) {
-					rb.batch.sVectors[rb.numVerts+i][0] = mesh->sVectorsArray[i][0];
-					rb.batch.sVectors[rb.numVerts+i][1] = mesh->sVectorsArray[i][1];
-					rb.batch.sVectors[rb.numVerts+i][2] = mesh->sVectorsArray[i][2];
-					rb.batch.tVectors[rb.numVerts+i][0] = mesh->tVectorsArray[i][0];
-					rb.batch.tVectors[rb.numVerts+i][1] = mesh->tVectorsArray[i][1];
-					rb.batch.tVectors[rb.numVerts+i][2] = mesh->tVectorsArray[i][2];
-				}
+			if (mesh->sVectorsArray) {
+				memcpy (rb.batch.sVectors[rb.numVerts], mesh->sVectorsArray, sizeof (vec3_t) * mesh->numVerts);
 				rb.inSVectors = rb.batch.sVectors;
-				rb.inTVectors = rb.batch.tVectors;
 			}
-			else {
-				if (mesh->sVectorsArray) {
-					for (i=0 ; i<mesh->numVerts ; i++) {
-						rb.batch.sVectors[rb.numVerts+i][0] = mesh->sVectorsArray[i][0];
-						rb.batch.sVectors[rb.numVerts+i][1] = mesh->sVectorsArray[i][1];
-						rb.batch.sVectors[rb.numVerts+i][2] = mesh->sVectorsArray[i][2];
-					}
-					rb.inSVectors = rb.batch.sVectors;
-				}
-				if (mesh->tVectorsArray) {
-					for (i=0 ; i<mesh->numVerts ; i++) {
-						rb.batch.tVectors[rb.numVerts+i][0] = mesh->tVectorsArray[i][0];
-						rb.batch.tVectors[rb.numVerts+i][1] = mesh->tVectorsArray[i][1];
-						rb.batch.tVectors[rb.numVerts+i][2] = mesh->tVectorsArray[i][2];
-					}
-					rb.inTVectors = rb.batch.tVectors;
-				}
+			if (mesh->tVectorsArray) {
+				memcpy (rb.batch.tVectors[rb.numVerts], mesh->tVectorsArray, sizeof (vec3_t) * mesh->numVerts);
+				rb.inTVectors = rb.batch.tVectors;
 			}
 		}
 	}
 
 	rb.numVerts += mesh->numVerts;
 }
+
+
+/*
+=============
+RB_WorldVBOOverflow
+=============
+*/
+qBool RB_WorldVBOOverflow (void)
+{
+	return (rb.numVBORanges >= RB_MAX_VBO_RANGES);
+}
+
+
+/*
+=============
+RB_PushWorldVBOMesh
+
+Queues a surface that already lives in the world vertex buffer. Nothing is
+copied, the index range is just appended to (or merged with) the list that
+RB_DrawElements walks when the batch is flushed.
+=============
+*/
+void RB_PushWorldVBOMesh (int firstIndex, int numIndexes, int firstVert, int numVerts, meshFeatures_t meshFeatures)
+{
+	rbVBORange_t	*range;
+	index_t			lastVert;
+
+	assert (numVerts);
+
+	rb.curMeshFeatures = meshFeatures;
+	if (!(meshFeatures & MF_NONBATCHED))
+		ri.pc.meshBatches++;
+
+	// Point the inputs at the buffer layout
+	if (!rb.inWorldVBO) {
+		rb.inWorldVBO = qTrue;
+		rb.inVertices = (vec3_t *)0;
+		rb.inCoords = (vec2_t *)rb.worldVBO.coordOffset;
+		rb.inLMCoords = (vec2_t *)rb.worldVBO.lmCoordOffset;
+	}
+
+	rb.numIndexes += numIndexes;
+	rb.numVerts += numVerts;
+	lastVert = firstVert + numVerts - 1;
+
+	// Extend the last range if this surface follows it in the buffer
+	if (rb.numVBORanges) {
+		range = &rb.vboRanges[rb.numVBORanges-1];
+		if (range->firstIndex + range->numIndexes == firstIndex) {
+			range->numIndexes += numIndexes;
+			if (firstVert < range->minVert)
+				range->minVert = firstVert;
+			if (lastVert > range->maxVert)
+				range->maxVert = lastVert;
+			return;
+		}
+	}
+
+	range = &rb.vboRanges[rb.numVBORanges++];
+	range->firstIndex = firstIndex;
+	range->numIndexes = numIndexes;
+	range->minVert = firstVert;
+	range->maxVert = lastVert;
+}
+
+/*
+=============================================================================
+
+	BENCHMARK
+
+=============================================================================
+*/
+
+#define PUSHBENCH_MAXVERTS	64
+#define PUSHBENCH_VERTSIZE	(sizeof (vec3_t) * 2 + sizeof (vec2_t) * 2 + sizeof (bvec4_t))
+
+/*
+=============
+RB_PushBench_f
+
+Pushes synthetic meshes through RB_PushMesh until the batch fills, over and
+over. The source streams are packed back to back behind the mesh_t the way
+the BSP loader lays out a patch, so the copies see the alignment real world
+surfaces have. Nothing is drawn, and with cl_headless this is registered
+without a window or context.
+=============
+*/
+static void RB_PushBench_f (void)
+{
+	static const int	sizes[] = { 4, 8, 16, 64 };
+	static byte			block[sizeof (mesh_t) + PUSHBENCH_MAXVERTS * PUSHBENCH_VERTSIZE + (PUSHBENCH_MAXVERTS-2) * 3 * sizeof (index_t)];
+	meshFeatures_t		features;
+	refStats_t			oldStats;
+	mesh_t				*mesh;
+	byte				*buffer;
+	uint32				startTime, time;
+	int					numFrames, frame;
+	int					numMeshes, numVerts, numIndexes;
+	int					i, j;
+
+	numFrames = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 1000;
+	if (numFrames < 1)
+		numFrames = 1;
+
+	// Carve the streams like R_CreateQ3BSPMeshForSurface does for patches
+	memset (block, 0, sizeof (block));
+	buffer = block;
+	mesh = (mesh_t *)buffer; buffer += sizeof (mesh_t);
+	mesh->vertexArray = (vec3_t *)buffer; buffer += PUSHBENCH_MAXVERTS * sizeof (vec3_t);
+	mesh->normalsArray = (vec3_t *)buffer; buffer += PUSHBENCH_MAXVERTS * sizeof (vec3_t);
+	mesh->coordArray = (vec2_t *)buffer; buffer += PUSHBENCH_MAXVERTS * sizeof (vec2_t);
+	mesh->lmCoordArray = (vec2_t *)buffer; buffer += PUSHBENCH_MAXVERTS * sizeof (vec2_t);
+	mesh->colorArray = (bvec4_t *)buffer; buffer += PUSHBENCH_MAXVERTS * sizeof (bvec4_t);
+	mesh->indexArray = (index_t *)buffer;
+	features = MF_STCOORDS|MF_LMCOORDS|MF_NORMALS|MF_COLORS;
+
+	for (i=0 ; i<PUSHBENCH_MAXVERTS ; i++) {
+		Vec3Set (mesh->vertexArray[i], i, i*2, i*3);
+		Vec3Set (mesh->normalsArray[i], 0, 0, 1);
+		mesh->coordArray[i][0] = mesh->lmCoordArray[i][0] = i * 0.25f;
+		mesh->coordArray[i][1] = mesh->lmCoordArray[i][1] = i * 0.5f;
+		mesh->colorArray[i][0] = mesh->colorArray[i][1] = mesh->colorArray[i][2] = mesh->colorArray[i][3] = 255;
+	}
+
+	Com_Printf (0, "Layout: %i bytes/vert, %i bytes/index, streams packed behind the mesh like loaded patches\n",
+		(int)PUSHBENCH_VERTSIZE, (int)sizeof (index_t));
+	Com_Printf (0, "Source offsets mod 16: xyz %i normal %i st %i lm %i color %i index %i\n",
+		(int)((size_t)mesh->vertexArray & 15), (int)((size_t)mesh->normalsArray & 15),
+		(int)((size_t)mesh->coordArray & 15), (int)((size_t)mesh->lmCoordArray & 15),
+		(int)((size_t)mesh->colorArray & 15), (int)((size_t)mesh->indexArray & 15));
+	Com_Printf (0, "Batch offsets mod 16:  xyz %i normal %i st %i lm %i color %i index %i\n",
+		(int)((size_t)rb.batch.vertices & 15), (int)((size_t)rb.batch.normals & 15),
+		(int)((size_t)rb.batch.coords & 15), (int)((size_t)rb.batch.lmCoords & 15),
+		(int)((size_t)rb.batch.colors & 15), (int)((size_t)rb.batch.indices & 15));
+
+	oldStats = ri.pc;
+	for (j=0 ; j<sizeof (sizes)/sizeof (sizes[0]) ; j++) {
+		mesh->numVerts = sizes[j];
+		mesh->numIndexes = (sizes[j] - 2) * 3;
+		for (i=2 ; i<sizes[j] ; i++) {
+			mesh->indexArray[(i-2)*3+0] = 0;
+			mesh->indexArray[(i-2)*3+1] = i - 1;
+			mesh->indexArray[(i-2)*3+2] = i;
+		}
+
+		numMeshes = numVerts = numIndexes = 0;
+		startTime = Sys_UMicroseconds ();
+		for (frame=0 ; frame<numFrames ; frame++) {
+			RB_ResetPointers ();
+			while (!RB_BackendOverflow (mesh->numVerts, mesh->numIndexes)) {
+				RB_PushMesh (mesh, features);
+				numMeshes++;
+				numVerts += mesh->numVerts;
+				numIndexes += mesh->numIndexes;
+			}
+		}
+		time = Sys_UMicroseconds () - startTime;
+		RB_ResetPointers ();
+
+		// Bytes per microsecond is MB/s
+		Com_Printf (0, "%2i verts: %8i meshes %6uus %6.2fns/vert %8.1fMB/s\n",
+			sizes[j], numMeshes, time,
+			numVerts ? (float)time * 1000.0f / (float)numVerts : 0.0f,
+			time ? ((float)numVerts * PUSHBENCH_VERTSIZE + (float)numIndexes * sizeof (index_t)) / (float)time : 0.0f);
+	}
+	ri.pc = oldStats;
+
+#ifdef R_SSE2
+	Com_Printf (0, "Index rebasing: SSE2, unaligned loads\n");
+#else
+	Com_Printf (0, "Index rebasing: scalar\n");
+#endif
+}
+
+
+/*
+=============
+RB_BatchInit
+=============
+*/
+void RB_BatchInit (void)
+{
+	cmd_pushBench = Cmd_AddCommand ("rb_pushbench", RB_PushBench_f, "Times mesh batching on synthetic meshes");
+}
+
+
+/*
+=============
+RB_BatchShutdown
+=============
+*/
+void RB_BatchShutdown (void)
+{
+	Cmd_RemoveCommand ("rb_pushbench", cmd_pushBench);
+}
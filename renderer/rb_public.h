@@ -34,6 +34,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #define RB_MAX_INDEXES			RB_MAX_VERTS*6
 #define RB_MAX_TRIANGLES		RB_MAX_INDEXES/3
 #define RB_MAX_NEIGHBORS		RB_MAX_TRIANGLES*3
+#define RB_MAX_VBO_RANGES		256
 
 // FIXME: this could be made local to the backend
 typedef struct rbData_batch_s {
@@ -52,6 +53,29 @@ typedef struct rbData_batch_s {
 #endif
 } rbData_batch_t;
 
+// Static world geometry, uploaded once per map by R_BuildWorldVBO
+typedef struct rbWorldVBO_s {
+	struct refModel_s		*model;
+
+	GLuint					vertexBuffer;
+	GLuint					indexBuffer;
+
+	int						numVerts;
+	int						numIndexes;
+
+	size_t					coordOffset;
+	size_t					lmCoordOffset;
+} rbWorldVBO_t;
+
+// A run of indexes in the world index buffer
+typedef struct rbVBORange_s {
+	int						firstIndex;
+	int						numIndexes;
+
+	index_t					minVert;
+	index_t					maxVert;
+} rbVBORange_t;
+
 typedef struct rbData_s {
 	// Batch buffers are used for MAT_ENTITY_MERGABLE materials and for
 	// storage to pass to the backend on non-MAT_ENTITY_MERGABLE materials.
@@ -67,6 +91,13 @@ typedef struct rbData_s {
 	vec3_t					*inTVectors;
 	vec3_t					*inVertices;
 
+	// World surfaces drawn straight out of the vertex buffer objects, the
+	// in* pointers above are buffer offsets while inWorldVBO is set
+	rbWorldVBO_t			worldVBO;
+	qBool					inWorldVBO;
+	int						numVBORanges;
+	rbVBORange_t			vboRanges[RB_MAX_VBO_RANGES];
+
 #ifdef SHADOW_VOLUMES
 	int						*inNeighbors;
 	vec3_t					*inTrNormals;
@@ -106,6 +106,13 @@ RB_ResetPointers
 */
 void RB_ResetPointers (void)
 {
+	if (rb.inWorldVBO) {
+		qglBindBufferARB (GL_ARRAY_BUFFER_ARB, 0);
+		qglBindBufferARB (GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+		rb.inWorldVBO = qFalse;
+	}
+	rb.numVBORanges = 0;
+
 	rb.inColors = NULL;
 	rb.inCoords = NULL;
 	rb.inIndices = NULL;
@@ -1602,11 +1609,22 @@ RB_DrawElements
 */
 static void RB_DrawElements (void)
 {
+	rbVBORange_t	*range;
+	int				i;
+
 	if (!rb.numVerts || !rb.numIndexes)
 		return;
 
 	// Flush
-	if (ri.config.extDrawRangeElements)
+	if (rb.inWorldVBO) {
+		for (i=0, range=rb.vboRanges ; i<rb.numVBORanges ; i++, range++) {
+			if (ri.config.extDrawRangeElements)
+				qglDrawRangeElementsEXT (GL_TRIANGLES, range->minVert, range->maxVert, range->numIndexes, GL_UNSIGNED_INT, (GLvoid *)(range->firstIndex * sizeof (index_t)));
+			else
+				qglDrawElements (GL_TRIANGLES, range->numIndexes, GL_UNSIGNED_INT, (GLvoid *)(range->firstIndex * sizeof (index_t)));
+		}
+	}
+	else if (ri.config.extDrawRangeElements)
 		qglDrawRangeElementsEXT (GL_TRIANGLES, 0, rb.numVerts, rb.numIndexes, GL_UNSIGNED_INT, rb.inIndices);
 	else
 		qglDrawElements (GL_TRIANGLES, rb.numIndexes, GL_UNSIGNED_INT, rb.inIndices);
@@ -2406,6 +2424,88 @@ static inline void RB_ShowNormals (void)
 	qglEnd ();
 }
 
+/*
+===============================================================================
+
+	WORLD VERTEX BUFFERS
+
+===============================================================================
+*/
+
+/*
+=============
+RB_WorldVBOMaterial
+
+Only materials that never touch vertex data on the CPU can be drawn out of
+the world buffers: no deforms, base/lightmap coordinates and a flat color.
+=============
+*/
+qBool RB_WorldVBOMaterial (const material_t *mat)
+{
+	const matPass_t	*pass;
+	int				i;
+
+	if (!rb.worldVBO.vertexBuffer || !r_worldVBO->intVal)
+		return qFalse;
+	if (mat->numDeforms)
+		return qFalse;
+
+	for (i=0, pass=mat->passes ; i<mat->numPasses ; pass++, i++) {
+		if (!(pass->flags & MAT_PASS_NOCOLORARRAY))
+			return qFalse;
+		if (pass->tcGen != TC_GEN_BASE && pass->tcGen != TC_GEN_LIGHTMAP)
+			return qFalse;
+		if (pass->numTCMods && !rb_matrixCoords)
+			return qFalse;
+	}
+
+	return qTrue;
+}
+
+
+/*
+=============
+RB_MergeVBORanges
+
+Surfaces come in from the mesh list in whatever order they were sorted in, so
+put the ranges back in buffer order and join the ones that touch. Surfaces of
+the same material and lightmap are stored per cluster, so most of a visible
+cluster collapses into a single draw.
+=============
+*/
+static void RB_MergeVBORanges (void)
+{
+	rbVBORange_t	temp, *out, *in;
+	int				i, j;
+
+	if (rb.numVBORanges < 2)
+		return;
+
+	// Insertion sort, the list is short and mostly in order
+	for (i=1 ; i<rb.numVBORanges ; i++) {
+		temp = rb.vboRanges[i];
+		for (j=i ; j>0 && rb.vboRanges[j-1].firstIndex > temp.firstIndex ; j--)
+			rb.vboRanges[j] = rb.vboRanges[j-1];
+		rb.vboRanges[j] = temp;
+	}
+
+	// Join neighbors
+	out = rb.vboRanges;
+	for (i=1, in=rb.vboRanges+1 ; i<rb.numVBORanges ; i++, in++) {
+		if (out->firstIndex + out->numIndexes == in->firstIndex) {
+			out->numIndexes += in->numIndexes;
+			if (in->minVert < out->minVert)
+				out->minVert = in->minVert;
+			if (in->maxVert > out->maxVert)
+				out->maxVert = in->maxVert;
+			continue;
+		}
+
+		*++out = *in;
+	}
+	rb.numVBORanges = out - rb.vboRanges + 1;
+}
+
 /*
 ===============================================================================
 
@@ -2428,8 +2528,10 @@ void RB_RenderMeshBuffer (meshBuffer_t *mb, qBool shadowPass)
 	qBool			debugLightmap, addDlights;
 	int				i;
 
-	if (r_skipBackend->intVal)
+	if (r_skipBackend->intVal) {
+		RB_ResetPointers ();
 		return;
+	}
 
 	// Collect mesh buffer values
 	rb.curMeshType = mb->sortKey & (MBT_MAX-1);
@@ -2478,7 +2580,13 @@ void RB_RenderMeshBuffer (meshBuffer_t *mb, qBool shadowPass)
 	RB_SetupMaterialState (rb.curMat);
 
 	// Setup vertices
-	if (rb.curMat->numDeforms) {
+	if (rb.inWorldVBO) {
+		RB_MergeVBORanges ();
+		qglBindBufferARB (GL_ARRAY_BUFFER_ARB, rb.worldVBO.vertexBuffer);
+		qglBindBufferARB (GL_ELEMENT_ARRAY_BUFFER_ARB, rb.worldVBO.indexBuffer);
+		qglVertexPointer (3, GL_FLOAT, 0, rb.inVertices);
+	}
+	else if (rb.curMat->numDeforms) {
 		RB_DeformVertices ();
 		qglVertexPointer (3, GL_FLOAT, 0, rb_outVertexArray);
 	}
@@ -2489,7 +2597,9 @@ void RB_RenderMeshBuffer (meshBuffer_t *mb, qBool shadowPass)
 	if (!rb.numIndexes || shadowPass)
 		return;
 
-	RB_LockArrays (rb.numVerts);
+	// Compiled arrays don't buy anything once the data is on the card
+	if (!rb.inWorldVBO)
+		RB_LockArrays (rb.numVerts);
 
 	// Render outlines if desired
 	if (rb_triangleOutlines) {
@@ -2801,6 +2911,8 @@ void RB_Init (void)
 		rb_matrixCoords = qTrue;
 		break;
 	}
+
+	RB_BatchInit ();
 }
 
 
@@ -2811,4 +2923,5 @@ RB_Shutdown
 */
 void RB_Shutdown (void)
 {
+	RB_BatchShutdown ();
 }
@@ -102,6 +102,27 @@ static vec3_t	r_aliasMeshMins[MD3_MAX_MESHES];
 static vec3_t	r_aliasMeshMaxs[MD3_MAX_MESHES];
 static float	r_aliasMeshRadius[MD3_MAX_MESHES];
 
+#define ALIAS_LERP_STEPS	256
+#define ALIAS_POSE_HASH		256
+
+typedef struct mAliasPose_s {
+	mAliasMesh_t			*mesh;
+	int						frame;
+	int						oldFrame;
+	int						lerpStep;
+	float					backLerp;
+
+	vec3_t					*points;		// unit scale, relative to the frame translation
+	vec3_t					*normals;
+	vec3_t					*sVectors;
+	vec3_t					*tVectors;
+
+	struct mAliasPose_s		*hashNext;
+} mAliasPose_t;
+
+static mAliasPose_t	*r_aliasPoseHash[ALIAS_POSE_HASH];
+static uint32		r_aliasPoseFrame;
+
 /*
 ===============================================================================
 
@@ -173,6 +194,246 @@ static void R_BuildTangentVectors (int numVertexes, vec3_t *xyzArray, vec2_t *st
 }
 
 
+/*
+===============================================================================
+
+	POSE CACHE
+
+	Entities drawn with the same mesh, frame pair and backlerp share one
+	interpolated vertex set for the frame. Only the per-entity scale and
+	offset are applied on every draw.
+
+===============================================================================
+*/
+
+/*
+===============
+R_AliasLerpPoints
+
+The SSE2 path writes one float past the last vertex, pose arrays are padded
+for it.
+===============
+*/
+static void R_AliasLerpPoints (vec3_t *out, mAliasVertex_t *verts, mAliasVertex_t *oldVerts, int numVerts, vec3_t scale, vec3_t oldScale)
+{
+#ifdef R_SSE2
+	__m128	vScale, vOldScale, p;
+	__m128i	v;
+
+	// The fourth lane picks up latLong, the zero scale drops it
+	vScale = _mm_setr_ps (scale[0], scale[1], scale[2], 0);
+	if (!oldVerts) {
+		for ( ; numVerts>0 ; numVerts--, verts++, out++) {
+			v = _mm_loadl_epi64 ((const __m128i *)verts);
+			p = _mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16));
+			_mm_storeu_ps (out[0], _mm_mul_ps (p, vScale));
+		}
+		return;
+	}
+
+	vOldScale = _mm_setr_ps (oldScale[0], oldScale[1], oldScale[2], 0);
+	for ( ; numVerts>0 ; numVerts--, verts++, oldVerts++, out++) {
+		v = _mm_loadl_epi64 ((const __m128i *)verts);
+		p = _mm_mul_ps (_mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16)), vScale);
+
+		v = _mm_loadl_epi64 ((const __m128i *)oldVerts);
+		p = _mm_add_ps (p, _mm_mul_ps (_mm_cvtepi32_ps (_mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16)), vOldScale));
+
+		_mm_storeu_ps (out[0], p);
+	}
+#else
+	if (!oldVerts) {
+		for ( ; numVerts>0 ; numVerts--, verts++, out++) {
+			out[0][0] = verts->point[0]*scale[0];
+			out[0][1] = verts->point[1]*scale[1];
+			out[0][2] = verts->point[2]*scale[2];
+		}
+		return;
+	}
+
+	for ( ; numVerts>0 ; numVerts--, verts++, oldVerts++, out++) {
+		out[0][0] = verts->point[0]*scale[0] + oldVerts->point[0]*oldScale[0];
+		out[0][1] = verts->point[1]*scale[1] + oldVerts->point[1]*oldScale[1];
+		out[0][2] = verts->point[2]*scale[2] + oldVerts->point[2]*oldScale[2];
+	}
+#endif
+}
+
+
+/*
+===============
+R_AliasLerpNormals
+===============
+*/
+static void R_AliasLerpNormals (vec3_t *out, mAliasVertex_t *verts, mAliasVertex_t *oldVerts, int numVerts, float backLerp)
+{
+	vec3_t		normal, oldNormal;
+
+	if (!oldVerts) {
+		for ( ; numVerts>0 ; numVerts--, verts++, out++) {
+			out[0][0] = r_sinTable[verts->latLong[0]] * r_cosTable[verts->latLong[1]];
+			out[0][1] = r_sinTable[verts->latLong[0]] * r_sinTable[verts->latLong[1]];
+			out[0][2] = r_cosTable[verts->latLong[0]];
+		}
+		return;
+	}
+
+	for ( ; numVerts>0 ; numVerts--, verts++, oldVerts++, out++) {
+		normal[0] = r_sinTable[verts->latLong[0]] * r_cosTable[verts->latLong[1]];
+		normal[1] = r_sinTable[verts->latLong[0]] * r_sinTable[verts->latLong[1]];
+		normal[2] = r_cosTable[verts->latLong[0]];
+
+		oldNormal[0] = r_sinTable[oldVerts->latLong[0]] * r_cosTable[oldVerts->latLong[1]];
+		oldNormal[1] = r_sinTable[oldVerts->latLong[0]] * r_sinTable[oldVerts->latLong[1]];
+		oldNormal[2] = r_cosTable[oldVerts->latLong[0]];
+
+		out[0][0] = normal[0] + (oldNormal[0] - normal[0]) * backLerp;
+		out[0][1] = normal[1] + (oldNormal[1] - normal[1]) * backLerp;
+		out[0][2] = normal[2] + (oldNormal[2] - normal[2]) * backLerp;
+
+		VectorNormalizeFastf (out[0]);
+	}
+}
+
+
+/*
+===============
+R_AliasTransformPoints
+
+Places a pose for one entity. Four vertexes are twelve floats, so the SSE2
+path runs over them as three vectors with the offset rotated to match.
+===============
+*/
+static void R_AliasTransformPoints (vec3_t *out, vec3_t *in, int numVerts, float scale, vec3_t move)
+{
+	float	*o, *i;
+#ifdef R_SSE2
+	__m128	vScale, m0, m1, m2;
+#endif
+
+	o = out[0];
+	i = in[0];
+
+#ifdef R_SSE2
+	vScale = _mm_set1_ps (scale);
+	m0 = _mm_setr_ps (move[0], move[1], move[2], move[0]);
+	m1 = _mm_setr_ps (move[1], move[2], move[0], move[1]);
+	m2 = _mm_setr_ps (move[2], move[0], move[1], move[2]);
+	for ( ; numVerts>=4 ; numVerts-=4, o+=12, i+=12) {
+		_mm_storeu_ps (o, _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (i), vScale), m0));
+		_mm_storeu_ps (o+4, _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (i+4), vScale), m1));
+		_mm_storeu_ps (o+8, _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (i+8), vScale), m2));
+	}
+#endif
+	for ( ; numVerts>0 ; numVerts--, o+=3, i+=3) {
+		o[0] = move[0] + i[0]*scale;
+		o[1] = move[1] + i[1]*scale;
+		o[2] = move[2] + i[2]*scale;
+	}
+}
+
+
+/*
+===============
+R_AliasPose
+
+Finds or builds the interpolated pose for a mesh. Without caching the exact
+backlerp is used and the pose is thrown away after the draw.
+===============
+*/
+static mAliasPose_t *R_AliasPose (mAliasModel_t *model, mAliasMesh_t *aliasMesh, int frameNum, int oldFrameNum, float backLerp, qBool cache, qBool calcNormals, qBool calcSTVectors)
+{
+	mAliasFrame_t	*frame, *oldFrame;
+	mAliasVertex_t	*verts, *oldVerts;
+	mAliasPose_t	*pose;
+	vec3_t			scale, oldScale;
+	int				lerpStep;
+	uint32			hash;
+
+	// Last frame's poses are gone
+	if (r_aliasPoseFrame != ri.frameCount) {
+		r_aliasPoseFrame = ri.frameCount;
+		memset (r_aliasPoseHash, 0, sizeof (r_aliasPoseHash));
+		Mem_FreePool (ri.aliasPoseArena);
+	}
+
+	// Snap the backlerp so nearby entities land on the same key
+	lerpStep = (int)(backLerp * ALIAS_LERP_STEPS + 0.5f);
+	if (frameNum == oldFrameNum || lerpStep <= 0) {
+		oldFrameNum = frameNum;
+		lerpStep = 0;
+		backLerp = 0;
+	}
+	else if (cache) {
+		if (lerpStep > ALIAS_LERP_STEPS)
+			lerpStep = ALIAS_LERP_STEPS;
+		backLerp = (float)lerpStep / (float)ALIAS_LERP_STEPS;
+	}
+
+	// Look for it
+	hash = ((uint32)(size_t)aliasMesh >> 4) ^ (frameNum * 31) ^ (oldFrameNum * 131) ^ (lerpStep * 7);
+	hash &= ALIAS_POSE_HASH-1;
+	pose = NULL;
+	if (cache) {
+		for (pose=r_aliasPoseHash[hash] ; pose ; pose=pose->hashNext) {
+			if (pose->mesh == aliasMesh
+			&& pose->frame == frameNum
+			&& pose->oldFrame == oldFrameNum
+			&& pose->lerpStep == lerpStep)
+				break;
+		}
+	}
+
+	if (pose) {
+		if ((!calcNormals || pose->normals) && (!calcSTVectors || pose->sVectors)) {
+			ri.pc.aliasPoseHits++;
+			return pose;
+		}
+	}
+	else {
+		pose = Mem_PoolAlloc (sizeof (mAliasPose_t), ri.aliasPoseArena, 0);
+		pose->mesh = aliasMesh;
+		pose->frame = frameNum;
+		pose->oldFrame = oldFrameNum;
+		pose->lerpStep = lerpStep;
+		pose->backLerp = backLerp;
+		if (cache) {
+			pose->hashNext = r_aliasPoseHash[hash];
+			r_aliasPoseHash[hash] = pose;
+		}
+	}
+	ri.pc.aliasPoses++;
+
+	frame = model->frames + frameNum;
+	oldFrame = model->frames + oldFrameNum;
+	verts = aliasMesh->vertexes + (frameNum * aliasMesh->numVerts);
+	oldVerts = (lerpStep) ? aliasMesh->vertexes + (oldFrameNum * aliasMesh->numVerts) : NULL;
+
+	// Store vertexes
+	if (!pose->points) {
+		pose->points = Mem_PoolAlloc (sizeof (vec3_t) * (aliasMesh->numVerts + 1), ri.aliasPoseArena, 0);
+
+		Vec3Scale (frame->scale, 1.0f - backLerp, scale);
+		Vec3Scale (oldFrame->scale, backLerp, oldScale);
+		R_AliasLerpPoints (pose->points, verts, oldVerts, aliasMesh->numVerts, scale, oldScale);
+	}
+
+	// Calculate normals
+	if (calcNormals && !pose->normals) {
+		pose->normals = Mem_PoolAlloc (sizeof (vec3_t) * aliasMesh->numVerts, ri.aliasPoseArena, 0);
+		R_AliasLerpNormals (pose->normals, verts, oldVerts, aliasMesh->numVerts, backLerp);
+	}
+
+	// Build stVectors, scale and offset don't change them
+	if (calcSTVectors && !pose->sVectors) {
+		pose->sVectors = Mem_PoolAlloc (sizeof (vec3_t) * aliasMesh->numVerts, ri.aliasPoseArena, 0);
+		pose->tVectors = Mem_PoolAlloc (sizeof (vec3_t) * aliasMesh->numVerts, ri.aliasPoseArena, 0);
+		R_BuildTangentVectors (aliasMesh->numVerts, pose->points, aliasMesh->coords, aliasMesh->numTris, aliasMesh->indexes, pose->sVectors, pose->tVectors);
+	}
+
+	return pose;
+}
+
 /*
 =============
 R_AliasModelBBox
@@ -400,14 +661,12 @@ R_DrawAliasModel
 void R_DrawAliasModel (meshBuffer_t *mb, qBool shadowPass)
 {
 	mAliasModel_t	*model;
-	mAliasVertex_t	*verts, *oldVerts;
 	mAliasMesh_t	*aliasMesh;
 	mAliasFrame_t	*frame, *oldFrame;
+	mAliasPose_t	*pose;
 	vec3_t			move, delta;
-	vec3_t			oldScale, scale;
-	float			frontLerp, backLerp;
+	float			backLerp;
 	vec3_t			shadowSpot;
-	int				i;
 	qBool			calcNormals;
 	qBool			calcSTVectors;
 	mesh_t			mesh;
@@ -450,20 +709,6 @@ void R_DrawAliasModel (meshBuffer_t *mb, qBool shadowPass)
 	if (ent->flags & RF_CULLHACK)
 		qglFrontFace (GL_CW);
 
-	// Interpolation calculations
-	backLerp = ent->backLerp;
-	if (!r_lerpmodels->intVal || mb->mat->flags & MAT_NOLERP)
-		backLerp = 0;
-	frontLerp = 1.0f - backLerp;
-
-	Vec3Subtract (ent->oldOrigin, ent->origin, delta);
-	Matrix3_TransformVector (ent->axis, delta, move);
-	Vec3Add (move, oldFrame->translate, move);
-
-	move[0] = frame->translate[0] + (move[0] - frame->translate[0]) * backLerp;
-	move[1] = frame->translate[1] + (move[1] - frame->translate[1]) * backLerp;
-	move[2] = frame->translate[2] + (move[2] - frame->translate[2]) * backLerp;
-
 	// Mesh features
 	features = MF_NONBATCHED | mb->mat->features;
 	if (mb->mat->features & MAT_AUTOSPRITE)
@@ -486,78 +731,30 @@ void R_DrawAliasModel (meshBuffer_t *mb, qBool shadowPass)
 		calcSTVectors = (features & MF_STVECTORS);
 	}
 
-	// Optimal route
-	if (ent->frame == ent->oldFrame) {
-		scale[0] = frame->scale[0] * ent->scale;
-		scale[1] = frame->scale[1] * ent->scale;
-		scale[2] = frame->scale[2] * ent->scale;
-
-		// Store vertexes
-		verts = aliasMesh->vertexes + (ent->frame * aliasMesh->numVerts);
-		for (i=0 ; i<aliasMesh->numVerts ; i++, verts++) {
-			rb.batch.vertices[i][0] = move[0] + verts->point[0]*scale[0];
-			rb.batch.vertices[i][1] = move[1] + verts->point[1]*scale[1];
-			rb.batch.vertices[i][2] = move[2] + verts->point[2]*scale[2];
-		}
-
-		// Calculate normals
-		if (calcNormals) {
-			verts = aliasMesh->vertexes + (ent->frame * aliasMesh->numVerts);
-			for (i=0 ; i<aliasMesh->numVerts ; i++, verts++) {
-				rb.batch.normals[i][0] = r_sinTable[verts->latLong[0]] * r_cosTable[verts->latLong[1]];
-				rb.batch.normals[i][1] = r_sinTable[verts->latLong[0]] * r_sinTable[verts->latLong[1]];
-				rb.batch.normals[i][2] = r_cosTable[verts->latLong[0]];
-			}
-		}
-	}
-	else {
-		verts = aliasMesh->vertexes + (ent->frame * aliasMesh->numVerts);
-		oldVerts = aliasMesh->vertexes + (ent->oldFrame * aliasMesh->numVerts);
-
-		scale[0] = (frontLerp * frame->scale[0]) * ent->scale;
-		scale[1] = (frontLerp * frame->scale[1]) * ent->scale;
-		scale[2] = (frontLerp * frame->scale[2]) * ent->scale;
-
-		oldScale[0] = (backLerp * oldFrame->scale[0]) * ent->scale;
-		oldScale[1] = (backLerp * oldFrame->scale[1]) * ent->scale;
-		oldScale[2] = (backLerp * oldFrame->scale[2]) * ent->scale;
-
-		// Store vertexes
-		for (i=0 ; i<aliasMesh->numVerts ; i++, verts++, oldVerts++) {
-			rb.batch.vertices[i][0] = move[0] + verts->point[0]*scale[0] + oldVerts->point[0]*oldScale[0];
-			rb.batch.vertices[i][1] = move[1] + verts->point[1]*scale[1] + oldVerts->point[1]*oldScale[1];
-			rb.batch.vertices[i][2] = move[2] + verts->point[2]*scale[2] + oldVerts->point[2]*oldScale[2];
-		}
-
-		// Calculate normals
-		if (calcNormals) {
-			vec3_t		normal, oldNormal;
+	// Interpolate, or pick up a pose another entity already built
+	backLerp = ent->backLerp;
+	if (!r_lerpmodels->intVal || mb->mat->flags & MAT_NOLERP)
+		backLerp = 0;
 
-			verts = aliasMesh->vertexes + (ent->frame * aliasMesh->numVerts);
-			oldVerts = aliasMesh->vertexes + (ent->oldFrame * aliasMesh->numVerts);
-			for (i=0 ; i<aliasMesh->numVerts ; i++, verts++, oldVerts++) {
-				normal[0] = r_sinTable[verts->latLong[0]] * r_cosTable[verts->latLong[1]];
-				normal[1] = r_sinTable[verts->latLong[0]] * r_sinTable[verts->latLong[1]];
-				normal[2] = r_cosTable[verts->latLong[0]];
+	pose = R_AliasPose (model, aliasMesh, ent->frame, ent->oldFrame, backLerp,
+		(r_lerpCache->intVal && ent->scale > 0), calcNormals, calcSTVectors);
+	if (pose->lerpStep)
+		backLerp = pose->backLerp;
 
-				oldNormal[0] = r_sinTable[oldVerts->latLong[0]] * r_cosTable[oldVerts->latLong[1]];
-				oldNormal[1] = r_sinTable[oldVerts->latLong[0]] * r_sinTable[oldVerts->latLong[1]];
-				oldNormal[2] = r_cosTable[oldVerts->latLong[0]];
+	Vec3Subtract (ent->oldOrigin, ent->origin, delta);
+	Matrix3_TransformVector (ent->axis, delta, move);
+	Vec3Add (move, oldFrame->translate, move);
 
-				rb.batch.normals[i][0] = normal[0] + (oldNormal[0] - normal[0]) * backLerp;
-				rb.batch.normals[i][1] = normal[1] + (oldNormal[1] - normal[1]) * backLerp;
-				rb.batch.normals[i][2] = normal[2] + (oldNormal[2] - normal[2]) * backLerp;
+	move[0] = frame->translate[0] + (move[0] - frame->translate[0]) * backLerp;
+	move[1] = frame->translate[1] + (move[1] - frame->translate[1]) * backLerp;
+	move[2] = frame->translate[2] + (move[2] - frame->translate[2]) * backLerp;
 
-				VectorNormalizeFastf (rb.batch.normals[i]);
-			}
-		}
-	}
+	// Store vertexes
+	R_AliasTransformPoints (rb.batch.vertices, pose->points, aliasMesh->numVerts, ent->scale, move);
 
-	// Build stVectors
 	if (calcSTVectors) {
-		R_BuildTangentVectors (aliasMesh->numVerts, rb.batch.vertices, aliasMesh->coords, aliasMesh->numTris, aliasMesh->indexes, rb.batch.sVectors, rb.batch.tVectors);
-		mesh.sVectorsArray = rb.batch.sVectors;
-		mesh.tVectorsArray = rb.batch.tVectors;
+		mesh.sVectorsArray = pose->sVectors;
+		mesh.tVectorsArray = pose->tVectors;
 	}
 	else {
 		mesh.sVectorsArray = NULL;
@@ -572,7 +769,7 @@ void R_DrawAliasModel (meshBuffer_t *mb, qBool shadowPass)
 	mesh.coordArray = aliasMesh->coords;
 	mesh.indexArray = aliasMesh->indexes;
 	mesh.lmCoordArray = NULL;
-	mesh.normalsArray = rb.batch.normals;
+	mesh.normalsArray = (calcNormals) ? pose->normals : rb.batch.normals;
 #ifdef SHADOW_VOLUMES
 	mesh.trNeighborsArray = aliasMesh->neighbors;
 	mesh.trNormalsArray = NULL;
@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 //
 
 #include "rf_local.h"
+#include <setjmp.h>
 
 #ifdef _WIN32
 # include "../include/jpeg/jpeglib.h"
@@ -240,12 +241,20 @@ static void jpg_noop(j_decompress_ptr cinfo)
 {
 }
 
+typedef struct jpgError_s {
+	struct jpeg_error_mgr	pub;
+	jmp_buf					setjmpBuffer;
+} jpgError_t;
+
+// Images can be decoded on the job workers, so bad files can't take the engine down
 static void jpeg_d_error_exit (j_common_ptr cinfo)
 {
-	char msg[1024];
+	jpgError_t	*err = (jpgError_t *)cinfo->err;
+	char		msg[JMSG_LENGTH_MAX];
 
 	(cinfo->err->format_message)(cinfo, msg);
-	Com_Error (ERR_FATAL, "R_LoadJPG: JPEG Lib Error: '%s'", msg);
+	Com_Printf (PRNT_WARNING, "R_LoadJPG: JPEG Lib Error: '%s'\n", msg);
+	longjmp (err->setjmpBuffer, 1);
 }
 
 static boolean jpg_fill_input_buffer (j_decompress_ptr cinfo)
@@ -271,8 +280,10 @@ ala Vic
 static void R_LoadJPG (char *name, byte **pic, int *width, int *height)
 {
     int		fileLen, components;
-    byte	*img, *scan, *buffer, *dummy;
-    struct	jpeg_error_mgr			jerr;
+    byte	*img, *scan, *buffer;
+	byte	*volatile imgBase = NULL;
+	byte	*volatile dummy = NULL;
+    jpgError_t						jerr;
     struct	jpeg_decompress_struct	cinfo;
 	uint32	i;
 
@@ -285,10 +296,21 @@ static void R_LoadJPG (char *name, byte **pic, int *width, int *height)
 		return;
 
 	// Parse the file
-	cinfo.err = jpeg_std_error (&jerr);
-	jerr.error_exit = jpeg_d_error_exit;
+	cinfo.err = jpeg_std_error (&jerr.pub);
+	jerr.pub.error_exit = jpeg_d_error_exit;
 
 	jpeg_create_decompress (&cinfo);
+	if (setjmp (jerr.setjmpBuffer)) {
+		jpeg_destroy_decompress (&cinfo);
+		if (imgBase)
+			Mem_Free (imgBase);
+		if (dummy)
+			Mem_Free (dummy);
+		if (pic)
+			*pic = NULL;
+		FS_FreeFile (buffer);
+		return;
+	}
 
 	jpeg_mem_src (&cinfo, buffer, fileLen);
 	jpeg_read_header (&cinfo, TRUE);
@@ -315,7 +337,7 @@ static void R_LoadJPG (char *name, byte **pic, int *width, int *height)
 	if (height)
 		*height = cinfo.output_height;
 
-	img = Mem_PoolAlloc (cinfo.output_width * cinfo.output_height * 4, ri.imageSysPool, r_imageAllocTag);
+	img = imgBase = Mem_PoolAlloc (cinfo.output_width * cinfo.output_height * 4, ri.imageSysPool, r_imageAllocTag);
 	dummy = Mem_PoolAlloc (cinfo.output_width * components, ri.imageSysPool, r_imageAllocTag);
 
 	if (pic)
@@ -407,8 +429,8 @@ R_LoadPCX
 */
 static void R_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *height)
 {
-	byte		*raw;
-	pcxHeader_t	*pcx;
+	byte		*buffer, *raw;
+	pcxHeader_t	*pcx, header;
 	int			x, y, fileLen;
 	int			dataByte, runLength;
 	byte		*out, *pix;
@@ -419,12 +441,13 @@ static void R_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *
 		*palette = NULL;
 
 	// Load the file
-	fileLen = FS_LoadFile (name, (void **)&raw, NULL);
-	if (!raw || fileLen <= 0)
+	fileLen = FS_LoadFile (name, (void **)&buffer, NULL);
+	if (!buffer || fileLen <= 0)
 		return;
 
-	// Parse the PCX file
-	pcx = (pcxHeader_t *)raw;
+	// Parse the PCX file, swapping a copy since the buffer may be a read-only pack view
+	header = *(pcxHeader_t *)buffer;
+	pcx = &header;
 
 	pcx->xMin = LittleShort (pcx->xMin);
 	pcx->yMin = LittleShort (pcx->yMin);
@@ -435,7 +458,7 @@ static void R_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *
 	pcx->bytesPerLine = LittleShort (pcx->bytesPerLine);
 	pcx->paletteType = LittleShort (pcx->paletteType);
 
-	raw = &pcx->data;
+	raw = &((pcxHeader_t *)buffer)->data;
 
 	// Sanity checks
 	if (pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1) {
@@ -461,7 +484,7 @@ static void R_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *
 
 	if (palette) {
 		*palette = Mem_PoolAlloc (768, ri.imageSysPool, r_imageAllocTag);
-		memcpy (*palette, (byte *)pcx + fileLen - 768, 768);
+		memcpy (*palette, buffer + fileLen - 768, 768);
 	}
 
 	if (width)
@@ -485,7 +508,7 @@ static void R_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *
 		}
 	}
 
-	if (raw - (byte *)pcx > fileLen) {
+	if (raw - buffer > fileLen) {
 		Com_DevPrintf (PRNT_WARNING, "R_LoadPCX: %s: PCX file was malformed", name);
 		Mem_Free (out);
 		out = NULL;
@@ -501,7 +524,7 @@ static void R_LoadPCX (char *name, byte **pic, byte **palette, int *width, int *
 
 	if (!pic)
 		Mem_Free (out);
-	FS_FreeFile (pcx);
+	FS_FreeFile (buffer);
 }
 
 /*
@@ -970,7 +993,7 @@ R_LoadWal
 */
 static void R_LoadWal (char *name, byte **pic, int *width, int *height)
 {
-	walTex_t	*mt;
+	walTex_t	*mt, header;
 	byte		*buffer, *out;
 	int			fileLen;
 	uint32		i;
@@ -980,8 +1003,9 @@ static void R_LoadWal (char *name, byte **pic, int *width, int *height)
 	if (!buffer || fileLen <= 0)
 		return;
 
-	// Parse the WAL file
-	mt = (walTex_t *)buffer;
+	// Parse the WAL file, swapping a copy since the buffer may be a read-only pack view
+	header = *(walTex_t *)buffer;
+	mt = &header;
 
 	mt->width = LittleLong (mt->width);
 	mt->height = LittleLong (mt->height);
@@ -2125,6 +2149,221 @@ static inline image_t *R_RegisterCubeMap (char *name, texFlags_t flags)
 }
 
 
+/*
+==============================================================================
+
+	BACKGROUND DECODING
+
+	Images named ahead of registration are decoded on the job workers, so
+	R_RegisterImage only has to upload them.
+==============================================================================
+*/
+
+#define MAX_IMAGE_PREFETCH		1024
+#define IMAGE_PREFETCH_HASHSIZE	256
+
+typedef struct imgPrefetch_s {
+	char					bareName[MAX_QPATH];
+	qBool					tryWal;
+	qBool					taken;
+
+	// Decoded result
+	char					loadName[MAX_QPATH];
+	byte					*pic;
+	int						width;
+	int						height;
+	int						samples;
+	qBool					upload8;
+	qBool					isPCX;
+
+	jobList_t				job;
+	struct imgPrefetch_s	*hashNext;
+} imgPrefetch_t;
+
+static imgPrefetch_t	r_imagePrefetch[MAX_IMAGE_PREFETCH];
+static imgPrefetch_t	*r_imagePrefetchHashTree[IMAGE_PREFETCH_HASHSIZE];
+static uint32			r_numImagePrefetch;
+
+/*
+===============
+R_DecodeImage
+
+Finds the pic on disk and decodes it, trying each supported format in turn.
+Safe to call from the job workers.
+===============
+*/
+static void R_DecodeImage (const char *bareName, qBool tryWal, char *loadName, byte **pic, int *width, int *height, int *samples, qBool *upload8, qBool *isPCX)
+{
+	size_t	len;
+
+	*pic = NULL;
+	*upload8 = qFalse;
+	*isPCX = qFalse;
+
+	Q_snprintfz (loadName, MAX_QPATH, "%s.png", bareName);
+	len = strlen(loadName);
+
+	// PNG
+	R_LoadPNG (loadName, pic, width, height, samples);
+	if (*pic)
+		return;
+
+	// TGA
+	loadName[len-3] = 't'; loadName[len-2] = 'g'; loadName[len-1] = 'a';
+	R_LoadTGA (loadName, pic, width, height, samples);
+	if (*pic)
+		return;
+
+	// JPG
+	*samples = 3;
+	loadName[len-3] = 'j'; loadName[len-2] = 'p'; loadName[len-1] = 'g';
+	R_LoadJPG (loadName, pic, width, height);
+	if (*pic)
+		return;
+
+	// WAL
+	*upload8 = qTrue;
+	if (tryWal) {
+		loadName[len-3] = 'w'; loadName[len-2] = 'a'; loadName[len-1] = 'l';
+		R_LoadWal (loadName, pic, width, height);
+		return;
+	}
+
+	// PCX
+	*isPCX = qTrue;
+	loadName[len-3] = 'p'; loadName[len-2] = 'c'; loadName[len-1] = 'x';
+	R_LoadPCX (loadName, pic, NULL, width, height);
+}
+
+
+/*
+===============
+R_DecodeImageJob
+===============
+*/
+static void R_DecodeImageJob (void *arg)
+{
+	imgPrefetch_t	*entry = (imgPrefetch_t *)arg;
+
+	R_DecodeImage (entry->bareName, entry->tryWal, entry->loadName, &entry->pic, &entry->width, &entry->height, &entry->samples, &entry->upload8, &entry->isPCX);
+}
+
+
+/*
+===============
+R_PrefetchImage
+
+Starts decoding an image that is about to be registered.
+===============
+*/
+void R_PrefetchImage (char *name)
+{
+	imgPrefetch_t	*entry;
+	const char		*bareName;
+	size_t			len;
+	uint32			hash;
+
+	if (!name)
+		return;
+	len = strlen (name);
+	if (len < 5 || len+1 >= MAX_QPATH)
+		return;
+	if (r_numImagePrefetch >= MAX_IMAGE_PREFETCH)
+		return;
+
+	bareName = R_BareImageName (name);
+
+	// Already loaded, or on the way
+	if (R_FindImage (bareName, 0))
+		return;
+
+	hash = Com_HashGeneric (bareName, IMAGE_PREFETCH_HASHSIZE);
+	for (entry=r_imagePrefetchHashTree[hash] ; entry ; entry=entry->hashNext) {
+		if (!strcmp (entry->bareName, bareName))
+			return;
+	}
+
+	entry = &r_imagePrefetch[r_numImagePrefetch++];
+	Q_strncpyz (entry->bareName, bareName, sizeof (entry->bareName));
+	entry->tryWal = !strcmp (name+len-4, ".wal") ? qTrue : qFalse;
+	entry->taken = qFalse;
+	entry->pic = NULL;
+	entry->job.numPending = 0;
+	entry->hashNext = r_imagePrefetchHashTree[hash];
+	r_imagePrefetchHashTree[hash] = entry;
+
+	Job_Add (&entry->job, R_DecodeImageJob, entry);
+}
+
+
+/*
+===============
+R_TakePrefetchedImage
+
+Hands over a decoded pic if it was found the same way R_DecodeImage would find it now.
+===============
+*/
+static qBool R_TakePrefetchedImage (const char *bareName, qBool tryWal, char *loadName, byte **pic, int *width, int *height, int *samples, qBool *upload8, qBool *isPCX)
+{
+	imgPrefetch_t	*entry;
+	uint32			hash;
+
+	if (!r_numImagePrefetch)
+		return qFalse;
+
+	hash = Com_HashGeneric (bareName, IMAGE_PREFETCH_HASHSIZE);
+	for (entry=r_imagePrefetchHashTree[hash] ; entry ; entry=entry->hashNext) {
+		if (!strcmp (entry->bareName, bareName))
+			break;
+	}
+	if (!entry || entry->taken)
+		return qFalse;
+
+	Job_Wait (&entry->job);
+
+	// Misses are retried, the file may have been downloaded since.
+	// Paletted results depend on whether a .wal was asked for.
+	if (!entry->pic || (entry->upload8 && entry->tryWal != tryWal))
+		return qFalse;
+
+	entry->taken = qTrue;
+	ri.reg.imagesPrefetched++;
+
+	Q_strncpyz (loadName, entry->loadName, MAX_QPATH);
+	*pic = entry->pic;
+	*width = entry->width;
+	*height = entry->height;
+	*samples = entry->samples;
+	*upload8 = entry->upload8;
+	*isPCX = entry->isPCX;
+	return qTrue;
+}
+
+
+/*
+===============
+R_FlushImagePrefetch
+
+Waits for the workers and frees anything that was never registered.
+===============
+*/
+static void R_FlushImagePrefetch (void)
+{
+	imgPrefetch_t	*entry;
+	uint32			i;
+
+	for (i=0, entry=r_imagePrefetch ; i<r_numImagePrefetch ; i++, entry++) {
+		Job_Wait (&entry->job);
+		if (!entry->taken && entry->pic)
+			Mem_Free (entry->pic);
+	}
+
+	r_numImagePrefetch = 0;
+	memset (r_imagePrefetchHashTree, 0, sizeof (r_imagePrefetchHashTree));
+}
+
+// ==========================================================================
+
 /*
 ===============
 R_RegisterImage
@@ -2138,6 +2377,7 @@ image_t	*R_RegisterImage (char *name, texFlags_t flags)
 	byte		*pic;
 	size_t		len;
 	int			width, height, samples;
+	qBool		tryWal, upload8, isPCX;
 	char		loadName[MAX_QPATH];
 	const char	*bareName;
 
@@ -2173,47 +2413,15 @@ image_t	*R_RegisterImage (char *name, texFlags_t flags)
 		return image;
 	}
 
-	// Not found -- load the pic from disk
-	Q_snprintfz (loadName, sizeof (loadName), "%s.png", bareName);
-	len = strlen(loadName);
-
-	// PNG
-	R_LoadPNG (loadName, &pic, &width, &height, &samples);
-	if (!pic) {
-		// TGA
-		loadName[len-3] = 't'; loadName[len-2] = 'g'; loadName[len-1] = 'a';
-		R_LoadTGA (loadName, &pic, &width, &height, &samples);
-		if (!pic) {
-			// JPG
-			samples = 3;
-			loadName[len-3] = 'j'; loadName[len-2] = 'p'; loadName[len-1] = 'g';
-			R_LoadJPG (loadName, &pic, &width, &height);
-			if (!pic) {
-				// WAL
-				if (!(strcmp (name+len-4, ".wal"))) {
-					loadName[len-3] = 'w'; loadName[len-2] = 'a'; loadName[len-1] = 'l';
-					R_LoadWal (loadName, &pic, &width, &height);
-					if (pic) {
-						image = R_LoadImage (loadName, bareName, &pic, width, height, 1, flags, samples, qTrue, qFalse);
-						return image;
-					}
-					return NULL;
-				}
-
-				// PCX
-				loadName[len-3] = 'p'; loadName[len-2] = 'c'; loadName[len-1] = 'x';
-				R_LoadPCX (loadName, &pic, NULL, &width, &height);
-				if (pic) {
-					image = R_LoadImage (loadName, bareName, &pic, width, height, 1, flags, samples, qTrue, qTrue);
-					return image;
-				}
-				return NULL;
-			}
-		}
-	}
+	// Not found -- use the background decode, or load the pic from disk
+	tryWal = !strcmp (name+len-4, ".wal") ? qTrue : qFalse;
+	if (!R_TakePrefetchedImage (bareName, tryWal, loadName, &pic, &width, &height, &samples, &upload8, &isPCX))
+		R_DecodeImage (bareName, tryWal, loadName, &pic, &width, &height, &samples, &upload8, &isPCX);
+	if (!pic)
+		return NULL;
 
 	// Found it, upload it
-	image = R_LoadImage (loadName, bareName, &pic, width, height, 1, flags, samples, qFalse, qFalse);
+	image = R_LoadImage (loadName, bareName, &pic, width, height, 1, flags, samples, upload8, isPCX);
 
 	// Finish
 	if (pic)
@@ -2286,6 +2494,9 @@ void R_EndImageRegistration (void)
 	image_t	*image;
 	uint32	i;
 
+	// Release decodes that were never asked for
+	R_FlushImagePrefetch ();
+
 	// Free the scratch
 	Mem_FreeTag (ri.imageSysPool, IMGTAG_REG);
 	r_palScratch = NULL;
@@ -91,11 +91,13 @@ cVar_t	*r_flareSize;
 cVar_t	*r_fontScale;
 cVar_t	*r_fullbright;
 cVar_t	*r_hwGamma;
+cVar_t	*r_lerpCache;
 cVar_t	*r_lerpmodels;
 cVar_t	*r_lightlevel;
 cVar_t	*r_lmMaxBlockSize;
 cVar_t	*r_lmModulate;
 cVar_t	*r_lmPacking;
+cVar_t	*r_modelCache;
 cVar_t	*r_noCull;
 cVar_t	*r_noRefresh;
 cVar_t	*r_noVis;
@@ -110,6 +112,7 @@ cVar_t	*r_swapInterval;
 cVar_t	*r_textureBits;
 cVar_t	*r_times;
 cVar_t	*r_vertexLighting;
+cVar_t	*r_worldVBO;
 cVar_t	*r_zFarAbs;
 cVar_t	*r_zFarMin;
 cVar_t	*r_zNear;
@@ -1207,11 +1210,13 @@ static void R_Register (void)
 	r_fontScale			= Cvar_Register ("r_fontScale",			"1",			CVAR_ARCHIVE);
 	r_fullbright		= Cvar_Register ("r_fullbright",		"0",			CVAR_CHEAT);
 	r_hwGamma			= Cvar_Register ("r_hwGamma",			"0",			CVAR_ARCHIVE|CVAR_LATCH_VIDEO);
+	r_lerpCache			= Cvar_Register ("r_lerpCache",			"1",			0);
 	r_lerpmodels		= Cvar_Register ("r_lerpmodels",		"1",			0);
 	r_lightlevel		= Cvar_Register ("r_lightlevel",		"0",			0);
 	r_lmMaxBlockSize	= Cvar_Register ("r_lmMaxBlockSize",	"4096",			CVAR_ARCHIVE|CVAR_LATCH_VIDEO);
 	r_lmModulate		= Cvar_Register ("r_lmModulate",		"2",			CVAR_ARCHIVE|CVAR_LATCH_VIDEO);
 	r_lmPacking			= Cvar_Register ("r_lmPacking",			"1",			CVAR_ARCHIVE|CVAR_LATCH_VIDEO);
+	r_modelCache		= Cvar_Register ("r_modelCache",		"1",			CVAR_ARCHIVE);
 	r_noCull			= Cvar_Register ("r_noCull",			"0",			0);
 	r_noRefresh			= Cvar_Register ("r_noRefresh",			"0",			0);
 	r_noVis				= Cvar_Register ("r_noVis",				"0",			0);
@@ -1226,6 +1231,7 @@ static void R_Register (void)
 	r_textureBits		= Cvar_Register ("r_textureBits",		"default",		CVAR_ARCHIVE|CVAR_LATCH_VIDEO);
 	r_times				= Cvar_Register ("r_times",				"0",			0);
 	r_vertexLighting	= Cvar_Register ("r_vertexLighting",	"0",			CVAR_ARCHIVE|CVAR_LATCH_VIDEO);
+	r_worldVBO			= Cvar_Register ("r_worldVBO",			"1",			CVAR_ARCHIVE);
 	r_zFarAbs			= Cvar_Register ("r_zFarAbs",			"0",			CVAR_CHEAT);
 	r_zFarMin			= Cvar_Register ("r_zFarMin",			"256",			CVAR_CHEAT);
 	r_zNear				= Cvar_Register ("r_zNear",				"4",			CVAR_CHEAT);
@@ -1329,7 +1335,8 @@ rInit_t R_Init (void)
 	ri.cStencilBits = 0;
 
 	// Create memory pools
-	ri.decalSysPool = Mem_CreatePool ("Refresh: Decal system");
+	ri.aliasPoseArena = Mem_CreateArena ("Refresh: Alias poses", 262144);
+	ri.decalSysPool = Mem_CreateSlabPool ("Refresh: Decal system", 4096);
 	ri.fontSysPool = Mem_CreatePool ("Refresh: Font system");
 	ri.genericPool = Mem_CreatePool ("Refresh: Generic");
 	ri.imageSysPool = Mem_CreatePool ("Refresh: Image system");
@@ -1501,6 +1508,31 @@ rInit_t R_Init (void)
 }
 
 
+/*
+===============
+R_HeadlessInit
+
+There's no window or context with cl_headless, so only the pieces that run
+without one are brought up. Those are the CPU side benchmarks.
+===============
+*/
+void R_HeadlessInit (void)
+{
+	RB_BatchInit ();
+}
+
+
+/*
+===============
+R_HeadlessShutdown
+===============
+*/
+void R_HeadlessShutdown (void)
+{
+	RB_BatchShutdown ();
+}
+
+
 /*
 ===============
 R_Shutdown
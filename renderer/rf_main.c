@@ -433,6 +433,10 @@ void R_EndFrame (void)
 			Com_Printf (0, "\n");
 			Com_Printf (0, "%3u add %3u sort %3u draw\n",
 				ri.pc.timeAddToList, ri.pc.timeSortList, ri.pc.timeDrawList);
+			Com_Printf (0, "%5uus sort %5u mesh %2u pass\n",
+				ri.pc.timeSortListMicro, ri.pc.sortedMeshes, ri.pc.sortPasses);
+			Com_Printf (0, "%4u pose %4u posehit\n",
+				ri.pc.aliasPoses, ri.pc.aliasPoseHits);
 
 			if (ri.scn.worldModel->touchFrame && !(ri.def.rdFlags & RDF_NOWORLDMODEL)) {
 				Com_Printf (0, "%3u marklv %3u marklt %3u recurs\n",
@@ -729,6 +733,7 @@ void R_BeginRegistration (void)
 	ri.reg.fontsReleased = 0;
 	ri.reg.fontsSeaked = 0;
 	ri.reg.fontsTouched = 0;
+	ri.reg.imagesPrefetched = 0;
 	ri.reg.imagesReleased = 0;
 	ri.reg.imagesResampled = 0;
 	ri.reg.imagesSeaked = 0;
@@ -769,5 +774,5 @@ void R_EndRegistration (void)
 	Com_Printf (PRNT_CONSOLE, "Fonts      rel/touch/seak: %i/%i/%i\n", ri.reg.fontsReleased, ri.reg.fontsTouched, ri.reg.fontsSeaked);
 	Com_Printf (PRNT_CONSOLE, "Models     rel/touch/seak: %i/%i/%i\n", ri.reg.modelsReleased, ri.reg.modelsTouched, ri.reg.modelsSeaked);
 	Com_Printf (PRNT_CONSOLE, "Materials  rel/touch/seak: %i/%i/%i\n", ri.reg.matsReleased, ri.reg.matsTouched, ri.reg.matsSeaked);
-	Com_Printf (PRNT_CONSOLE, "Images     rel/resamp/seak/touch: %i/%i/%i/%i\n", ri.reg.imagesReleased, ri.reg.imagesResampled, ri.reg.imagesSeaked, ri.reg.imagesTouched);
+	Com_Printf (PRNT_CONSOLE, "Images     rel/resamp/seak/touch/prefetch: %i/%i/%i/%i/%i\n", ri.reg.imagesReleased, ri.reg.imagesResampled, ri.reg.imagesSeaked, ri.reg.imagesTouched, ri.reg.imagesPrefetched);
 }
@@ -23,8 +23,6 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include "rf_local.h"
 
-#define 	QSORT_MAX_STACKDEPTH	4096
-
 meshList_t	r_portalList;
 meshList_t	r_worldList;
 meshList_t	*r_currentList;
@@ -133,82 +131,82 @@ meshBuffer_t *R_AddMeshToList (material_t *mat, float matTime, refEntity_t *ent,
 
 /*
 ================
-R_QSortMeshBuffers
+R_RSortMeshBuffers
 
-Quicksort
+Stable LSD radix sort, 8 bits of the key per pass. Only keys and indexes move
+during the passes, the mesh buffers themselves are moved once at the end.
+Digits that are the same across the whole list (usually most of the upper
+key bits) are skipped, and a list that's already in order is left alone.
 ================
 */
-static void R_QSortMeshBuffers (meshBuffer_t *meshes, int Li, int Ri)
-{
-	int		li, ri, stackDepth, total;
-	meshBuffer_t median, tempbuf;
-	static int	localStack[QSORT_MAX_STACKDEPTH];
-
-	stackDepth = 0;
-	total = Ri + 1;
-
-mark0:
-	if (Ri - Li < 48) {
-		li = Li;
-		ri = Ri;
+static uint32		r_sortKeys[2][MAX_MESH_BUFFER];
+static uint16		r_sortIndexes[2][MAX_MESH_BUFFER];
+static meshBuffer_t	r_sortScratch[MAX_MESH_BUFFER];
 
-		R_MBCopy (meshes[(Li+Ri) >> 1], median);
-
-		if (meshes[Li].sortKey > median.sortKey) {
-			if (meshes[Ri].sortKey > meshes[Li].sortKey) 
-				R_MBCopy (meshes[Li], median);
-		}
-		else if (median.sortKey > meshes[Ri].sortKey) {
-			R_MBCopy (meshes[Ri], median);
-		}
+static void R_RSortMeshBuffers (meshBuffer_t *meshes, int numMeshes)
+{
+	uint32	counts[4][256];
+	uint32	key, prevKey, offset, count;
+	int		i, pass, shift, src;
+	qBool	sorted;
 
-		while (li < ri) {
-			while (median.sortKey > meshes[li].sortKey)
-				li++;
-			while (meshes[ri].sortKey > median.sortKey)
-				ri--;
+	if (numMeshes < 2)
+		return;
+	assert (numMeshes <= MAX_MESH_BUFFER);
+
+	// Build all four histograms and check the order in one go
+	memset (counts, 0, sizeof (counts));
+	sorted = qTrue;
+	prevKey = 0;
+	for (i=0 ; i<numMeshes ; i++) {
+		key = meshes[i].sortKey;
+		if (key < prevKey)
+			sorted = qFalse;
+		prevKey = key;
+
+		r_sortKeys[0][i] = key;
+		r_sortIndexes[0][i] = i;
+
+		counts[0][key & 255]++;
+		counts[1][(key >> 8) & 255]++;
+		counts[2][(key >> 16) & 255]++;
+		counts[3][key >> 24]++;
+	}
 
-			if (li <= ri) {
-				R_MBCopy (meshes[ri], tempbuf);
-				R_MBCopy (meshes[li], meshes[ri]);
-				R_MBCopy (tempbuf, meshes[li]);
+	ri.pc.sortedMeshes += numMeshes;
+	if (sorted)
+		return;
 
-				li++;
-				ri--;
-			}
+	// Sort the indexes
+	src = 0;
+	for (pass=0 ; pass<4 ; pass++) {
+		shift = pass * 8;
+		if (counts[pass][(r_sortKeys[src][0] >> shift) & 255] == (uint32)numMeshes)
+			continue;	// Every key has the same digit here
+
+		offset = 0;
+		for (i=0 ; i<256 ; i++) {
+			count = counts[pass][i];
+			counts[pass][i] = offset;
+			offset += count;
 		}
 
-		if (Li < ri && stackDepth < QSORT_MAX_STACKDEPTH) {
-			localStack[stackDepth++] = li;
-			localStack[stackDepth++] = Ri;
-			li = Li;
-			Ri = ri;
-			goto mark0;
-		}
+		for (i=0 ; i<numMeshes ; i++) {
+			key = r_sortKeys[src][i];
+			offset = counts[pass][(key >> shift) & 255]++;
 
-		if (li < Ri) {
-			Li = li;
-			goto mark0;
+			r_sortKeys[!src][offset] = key;
+			r_sortIndexes[!src][offset] = r_sortIndexes[src][i];
 		}
-	}
 
-	if (stackDepth) {
-		Ri = ri = localStack[--stackDepth];
-		Li = li = localStack[--stackDepth];
-		goto mark0;
+		src = !src;
+		ri.pc.sortPasses++;
 	}
 
-	for (li=1 ; li<total ; li++) {
-		R_MBCopy (meshes[li], tempbuf);
-		ri = li - 1;
-
-		while (ri >= 0 && meshes[ri].sortKey > tempbuf.sortKey) {
-			R_MBCopy (meshes[ri], meshes[ri+1]);
-			ri--;
-		}
-		if (li != ri+1)
-			R_MBCopy (tempbuf, meshes[ri+1]);
-	}
+	// Move the mesh buffers into place
+	for (i=0 ; i<numMeshes ; i++)
+		R_MBCopy (meshes[r_sortIndexes[src][i]], r_sortScratch[i]);
+	memcpy (meshes, r_sortScratch, sizeof (meshBuffer_t) * numMeshes);
 }
 
 
@@ -245,33 +243,58 @@ R_SortMeshList
 */
 void R_SortMeshList (void)
 {
-	uint32	startTime = 0;
+	uint32	startTime = 0, startMicro = 0;
 	int		i;
 
 	if (r_debugSorting->intVal)
 		return;
 
-	if (r_times->intVal)
+	if (r_times->intVal) {
 		startTime = Sys_UMilliseconds ();
+		startMicro = Sys_UMicroseconds ();
+	}
 
 	// Sort meshes
 	for (i=0 ; i<MAX_MESH_KEYS ; i++) {
 		if (r_currentList->numMeshes[i])
-			R_QSortMeshBuffers (r_currentList->meshBuffer[i], 0, r_currentList->numMeshes[i] - 1);
+			R_RSortMeshBuffers (r_currentList->meshBuffer[i], r_currentList->numMeshes[i]);
 	}
 
 	// Sort additive meshes
 	for (i=0 ; i<MAX_ADDITIVE_KEYS ; i++) {
 		if (r_currentList->numAdditiveMeshes[i])
-			R_ISortMeshBuffers (r_currentList->meshBufferAdditive[i], r_currentList->numAdditiveMeshes[i]);
+			R_RSortMeshBuffers (r_currentList->meshBufferAdditive[i], r_currentList->numAdditiveMeshes[i]);
 	}
 
 	// Sort post-process meshes
 	if (r_currentList->numPostProcessMeshes)
 		R_ISortMeshBuffers (r_currentList->meshBufferPostProcess, r_currentList->numPostProcessMeshes);
 
-	if (r_times->intVal)
+	if (r_times->intVal) {
 		ri.pc.timeSortList += Sys_UMilliseconds () - startTime;
+		ri.pc.timeSortListMicro += Sys_UMicroseconds () - startMicro;
+	}
+}
+
+
+/*
+=============
+R_WorldVBOSurface
+
+Surfaces lit or fogged on the CPU, and anything being outlined, still have to
+go through the client-side batch.
+=============
+*/
+static inline qBool R_WorldVBOSurface (meshBuffer_t *mb, mBspSurface_t *surf, meshType_t meshType, qBool triangleOutlines)
+{
+	if (triangleOutlines || surf->vboFirstIndex < 0)
+		return qFalse;
+	if (mb->fog)
+		return qFalse;
+	if (meshType == MBT_Q3BSP && surf->dLightFrame == ri.frameCount && !ri.config.extTex3D)
+		return qFalse;
+
+	return RB_WorldVBOMaterial (mb->mat);
 }
 
 
@@ -286,6 +309,7 @@ static inline void R_BatchMeshBuffer (meshBuffer_t *mb, meshBuffer_t *nextMB, qB
 	meshFeatures_t	features;
 	meshType_t		meshType;
 	meshType_t		nextMeshType;
+	qBool			useVBO;
 
 	// Check if it's a sky surface
 	if (mb->mat->flags & MAT_SKY) {
@@ -346,7 +370,11 @@ static inline void R_BatchMeshBuffer (meshBuffer_t *mb, meshBuffer_t *nextMB, qB
 		if (!triangleOutlines)
 			ri.pc.worldPolys++;
 
-		RB_PushMesh (surf->mesh, features);
+		useVBO = R_WorldVBOSurface (mb, surf, meshType, triangleOutlines);
+		if (useVBO)
+			RB_PushWorldVBOMesh (surf->vboFirstIndex, surf->mesh->numIndexes, surf->vboFirstVert, surf->mesh->numVerts, features);
+		else
+			RB_PushMesh (surf->mesh, features);
 
 		if (features & MF_NONBATCHED
 		|| mb->mat->flags & MAT_DEFORMV_BULGE
@@ -358,7 +386,8 @@ static inline void R_BatchMeshBuffer (meshBuffer_t *mb, meshBuffer_t *nextMB, qB
 		|| nextMB->matTime != mb->matTime
 		|| !nextSurf
 		|| nextSurf->q2_lmTexNumActive != surf->q2_lmTexNumActive
-		|| RB_BackendOverflow (nextSurf->mesh->numVerts, nextSurf->mesh->numIndexes)) {
+		|| R_WorldVBOSurface (nextMB, nextSurf, nextMeshType, triangleOutlines) != useVBO
+		|| (useVBO ? RB_WorldVBOOverflow () : RB_BackendOverflow (nextSurf->mesh->numVerts, nextSurf->mesh->numIndexes))) {
 			if (mb->entity->model != ri.scn.worldModel)
 				RB_RotateForEntity (mb->entity);
 
@@ -386,7 +415,12 @@ static inline void R_BatchMeshBuffer (meshBuffer_t *mb, meshBuffer_t *nextMB, qB
 			features |= MF_NOCULL;
 		if (!(mb->mat->flags & MAT_ENTITY_MERGABLE) || r_debugBatching->intVal == 2)
 			features |= MF_NONBATCHED;
-		RB_PushMesh (surf->mesh, features);
+
+		useVBO = R_WorldVBOSurface (mb, surf, meshType, triangleOutlines);
+		if (useVBO)
+			RB_PushWorldVBOMesh (surf->vboFirstIndex, surf->mesh->numIndexes, surf->vboFirstVert, surf->mesh->numVerts, features);
+		else
+			RB_PushMesh (surf->mesh, features);
 
 		if (features & MF_NONBATCHED
 		|| mb->mat->flags & MAT_DEFORMV_BULGE
@@ -398,7 +432,8 @@ static inline void R_BatchMeshBuffer (meshBuffer_t *mb, meshBuffer_t *nextMB, qB
 		|| nextSurf->dLightBits != surf->dLightBits
 		|| nextSurf->lmTexNum != surf->lmTexNum
 		|| nextMB->mat->flags & MAT_DEFORMV_BULGE
-		|| RB_BackendOverflow (nextSurf->mesh->numVerts, nextSurf->mesh->numIndexes)) {
+		|| R_WorldVBOSurface (nextMB, nextSurf, nextMeshType, triangleOutlines) != useVBO
+		|| (useVBO ? RB_WorldVBOOverflow () : RB_BackendOverflow (nextSurf->mesh->numVerts, nextSurf->mesh->numIndexes))) {
 			if (mb->entity->model != ri.scn.worldModel)
 				RB_RotateForEntity (mb->entity);
 
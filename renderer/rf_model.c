@@ -110,6 +110,356 @@ static void R_BuildTriangleNeighbors (int *neighbors, index_t *indexes, int numT
 	}
 }
 
+/*
+===============================================================================
+
+	ALIAS MODEL CACHE
+
+	The processed MD2/MD3 layout is written to modelcache/ in the game
+	directory, and loaded back as-is while the source checksum still
+	matches. This skips MD2 vertex welding and the neighbor search.
+
+===============================================================================
+*/
+
+#define ALIAS_CACHE_IDENT		(('C'<<24)+('M'<<16)+('L'<<8)+'E')	// "ELMC"
+#define ALIAS_CACHE_VERSION		1
+
+#define ALIAS_CACHE_NEIGHBORS	1
+
+typedef struct aliasCacheHeader_s {
+	int				ident;
+	int				version;
+	int				modelType;
+	int				flags;
+
+	uint32			checksum;		// of the source file
+	int				fileLen;
+
+	vec3_t			mins;
+	vec3_t			maxs;
+	float			radius;
+
+	int				numFrames;
+	int				numTags;
+	int				numMeshes;
+} aliasCacheHeader_t;
+
+typedef struct aliasCacheMesh_s {
+	char			name[MAX_QPATH];
+
+	int				numVerts;
+	int				numTris;
+	int				numSkins;
+} aliasCacheMesh_t;
+
+/*
+===============
+R_AliasCacheName
+===============
+*/
+static void R_AliasCacheName (refModel_t *model, char *out, size_t size)
+{
+	Q_snprintfz (out, size, "modelcache/%s.rmc", model->name);
+}
+
+
+/*
+===============
+R_AliasCacheRead
+
+Steps through the cache buffer, NULL if it runs out.
+===============
+*/
+static void *R_AliasCacheRead (byte **cursor, byte *end, size_t size)
+{
+	byte	*data;
+
+	data = *cursor;
+	if (size > (size_t)(end - data))
+		return NULL;
+
+	*cursor += size;
+	return data;
+}
+
+
+/*
+===============
+R_LoadAliasCache
+
+Everything is checked against the file length before anything is allocated,
+a stale or broken cache just falls back to a full load.
+===============
+*/
+static qBool R_LoadAliasCache (refModel_t *model, modelType_t modelType, uint32 checksum, int fileLen)
+{
+	char				name[MAX_OSPATH];
+	aliasCacheHeader_t	*header;
+	aliasCacheMesh_t	*inMesh;
+	mAliasModel_t		*outModel;
+	mAliasMesh_t		*outMesh;
+	mAliasSkin_t		*outSkin;
+	byte				*buffer, *cursor, *end;
+	byte				*allocBuffer;
+	char				*skinNames;
+	int					flags;
+	int					cacheLen;
+	int					i, j;
+
+	R_AliasCacheName (model, name, sizeof (name));
+	cacheLen = FS_LoadFile (name, (void **)&buffer, NULL);
+	if (!buffer || cacheLen <= 0)
+		return qFalse;
+
+	cursor = buffer;
+	end = buffer + cacheLen;
+
+	// Check the header
+#ifdef SHADOW_VOLUMES
+	flags = ALIAS_CACHE_NEIGHBORS;
+#else
+	flags = 0;
+#endif
+	header = R_AliasCacheRead (&cursor, end, sizeof (aliasCacheHeader_t));
+	if (!header
+	|| header->ident != ALIAS_CACHE_IDENT
+	|| header->version != ALIAS_CACHE_VERSION
+	|| header->modelType != modelType
+	|| header->flags != flags
+	|| header->checksum != checksum
+	|| header->fileLen != fileLen
+	|| header->numFrames <= 0 || header->numFrames > MD3_MAX_FRAMES
+	|| header->numTags < 0 || header->numTags > MD3_MAX_TAGS
+	|| header->numMeshes < 0 || header->numMeshes > MD3_MAX_MESHES) {
+		FS_FreeFile (buffer);
+		return qFalse;
+	}
+
+	// Walk the meshes to make sure it's all there
+	if (!R_AliasCacheRead (&cursor, end, (sizeof (mAliasFrame_t) * header->numFrames)
+										+ (sizeof (mAliasTag_t) * header->numFrames * header->numTags)))
+		goto badCache;
+
+	for (i=0 ; i<header->numMeshes ; i++) {
+		index_t		*indexes;
+
+		inMesh = R_AliasCacheRead (&cursor, end, sizeof (aliasCacheMesh_t));
+		if (!inMesh
+		|| inMesh->numVerts <= 0 || inMesh->numVerts >= ALIAS_MAX_VERTS
+		|| inMesh->numTris <= 0 || inMesh->numTris > MD3_MAX_TRIANGLES
+		|| inMesh->numSkins < 0 || inMesh->numSkins > MD3_MAX_SHADERS)
+			goto badCache;
+
+		if (!R_AliasCacheRead (&cursor, end, MAX_QPATH * inMesh->numSkins))
+			goto badCache;
+
+		indexes = R_AliasCacheRead (&cursor, end, sizeof (index_t) * inMesh->numTris * 3);
+		if (!indexes)
+			goto badCache;
+		for (j=0 ; j<inMesh->numTris*3 ; j++) {
+			if (indexes[j] < 0 || indexes[j] >= inMesh->numVerts)
+				goto badCache;
+		}
+
+		if (!R_AliasCacheRead (&cursor, end, (sizeof (vec2_t) * inMesh->numVerts)
+											+ (sizeof (mAliasVertex_t) * header->numFrames * inMesh->numVerts)
+											+ (sizeof (vec3_t) * header->numFrames * 2)
+											+ (sizeof (float) * header->numFrames)))
+			goto badCache;
+
+#ifdef SHADOW_VOLUMES
+		if (!R_AliasCacheRead (&cursor, end, sizeof (int) * inMesh->numTris * 3))
+			goto badCache;
+#endif
+	}
+	if (cursor != end)
+		goto badCache;
+
+	//
+	// Map it in
+	//
+	cursor = buffer + sizeof (aliasCacheHeader_t);
+
+	allocBuffer = R_ModAlloc (model, sizeof (mAliasModel_t)
+									+ (sizeof (mAliasFrame_t) * header->numFrames)
+									+ (sizeof (mAliasTag_t) * header->numFrames * header->numTags)
+									+ (sizeof (mAliasMesh_t) * header->numMeshes));
+
+	outModel = model->aliasModel = (mAliasModel_t *)allocBuffer;
+	model->type = modelType;
+	Vec3Copy (header->mins, model->mins);
+	Vec3Copy (header->maxs, model->maxs);
+	model->radius = header->radius;
+
+	allocBuffer += sizeof (mAliasModel_t);
+	outModel->numFrames = header->numFrames;
+	outModel->frames = (mAliasFrame_t *)allocBuffer;
+	memcpy (outModel->frames, R_AliasCacheRead (&cursor, end, sizeof (mAliasFrame_t) * header->numFrames), sizeof (mAliasFrame_t) * header->numFrames);
+
+	allocBuffer += sizeof (mAliasFrame_t) * header->numFrames;
+	outModel->numTags = header->numTags;
+	if (header->numTags) {
+		outModel->tags = (mAliasTag_t *)allocBuffer;
+		memcpy (outModel->tags, R_AliasCacheRead (&cursor, end, sizeof (mAliasTag_t) * header->numFrames * header->numTags), sizeof (mAliasTag_t) * header->numFrames * header->numTags);
+	}
+
+	allocBuffer += sizeof (mAliasTag_t) * header->numFrames * header->numTags;
+	outModel->numMeshes = header->numMeshes;
+	outModel->meshes = (mAliasMesh_t *)allocBuffer;
+
+	for (i=0, outMesh=outModel->meshes ; i<header->numMeshes ; i++, outMesh++) {
+		size_t		size;
+
+		inMesh = R_AliasCacheRead (&cursor, end, sizeof (aliasCacheMesh_t));
+		Q_strncpyz (outMesh->name, inMesh->name, sizeof (outMesh->name));
+		outMesh->numVerts = inMesh->numVerts;
+		outMesh->numTris = inMesh->numTris;
+		outMesh->numSkins = inMesh->numSkins;
+		skinNames = R_AliasCacheRead (&cursor, end, MAX_QPATH * inMesh->numSkins);
+
+		// The rest is stored in the same order as it's laid out here
+		size = (sizeof (index_t) * outMesh->numTris * 3)
+			+ (sizeof (vec2_t) * outMesh->numVerts)
+			+ (sizeof (mAliasVertex_t) * header->numFrames * outMesh->numVerts)
+			+ (sizeof (vec3_t) * header->numFrames * 2)
+			+ (sizeof (float) * header->numFrames);
+#ifdef SHADOW_VOLUMES
+		size += sizeof (int) * outMesh->numTris * 3;
+#endif
+		allocBuffer = R_ModAlloc (model, (sizeof (mAliasSkin_t) * outMesh->numSkins) + size);
+
+		outMesh->skins = (mAliasSkin_t *)allocBuffer;
+		allocBuffer += sizeof (mAliasSkin_t) * outMesh->numSkins;
+		memcpy (allocBuffer, R_AliasCacheRead (&cursor, end, size), size);
+
+		outMesh->indexes = (index_t *)allocBuffer;
+		allocBuffer += sizeof (index_t) * outMesh->numTris * 3;
+		outMesh->coords = (vec2_t *)allocBuffer;
+		allocBuffer += sizeof (vec2_t) * outMesh->numVerts;
+		outMesh->vertexes = (mAliasVertex_t *)allocBuffer;
+		allocBuffer += sizeof (mAliasVertex_t) * header->numFrames * outMesh->numVerts;
+		outMesh->mins = (vec3_t *)allocBuffer;
+		allocBuffer += sizeof (vec3_t) * header->numFrames;
+		outMesh->maxs = (vec3_t *)allocBuffer;
+		allocBuffer += sizeof (vec3_t) * header->numFrames;
+		outMesh->radius = (float *)allocBuffer;
+#ifdef SHADOW_VOLUMES
+		allocBuffer += sizeof (float) * header->numFrames;
+		outMesh->neighbors = (int *)allocBuffer;
+#endif
+
+		// Register the skins
+		for (j=0, outSkin=outMesh->skins ; j<outMesh->numSkins ; j++, outSkin++, skinNames+=MAX_QPATH) {
+			if (!skinNames[0])
+				continue;
+
+			Q_strncpyz (outSkin->name, skinNames, sizeof (outSkin->name));
+			outSkin->material = R_RegisterSkin (outSkin->name);
+			if (!outSkin->material)
+				Com_DevPrintf (PRNT_WARNING, "R_LoadAliasCache: '%s' could not load skin '%s' on mesh '%s'\n",
+								model->name, outSkin->name, outMesh->name);
+		}
+	}
+
+	Com_DevPrintf (0, "R_LoadAliasCache: '%s' loaded from '%s'\n", model->name, name);
+	FS_FreeFile (buffer);
+	return qTrue;
+
+badCache:
+	Com_DevPrintf (PRNT_WARNING, "R_LoadAliasCache: '%s' is damaged, rebuilding\n", name);
+	FS_FreeFile (buffer);
+	return qFalse;
+}
+
+
+/*
+===============
+R_AliasCacheWrite
+===============
+*/
+static void R_AliasCacheWrite (void *data, size_t size, fileHandle_t fileNum)
+{
+	if (size)
+		FS_Write (data, size, fileNum);
+}
+
+
+/*
+===============
+R_WriteAliasCache
+===============
+*/
+static void R_WriteAliasCache (refModel_t *model, uint32 checksum, int fileLen)
+{
+	char				name[MAX_OSPATH];
+	char				skinName[MAX_QPATH];
+	aliasCacheHeader_t	header;
+	aliasCacheMesh_t	outMesh;
+	mAliasModel_t		*aliasModel;
+	mAliasMesh_t		*inMesh;
+	fileHandle_t		fileNum;
+	int					numFrames;
+	int					i, j;
+
+	R_AliasCacheName (model, name, sizeof (name));
+	FS_OpenFile (name, &fileNum, FS_MODE_WRITE_BINARY);
+	if (!fileNum) {
+		Com_DevPrintf (PRNT_WARNING, "R_WriteAliasCache: couldn't open '%s'\n", name);
+		return;
+	}
+
+	aliasModel = model->aliasModel;
+	numFrames = aliasModel->numFrames;
+
+	memset (&header, 0, sizeof (header));
+	header.ident = ALIAS_CACHE_IDENT;
+	header.version = ALIAS_CACHE_VERSION;
+	header.modelType = model->type;
+#ifdef SHADOW_VOLUMES
+	header.flags = ALIAS_CACHE_NEIGHBORS;
+#endif
+	header.checksum = checksum;
+	header.fileLen = fileLen;
+	Vec3Copy (model->mins, header.mins);
+	Vec3Copy (model->maxs, header.maxs);
+	header.radius = model->radius;
+	header.numFrames = numFrames;
+	header.numTags = aliasModel->numTags;
+	header.numMeshes = aliasModel->numMeshes;
+
+	R_AliasCacheWrite (&header, sizeof (header), fileNum);
+	R_AliasCacheWrite (aliasModel->frames, sizeof (mAliasFrame_t) * numFrames, fileNum);
+	R_AliasCacheWrite (aliasModel->tags, sizeof (mAliasTag_t) * numFrames * aliasModel->numTags, fileNum);
+
+	for (i=0, inMesh=aliasModel->meshes ; i<aliasModel->numMeshes ; i++, inMesh++) {
+		memset (&outMesh, 0, sizeof (outMesh));
+		Q_strncpyz (outMesh.name, inMesh->name, sizeof (outMesh.name));
+		outMesh.numVerts = inMesh->numVerts;
+		outMesh.numTris = inMesh->numTris;
+		outMesh.numSkins = inMesh->numSkins;
+		R_AliasCacheWrite (&outMesh, sizeof (outMesh), fileNum);
+
+		for (j=0 ; j<inMesh->numSkins ; j++) {
+			memset (skinName, 0, sizeof (skinName));
+			Q_strncpyz (skinName, inMesh->skins[j].name, sizeof (skinName));
+			R_AliasCacheWrite (skinName, sizeof (skinName), fileNum);
+		}
+
+		R_AliasCacheWrite (inMesh->indexes, sizeof (index_t) * inMesh->numTris * 3, fileNum);
+		R_AliasCacheWrite (inMesh->coords, sizeof (vec2_t) * inMesh->numVerts, fileNum);
+		R_AliasCacheWrite (inMesh->vertexes, sizeof (mAliasVertex_t) * numFrames * inMesh->numVerts, fileNum);
+		R_AliasCacheWrite (inMesh->mins, sizeof (vec3_t) * numFrames, fileNum);
+		R_AliasCacheWrite (inMesh->maxs, sizeof (vec3_t) * numFrames, fileNum);
+		R_AliasCacheWrite (inMesh->radius, sizeof (float) * numFrames, fileNum);
+#ifdef SHADOW_VOLUMES
+		R_AliasCacheWrite (inMesh->neighbors, sizeof (int) * inMesh->numTris * 3, fileNum);
+#endif
+	}
+
+	FS_CloseFile (fileNum);
+}
+
 /*
 ===============================================================================
 
@@ -149,6 +499,7 @@ static qBool R_LoadMD2Model (refModel_t *model)
 	byte			*allocBuffer;
 	byte			*buffer;
 	int				fileLen;
+	uint32			checksum;
 
 	// Load the file
 	fileLen = FS_LoadFile (model->name, (void **)&buffer, NULL);
@@ -171,6 +522,13 @@ static qBool R_LoadMD2Model (refModel_t *model)
 		return qFalse;
 	}
 
+	// Use the processed copy if it's still good
+	checksum = Com_BlockChecksum (buffer, fileLen);
+	if (r_modelCache->intVal && R_LoadAliasCache (model, MODEL_MD2, checksum, fileLen)) {
+		FS_FreeFile (buffer);
+		return qTrue;
+	}
+
 	allocBuffer = R_ModAlloc (model, sizeof (mAliasModel_t) + sizeof (mAliasMesh_t));
 
 	outModel = model->aliasModel = (mAliasModel_t *)allocBuffer;
@@ -415,6 +773,8 @@ static qBool R_LoadMD2Model (refModel_t *model)
 	}
 
 	// Done
+	if (r_modelCache->intVal)
+		R_WriteAliasCache (model, checksum, fileLen);
 	FS_FreeFile (buffer);
 	return qTrue;
 }
@@ -478,6 +838,7 @@ static qBool R_LoadMD3Model (refModel_t *model)
 	byte				*allocBuffer;
 	byte				*buffer;
 	int					fileLen;
+	uint32				checksum;
 
 	// Load the file
 	fileLen = FS_LoadFile (model->name, (void **)&buffer, NULL);
@@ -500,6 +861,13 @@ static qBool R_LoadMD3Model (refModel_t *model)
 		return qFalse;
 	}
 
+	// Use the processed copy if it's still good
+	checksum = Com_BlockChecksum (buffer, fileLen);
+	if (r_modelCache->intVal && R_LoadAliasCache (model, MODEL_MD3, checksum, fileLen)) {
+		FS_FreeFile (buffer);
+		return qTrue;
+	}
+
 	model->aliasModel = outModel = R_ModAlloc (model, sizeof (mAliasModel_t));
 	model->type = MODEL_MD3;
 
@@ -756,6 +1124,8 @@ static qBool R_LoadMD3Model (refModel_t *model)
 	}
 
 	// Done
+	if (r_modelCache->intVal)
+		R_WriteAliasCache (model, checksum, fileLen);
 	FS_FreeFile (buffer);
 	return qTrue;
 }
@@ -2506,7 +2876,7 @@ R_LoadQ2BSPModel
 */
 static qBool R_LoadQ2BSPModel (refModel_t *model, byte *buffer)
 {
-	dQ2BspHeader_t	*header;
+	dQ2BspHeader_t	*header, headerCopy;
 	mBspHeader_t	*bm;
 	byte			*modBase;
 	int				version;
@@ -2525,9 +2895,11 @@ static qBool R_LoadQ2BSPModel (refModel_t *model, byte *buffer)
 	}
 
 	//
-	// Swap all the lumps
+	// Swap all the lumps, into a copy since the buffer may be a read-only pack view
 	//
-	modBase = (byte *)header;
+	modBase = buffer;
+	headerCopy = *header;
+	header = &headerCopy;
 	for (i=0 ; i<sizeof(dQ2BspHeader_t)/4 ; i++)
 		((int *)header)[i] = LittleLong (((int *)header)[i]);
 
@@ -3808,7 +4180,7 @@ R_LoadQ3BSPModel
 */
 static qBool R_LoadQ3BSPModel (refModel_t *model, byte *buffer)
 {
-	dQ3BspHeader_t	*header;
+	dQ3BspHeader_t	*header, headerCopy;
 	mBspHeader_t	*bm;
 	byte			*modBase;
 	vec3_t			maxs;
@@ -3828,9 +4200,11 @@ static qBool R_LoadQ3BSPModel (refModel_t *model, byte *buffer)
 	}
 
 	//
-	// Swap all the lumps
+	// Swap all the lumps, into a copy since the buffer may be a read-only pack view
 	//
-	modBase = (byte *)header;
+	modBase = buffer;
+	headerCopy = *header;
+	header = &headerCopy;
 	for (i=0 ; i<sizeof (dQ3BspHeader_t)/4 ; i++)
 		((int *)header)[i] = LittleLong (((int *)header)[i]);
 
@@ -3928,6 +4302,10 @@ static void R_FreeModel (refModel_t *model)
 		prev = &hashMdl->hashNext;
 	}
 
+	// Drop the world buffers built from it
+	if (model == rb.worldVBO.model)
+		R_ReleaseWorldVBO ();
+
 	// Free it
 	if (model->memSize > 0)
 		Mem_FreeTag (ri.modelSysPool, model->memTag);
@@ -4249,6 +4627,9 @@ void R_RegisterMap (char *mapName)
 	ri.scn.worldModel = R_LoadBSPModel (mapName);
 	ri.scn.worldEntity->model = ri.scn.worldModel;
 
+	// Upload static geometry
+	R_BuildWorldVBO (ri.scn.worldModel);
+
 	// Force markleafs
 	ri.scn.oldViewCluster = -1;
 	ri.scn.viewCluster = -1;
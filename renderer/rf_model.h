@@ -274,6 +274,9 @@ typedef struct mBspSurface_s {
 	int						lmTexNum;
 	uint32					dLightFrame;
 	uint32					dLightBits;
+
+	int						vboFirstIndex;		// -1 if not in the world vertex buffer
+	int						vboFirstVert;
 } mBspSurface_t;
 
 typedef struct mNodeLeafShared_s {
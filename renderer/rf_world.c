@@ -825,6 +825,257 @@ void R_AddWorldToList (void)
 		ri.pc.timeRecurseWorld += Sys_UMilliseconds () - startTime;
 }
 
+/*
+=============================================================================
+
+	WORLD VERTEX BUFFERS
+
+	World surfaces are uploaded once when the map is registered. They're laid
+	out by material, then lightmap, then cluster, so that the surfaces one
+	batch needs from a visible cluster end up as one run of indexes.
+
+=============================================================================
+*/
+
+typedef struct worldVBOSurf_s {
+	mBspSurface_t		*surf;
+	material_t			*mat;
+	int					lmTexNum;
+	int					cluster;
+} worldVBOSurf_t;
+
+/*
+================
+R_WorldVBOSurfCmp
+================
+*/
+static int R_WorldVBOSurfCmp (const void *a, const void *b)
+{
+	const worldVBOSurf_t	*s1 = (const worldVBOSurf_t *)a;
+	const worldVBOSurf_t	*s2 = (const worldVBOSurf_t *)b;
+
+	if (s1->mat != s2->mat)
+		return (s1->mat < s2->mat) ? -1 : 1;
+	if (s1->lmTexNum != s2->lmTexNum)
+		return (s1->lmTexNum < s2->lmTexNum) ? -1 : 1;
+	if (s1->cluster != s2->cluster)
+		return (s1->cluster < s2->cluster) ? -1 : 1;
+	return (s1->surf < s2->surf) ? -1 : 1;
+}
+
+
+/*
+================
+R_WorldVBOSurfMaterial
+================
+*/
+static material_t *R_WorldVBOSurfMaterial (refModel_t *model, mBspSurface_t *surf)
+{
+	material_t	*mat;
+
+	if (model->type == MODEL_Q3BSP) {
+		if (surf->q3_faceType == FACETYPE_FLARE || !surf->q3_shaderRef)
+			return NULL;
+		mat = surf->q3_shaderRef->mat;
+	}
+	else {
+		if (surf->q2_texInfo->flags & SURF_TEXINFO_SKY)
+			return NULL;
+		mat = surf->q2_texInfo->mat;
+	}
+
+	if (!mat || mat->flags & MAT_SKY)
+		return NULL;
+	return mat;
+}
+
+
+/*
+================
+R_WorldVBOClusters
+
+Picks the first cluster each surface shows up in, surfaces that aren't in
+any leaf (brush models) are left at -1.
+================
+*/
+static void R_WorldVBOClusters (refModel_t *model, int *clusters)
+{
+	mBspSurface_t	**mark;
+	mBspLeaf_t		*leaf;
+	int				i, j, surfNum;
+
+	for (i=0 ; i<model->bspModel.numSurfaces ; i++)
+		clusters[i] = -1;
+
+	for (i=0, leaf=model->bspModel.leafs ; i<model->bspModel.numLeafs ; i++, leaf++) {
+		if (leaf->cluster < 0)
+			continue;
+
+		if (model->type == MODEL_Q3BSP) {
+			if (!leaf->q3_firstVisSurface)
+				continue;
+
+			for (mark=leaf->q3_firstVisSurface ; *mark ; mark++) {
+				surfNum = *mark - model->bspModel.surfaces;
+				if (clusters[surfNum] == -1)
+					clusters[surfNum] = leaf->cluster;
+			}
+		}
+		else {
+			for (j=0, mark=leaf->q2_firstMarkSurface ; j<leaf->q2_numMarkSurfaces ; j++, mark++) {
+				surfNum = *mark - model->bspModel.surfaces;
+				if (clusters[surfNum] == -1)
+					clusters[surfNum] = leaf->cluster;
+			}
+		}
+	}
+}
+
+
+/*
+================
+R_BuildWorldVBO
+================
+*/
+void R_BuildWorldVBO (refModel_t *model)
+{
+	worldVBOSurf_t	*list, *ws;
+	mBspSurface_t	*surf;
+	mesh_t			*mesh;
+	material_t		*mat;
+	int				*clusters;
+	byte			*vertData;
+	vec3_t			*outVerts;
+	vec2_t			*outCoords, *outLMCoords;
+	index_t			*indexData, *outIndex;
+	size_t			vertSize;
+	int				numSurfs, numVerts, numIndexes;
+	int				i, j;
+	uint32			startTime;
+
+	if (rb.worldVBO.model == model)
+		return;
+	R_ReleaseWorldVBO ();
+
+	if (!ri.config.extVertexBufferObject || !r_worldVBO->intVal)
+		return;
+	if (model->type != MODEL_Q2BSP && model->type != MODEL_Q3BSP)
+		return;
+
+	startTime = Sys_UMilliseconds ();
+
+	// Gather the surfaces that have something to upload
+	clusters = Mem_PoolAlloc (sizeof (int) * model->bspModel.numSurfaces, ri.genericPool, 0);
+	list = Mem_PoolAlloc (sizeof (worldVBOSurf_t) * model->bspModel.numSurfaces, ri.genericPool, 0);
+	R_WorldVBOClusters (model, clusters);
+
+	numSurfs = numVerts = numIndexes = 0;
+	for (i=0, surf=model->bspModel.surfaces ; i<model->bspModel.numSurfaces ; i++, surf++) {
+		surf->vboFirstIndex = -1;
+		surf->vboFirstVert = 0;
+
+		mesh = surf->mesh;
+		if (!mesh || !mesh->numVerts || !mesh->numIndexes || !mesh->vertexArray || !mesh->indexArray)
+			continue;
+		mat = R_WorldVBOSurfMaterial (model, surf);
+		if (!mat)
+			continue;
+
+		ws = &list[numSurfs++];
+		ws->surf = surf;
+		ws->mat = mat;
+		ws->lmTexNum = surf->lmTexNum;
+		ws->cluster = clusters[i];
+
+		numVerts += mesh->numVerts;
+		numIndexes += mesh->numIndexes;
+	}
+
+	if (!numSurfs) {
+		Mem_Free (list);
+		Mem_Free (clusters);
+		return;
+	}
+
+	qsort (list, numSurfs, sizeof (worldVBOSurf_t), R_WorldVBOSurfCmp);
+
+	// Fill in the buffers
+	vertSize = numVerts * (sizeof (vec3_t) + sizeof (vec2_t) * 2);
+	vertData = Mem_PoolAlloc (vertSize, ri.genericPool, 0);
+	indexData = Mem_PoolAlloc (sizeof (index_t) * numIndexes, ri.genericPool, 0);
+
+	outVerts = (vec3_t *)vertData;
+	outCoords = (vec2_t *)(vertData + numVerts * sizeof (vec3_t));
+	outLMCoords = outCoords + numVerts;
+	outIndex = indexData;
+
+	rb.worldVBO.coordOffset = numVerts * sizeof (vec3_t);
+	rb.worldVBO.lmCoordOffset = rb.worldVBO.coordOffset + numVerts * sizeof (vec2_t);
+
+	numVerts = numIndexes = 0;
+	for (i=0, ws=list ; i<numSurfs ; i++, ws++) {
+		surf = ws->surf;
+		mesh = surf->mesh;
+
+		surf->vboFirstIndex = numIndexes;
+		surf->vboFirstVert = numVerts;
+
+		memcpy (outVerts + numVerts, mesh->vertexArray, sizeof (vec3_t) * mesh->numVerts);
+		if (mesh->coordArray)
+			memcpy (outCoords + numVerts, mesh->coordArray, sizeof (vec2_t) * mesh->numVerts);
+		if (mesh->lmCoordArray)
+			memcpy (outLMCoords + numVerts, mesh->lmCoordArray, sizeof (vec2_t) * mesh->numVerts);
+
+		for (j=0 ; j<mesh->numIndexes ; j++)
+			*outIndex++ = numVerts + mesh->indexArray[j];
+
+		numVerts += mesh->numVerts;
+		numIndexes += mesh->numIndexes;
+	}
+
+	// Upload
+	qglGenBuffersARB (1, &rb.worldVBO.vertexBuffer);
+	qglBindBufferARB (GL_ARRAY_BUFFER_ARB, rb.worldVBO.vertexBuffer);
+	qglBufferDataARB (GL_ARRAY_BUFFER_ARB, vertSize, vertData, GL_STATIC_DRAW_ARB);
+	qglBindBufferARB (GL_ARRAY_BUFFER_ARB, 0);
+
+	qglGenBuffersARB (1, &rb.worldVBO.indexBuffer);
+	qglBindBufferARB (GL_ELEMENT_ARRAY_BUFFER_ARB, rb.worldVBO.indexBuffer);
+	qglBufferDataARB (GL_ELEMENT_ARRAY_BUFFER_ARB, sizeof (index_t) * numIndexes, indexData, GL_STATIC_DRAW_ARB);
+	qglBindBufferARB (GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+
+	rb.worldVBO.model = model;
+	rb.worldVBO.numVerts = numVerts;
+	rb.worldVBO.numIndexes = numIndexes;
+
+	GL_CheckForError ("R_BuildWorldVBO");
+
+	Mem_Free (indexData);
+	Mem_Free (vertData);
+	Mem_Free (list);
+	Mem_Free (clusters);
+
+	Com_DevPrintf (0, "R_BuildWorldVBO: %i surfaces, %i verts, %i indexes (%uKB) in %ums\n",
+		numSurfs, numVerts, numIndexes, (uint32)((vertSize + sizeof (index_t) * numIndexes) / 1024),
+		Sys_UMilliseconds () - startTime);
+}
+
+
+/*
+================
+R_ReleaseWorldVBO
+================
+*/
+void R_ReleaseWorldVBO (void)
+{
+	if (rb.worldVBO.vertexBuffer)
+		qglDeleteBuffersARB (1, &rb.worldVBO.vertexBuffer);
+	if (rb.worldVBO.indexBuffer)
+		qglDeleteBuffersARB (1, &rb.worldVBO.indexBuffer);
+
+	memset (&rb.worldVBO, 0, sizeof (rb.worldVBO));
+}
+
 /*
 =============================================================================
 
@@ -851,5 +1102,6 @@ R_WorldShutdown
 */
 void R_WorldShutdown (void)
 {
+	R_ReleaseWorldVBO ();
 	R_SkyShutdown ();
 }
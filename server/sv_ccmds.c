@@ -453,6 +453,22 @@ static void SV_DemoMap_f (void)
 }
 
 
+/*
+==================
+SV_DemoSeek_f
+==================
+*/
+static void SV_DemoSeek_f (void)
+{
+	if (Cmd_Argc () != 2) {
+		Com_Printf (0, "syntax: demo_seek <seconds>\n");
+		return;
+	}
+
+	SV_SeekDemo ((int)(atof (Cmd_Argv (1)) * 1000));
+}
+
+
 /*
 ==================
 SV_GameMap_f
@@ -890,7 +906,6 @@ static void SV_ServerRecord_f (void)
 	char		name[MAX_OSPATH];
 	static byte	buf_data[32768];
 	netMsg_t	buf;
-	int			len;
 	int			i;
 
 	if (Cmd_Argc () != 2) {
@@ -919,9 +934,19 @@ static void SV_ServerRecord_f (void)
 		return;
 	}
 
+	// Keep the disk out of the frame
+	FS_SetAsyncWrite (svs.demoFile);
+
 	// Setup a buffer to catch all multicasts
 	MSG_Init (&svs.demoMultiCast, svs.demoMultiCastBuf, sizeof (svs.demoMultiCastBuf));
 
+	// Keyframes are indexed from the first frame on
+	svs.demoBytes = 0;
+	svs.demoIndexing = (sv_demoKeyframes->floatVal > 0);
+	svs.demoStartFrame = sv.frameNum;
+	svs.demoLastKeyTime = 0;
+	svs.numDemoKeys = 0;
+
 	// Write a single giant fake message with all the startup info
 	MSG_Init (&buf, buf_data, sizeof (buf_data));
 
@@ -959,9 +984,7 @@ static void SV_ServerRecord_f (void)
 
 	// Write it to the demo file
 	Com_DevPrintf (0, "signon message length: %i\n", buf.curSize);
-	len = LittleLong ((int) buf.curSize);
-	FS_Write (&len, sizeof (len), svs.demoFile);
-	FS_Write (buf.data, buf.curSize, svs.demoFile);
+	SV_WriteServerDemo (buf.data, (int) buf.curSize);
 
 	// The rest of the demo file will be individual frames
 }
@@ -980,8 +1003,7 @@ static void SV_ServerStop_f (void)
 		Com_Printf (0, "Not doing a serverrecord.\n");
 		return;
 	}
-	FS_CloseFile (svs.demoFile);
-	svs.demoFile = 0;
+	SV_CloseServerDemo ();
 	Com_Printf (0, "Recording completed.\n");
 }
 
@@ -1042,6 +1064,7 @@ void SV_OperatorCommandInit (void)
 	Cmd_AddCommand ("map",			SV_Map_f,			"Loads a map");
 	Cmd_AddCommand ("devmap",		SV_Map_f,			"Opens a map with cheats enabled");
 	Cmd_AddCommand ("demomap",		SV_DemoMap_f,		"Loads a demo");
+	Cmd_AddCommand ("demo_seek",	SV_DemoSeek_f,		"Jumps demo playback to the keyframe at or before a time in seconds");
 	Cmd_AddCommand ("gamemap",		SV_GameMap_f,		"Loads a map without clearing game state");
 	Cmd_AddCommand ("setmaster",	SV_SetMaster_f,		"");
 
@@ -1059,4 +1082,8 @@ void SV_OperatorCommandInit (void)
 	Cmd_AddCommand ("killserver",	SV_KillServer_f,	"");
 
 	Cmd_AddCommand ("sv",			SV_ServerCommand_f,	"");
+
+	SV_WorldCommandInit ();
+	SV_DownloadCommandInit ();
+	SV_SendCommandInit ();
 }
@@ -23,6 +23,168 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 
 #include "sv_local.h"
 
+/*
+=============================================================================
+
+	ENTITY DELTA CACHE
+
+	Clients that see the same entity and acked the same frame need the same
+	delta for it, byte for byte. Deltas are kept for the rest of the server
+	frame keyed on the exact pair of states, so the repeats are a copy. Frames
+	are built on several threads at once, so the buckets are locked in stripes.
+=============================================================================
+*/
+
+#define DELTA_CACHE_HASH		4096		// must be a power of two
+#define DELTA_CACHE_LOCKS		16			// must be a power of two
+#define DELTA_CACHE_ENTRIES		8192
+#define DELTA_CACHE_BYTES		(DELTA_CACHE_ENTRIES*32)
+#define DELTA_CACHE_MAXDELTA	64			// largest delta MSG_WriteDeltaEntity can write
+
+typedef struct deltaCacheEntry_s {
+	entityStateOld_t			from;
+	entityStateOld_t			to;
+	qBool						force;
+	qBool						newEntity;
+	uint32						hash;
+	int							ofs;
+	int							len;
+	struct deltaCacheEntry_s	*hashNext;
+} deltaCacheEntry_t;
+
+static deltaCacheEntry_t	**sv_deltaHash;
+static deltaCacheEntry_t	*sv_deltaEntries;
+static byte					*sv_deltaBytes;
+static void					*sv_deltaLocks[DELTA_CACHE_LOCKS];
+static volatile int			sv_numDeltaEntries;
+static volatile int			sv_numDeltaBytes;
+
+/*
+=============
+SV_ResetDeltaCache
+
+Called at the start of each round of client frames, before any are built.
+=============
+*/
+void SV_ResetDeltaCache (void)
+{
+	int		i;
+
+	if (!sv_deltaCache->intVal)
+		return;
+
+	if (!sv_deltaHash) {
+		sv_deltaHash = Mem_PoolAlloc (sizeof (deltaCacheEntry_t *) * DELTA_CACHE_HASH, sv_genericPool, 0);
+		sv_deltaEntries = Mem_PoolAlloc (sizeof (deltaCacheEntry_t) * DELTA_CACHE_ENTRIES, sv_genericPool, 0);
+		sv_deltaBytes = Mem_PoolAlloc (DELTA_CACHE_BYTES, sv_genericPool, 0);
+		for (i=0 ; i<DELTA_CACHE_LOCKS ; i++)
+			sv_deltaLocks[i] = Sys_CreateMutex ();
+	}
+	else if (sv_numDeltaEntries) {
+		memset (sv_deltaHash, 0, sizeof (deltaCacheEntry_t *) * DELTA_CACHE_HASH);
+	}
+
+	sv_numDeltaEntries = 0;
+	sv_numDeltaBytes = 0;
+}
+
+
+/*
+=============
+SV_DeltaHash
+=============
+*/
+static uint32 SV_DeltaHash (entityStateOld_t *from, entityStateOld_t *to)
+{
+	uint32	*words;
+	uint32	hash;
+	int		i;
+
+	// FNV-1a over both states a word at a time
+	hash = 2166136261u;
+	for (words=(uint32 *)from, i=0 ; i<sizeof (entityStateOld_t)/4 ; i++)
+		hash = (hash ^ words[i]) * 16777619u;
+	for (words=(uint32 *)to, i=0 ; i<sizeof (entityStateOld_t)/4 ; i++)
+		hash = (hash ^ words[i]) * 16777619u;
+
+	return hash;
+}
+
+
+/*
+=============
+SV_WriteDeltaEntity
+
+MSG_WriteDeltaEntity through the cache
+=============
+*/
+static void SV_WriteDeltaEntity (netMsg_t *msg, entityStateOld_t *from, entityStateOld_t *to, qBool force, qBool newEntity)
+{
+	deltaCacheEntry_t	*entry;
+	netMsg_t			delta;
+	byte				deltaBuff[DELTA_CACHE_MAXDELTA];
+	void				*lock;
+	uint32				hash;
+	int					bucket, index, ofs;
+
+	if (!sv_deltaCache->intVal || !sv_deltaHash) {
+		MSG_WriteDeltaEntity (msg, from, to, force, newEntity);
+		return;
+	}
+
+	hash = SV_DeltaHash (from, to);
+	bucket = hash & (DELTA_CACHE_HASH-1);
+	lock = sv_deltaLocks[bucket & (DELTA_CACHE_LOCKS-1)];
+
+	Sys_LockMutex (lock);
+	for (entry=sv_deltaHash[bucket] ; entry ; entry=entry->hashNext) {
+		if (entry->hash == hash
+		&& entry->force == force
+		&& entry->newEntity == newEntity
+		&& !memcmp (&entry->from, from, sizeof (entityStateOld_t))
+		&& !memcmp (&entry->to, to, sizeof (entityStateOld_t)))
+			break;
+	}
+	Sys_UnlockMutex (lock);
+
+	// Entries aren't touched again until the next reset
+	if (entry) {
+		if (entry->len)
+			MSG_WriteRaw (msg, sv_deltaBytes + entry->ofs, entry->len);
+		Sys_AtomicAdd (&sv.deltaCacheHits, 1);
+		return;
+	}
+
+	MSG_Init (&delta, deltaBuff, sizeof (deltaBuff));
+	MSG_WriteDeltaEntity (&delta, from, to, force, newEntity);
+	if (delta.curSize)
+		MSG_WriteRaw (msg, delta.data, delta.curSize);
+	Sys_AtomicAdd (&sv.deltaCacheMisses, 1);
+
+	// Keep it if there's room
+	index = Sys_AtomicAdd (&sv_numDeltaEntries, 1);
+	if (index >= DELTA_CACHE_ENTRIES)
+		return;
+	ofs = Sys_AtomicAdd (&sv_numDeltaBytes, (int)delta.curSize);
+	if (ofs + (int)delta.curSize > DELTA_CACHE_BYTES)
+		return;
+
+	entry = &sv_deltaEntries[index];
+	entry->from = *from;
+	entry->to = *to;
+	entry->force = force;
+	entry->newEntity = newEntity;
+	entry->hash = hash;
+	entry->ofs = ofs;
+	entry->len = (int)delta.curSize;
+	memcpy (sv_deltaBytes + ofs, delta.data, delta.curSize);
+
+	Sys_LockMutex (lock);
+	entry->hashNext = sv_deltaHash[bucket];
+	sv_deltaHash[bucket] = entry;
+	Sys_UnlockMutex (lock);
+}
+
 /*
 =============================================================================
 
@@ -81,7 +243,7 @@ static void SV_EmitPacketEntities (clientFrame_t *from, clientFrame_t *to, netMs
 			** note that players are always 'newentities', this updates their oldorigin always
 			** and prevents warping
 			*/
-			MSG_WriteDeltaEntity (msg, oldEnt, newEnt, qFalse, newEnt->number <= maxclients->intVal);
+			SV_WriteDeltaEntity (msg, oldEnt, newEnt, qFalse, newEnt->number <= maxclients->intVal);
 			oldIndex++;
 			newIndex++;
 			continue;
@@ -89,7 +251,7 @@ static void SV_EmitPacketEntities (clientFrame_t *from, clientFrame_t *to, netMs
 
 		if (newNum < oldNum) {
 			// This is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity (msg, &sv.baseLines[newNum], newEnt, qTrue, qTrue);
+			SV_WriteDeltaEntity (msg, &sv.baseLines[newNum], newEnt, qTrue, qTrue);
 			newIndex++;
 			continue;
 		}
@@ -356,7 +518,61 @@ void SV_WriteFrameToClient (svClient_t *client, netMsg_t *msg)
 =============================================================================
 */
 
-static byte		sv_fatPVS[65536/8];	// 32767 is Q2BSP_MAX_LEAFS
+static byte		*sv_viewVis;			// fat PVS and PHS rows for every client view
+static int		sv_viewVisSize;
+
+// entities that could be sent this frame, see SV_PrepareClientFrames
+typedef struct svVisSlot_s {
+	int				cluster;
+	uint64			bits[MAX_CS_EDICTS/64];		// candidates in the cluster
+} svVisSlot_t;
+
+typedef struct svVisMap_s {
+	int				stamp;
+	int				slot;
+} svVisMap_t;
+
+static edict_t		*sv_candidates[MAX_CS_EDICTS];
+static int			sv_candidateIndex[MAX_CS_EDICTS];		// -1 if not a candidate
+static int			sv_numCandidates;
+static uint64		sv_specialCandidates[MAX_CS_EDICTS/64];	// beams and headnode checks
+
+static svVisSlot_t	*sv_visSlots;			// one per cluster with a candidate in it
+static int			sv_numVisSlots;
+static int			sv_maxVisSlots;
+static svVisMap_t	*sv_visMap;				// cluster to slot, valid if stamped this frame
+static int			sv_visMapSize;
+static int			sv_visStamp;
+
+/*
+============
+SV_AllocClientViews
+
+Points each view at its own pair of vis rows, so views can be culled against
+in parallel while the collision model's row cache moves on underneath.
+============
+*/
+void SV_AllocClientViews (svClientView_t *views, int numViews)
+{
+	int		rowBytes, size;
+	int		i;
+
+	// Keep the rows 64-bit aligned for CM_VisOr
+	rowBytes = max (((CM_NumClusters () + 63) >> 6) << 3, 8);
+	size = rowBytes * 2 * max (numViews, 1);
+	if (size > sv_viewVisSize) {
+		if (sv_viewVis)
+			Mem_Free (sv_viewVis);
+		sv_viewVis = Mem_PoolAlloc (size, sv_genericPool, 0);
+		sv_viewVisSize = size;
+	}
+
+	for (i=0 ; i<numViews ; i++) {
+		views[i].pvs = sv_viewVis + rowBytes * (i*2);
+		views[i].phs = sv_viewVis + rowBytes * (i*2 + 1);
+	}
+}
+
 
 /*
 ============
@@ -366,12 +582,11 @@ The client will interpolate the view position,
 so we can't use a single PVS point
 ===========
 */
-static void SV_FatPVS (vec3_t org)
+static void SV_FatPVS (vec3_t org, byte *fatPVS)
 {
 	int		leafs[64];
 	int		i, j, count;
-	int		longs;
-	byte	*src;
+	int		rowBytes;
 	vec3_t	mins, maxs;
 
 	for (i=0 ; i<3 ; i++) {
@@ -382,13 +597,13 @@ static void SV_FatPVS (vec3_t org)
 	count = CM_BoxLeafnums (mins, maxs, leafs, 64, NULL);
 	if (count < 1)
 		Com_Error (ERR_FATAL, "SV_FatPVS: count < 1");
-	longs = (CM_NumClusters()+31)>>5;
+	rowBytes = (CM_NumClusters()+7)>>3;
 
 	// convert leafs to clusters
 	for (i=0 ; i<count ; i++)
 		leafs[i] = CM_LeafCluster(leafs[i]);
 
-	memcpy (sv_fatPVS, CM_ClusterPVS(leafs[0]), longs<<2);
+	memcpy (fatPVS, CM_ClusterPVS(leafs[0]), rowBytes);
 	// or in all the other leaf bits
 	for (i=1 ; i<count ; i++) {
 		for (j=0 ; j<i ; j++)
@@ -396,39 +611,30 @@ static void SV_FatPVS (vec3_t org)
 				break;
 		if (j != i)
 			continue;		// already have the cluster we want
-		src = CM_ClusterPVS(leafs[i]);
-		for (j=0 ; j<longs ; j++)
-			((long *)sv_fatPVS)[j] |= ((long *)src)[j];
+		CM_VisOr (fatPVS, CM_ClusterPVS(leafs[i]), rowBytes);
 	}
 }
 
 
 /*
 =============
-SV_BuildClientFrame
+SV_SetupClientView
 
-Decides which entities are going to be visible to the client, and
-copies off the playerstat and areaBits.
+Everything SV_CullClientFrame needs from the collision model, worked out up
+front on the main thread. The view origin comes from the client's own
+playerState_t unless one is given. Returns qFalse if the client isn't in the
+game yet.
 =============
 */
-void SV_BuildClientFrame (svClient_t *client)
+qBool SV_SetupClientView (svClient_t *client, svClientView_t *view, float *origin)
 {
-	int			e, i;
-	vec3_t		org;
-	edict_t		*ent;
-	edict_t		*clent;
+	edict_t			*clent;
 	clientFrame_t	*frame;
-	entityStateOld_t	*state;
-	int			l;
-	int			clientarea, clientcluster;
-	int			leafnum;
-	int			c_fullsend;
-	byte		*clientphs;
-	byte		*bitvector;
+	int				leafnum;
 
 	clent = client->edict;
 	if (!clent->client)
-		return;		// not in game yet
+		return qFalse;		// not in game yet
 
 	// This is the frame we are creating
 	frame = &client->frames[sv.frameNum & UPDATE_MASK];
@@ -436,31 +642,92 @@ void SV_BuildClientFrame (svClient_t *client)
 	frame->sentTime = svs.realTime; // save it for ping calc later
 
 	// Find the client's PVS
-	org[0] = clent->client->playerState.pMove.origin[0]*(1.0f/8.0f) + clent->client->playerState.viewOffset[0];
-	org[1] = clent->client->playerState.pMove.origin[1]*(1.0f/8.0f) + clent->client->playerState.viewOffset[1];
-	org[2] = clent->client->playerState.pMove.origin[2]*(1.0f/8.0f) + clent->client->playerState.viewOffset[2];
+	if (origin) {
+		Vec3Copy (origin, view->origin);
+	}
+	else {
+		view->origin[0] = clent->client->playerState.pMove.origin[0]*(1.0f/8.0f) + clent->client->playerState.viewOffset[0];
+		view->origin[1] = clent->client->playerState.pMove.origin[1]*(1.0f/8.0f) + clent->client->playerState.viewOffset[1];
+		view->origin[2] = clent->client->playerState.pMove.origin[2]*(1.0f/8.0f) + clent->client->playerState.viewOffset[2];
+	}
 
-	leafnum = CM_PointLeafnum (org);
-	clientarea = CM_LeafArea (leafnum);
-	clientcluster = CM_LeafCluster (leafnum);
+	leafnum = CM_PointLeafnum (view->origin);
+	view->area = CM_LeafArea (leafnum);
 
 	// calculate the visible areas
-	frame->areaBytes = CM_WriteAreaBits (frame->areaBits, clientarea);
+	frame->areaBytes = CM_WriteAreaBits (frame->areaBits, view->area);
 
 	// grab the current playerState_t
 	frame->playerState = clent->client->playerState;
 
-	SV_FatPVS (org);
-	clientphs = CM_ClusterPHS (clientcluster);
+	SV_FatPVS (view->origin, view->pvs);
+	memcpy (view->phs, CM_ClusterPHS (CM_LeafCluster (leafnum)), (CM_NumClusters()+7)>>3);
+	return qTrue;
+}
 
-	// build up the list of visible entities
-	frame->numEntities = 0;
-	frame->firstEntity = svs.nextClientEntities;
 
-	c_fullsend = 0;
+/*
+=============
+SV_GrowVisSlots
+=============
+*/
+static void SV_GrowVisSlots (void)
+{
+	svVisSlot_t	*slots;
+
+	sv_maxVisSlots = max (sv_maxVisSlots * 2, 256);
+	slots = Mem_PoolAlloc (sizeof (svVisSlot_t) * sv_maxVisSlots, sv_genericPool, 0);
+	if (sv_visSlots) {
+		memcpy (slots, sv_visSlots, sizeof (svVisSlot_t) * sv_numVisSlots);
+		Mem_Free (sv_visSlots);
+	}
+	sv_visSlots = slots;
+}
+
+
+/*
+=============
+SV_PrepareClientFrames
+
+Done once a frame before any client frames are built. Everything about an
+entity that doesn't depend on who is looking is worked out here: whether it
+is sent at all, and which clusters it's in. Each cluster that holds an
+entity gets a bitset of the candidates in it, so a client only tests those
+clusters against its PVS and ORs in the ones it can see. Beams, which go by PHS, and entities in too
+many clusters to list, which go by headnode, are left to be checked one at
+a time. Also fixes up entity numbers, so building the frames never writes
+to the edicts.
+=============
+*/
+void SV_PrepareClientFrames (void)
+{
+	edict_t		*ent;
+	int			numClusters;
+	int			e, i, l;
+	int			slot;
+
+	sv_visStamp++;
+	sv_numCandidates = 0;
+	sv_numVisSlots = 0;
+	memset (sv_specialCandidates, 0, sizeof (sv_specialCandidates));
+	for (e=0 ; e<MAX_CS_EDICTS ; e++)
+		sv_candidateIndex[e] = -1;
+
+	// Cluster slots are mapped per map
+	numClusters = CM_NumClusters ();
+	if (numClusters > sv_visMapSize) {
+		if (sv_visMap)
+			Mem_Free (sv_visMap);
+		sv_visMap = Mem_PoolAlloc (sizeof (svVisMap_t) * numClusters, sv_genericPool, 0);
+		sv_visMapSize = numClusters;
+	}
 
-	for (e=1 ; e<ge->numEdicts ; e++) {
+	for (e=1 ; e<ge->numEdicts && e<MAX_CS_EDICTS ; e++) {
 		ent = EDICT_NUM(e);
+		if (ent->s.number != e) {
+			Com_DevPrintf (0, "FIXING ENT->S.NUMBER!!!\n");
+			ent->s.number = e;
+		}
 
 		// ignore ents without visible models
 		if (ent->svFlags & SVF_NOCLIENT)
@@ -470,78 +737,286 @@ void SV_BuildClientFrame (svClient_t *client)
 		if (!ent->s.modelIndex && !ent->s.effects && !ent->s.sound && !ent->s.event)
 			continue;
 
-		// ignore if not touching a PV leaf
-		if (ent != clent) {
-			// check area
-			if (!CM_AreasConnected (clientarea, ent->areaNum)) {
-				/*
-				** doors can legally straddle two areas, so
-				** we may need to check another one
-				*/
-				if (!ent->areaNum2 || !CM_AreasConnected (clientarea, ent->areaNum2))
-					continue;		// blocked by a door
-			}
+		sv_candidateIndex[e] = sv_numCandidates;
+		sv_candidates[sv_numCandidates] = ent;
 
-			// beams just check one point for PHS
-			if (ent->s.renderFx & RF_BEAM) {
-				l = ent->clusterNums[0];
-				if (!(clientphs[l >> 3] & (1 << (l&7))))
+		if (ent->s.renderFx & RF_BEAM || ent->numClusters == -1) {
+			sv_specialCandidates[sv_numCandidates>>6] |= (uint64)1 << (sv_numCandidates&63);
+		}
+		else {
+			for (i=0 ; i<ent->numClusters ; i++) {
+				l = ent->clusterNums[i];
+				if (l < 0 || l >= numClusters)
 					continue;
-			}
-			else {
-				// FIXME: if an ent has a model and a sound, but isn't
-				// in the PVS, only the PHS, clear the model
-				if (ent->s.sound)
-					bitvector = sv_fatPVS;	//clientphs;
-				else
-					bitvector = sv_fatPVS;
-
-				if (ent->numClusters == -1) {
-					// too many leafs for individual check, go by headnode
-					if (!CM_HeadnodeVisible (ent->headNode, bitvector))
-						continue;
-					c_fullsend++;
-				}
-				else {
-					// check individual leafs
-					for (i=0 ; i < ent->numClusters ; i++) {
-						l = ent->clusterNums[i];
-						if (bitvector[l >> 3] & (1 << (l&7)))
-							break;
-					}
-					if (i == ent->numClusters)
-						continue;		// not visible
-				}
 
-				if (!ent->s.modelIndex) {
-					// don't send sounds if they will be attenuated away
-					vec3_t	delta;
-					float	len;
+				if (sv_visMap[l].stamp != sv_visStamp) {
+					if (sv_numVisSlots == sv_maxVisSlots)
+						SV_GrowVisSlots ();
 
-					Vec3Subtract (org, ent->s.origin, delta);
-					len = Vec3Length (delta);
-					if (len > 400)
-						continue;
+					sv_visMap[l].stamp = sv_visStamp;
+					sv_visMap[l].slot = sv_numVisSlots;
+					sv_visSlots[sv_numVisSlots].cluster = l;
+					memset (sv_visSlots[sv_numVisSlots].bits, 0, sizeof (sv_visSlots[sv_numVisSlots].bits));
+					sv_numVisSlots++;
 				}
+
+				slot = sv_visMap[l].slot;
+				sv_visSlots[slot].bits[sv_numCandidates>>6] |= (uint64)1 << (sv_numCandidates&63);
 			}
 		}
 
-		// add it to the circular clientEntities array
-		state = &svs.clientEntities[svs.nextClientEntities%svs.numClientEntities];
-		if (ent->s.number != e) {
-			Com_DevPrintf (0, "FIXING ENT->S.NUMBER!!!\n");
-			ent->s.number = e;
+		sv_numCandidates++;
+	}
+}
+
+
+/*
+=============
+SV_CandidateVisible
+
+The per-client part of the old edict walk, for a candidate that the cluster
+sets already let through, or that has to be checked on its own.
+=============
+*/
+static qBool SV_CandidateVisible (edict_t *ent, svClientView_t *view, qBool special)
+{
+	vec3_t	delta;
+	int		l;
+
+	// check area
+	if (!CM_AreasConnected (view->area, ent->areaNum)) {
+		/*
+		** doors can legally straddle two areas, so
+		** we may need to check another one
+		*/
+		if (!ent->areaNum2 || !CM_AreasConnected (view->area, ent->areaNum2))
+			return qFalse;		// blocked by a door
+	}
+
+	// beams just check one point for PHS
+	if (ent->s.renderFx & RF_BEAM) {
+		l = ent->clusterNums[0];
+		return (view->phs[l >> 3] & (1 << (l&7))) ? qTrue : qFalse;
+	}
+
+	// too many leafs for individual check, go by headnode
+	if (special && !CM_HeadnodeVisible (ent->headNode, view->pvs))
+		return qFalse;
+
+	// FIXME: if an ent has a model and a sound, but isn't
+	// in the PVS, only the PHS, clear the model
+	if (!ent->s.modelIndex) {
+		// don't send sounds if they will be attenuated away
+		Vec3Subtract (view->origin, ent->s.origin, delta);
+		if (Vec3Length (delta) > 400)
+			return qFalse;
+	}
+
+	return qTrue;
+}
+
+
+/*
+=============
+SV_CullClientFrame
+
+Decides which entities are going to be visible to the client from a view
+set up by SV_SetupClientView, out of the candidates SV_PrepareClientFrames
+found. Only reads shared state, apart from reserving its run of
+svs.clientEntities, so it's safe to call for several clients at once.
+=============
+*/
+void SV_CullClientFrame (svClient_t *client, svClientView_t *view)
+{
+	uint64			visBits[MAX_CS_EDICTS/64];
+	uint64			*slotBits, word;
+	int				visible[MAX_CS_EDICTS];
+	int				numVisible, numWords;
+	int				c, i, w, l;
+	int				first;
+	edict_t			*ent;
+	edict_t			*clent;
+	clientFrame_t	*frame;
+	entityStateOld_t	*state;
+
+	clent = client->edict;
+	frame = &client->frames[sv.frameNum & UPDATE_MASK];
+
+	// Gather every candidate in a cluster the fat PVS can see
+	numWords = (sv_numCandidates + 63) >> 6;
+	memset (visBits, 0, sizeof (uint64) * numWords);
+	for (i=0 ; i<sv_numVisSlots ; i++) {
+		l = sv_visSlots[i].cluster;
+		if (!(view->pvs[l >> 3] & (1 << (l&7))))
+			continue;
+
+		slotBits = sv_visSlots[i].bits;
+		for (w=0 ; w<numWords ; w++)
+			visBits[w] |= slotBits[w];
+	}
+
+	// build up the list of visible entities, in entity order
+	numVisible = 0;
+	for (w=0 ; w<numWords ; w++) {
+		word = visBits[w] | sv_specialCandidates[w];
+		for (c=w<<6 ; word ; c++, word>>=1) {
+			if (!(word & 1))
+				continue;
+
+			// the client's own entity always goes
+			ent = sv_candidates[c];
+			if (ent != clent && !SV_CandidateVisible (ent, view, (sv_specialCandidates[w] >> (c&63)) & 1))
+				continue;
+
+			visible[numVisible++] = ent->s.number;
 		}
-		//memcpy (&state, &ent->s, sizeof (entityStateOld_t));
+	}
+
+	// the client's own entity is never culled, but might not be in a visible cluster
+	c = sv_candidateIndex[NUM_FOR_EDICT(clent)];
+	if (c >= 0 && !((visBits[c>>6] | sv_specialCandidates[c>>6]) & ((uint64)1 << (c&63)))) {
+		for (i=numVisible ; i>0 && visible[i-1]>clent->s.number ; i--)
+			visible[i] = visible[i-1];
+		visible[i] = clent->s.number;
+		numVisible++;
+	}
+
+	// add them to the circular clientEntities array
+	first = Sys_AtomicAdd ((volatile int *)&svs.nextClientEntities, numVisible);
+	frame->firstEntity = first;
+	frame->numEntities = numVisible;
+
+	for (i=0 ; i<numVisible ; i++) {
+		ent = EDICT_NUM(visible[i]);
+		state = &svs.clientEntities[(first+i)%svs.numClientEntities];
 		*state = ent->s;
 
 		// don't mark players missiles as solid
 		if (ent->owner == client->edict)
 			state->solid = SOLID_NOT;
+	}
+}
+
+
+/*
+=============
+SV_BuildClientFrame
+
+Decides which entities are going to be visible to the client, and
+copies off the playerstat and areaBits.
+=============
+*/
+void SV_BuildClientFrame (svClient_t *client)
+{
+	svClientView_t	view;
+
+	SV_AllocClientViews (&view, 1);
+	if (SV_SetupClientView (client, &view, NULL))
+		SV_CullClientFrame (client, &view);
+}
+
+
+/*
+==================
+SV_WriteServerDemo
+
+Writes a serverrecord message prefixed by its length, counting the bytes for the index
+==================
+*/
+void SV_WriteServerDemo (byte *data, int length)
+{
+	int		swLen;
+
+	swLen = LittleLong (length);
+	FS_Write (&swLen, sizeof (swLen), svs.demoFile);
+	if (length)
+		FS_Write (data, length, svs.demoFile);
+
+	svs.demoBytes += sizeof (swLen) + length;
+}
+
+
+/*
+==================
+SV_CloseServerDemo
+
+Ends the message stream and puts the keyframe index behind it
+==================
+*/
+void SV_CloseServerDemo (void)
+{
+	int		len, i;
 
-		svs.nextClientEntities++;
-		frame->numEntities++;
+	if (svs.numDemoKeys) {
+		len = -1;
+		FS_Write (&len, sizeof (len), svs.demoFile);
+
+		for (i=0 ; i<svs.numDemoKeys ; i++) {
+			svs.demoKeys[i].time = LittleLong (svs.demoKeys[i].time);
+			svs.demoKeys[i].offset = LittleLong (svs.demoKeys[i].offset);
+		}
+		FS_Write (svs.demoKeys, sizeof (demoIndex_t) * svs.numDemoKeys, svs.demoFile);
+
+		len = LittleLong (svs.numDemoKeys);
+		FS_Write (&len, sizeof (len), svs.demoFile);
+		len = LittleLong (DEMO_INDEX_MAGIC);
+		FS_Write (&len, sizeof (len), svs.demoFile);
+
+		Com_DevPrintf (0, "Indexed %i demo keyframes\n", svs.numDemoKeys);
+		svs.numDemoKeys = 0;
+	}
+
+	FS_CloseFile (svs.demoFile);
+	svs.demoFile = 0;
+}
+
+
+/*
+==================
+SV_WriteDemoKeyframe
+
+Every serverrecord frame is written without deltas, so any of them can be
+seeked to. Every demo_keyframes seconds one is indexed, with the whole
+configstring table repeated ahead of it, empty slots cleared, so it doesn't
+depend on anything a seek skipped or left behind.
+==================
+*/
+static void SV_WriteDemoKeyframe (void)
+{
+	byte		buf_data[MAX_SV_USABLEMSG];
+	netMsg_t	buf;
+	int			time;
+	int			i;
+
+	time = (sv.frameNum - svs.demoStartFrame) * 100;
+	if (svs.numDemoKeys && time - svs.demoLastKeyTime < sv_demoKeyframes->floatVal * 1000)
+		return;
+
+	if (svs.numDemoKeys == DEMO_MAX_KEYS) {
+		Com_DevPrintf (PRNT_WARNING, "SV_WriteDemoKeyframe: index full, the rest of the demo won't be seekable\n");
+		svs.demoIndexing = qFalse;
+		return;
 	}
+
+	svs.demoKeys[svs.numDemoKeys].time = time;
+	svs.demoKeys[svs.numDemoKeys].offset = svs.demoBytes;
+	svs.numDemoKeys++;
+	svs.demoLastKeyTime = time;
+
+	MSG_Init (&buf, buf_data, sizeof (buf_data));
+	for (i=0 ; i<MAX_CFGSTRINGS ; i++) {
+		if (buf.curSize + (int)strlen (sv.configStrings[i]) + 32 > buf.maxSize) {
+			SV_WriteServerDemo (buf.data, (int) buf.curSize);
+			buf.curSize = 0;
+		}
+
+		MSG_WriteByte (&buf, SVC_CONFIGSTRING);
+		MSG_WriteShort (&buf, i);
+		MSG_WriteString (&buf, sv.configStrings[i]);
+	}
+
+	if (buf.curSize)
+		SV_WriteServerDemo (buf.data, (int) buf.curSize);
 }
 
 
@@ -560,7 +1035,6 @@ void SV_RecordDemoMessage (void)
 	entityStateOld_t	nostate;
 	netMsg_t		buf;
 	static byte		buf_data[32768];
-	int				len;
 
 	if (!svs.demoFile)
 		return;
@@ -594,7 +1068,7 @@ void SV_RecordDemoMessage (void)
 	MSG_Clear (&svs.demoMultiCast);
 
 	// now write the entire message to the file, prefixed by the length
-	len = LittleLong ((int) buf.curSize);
-	FS_Write (&len, sizeof (len), svs.demoFile);
-	FS_Write (buf.data, buf.curSize, svs.demoFile);
+	if (svs.demoIndexing)
+		SV_WriteDemoKeyframe ();
+	SV_WriteServerDemo (buf.data, (int) buf.curSize);
 }
@@ -484,6 +484,8 @@ void SV_GameAPI_Init (void)
 	gi.unlinkentity			= SV_UnlinkEdict;
 	gi.BoxEdicts			= SV_AreaEdicts;
 	gi.trace				= SV_Trace;
+	gi.BoxTraceBatch		= CM_BoxTraceBatch;
+	gi.TraceBatch			= SV_TraceBatch;
 	gi.pointcontents		= SV_PointContents;
 	gi.setmodel				= GI_SetModel;
 	gi.inPVS				= GI_IsInPVS;
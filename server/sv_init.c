@@ -139,6 +139,12 @@ static void SV_SpawnServer (char *server, char *spawnPoint, ssState_t serverStat
 		sv.demoFile = 0;
 	}
 
+	// Let a serverrecord catch up while the level loads, a seek can't cross the level change
+	if (svs.demoFile) {
+		FS_FlushFile (svs.demoFile);
+		svs.demoIndexing = qFalse;
+	}
+
 	svs.spawnCount++;	// Any partially connected client will be restarted
 
 	// Wipe the entire per-level structure
@@ -289,6 +295,7 @@ void SV_GameInit (void)
 
 	svs.spawnCount = rand ();
 	svs.clients = Mem_PoolAlloc (sizeof (svClient_t)*maxclients->intVal, sv_genericPool, 0);
+	SV_ClientHashInit ();
 	svs.numClientEntities = maxclients->intVal*UPDATE_BACKUP*64;
 	svs.clientEntities = Mem_PoolAlloc (sizeof (entityStateOld_t)*svs.numClientEntities, sv_genericPool, 0);
 
@@ -59,6 +59,16 @@ typedef struct server_s {
 	// demo server information
 	fileHandle_t		demoFile;
 	qBool				timeDemo;			// don't time sync
+	int					numDemoKeys;		// keyframe index for demo_seek
+	demoIndex_t			demoKeys[DEMO_MAX_KEYS];
+
+	// client leaf cache statistics, see showmulticast
+	int					leafCacheHits;
+	int					leafCacheMisses;
+
+	// entity delta cache statistics, see showdeltacache
+	volatile int		deltaCacheHits;
+	volatile int		deltaCacheMisses;
 } serverState_t;
 
 extern serverState_t	sv;					// local server
@@ -95,6 +105,14 @@ typedef enum svCLState_s {
 	SVCS_SPAWNED	// client is fully in game
 } svCLState_t;
 
+// what a client frame is culled against, see SV_SetupClientView
+typedef struct svClientView_s {
+	vec3_t			origin;
+	int				area;
+	byte			*pvs;							// fat PVS around origin
+	byte			*phs;
+} svClientView_t;
+
 typedef struct svClient_s {
 	svCLState_t		state;
 
@@ -124,9 +142,15 @@ typedef struct svClient_s {
 
 	clientFrame_t	frames[UPDATE_BACKUP];			// updates can be delta'd from here
 
+	struct svDownload_s	*downloadCache;				// shared copy download points into
 	byte			*download;						// file being downloaded
 	int				downloadSize;					// total bytes (can't use EOF because of paks)
 	int				downloadCount;					// bytes sent
+	qBool			downloadCompress;				// client asked for SVC_ZDOWNLOAD ("udp-zlib")
+	int				downloadPending;				// chunks sent that haven't been answered with nextdl
+	int				downloadCredit;					// bytes that can go out under the client's rate
+	int				downloadCreditTime;
+	int				downloadStart;
 
 	int				lastMessage;					// sv.frameNum when packet was last received
 	int				lastConnect;
@@ -136,6 +160,14 @@ typedef struct svClient_s {
 	netChan_t		netChan;
 
 	uint32			protocol;						// client protocol
+
+	// leaf under edict->s.origin, shared by every multicast and sound
+	// until the client moves (see SV_ClientLeaf)
+	int				leafSpawnCount;
+	vec3_t			leafOrigin;
+	int				leafNum;
+	int				leafCluster;
+	int				leafArea;
 } svClient_t;
 
 // a client can leave the server in one of four ways:
@@ -173,6 +205,8 @@ typedef struct serverStatic_s {
 	int					spawnCount;					// incremented each server start -- used to check late spawns
 
 	svClient_t			*clients;					// [maxclients->floatVal];
+	svClient_t			**clientHash;				// open-addressed on (address, qPort), see SV_ClientHashFind
+	int					clientHashMask;
 	int					numClientEntities;			// maxclients->floatVal*UPDATE_BACKUP*MAX_PACKET_ENTITIES
 	int					nextClientEntities;			// next client_entity to use
 	entityStateOld_t	*clientEntities;			// [numClientEntities]
@@ -185,6 +219,14 @@ typedef struct serverStatic_s {
 	fileHandle_t		demoFile;
 	netMsg_t			demoMultiCast;
 	byte				demoMultiCastBuf[MAX_SV_MSGLEN];
+	int					demoBytes;					// written so far, for keyframe offsets
+
+	// Serverrecord keyframe index, see demo_keyframes
+	qBool				demoIndexing;				// off once full or the map changes
+	int					demoStartFrame;
+	int					demoLastKeyTime;
+	int					numDemoKeys;
+	demoIndex_t			demoKeys[DEMO_MAX_KEYS];
 } serverStatic_t;
 
 extern serverStatic_t	svs;
@@ -213,6 +255,16 @@ extern	cVar_t		*sv_noreload;			// don't reload level state when reentering
 extern	cVar_t		*sv_airaccelerate;		// don't reload level state when reentering
 											// development tool
 extern	cVar_t		*sv_enforcetime;
+extern	cVar_t		*sv_showmulticast;
+extern	cVar_t		*sv_areaIndex;
+extern	cVar_t		*sv_areaGridSize;
+extern	cVar_t		*sv_downloadWindow;
+extern	cVar_t		*sv_downloadCacheMB;
+extern	cVar_t		*sv_downloadPrecompress;
+extern	cVar_t		*sv_snapshotJobs;
+extern	cVar_t		*sv_deltaCache;
+extern	cVar_t		*sv_showdeltacache;
+extern	cVar_t		*sv_demoKeyframes;
 
 extern	svClient_t	*sv_currentClient;
 extern	edict_t		*sv_currentEdict;
@@ -245,6 +297,9 @@ int		SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **list, int maxCount, int
 // bounding boxes that intersect the given area. It is possible
 // for a non-axial bmodel to be returned that doesn't actually
 // intersect the area on an exact test.
+
+void	SV_AreaRecordFrame (void);
+void	SV_WorldCommandInit (void);
 // returns the number of pointers filled in
 // ??? does this always return the world?
 
@@ -269,6 +324,9 @@ trace_t	SV_Trace (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, edict_t *p
 
 // passedict is explicitly excluded from clipping checks (normally NULL)
 
+void	SV_TraceBatch (const traceReq_t *reqs, edict_t **passEdicts, trace_t *out, int numReqs);
+// SV_Trace for many moves at once, world headNode only
+
 // ==========================================================================
 
 //
@@ -282,8 +340,16 @@ void		SV_ReadLevelFile (void);
 //
 
 void		SV_WriteFrameToClient (svClient_t *client, netMsg_t *msg);
+void		SV_WriteServerDemo (byte *data, int length);
+void		SV_CloseServerDemo (void);
 void		SV_RecordDemoMessage (void);
 void		SV_BuildClientFrame (svClient_t *client);
+void		SV_ResetDeltaCache (void);
+
+void		SV_AllocClientViews (svClientView_t *views, int numViews);
+qBool		SV_SetupClientView (svClient_t *client, svClientView_t *view, float *origin);
+void		SV_PrepareClientFrames (void);
+void		SV_CullClientFrame (svClient_t *client, svClientView_t *view);
 
 //
 // sv_gameapi.c
@@ -306,6 +372,12 @@ void		SV_LoadMap (qBool attractLoop, char *levelString, qBool loadGame, qBool de
 //
 
 void		SV_SetState (ssState_t state);
+
+void		SV_ClientHashInit (void);
+svClient_t	*SV_ClientHashFind (netAdr_t *adr, int qPort);
+void		SV_ClientHashAdd (svClient_t *cl);
+void		SV_ClientHashRemove (svClient_t *cl);
+
 void		SV_DropClient (svClient_t *drop);
 void		SV_UserinfoChanged (svClient_t *cl);
 void		SV_UpdateTitle (void);
@@ -324,7 +396,11 @@ void		SV_Pmove (pMoveNew_t *pMove, float airAcceleration);
 // sv_send.c
 //
 
+void		SV_LoadDemoIndex (int fileLen);
+void		SV_SeekDemo (int msec);
+qBool		SV_RateDrop (svClient_t *c);
 void		SV_SendClientMessages (void);
+void		SV_SendCommandInit (void);
 
 void		SV_Unicast (edict_t *ent, qBool reliable);
 void		SV_Multicast (vec3_t origin, multiCast_t to);
@@ -339,4 +415,8 @@ void		SV_BroadcastCommand (char *fmt, ...);
 //
 
 void		SV_Nextserver (void);
+void		SV_ReleaseDownload (svClient_t *cl);
+void		SV_DownloadCacheShutdown (void);
+void		SV_DownloadCommandInit (void);
+void		SV_SendDownload (svClient_t *cl);
 void		SV_ExecuteClientMessage (svClient_t *cl);
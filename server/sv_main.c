@@ -43,6 +43,9 @@ cVar_t	*allow_download_players;
 cVar_t	*allow_download_models;
 cVar_t	*allow_download_sounds;
 cVar_t	*allow_download_maps;
+cVar_t	*sv_downloadWindow;		// download chunks in flight before waiting on nextdl
+cVar_t	*sv_downloadCacheMB;		// size cap for files nobody is downloading
+cVar_t	*sv_downloadPrecompress;	// deflate cached files once for SVC_ZDOWNLOAD
 
 cVar_t	*sv_airaccelerate;
 
@@ -50,6 +53,15 @@ cVar_t	*sv_noreload;			// don't reload level state when reentering
 
 cVar_t	*maxclients;
 cVar_t	*sv_showclamp;
+cVar_t	*sv_showmulticast;
+
+cVar_t	*sv_areaIndex;
+cVar_t	*sv_areaGridSize;
+
+cVar_t	*sv_snapshotJobs;		// build client frames on the job workers
+cVar_t	*sv_deltaCache;			// share encoded entity deltas between clients
+cVar_t	*sv_showdeltacache;
+cVar_t	*sv_demoKeyframes;			// seconds between indexed serverrecord keyframes
 
 cVar_t	*hostname;
 cVar_t	*public_server;			// should heartbeats be sent
@@ -70,6 +82,163 @@ void SV_SetState (ssState_t state)
 }
 
 
+/*
+=============================================================================
+
+	CLIENT HASH
+
+	Maps a packet's (address, qPort) to the connected client in SV_ReadPackets
+	without walking every slot. A client is hashed from Netchan_Setup until
+	its slot goes free, under the netChan address it was added with, so the
+	address must not change while it's in the table.
+
+=============================================================================
+*/
+
+/*
+=====================
+SV_ClientHashKey
+=====================
+*/
+static uint32 SV_ClientHashKey (netAdr_t *adr, int qPort)
+{
+	uint32	key;
+
+	key = (uint32)qPort & 0xffff;
+	if (adr->naType == NA_IP) {
+		key ^= *(uint32 *)adr->ip * 2654435761U;
+		key ^= (uint32)adr->port << 16;
+	}
+
+	key ^= key >> 15;
+	key *= 0x2c1b3c6d;
+	key ^= key >> 12;
+	return key;
+}
+
+
+/*
+=====================
+SV_ClientHashMatch
+=====================
+*/
+static qBool SV_ClientHashMatch (svClient_t *cl, netAdr_t *adr, int qPort)
+{
+	if (cl->netChan.qPort != qPort)
+		return qFalse;
+	if (!(NET_CompareBaseAdr ((*adr), cl->netChan.remoteAddress)))
+		return qFalse;
+	if (adr->naType == NA_IP && adr->port != cl->netChan.remoteAddress.port)
+		return qFalse;
+	return qTrue;
+}
+
+
+/*
+=====================
+SV_ClientHashInit
+
+Called after svs.clients is allocated
+=====================
+*/
+void SV_ClientHashInit (void)
+{
+	int		size;
+
+	// Keep the load under half so probes stay short
+	for (size=16 ; size<maxclients->intVal*2 ; size<<=1) ;
+
+	if (svs.clientHash)
+		Mem_Free (svs.clientHash);
+	svs.clientHash = Mem_PoolAlloc (sizeof (svClient_t *) * size, sv_genericPool, 0);
+	svs.clientHashMask = size - 1;
+}
+
+
+/*
+=====================
+SV_ClientHashFind
+=====================
+*/
+svClient_t *SV_ClientHashFind (netAdr_t *adr, int qPort)
+{
+	svClient_t	*cl;
+	uint32		i;
+
+	if (!svs.clientHash)
+		return NULL;
+
+	for (i=SV_ClientHashKey (adr, qPort) ; ; i++) {
+		cl = svs.clientHash[i & svs.clientHashMask];
+		if (!cl)
+			return NULL;
+		if (SV_ClientHashMatch (cl, adr, qPort))
+			return cl;
+	}
+}
+
+
+/*
+=====================
+SV_ClientHashAdd
+=====================
+*/
+void SV_ClientHashAdd (svClient_t *cl)
+{
+	uint32	i;
+
+	if (!svs.clientHash)
+		return;
+
+	for (i=SV_ClientHashKey (&cl->netChan.remoteAddress, cl->netChan.qPort) ; ; i++) {
+		if (svs.clientHash[i & svs.clientHashMask] == cl)
+			return;
+		if (!svs.clientHash[i & svs.clientHashMask]) {
+			svs.clientHash[i & svs.clientHashMask] = cl;
+			return;
+		}
+	}
+}
+
+
+/*
+=====================
+SV_ClientHashRemove
+
+Shifts the rest of the probe run back so lookups never need tombstones
+=====================
+*/
+void SV_ClientHashRemove (svClient_t *cl)
+{
+	svClient_t	**table = svs.clientHash;
+	uint32		mask = svs.clientHashMask;
+	uint32		i, j, home;
+
+	if (!table)
+		return;
+
+	for (i=SV_ClientHashKey (&cl->netChan.remoteAddress, cl->netChan.qPort) & mask ; ; i=(i+1) & mask) {
+		if (!table[i])
+			return;		// not hashed
+		if (table[i] == cl)
+			break;
+	}
+
+	table[i] = NULL;
+	for (j=(i+1) & mask ; table[j] ; j=(j+1) & mask) {
+		home = SV_ClientHashKey (&table[j]->netChan.remoteAddress, table[j]->netChan.qPort) & mask;
+
+		// Move it into the hole if the hole sits between its home slot and j
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			table[i] = table[j];
+			table[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+//=============================================================================
+
 /*
 =====================
 SV_DropClient
@@ -90,11 +259,10 @@ void SV_DropClient (svClient_t *drop)
 		ge->ClientDisconnect (drop->edict);
 	}
 
-	if (drop->download) {
-		FS_FreeFile (drop->download);
-		drop->download = NULL;
-	}
+	if (drop->download)
+		SV_ReleaseDownload (drop);
 
+	SV_ClientHashRemove (drop);
 	drop->state = SVCS_FREE;		// become free in a few seconds
 	drop->name[0] = 0;
 }
@@ -379,6 +547,7 @@ static void SVC_DirectConnect_f (void)
 	int			version;
 	int			qPort;
 	int			challenge;
+	qBool		fragments;
 
 	adr = sv_netFrom;
 
@@ -468,6 +637,8 @@ gotNewClient:
 	** Build a new connection and accept the new client
 	** This is the only place a svClient_t is ever initialized
 	*/
+	SV_ClientHashRemove (newcl);
+	Netchan_Release (&newcl->netChan);
 	*newcl = temp;
 	sv_currentClient = newcl;
 	edictNum = (newcl-svs.clients)+1;
@@ -492,10 +663,14 @@ gotNewClient:
 	Q_strncpyz (newcl->userInfo, userInfo, sizeof (newcl->userInfo));
 	SV_UserinfoChanged (newcl);
 
-	// Send the connect packet to the client
-	Netchan_OutOfBandPrint (NS_SERVER, &adr, "client_connect");
+	// Send the connect packet to the client, agreeing to fragmented reliables if it asked.
+	// The loopback queue is only a few packets deep and paging costs nothing there anyway.
+	fragments = !strcmp (Cmd_Argv (5), "fragments") && !NET_IsLocalAddress (adr);
+	Netchan_OutOfBandPrint (NS_SERVER, &adr, fragments ? "client_connect fragments" : "client_connect");
 
 	Netchan_Setup (NS_SERVER, &newcl->netChan, &adr, version, qPort, 0);
+	newcl->netChan.fragments = fragments;
+	SV_ClientHashAdd (newcl);
 
 	newcl->protocol = version;
 	newcl->state = SVCS_CONNECTED;
@@ -781,26 +956,43 @@ static void SV_ReadPackets (void)
 		qPort = MSG_ReadShort (&sv_netMessage) & 0xffff;
 
 		// Check for packets from connected clients
-		for (i=0, cl=svs.clients ; i<maxclients->intVal ; i++, cl++) {
-			if (cl->state == SVCS_FREE)
-				continue;
-			if (!NET_CompareBaseAdr (sv_netFrom, cl->netChan.remoteAddress))
-				continue;
-			if (cl->netChan.qPort != qPort)
-				continue;
-			if (cl->netChan.remoteAddress.port != sv_netFrom.port) {
+		cl = SV_ClientHashFind (&sv_netFrom, qPort);
+		if (!cl) {
+			// A translated port won't hash to where the client was added
+			for (i=0, cl=svs.clients ; i<maxclients->intVal ; i++, cl++) {
+				if (cl->state == SVCS_FREE)
+					continue;
+				if (!(NET_CompareBaseAdr (sv_netFrom, cl->netChan.remoteAddress)))
+					continue;
+				if (cl->netChan.qPort != qPort)
+					continue;
+
 				Com_Printf (0, "SV_ReadPackets: fixing up a translated port\n");
+				SV_ClientHashRemove (cl);
 				cl->netChan.remoteAddress.port = sv_netFrom.port;
+				SV_ClientHashAdd (cl);
+				break;
 			}
+			if (i == maxclients->intVal)
+				continue;
+		}
+
+		if (Netchan_Process (&cl->netChan, &sv_netMessage)) {
+			// This is a valid, sequenced packet, so process it
+			if (cl->state != SVCS_FREE) {
+				cl->lastMessage = svs.realTime;	// Don't timeout
+				SV_ExecuteClientMessage (cl);
 
-			if (Netchan_Process (&cl->netChan, &sv_netMessage)) {
-				// This is a valid, sequenced packet, so process it
-				if (cl->state != SVCS_FREE) {
-					cl->lastMessage = svs.realTime;	// Don't timeout
-					SV_ExecuteClientMessage (cl);
+				// Keep downloads moving at the round trip instead of the frame rate
+				if (cl->download) {
+					SV_SendDownload (cl);
+
+					if ((cl->netChan.message.curSize || cl->netChan.bulkBuff) && !cl->netChan.reliableLength && !SV_RateDrop (cl)) {
+						Netchan_Transmit (&cl->netChan, 0, NULL);
+						cl->messageSize[sv.frameNum % RATE_MESSAGES] += cl->netChan.lastSentSize;
+					}
 				}
 			}
-			break;
 		}
 	}
 }
@@ -943,9 +1135,23 @@ void SV_Frame (int msec)
 
 	// Let everything in the world think and move
 	SV_RunGameFrame ();
+	SV_AreaRecordFrame ();
 
 	// Send messages back to the clients that had packets read this frame
+	NET_BeginSendBatch (NS_SERVER);
 	SV_SendClientMessages ();
+	NET_FlushSendBatch (NS_SERVER);
+
+	if (sv_showmulticast->intVal && (sv.leafCacheHits || sv.leafCacheMisses))
+		Com_Printf (0, "sv multicast: %i client leafs cached, %i looked up\n", sv.leafCacheHits, sv.leafCacheMisses);
+	sv.leafCacheHits = 0;
+	sv.leafCacheMisses = 0;
+
+	if (sv_showdeltacache->intVal && (sv.deltaCacheHits || sv.deltaCacheMisses))
+		Com_Printf (0, "sv delta cache: %i hits, %i misses, %i%% hit rate\n",
+			sv.deltaCacheHits, sv.deltaCacheMisses, sv.deltaCacheHits * 100 / (sv.deltaCacheHits + sv.deltaCacheMisses));
+	sv.deltaCacheHits = 0;
+	sv.deltaCacheMisses = 0;
 
 	// Save the entire world state if recording a serverdemo
 	SV_RecordDemoMessage ();
@@ -992,6 +1198,14 @@ void SV_ServerInit (void)
 	zombietime				= Cvar_Register ("zombietime",				"2",		0);
 
 	sv_showclamp			= Cvar_Register ("showclamp",				"0",		0);
+	sv_showmulticast		= Cvar_Register ("showmulticast",			"0",		0);
+
+	sv_areaIndex			= Cvar_Register ("sv_areaIndex",			"0",		CVAR_ARCHIVE);
+	sv_areaGridSize			= Cvar_Register ("sv_areaGridSize",			"64",		CVAR_ARCHIVE);
+	sv_snapshotJobs			= Cvar_Register ("sv_snapshotJobs",			"1",		CVAR_ARCHIVE);
+	sv_deltaCache			= Cvar_Register ("sv_deltaCache",			"1",		CVAR_ARCHIVE);
+	sv_showdeltacache		= Cvar_Register ("showdeltacache",			"0",		0);
+	sv_demoKeyframes		= Cvar_Register ("demo_keyframes",			"0",		CVAR_ARCHIVE);
 	sv_paused				= Cvar_Register ("paused",					"0",		CVAR_CHEAT);
 	sv_timedemo				= Cvar_Register ("timedemo",				"0",		CVAR_CHEAT);
 
@@ -1005,6 +1219,9 @@ void SV_ServerInit (void)
 	allow_download_models	= Cvar_Register ("allow_download_models",	"1",		CVAR_ARCHIVE);
 	allow_download_sounds	= Cvar_Register ("allow_download_sounds",	"1",		CVAR_ARCHIVE);
 	allow_download_maps		= Cvar_Register ("allow_download_maps",		"1",		CVAR_ARCHIVE);
+	sv_downloadWindow		= Cvar_Register ("sv_downloadWindow",		"48",		CVAR_ARCHIVE);
+	sv_downloadCacheMB		= Cvar_Register ("sv_downloadCacheMB",		"64",		CVAR_ARCHIVE);
+	sv_downloadPrecompress	= Cvar_Register ("sv_downloadPrecompress",	"1",		CVAR_ARCHIVE);
 
 	public_server			= Cvar_Register ("public",					"0",		0);
 
@@ -1060,9 +1277,16 @@ Called when each game quits, before Sys_Quit or Sys_Error
 */
 void SV_ServerShutdown (char *finalMessage, qBool reconnect, qBool crashing)
 {
-	if (svs.clients)
+	int		i;
+
+	if (svs.clients) {
 		SV_FinalMessage (finalMessage, reconnect);
 
+		// Before maxclients can latch a new value
+		for (i=0 ; i<maxclients->intVal ; i++)
+			Netchan_Release (&svs.clients[i].netChan);
+	}
+
 	SV_MasterShutdown ();
 
 	if (!crashing) {
@@ -1081,12 +1305,15 @@ void SV_ServerShutdown (char *finalMessage, qBool reconnect, qBool crashing)
 	Com_SetServerState (SS_DEAD);
 
 	// Free server static data
+	SV_DownloadCacheShutdown ();
 	if (svs.clients)
 		Mem_Free (svs.clients);
+	if (svs.clientHash)
+		Mem_Free (svs.clientHash);
 	if (svs.clientEntities)
 		Mem_Free (svs.clientEntities);
 	if (svs.demoFile)
-		FS_CloseFile (svs.demoFile);
+		SV_CloseServerDemo ();
 	memset (&svs, 0, sizeof (svs));
 
 	// If the server is crashing there's no sense in releasing this memory
@@ -153,6 +153,34 @@ void SV_Unicast (edict_t *ent, qBool reliable)
 }
 
 
+/*
+=================
+SV_ClientLeaf
+
+Looks up the leaf, cluster and area under a client's origin. The result is
+kept until the client moves, so every multicast and sound in a frame shares
+one BSP descent per client.
+=================
+*/
+static void SV_ClientLeaf (svClient_t *client)
+{
+	float	*origin;
+
+	origin = client->edict->s.origin;
+	if (client->leafSpawnCount == svs.spawnCount && Vec3Compare (origin, client->leafOrigin)) {
+		sv.leafCacheHits++;
+		return;
+	}
+
+	sv.leafCacheMisses++;
+	client->leafSpawnCount = svs.spawnCount;
+	Vec3Copy (origin, client->leafOrigin);
+	client->leafNum = CM_PointLeafnum (origin);
+	client->leafCluster = CM_LeafCluster (client->leafNum);
+	client->leafArea = CM_LeafArea (client->leafNum);
+}
+
+
 /*
 =================
 SV_Multicast
@@ -172,7 +200,7 @@ void SV_Multicast (vec3_t origin, multiCast_t to)
 	int			leafNum, cluster;
 	int			j;
 	qBool		reliable;
-	int			area1, area2;
+	int			area1;
 
 	reliable = qFalse;
 
@@ -227,12 +255,11 @@ void SV_Multicast (vec3_t origin, multiCast_t to)
 			continue;
 
 		if (mask) {
-			leafNum = CM_PointLeafnum (client->edict->s.origin);
-			cluster = CM_LeafCluster (leafNum);
-			area2 = CM_LeafArea (leafNum);
-			if (!CM_AreasConnected (area1, area2))
+			SV_ClientLeaf (client);
+			if (!CM_AreasConnected (area1, client->leafArea))
 				continue;
-			if (mask && (!(mask[cluster>>3] & (1<<(cluster&7)))))
+			cluster = client->leafCluster;
+			if (!(mask[cluster>>3] & (1<<(cluster&7))))
 				continue;
 		}
 
@@ -281,7 +308,7 @@ or the midpoint of the entity box for bmodels.
 void SV_StartSound (vec3_t origin, edict_t *entity, int channel, int soundIndex, float vol, float attenuation, float timeOffset)
 {
 	int			sendChan, flags, i, ent;
-	int			cluster, leafNum, area1 = 0, area2;
+	int			cluster, leafNum, area1 = 0;
 	float		leftVol, rightVol, distanceMult;
 	svClient_t	*client;
 	byte		*mask;
@@ -358,12 +385,11 @@ void SV_StartSound (vec3_t origin, edict_t *entity, int channel, int soundIndex,
 			continue;
 
 		if (usePHS) {
-			leafNum = CM_PointLeafnum (client->edict->s.origin);
-			area2 = CM_LeafArea (leafNum);
-			cluster = CM_LeafCluster (leafNum);
+			SV_ClientLeaf (client);
+			cluster = client->leafCluster;
 			mask = CM_ClusterPHS (cluster);
 
-			if (!CM_AreasConnected (area1, area2))
+			if (!CM_AreasConnected (area1, client->leafArea))
 				continue; // leafs aren't connected
 
 			if (mask && (!(mask[cluster>>3] & (1<<(cluster&7)))))
@@ -420,6 +446,43 @@ void SV_StartSound (vec3_t origin, edict_t *entity, int channel, int soundIndex,
 ===============================================================================
 */
 
+/*
+=======================
+SV_TransmitClientDatagram
+
+Appends the multicasts for this client to its encoded frame and sends it
+=======================
+*/
+static void SV_TransmitClientDatagram (svClient_t *client, netMsg_t *msg)
+{
+	// Copy the accumulated multicast datagram for this client out to the message it is
+	// necessary for this to be after the WriteEntities so that entity references will be current
+	if (client->datagram.overFlowed) {
+		Com_Printf (PRNT_WARNING, "WARNING: datagram overflowed for %s\n", client->name);
+	}
+	else if (client->datagram.curSize) {
+		MSG_WriteRaw (msg, client->datagram.data, client->datagram.curSize);
+	}
+
+	MSG_Clear (&client->datagram);
+
+	if (msg->overFlowed) {
+		// Must have room left for the packet header
+		Com_Printf (PRNT_WARNING, "WARNING: msg overflowed for %s\n", client->name);
+		MSG_Clear (msg);
+	}
+
+	// Send the datagram
+	Netchan_Transmit (&client->netChan, msg->curSize, msg->data);
+
+	// Record the size for rate estimation, pieces of a fragmented reliable included
+	if (client->netChan.reliableBulk)
+		client->messageSize[sv.frameNum % RATE_MESSAGES] = client->netChan.lastSentSize;
+	else
+		client->messageSize[sv.frameNum % RATE_MESSAGES] = msg->curSize;
+}
+
+
 /*
 =======================
 SV_SendClientDatagram
@@ -438,32 +501,276 @@ qBool SV_SendClientDatagram (svClient_t *client)
 	// Send over all the relevant entityStateOld_t and the playerState_t
 	SV_WriteFrameToClient (client, &msg);
 
-	// Copy the accumulated multicast datagram for this client out to the message it is
-	// necessary for this to be after the WriteEntities so that entity references will be current
-	if (client->datagram.overFlowed) {
-		Com_Printf (PRNT_WARNING, "WARNING: datagram overflowed for %s\n", client->name);
+	SV_TransmitClientDatagram (client, &msg);
+	return qTrue;
+}
+
+/*
+===============================================================================
+
+	PARALLEL FRAME UPDATES
+
+	Culling and delta encoding a frame only reads the world, so with job
+	workers around every spawned client's frame is built at once, each into
+	its own message. Anything touching the collision model's caches is done
+	beforehand and the packets still go out in client order afterwards.
+===============================================================================
+*/
+
+typedef struct svSnapshot_s {
+	svClient_t		*client;
+	svClientView_t	*view;
+	qBool			inGame;
+	netMsg_t		msg;
+	byte			msgBuff[MAX_SV_MSGLEN];
+} svSnapshot_t;
+
+static svSnapshot_t		*sv_snapshots;
+static svClientView_t	*sv_snapshotViews;
+static int				sv_maxSnapshots;
+
+/*
+=======================
+SV_AllocSnapshots
+=======================
+*/
+static svSnapshot_t *SV_AllocSnapshots (int numSnaps)
+{
+	if (numSnaps > sv_maxSnapshots) {
+		if (sv_snapshots) {
+			Mem_Free (sv_snapshots);
+			Mem_Free (sv_snapshotViews);
+		}
+		sv_snapshots = Mem_PoolAlloc (sizeof (svSnapshot_t) * numSnaps, sv_genericPool, 0);
+		sv_snapshotViews = Mem_PoolAlloc (sizeof (svClientView_t) * numSnaps, sv_genericPool, 0);
+		sv_maxSnapshots = numSnaps;
 	}
-	else if (client->datagram.curSize) {
-		MSG_WriteRaw (&msg, client->datagram.data, client->datagram.curSize);
+
+	return sv_snapshots;
+}
+
+
+/*
+=======================
+SV_SnapshotJob
+=======================
+*/
+static void SV_SnapshotJob (void *arg)
+{
+	svSnapshot_t	*snap = (svSnapshot_t *)arg;
+
+	if (snap->inGame)
+		SV_CullClientFrame (snap->client, snap->view);
+
+	MSG_Init (&snap->msg, snap->msgBuff, sizeof (snap->msgBuff));
+	snap->msg.allowOverflow = qTrue;
+
+	// Send over all the relevant entityStateOld_t and the playerState_t
+	SV_WriteFrameToClient (snap->client, &snap->msg);
+}
+
+
+/*
+=======================
+SV_SetupSnapshots
+
+Snapshots come from SV_AllocSnapshots with their clients filled in. A view
+origin can be given per snapshot for clients that aren't where their edict
+is (see snapbench).
+=======================
+*/
+static void SV_SetupSnapshots (int numSnaps, vec3_t *origins)
+{
+	int		i;
+
+	// Collision model lookups stay on this thread
+	SV_AllocClientViews (sv_snapshotViews, numSnaps);
+	for (i=0 ; i<numSnaps ; i++) {
+		sv_snapshots[i].view = &sv_snapshotViews[i];
+		sv_snapshots[i].inGame = SV_SetupClientView (sv_snapshots[i].client, sv_snapshots[i].view, origins ? origins[i] : NULL);
 	}
+}
 
-	MSG_Clear (&client->datagram);
 
-	if (msg.overFlowed) {
-		// Must have room left for the packet header
-		Com_Printf (PRNT_WARNING, "WARNING: msg overflowed for %s\n", client->name);
-		MSG_Clear (&msg);
+/*
+=======================
+SV_BuildSnapshots
+=======================
+*/
+static void SV_BuildSnapshots (int numSnaps, qBool parallel)
+{
+	jobList_t	jobs;
+	int			i;
+
+	memset (&jobs, 0, sizeof (jobs));
+	for (i=0 ; i<numSnaps ; i++) {
+		if (parallel)
+			Job_Add (&jobs, SV_SnapshotJob, &sv_snapshots[i]);
+		else
+			SV_SnapshotJob (&sv_snapshots[i]);
 	}
+	Job_Wait (&jobs);
+}
 
-	// Send the datagram
-	Netchan_Transmit (&client->netChan, msg.curSize, msg.data);
 
-	// Record the size for rate estimation
-	client->messageSize[sv.frameNum % RATE_MESSAGES] = msg.curSize;
+/*
+=======================
+SV_SendSnapshots
+=======================
+*/
+static void SV_SendSnapshots (int numSnaps)
+{
+	int		i;
+
+	SV_SetupSnapshots (numSnaps, NULL);
+	SV_BuildSnapshots (numSnaps, qTrue);
 
-	return qTrue;
+	// In client order, as if they had been built one at a time
+	for (i=0 ; i<numSnaps ; i++)
+		SV_TransmitClientDatagram (sv_snapshots[i].client, &sv_snapshots[i].msg);
+}
+
+
+/*
+=======================
+SV_SnapBench_f
+
+Builds frames for a crowd of bot clients standing where the entities are,
+once a client at a time and once on the job workers, and reports how long
+each phase took. Nothing is sent. Every bot borrows the edict of a spawned
+client, so at least one has to be in the game.
+=======================
+*/
+static void SV_SnapBench_f (void)
+{
+	entityStateOld_t	*savedEntities;
+	svClient_t			*bots, *cl;
+	vec3_t				*origins;
+	edict_t				*ent;
+	int					numBots, numFrames, numSpawned;
+	int					savedNext, numOrigins;
+	int					frame, i, e;
+	int					setupTime, serialTime, parallelTime;
+	size_t				bytes;
+
+	if (Com_ServerState () != SS_GAME) {
+		Com_Printf (0, "snapbench: no game running\n");
+		return;
+	}
+
+	numBots = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 64;
+	numFrames = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 100;
+	numBots = clamp (numBots, 1, MAX_CS_CLIENTS);
+	numFrames = max (numFrames, 1);
+
+	for (numSpawned=0, i=0, cl=svs.clients ; i<maxclients->intVal ; i++, cl++) {
+		if (cl->state == SVCS_SPAWNED && cl->edict->client)
+			numSpawned++;
+	}
+	if (!numSpawned) {
+		Com_Printf (0, "snapbench: needs a spawned client to copy\n");
+		return;
+	}
+
+	// Clone the spawned clients, without deltas so every frame is a full one
+	bots = Mem_PoolAlloc (sizeof (svClient_t) * numBots, sv_genericPool, 0);
+	origins = Mem_PoolAlloc (sizeof (vec3_t) * numBots, sv_genericPool, 0);
+	for (i=0, cl=svs.clients ; i<numBots ; cl++) {
+		if (cl == svs.clients + maxclients->intVal)
+			cl = svs.clients;
+		if (cl->state != SVCS_SPAWNED || !cl->edict->client)
+			continue;
+
+		bots[i] = *cl;
+		bots[i].lastFrame = -1;
+		i++;
+	}
+
+	// Spread them over the map, standing in on visible entities
+	for (numOrigins=0, e=1 ; e<ge->numEdicts && numOrigins<numBots ; e++) {
+		ent = EDICT_NUM(e);
+		if (!ent->inUse || !ent->s.modelIndex || (ent->svFlags & SVF_NOCLIENT))
+			continue;
+
+		Vec3Copy (ent->s.origin, origins[numOrigins]);
+		origins[numOrigins][2] += 24;
+		numOrigins++;
+	}
+	if (!numOrigins) {
+		Vec3Copy (bots[0].edict->s.origin, origins[0]);
+		numOrigins = 1;
+	}
+	for (i=numOrigins ; i<numBots ; i++)
+		Vec3Copy (origins[i % numOrigins], origins[i]);
+
+	// The bots write over the real clients' delta sources
+	savedNext = svs.nextClientEntities;
+	savedEntities = Mem_PoolAlloc (sizeof (entityStateOld_t) * svs.numClientEntities, sv_genericPool, 0);
+	memcpy (savedEntities, svs.clientEntities, sizeof (entityStateOld_t) * svs.numClientEntities);
+
+	SV_PrepareClientFrames ();
+	SV_AllocSnapshots (numBots);
+	for (i=0 ; i<numBots ; i++)
+		sv_snapshots[i].client = &bots[i];
+
+	// Setup is the same either way, it's timed on its own and taken off the rest
+	setupTime = Sys_Milliseconds ();
+	for (frame=0 ; frame<numFrames ; frame++)
+		SV_SetupSnapshots (numBots, origins);
+	setupTime = Sys_Milliseconds () - setupTime;
+
+	serialTime = Sys_Milliseconds ();
+	for (frame=0 ; frame<numFrames ; frame++) {
+		SV_ResetDeltaCache ();
+		SV_SetupSnapshots (numBots, origins);
+		SV_BuildSnapshots (numBots, qFalse);
+	}
+	serialTime = max (Sys_Milliseconds () - serialTime - setupTime, 0);
+
+	parallelTime = Sys_Milliseconds ();
+	for (frame=0 ; frame<numFrames ; frame++) {
+		SV_ResetDeltaCache ();
+		SV_SetupSnapshots (numBots, origins);
+		SV_BuildSnapshots (numBots, qTrue);
+	}
+	parallelTime = max (Sys_Milliseconds () - parallelTime - setupTime, 0);
+
+	for (i=0, bytes=0 ; i<numBots ; i++)
+		bytes += sv_snapshots[i].msg.curSize;
+
+	memcpy (svs.clientEntities, savedEntities, sizeof (entityStateOld_t) * svs.numClientEntities);
+	svs.nextClientEntities = savedNext;
+
+	Com_Printf (0, "%i bots from %i views, %i frames, %i job workers, %u bytes a frame\n",
+		numBots, numOrigins, numFrames, Job_NumWorkers (), (uint32)bytes);
+	Com_Printf (0, "setup            : %6.2fms a frame\n", setupTime / (float)numFrames);
+	Com_Printf (0, "build (serial)   : %6.2fms a frame\n", serialTime / (float)numFrames);
+	Com_Printf (0, "build (parallel) : %6.2fms a frame, %.2fx\n", parallelTime / (float)numFrames,
+		parallelTime ? serialTime / (float)parallelTime : 0.0f);
+
+	Mem_Free (savedEntities);
+	Mem_Free (origins);
+	Mem_Free (bots);
+}
+
+
+/*
+=======================
+SV_SendCommandInit
+=======================
+*/
+void SV_SendCommandInit (void)
+{
+	Cmd_AddCommand ("snapbench",	SV_SnapBench_f,		"Times building client frames for a crowd of bots, serially and on the job workers");
 }
 
+/*
+===============================================================================
+
+	CLIENT MESSAGES
+
+===============================================================================
+*/
 
 /*
 ==================
@@ -481,6 +788,87 @@ static void SV_DemoCompleted (void)
 }
 
 
+/*
+==================
+SV_LoadDemoIndex
+
+Picks up the keyframe index from behind the end of a demo, if it has one
+==================
+*/
+void SV_LoadDemoIndex (int fileLen)
+{
+	int		numKeys, magic;
+	int		i;
+
+	sv.numDemoKeys = 0;
+	if (fileLen < (int)(sizeof (numKeys) + sizeof (magic) + sizeof (demoIndex_t)))
+		return;
+
+	FS_Seek (sv.demoFile, fileLen - sizeof (numKeys) - sizeof (magic), FS_SEEK_SET);
+	if (FS_Read (&numKeys, sizeof (numKeys), sv.demoFile) == sizeof (numKeys)
+	&& FS_Read (&magic, sizeof (magic), sv.demoFile) == sizeof (magic)) {
+		numKeys = LittleLong (numKeys);
+		magic = LittleLong (magic);
+
+		if (magic == DEMO_INDEX_MAGIC && numKeys > 0 && numKeys <= DEMO_MAX_KEYS
+		&& (int)(sizeof (demoIndex_t) * numKeys + sizeof (numKeys) + sizeof (magic)) <= fileLen) {
+			FS_Seek (sv.demoFile, fileLen - sizeof (demoIndex_t) * numKeys - sizeof (numKeys) - sizeof (magic), FS_SEEK_SET);
+			if (FS_Read (sv.demoKeys, sizeof (demoIndex_t) * numKeys, sv.demoFile) == sizeof (demoIndex_t) * numKeys) {
+				for (i=0 ; i<numKeys ; i++) {
+					sv.demoKeys[i].time = LittleLong (sv.demoKeys[i].time);
+					sv.demoKeys[i].offset = LittleLong (sv.demoKeys[i].offset);
+				}
+				sv.numDemoKeys = numKeys;
+			}
+		}
+	}
+
+	// Playback starts from the top either way
+	FS_Seek (sv.demoFile, 0, FS_SEEK_SET);
+
+	if (sv.numDemoKeys)
+		Com_DevPrintf (0, "Demo has %i keyframes over %i seconds\n", sv.numDemoKeys, sv.demoKeys[sv.numDemoKeys-1].time / 1000);
+}
+
+
+/*
+==================
+SV_SeekDemo
+
+Moves demo playback to the last keyframe at or before msec. The next message
+read in SV_SendClientMessages is then the keyframe, which needs nothing that
+came before it.
+==================
+*/
+void SV_SeekDemo (int msec)
+{
+	int		lo, hi, mid;
+
+	if (Com_ServerState () != SS_DEMO || !sv.demoFile) {
+		Com_Printf (0, "Not playing a demo.\n");
+		return;
+	}
+	if (!sv.numDemoKeys) {
+		Com_Printf (0, "This demo has no keyframe index, record it with demo_keyframes set.\n");
+		return;
+	}
+
+	// Binary search for the last key at or before the time
+	lo = 0;
+	hi = sv.numDemoKeys - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (sv.demoKeys[mid].time <= msec)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	FS_Seek (sv.demoFile, sv.demoKeys[lo].offset, FS_SEEK_SET);
+	Com_Printf (0, "Seeked to %i.%i seconds.\n", sv.demoKeys[lo].time / 1000, (sv.demoKeys[lo].time % 1000) / 100);
+}
+
+
 /*
 =======================
 SV_RateDrop
@@ -512,6 +900,25 @@ qBool SV_RateDrop (svClient_t *c)
 }
 
 
+/*
+=======================
+SV_SendReliable
+
+Updates the reliable stream of a client that isn't getting frames. Passes
+over a fragmented reliable are held to the client's rate the way frames are.
+=======================
+*/
+static void SV_SendReliable (svClient_t *c, size_t length, byte *data)
+{
+	if ((c->netChan.reliableBulk || c->netChan.bulkBuff) && SV_RateDrop (c))
+		return;
+
+	Netchan_Transmit (&c->netChan, length, data);
+	if (c->netChan.reliableBulk)
+		c->messageSize[sv.frameNum % RATE_MESSAGES] = c->netChan.lastSentSize;
+}
+
+
 /*
 =======================
 SV_SendClientMessages
@@ -523,9 +930,13 @@ void SV_SendClientMessages (void)
 	svClient_t	*c;
 	int			msgLen;
 	byte		msgBuf[MAX_SV_MSGLEN];
+	byte		*bulkBuf;
 	int			r;
+	qBool		parallel;
+	int			numSnaps;
 
 	msgLen = 0;
+	bulkBuf = NULL;
 
 	// Read the next demo message if needed
 	if (Com_ServerState () == SS_DEMO && sv.demoFile) {
@@ -546,17 +957,34 @@ void SV_SendClientMessages (void)
 				return;
 			}
 
+			if (msgLen > NETCHAN_MAX_BULK)
+				Com_Error (ERR_DROP, "SV_SendClientMessages: msgLen > NETCHAN_MAX_BULK");
+
+			// A fragmented reliable was recorded whole, and goes back out fragmented
 			if (msgLen > MAX_SV_MSGLEN)
-				Com_Error (ERR_DROP, "SV_SendClientMessages: msgLen > MAX_SV_MSGLEN");
+				bulkBuf = Mem_PoolAlloc (msgLen, sv_genericPool, 0);
 
-			r = (int) FS_Read (msgBuf, msgLen, sv.demoFile);
+			r = (int) FS_Read (bulkBuf ? bulkBuf : msgBuf, msgLen, sv.demoFile);
 			if (r != msgLen) {
+				if (bulkBuf)
+					Mem_Free (bulkBuf);
 				SV_DemoCompleted ();
 				return;
 			}
 		}
 	}
 
+	// Frames are built on the job workers when there are any
+	parallel = (sv_snapshotJobs->intVal && Job_NumWorkers () > 0 && Com_ServerState () == SS_GAME);
+	if (parallel)
+		SV_AllocSnapshots (maxclients->intVal);
+	numSnaps = 0;
+
+	if (Com_ServerState () == SS_GAME) {
+		SV_PrepareClientFrames ();
+		SV_ResetDeltaCache ();
+	}
+
 	// Send a message to each connected client
 	for (i=0, c=svs.clients ; i<maxclients->intVal ; i++, c++) {
 		if (!c->state)
@@ -570,11 +998,21 @@ void SV_SendClientMessages (void)
 			SV_DropClient (c);
 		}
 
+		// Top up the download window as rate allows
+		if (c->download)
+			SV_SendDownload (c);
+
 		switch (Com_ServerState ()) {
 		case SS_CINEMATIC:
 		case SS_DEMO:
 		case SS_PIC:
-			Netchan_Transmit (&c->netChan, msgLen, msgBuf);
+			if (bulkBuf) {
+				if (!Netchan_QueueBulk (&c->netChan, bulkBuf, msgLen))
+					Com_Printf (PRNT_WARNING, "WARNING: %s can't take a %i byte demo message, skipped\n", c->name, msgLen);
+				SV_SendReliable (c, 0, NULL);
+			}
+			else
+				SV_SendReliable (c, msgLen, msgBuf);
 			break;
 
 		default:
@@ -583,14 +1021,22 @@ void SV_SendClientMessages (void)
 				if (SV_RateDrop (c))
 					continue;
 
-				SV_SendClientDatagram (c);
+				if (parallel)
+					sv_snapshots[numSnaps++].client = c;
+				else
+					SV_SendClientDatagram (c);
 			}
 			else {
-				// Just update reliable	if needed
-				if (c->netChan.message.curSize	|| Sys_Milliseconds () - c->netChan.lastSent > 100)
-					Netchan_Transmit (&c->netChan, 0, NULL);
+				// Just update reliable	if needed, and keep a bulk download window moving
+				if (c->netChan.message.curSize || c->netChan.bulkBuff || c->netChan.reliableBulk
+				|| Sys_Milliseconds () - c->netChan.lastSent > 100)
+					SV_SendReliable (c, 0, NULL);
 			}
 			break;
 		}
 	}
+	if (numSnaps)
+		SV_SendSnapshots (numSnaps);
+	if (bulkBuf)
+		Mem_Free (bulkBuf);
 }
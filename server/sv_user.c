@@ -43,12 +43,108 @@ SV_BeginDemoServer
 static void SV_BeginDemoserver (void)
 {
 	char	name[MAX_OSPATH];
+	int		fileLen;
 
 	Q_snprintfz (name, sizeof (name), "demos/%s", sv.name);
-	FS_OpenFile (name, &sv.demoFile, FS_MODE_READ_BINARY);
+	fileLen = FS_OpenFile (name, &sv.demoFile, FS_MODE_READ_BINARY);
 
 	if (!sv.demoFile)
 		Com_Error (ERR_DROP, "Couldn't open %s", name);
+
+	SV_LoadDemoIndex (fileLen);
+}
+
+
+#define SV_GAMESTATE_SLICE	16384	// raw bytes per SVC_ZPACKET, has to fit in its short
+#define SV_GAMESTATE_SLACK	4096	// flush before this much is left, statusbar strings run long
+
+/*
+==================
+SV_FlushGamestateSlice
+
+Deflates a slice of the gamestate into a SVC_ZPACKET, or copies it across
+unchanged when that doesn't make it any smaller.
+==================
+*/
+static void SV_FlushGamestateSlice (netMsg_t *slice, netMsg_t *bulk)
+{
+	byte	zBuff[SV_GAMESTATE_SLICE];
+	int		zLen;
+
+	if (!slice->curSize)
+		return;
+
+	zLen = FS_ZLibCompressChunk (slice->data, slice->curSize, zBuff, sizeof (zBuff), 9, -15);
+	if (zLen > 0 && zLen + 5 < slice->curSize) {
+		MSG_WriteByte (bulk, SVC_ZPACKET);
+		MSG_WriteShort (bulk, zLen);
+		MSG_WriteShort (bulk, slice->curSize);
+		MSG_WriteRaw (bulk, zBuff, zLen);
+	}
+	else
+		MSG_WriteRaw (bulk, slice->data, slice->curSize);
+
+	MSG_Clear (slice);
+}
+
+
+/*
+==================
+SV_SendGamestate
+
+Queues every configstring and baseline as one fragmented reliable, instead
+of the client paging through them a packet per round trip. Returns qFalse if
+it wouldn't fit, so the caller can fall back to the paged commands.
+==================
+*/
+static qBool SV_SendGamestate (svClient_t *cl)
+{
+	byte				sliceBuff[SV_GAMESTATE_SLICE];
+	netMsg_t			slice, bulk;
+	entityStateOld_t	nullstate;
+	entityStateOld_t	*base;
+	qBool				queued;
+	int					i;
+
+	MSG_Init (&slice, sliceBuff, sizeof (sliceBuff));
+	MSG_Init (&bulk, Mem_PoolAlloc (NETCHAN_MAX_BULK, sv_genericPool, 0), NETCHAN_MAX_BULK);
+	bulk.allowOverflow = qTrue;
+
+	for (i=0 ; i<MAX_CFGSTRINGS ; i++) {
+		if (!sv.configStrings[i][0])
+			continue;
+
+		MSG_WriteByte (&slice, SVC_CONFIGSTRING);
+		MSG_WriteShort (&slice, i);
+		MSG_WriteString (&slice, sv.configStrings[i]);
+		if (slice.curSize > SV_GAMESTATE_SLICE - SV_GAMESTATE_SLACK)
+			SV_FlushGamestateSlice (&slice, &bulk);
+	}
+
+	memset (&nullstate, 0, sizeof (nullstate));
+	for (i=0 ; i<MAX_CS_EDICTS ; i++) {
+		base = &sv.baseLines[i];
+		if (!base->modelIndex && !base->sound && !base->effects)
+			continue;
+
+		MSG_WriteByte (&slice, SVC_SPAWNBASELINE);
+		MSG_WriteDeltaEntity (&slice, &nullstate, base, qTrue, qTrue);
+		if (slice.curSize > SV_GAMESTATE_SLICE - SV_GAMESTATE_SLACK)
+			SV_FlushGamestateSlice (&slice, &bulk);
+	}
+
+	MSG_WriteByte (&slice, SVC_STUFFTEXT);
+	MSG_WriteString (&slice, Q_VarArgs ("precache %i\n", svs.spawnCount));
+	SV_FlushGamestateSlice (&slice, &bulk);
+
+	queued = qFalse;
+	if (!bulk.overFlowed)
+		queued = Netchan_QueueBulk (&cl->netChan, bulk.data, bulk.curSize);
+	if (queued)
+		Com_DevPrintf (0, "SV_SendGamestate: %s, %u bytes\n", cl->name, (uint32)bulk.curSize);
+
+	Mem_Free (bulk.data);
+	return queued;
 }
 
 
@@ -112,7 +208,10 @@ static void SV_New_f (void)
 		sv_currentClient->edict = ent;
 		memset (&sv_currentClient->lastCmd, 0, sizeof (sv_currentClient->lastCmd));
 
-		// Begin fetching configstrings
+		// Send the whole gamestate at once if the client can take it, else begin fetching configstrings
+		if (sv_currentClient->netChan.fragments && SV_SendGamestate (sv_currentClient))
+			return;
+
 		MSG_WriteByte (&sv_currentClient->netChan.message, SVC_STUFFTEXT);
 		MSG_WriteString (&sv_currentClient->netChan.message, Q_VarArgs ("cmd configstrings %i 0\n", svs.spawnCount));
 	}
@@ -259,40 +358,688 @@ static void SV_Begin_f (void)
 
 // ==========================================================================
 
+/*
+=============================================================================
+
+	DOWNLOAD CACHE
+
+	Every client fetching a file shares one copy of it, keyed by path and
+	modification time. Once sv_downloadCacheMB is exceeded, files nobody is
+	fetching are evicted least recently used first. With
+	sv_downloadPrecompress a file is also deflated once into chunks that
+	SV_SendDownload hands to each SVC_ZDOWNLOAD client as they are. That
+	runs on a job worker, and clients are deflated for window by window
+	until it finishes.
+
+=============================================================================
+*/
+
+#define SV_ZDOWNLOAD_CHUNK	8192	// largest raw span deflated into one chunk
+#define SV_ZDOWNLOAD_TARGET	1024	// compressed size precompressed chunks aim for
+#define SV_DOWNLOAD_RESERVE	256		// reliable space left for prints and such
+#define SV_DOWNLOAD_BULK	65536	// most a window sent as one fragmented reliable can hold
+
+typedef struct svDownloadChunk_s {
+	int					rawOfs, rawLen;
+	int					zOfs, zLen;				// zLen 0 means the span goes out stored
+} svDownloadChunk_t;
+
+typedef struct svDownload_s {
+	char				name[MAX_OSPATH];
+	int					fileTime;
+	qBool				fromPak;
+	qBool				stale;					// changed on disk, freed once the last client is done
+
+	byte				*data;
+	int					size;
+
+	svDownloadChunk_t	*chunks;
+	int					numChunks;
+	byte				*zData;
+	int					zSize;
+
+	jobList_t			job;					// precompression, see SV_DownloadReady
+	qBool				compressing;
+
+	int					refCount;
+	uint32				lastUsed;
+
+	struct svDownload_s	*next;
+} svDownload_t;
+
+static svDownload_t	*sv_downloadCache;
+static int			sv_downloadCacheBytes;
+static uint32		sv_downloadCacheSequence;
+
+static int			sv_downloadCacheHits;
+static int			sv_downloadCacheMisses;
+static int			sv_downloadCacheEvictions;
+
 /*
 ==================
-SV_NextDownload_f
+SV_DeflateChunk
+
+Deflates as much of data as fits in room, returns the raw length used.
+zLen comes back 0 when the span doesn't compress and should go out stored.
 ==================
 */
-static void SV_NextDownload_f (void)
+static int SV_DeflateChunk (byte *data, int rawLen, byte *out, int room, int *zLen)
+{
+	// Start from a typical ratio and shrink until it fits
+	rawLen = min (rawLen, min (room * 3, SV_ZDOWNLOAD_CHUNK));
+	for ( ; ; ) {
+		*zLen = FS_ZLibCompressChunk (data, rawLen, out, room, 6, -15);
+		if (*zLen > 0 && *zLen < rawLen)
+			return rawLen;
+		if (rawLen <= room) {
+			*zLen = 0;
+			return rawLen;
+		}
+		rawLen /= 2;
+	}
+}
+
+
+/*
+==================
+SV_PrecompressJob
+
+Runs on a job worker, only touches the download it was handed.
+==================
+*/
+static void SV_PrecompressJob (void *arg)
+{
+	svDownload_t		*dl = (svDownload_t *)arg;
+	svDownloadChunk_t	*chunks;
+	byte				*zData;
+	int					maxChunks, ofs, zOfs;
+
+	// Every chunk but the last covers at least half the target
+	maxChunks = dl->size / (SV_ZDOWNLOAD_TARGET / 2) + 1;
+	chunks = Mem_PoolAlloc (sizeof (svDownloadChunk_t) * maxChunks, sv_genericPool, 0);
+	zData = Mem_PoolAlloc (dl->size, sv_genericPool, 0);
+
+	for (ofs=0, zOfs=0 ; ofs<dl->size ; dl->numChunks++) {
+		chunks[dl->numChunks].rawOfs = ofs;
+		chunks[dl->numChunks].zOfs = zOfs;
+		chunks[dl->numChunks].rawLen = SV_DeflateChunk (dl->data + ofs, dl->size - ofs, zData + zOfs, min (SV_ZDOWNLOAD_TARGET, dl->size - zOfs), &chunks[dl->numChunks].zLen);
+
+		ofs += chunks[dl->numChunks].rawLen;
+		zOfs += chunks[dl->numChunks].zLen;
+	}
+
+	// Keep just what was used
+	dl->chunks = Mem_PoolAlloc (sizeof (svDownloadChunk_t) * dl->numChunks, sv_genericPool, 0);
+	memcpy (dl->chunks, chunks, sizeof (svDownloadChunk_t) * dl->numChunks);
+	Mem_Free (chunks);
+
+	if (zOfs) {
+		dl->zData = Mem_PoolAlloc (zOfs, sv_genericPool, 0);
+		memcpy (dl->zData, zData, zOfs);
+	}
+	dl->zSize = zOfs;
+	Mem_Free (zData);
+}
+
+
+/*
+==================
+SV_PrecompressDownload
+==================
+*/
+static void SV_PrecompressDownload (svDownload_t *dl)
+{
+	if (dl->chunks || dl->compressing)
+		return;
+
+	dl->compressing = qTrue;
+	Job_Add (&dl->job, SV_PrecompressJob, dl);
+}
+
+
+/*
+==================
+SV_DownloadReady
+
+True once the precompressed chunks can be handed out. Picks up a finished
+job, so nothing but the worker touches the chunks before this says so.
+==================
+*/
+static qBool SV_DownloadReady (svDownload_t *dl)
+{
+	if (dl->compressing) {
+		if (!Job_Done (&dl->job))
+			return qFalse;
+
+		dl->compressing = qFalse;
+		sv_downloadCacheBytes += dl->zSize + sizeof (svDownloadChunk_t) * dl->numChunks;
+	}
+
+	return (dl->chunks != NULL);
+}
+
+
+/*
+==================
+SV_FindDownloadChunk
+==================
+*/
+static svDownloadChunk_t *SV_FindDownloadChunk (svDownload_t *dl, int ofs)
+{
+	int		low, high, mid;
+
+	low = 0;
+	high = dl->numChunks - 1;
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if (dl->chunks[mid].rawOfs <= ofs)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	return &dl->chunks[low];
+}
+
+
+/*
+==================
+SV_FreeDownload
+==================
+*/
+static void SV_FreeDownload (svDownload_t *dl)
+{
+	svDownload_t	**prev;
+
+	// Can't pull the data out from under the worker
+	if (dl->compressing) {
+		Job_Wait (&dl->job);
+		SV_DownloadReady (dl);
+	}
+
+	for (prev=&sv_downloadCache ; *prev ; prev=&(*prev)->next) {
+		if (*prev == dl) {
+			*prev = dl->next;
+			break;
+		}
+	}
+
+	sv_downloadCacheBytes -= dl->size + dl->zSize + sizeof (svDownloadChunk_t) * dl->numChunks;
+
+	FS_FreeFile (dl->data);
+	if (dl->chunks)
+		Mem_Free (dl->chunks);
+	if (dl->zData)
+		Mem_Free (dl->zData);
+	Mem_Free (dl);
+}
+
+
+/*
+==================
+SV_TrimDownloadCache
+==================
+*/
+static void SV_TrimDownloadCache (void)
+{
+	svDownload_t	*dl, *oldest;
+	int				maxBytes;
+
+	maxBytes = max (sv_downloadCacheMB->intVal, 0) * 1024 * 1024;
+	while (sv_downloadCacheBytes > maxBytes) {
+		oldest = NULL;
+		for (dl=sv_downloadCache ; dl ; dl=dl->next) {
+			if (dl->refCount)
+				continue;
+			if (!oldest || dl->lastUsed < oldest->lastUsed)
+				oldest = dl;
+		}
+		if (!oldest)
+			break;	// everything left is being sent
+
+		SV_FreeDownload (oldest);
+		sv_downloadCacheEvictions++;
+	}
+}
+
+
+/*
+==================
+SV_AcquireDownload
+
+Returns the shared copy of a file with a reference held, NULL if it
+can't be loaded
+==================
+*/
+static svDownload_t *SV_AcquireDownload (char *name)
+{
+	extern qBool	fs_fileFromPak;
+	svDownload_t	*dl, *next;
+	byte			*data;
+	int				fileTime, size;
+
+	fileTime = FS_FileTime (name);
+	if (fileTime == -1)
+		return NULL;
+
+	for (dl=sv_downloadCache ; dl ; dl=next) {
+		next = dl->next;
+		if (dl->stale || Q_stricmp (dl->name, name))
+			continue;
+
+		if (dl->fileTime == fileTime) {
+			sv_downloadCacheHits++;
+			dl->refCount++;
+			dl->lastUsed = ++sv_downloadCacheSequence;
+			return dl;
+		}
+
+		// Changed on disk, let the clients that have it finish
+		dl->stale = qTrue;
+		if (!dl->refCount)
+			SV_FreeDownload (dl);
+	}
+
+	size = FS_LoadFile (name, (void **)&data, NULL);
+	if (!data)
+		return NULL;
+	if (size <= 0) {
+		FS_FreeFile (data);
+		return NULL;
+	}
+	sv_downloadCacheMisses++;
+
+	dl = Mem_PoolAlloc (sizeof (svDownload_t), sv_genericPool, 0);
+	Q_strncpyz (dl->name, name, sizeof (dl->name));
+	dl->fileTime = fileTime;
+	dl->fromPak = fs_fileFromPak;
+	dl->data = data;
+	dl->size = size;
+	dl->refCount = 1;
+	dl->lastUsed = ++sv_downloadCacheSequence;
+
+	dl->next = sv_downloadCache;
+	sv_downloadCache = dl;
+	sv_downloadCacheBytes += size;
+
+	SV_TrimDownloadCache ();
+	return dl;
+}
+
+
+/*
+==================
+SV_ReleaseDownload
+==================
+*/
+void SV_ReleaseDownload (svClient_t *cl)
 {
-	int		r;
-	int		percent;
-	int		size;
+	svDownload_t	*dl = cl->downloadCache;
 
-	if (!sv_currentClient->download)
+	cl->downloadCache = NULL;
+	cl->download = NULL;
+	if (!dl)
 		return;
 
-	r = sv_currentClient->downloadSize - sv_currentClient->downloadCount;
-	if (r > 1024)
-		r = 1024;
+	dl->refCount--;
+	if (dl->stale && !dl->refCount)
+		SV_FreeDownload (dl);
+	else
+		SV_TrimDownloadCache ();
+}
+
+
+/*
+==================
+SV_DownloadCacheShutdown
+==================
+*/
+void SV_DownloadCacheShutdown (void)
+{
+	while (sv_downloadCache)
+		SV_FreeDownload (sv_downloadCache);
+
+	sv_downloadCacheBytes = 0;
+}
+
+
+/*
+==================
+SV_DownloadCache_f
+==================
+*/
+static void SV_DownloadCache_f (void)
+{
+	svDownload_t	*dl;
+	int				num;
+
+	Com_Printf (0, "size     deflated refs name\n");
+	Com_Printf (0, "-------- -------- ---- --------------------------------\n");
+	for (dl=sv_downloadCache, num=0 ; dl ; dl=dl->next, num++) {
+		SV_DownloadReady (dl);
+		if (dl->compressing)
+			Com_Printf (0, "%8i deflating %4i %s%s\n", dl->size, dl->refCount, dl->name, dl->stale ? " (stale)" : "");
+		else
+			Com_Printf (0, "%8i %8i %4i %s%s\n", dl->size, dl->zSize, dl->refCount, dl->name, dl->stale ? " (stale)" : "");
+	}
+
+	Com_Printf (0, "%i files, %.1fMB of %iMB\n", num, sv_downloadCacheBytes / (1024.0f * 1024.0f), sv_downloadCacheMB->intVal);
+	Com_Printf (0, "%i hits, %i misses, %i evictions\n", sv_downloadCacheHits, sv_downloadCacheMisses, sv_downloadCacheEvictions);
+}
 
-	MSG_WriteByte (&sv_currentClient->netChan.message, SVC_DOWNLOAD);
-	MSG_WriteShort (&sv_currentClient->netChan.message, r);
 
-	sv_currentClient->downloadCount += r;
-	size = sv_currentClient->downloadSize;
-	if (!size)
-		size = 1;
-	percent = sv_currentClient->downloadCount*100/size;
-	MSG_WriteByte (&sv_currentClient->netChan.message, percent);
-	MSG_WriteRaw (&sv_currentClient->netChan.message, sv_currentClient->download + sv_currentClient->downloadCount - r, r);
+/*
+==================
+SV_DownloadBenchPass
 
-	if (sv_currentClient->downloadCount != sv_currentClient->downloadSize)
+Runs the whole download through SV_SendDownload, acking everything after
+each round trip. A loopback client gets one reliable message a round trip;
+a remote one that takes fragments gets a paced bulk window a round trip.
+==================
+*/
+static void SV_DownloadBenchPass (svClient_t *cl, byte *data, int size, qBool remote)
+{
+	int			numRounds, wireBytes, numPieces;
+	uint32		start, time;
+
+	if (remote) {
+		cl->netChan.remoteAddress.naType = NA_IP;
+		cl->netChan.fragments = qTrue;
+		cl->rate = 1 << 24;
+	}
+	else {
+		cl->netChan.remoteAddress.naType = NA_LOOPBACK;
+		cl->netChan.fragments = qFalse;
+	}
+
+	cl->download = data;
+	cl->downloadSize = size;
+	cl->downloadCount = 0;
+	cl->downloadPending = 0;
+	cl->downloadCredit = 0;
+	cl->downloadCreditTime = Sys_Milliseconds ();
+	cl->downloadStart = cl->downloadCreditTime;
+
+	numRounds = 0;
+	wireBytes = 0;
+	start = Sys_UMilliseconds ();
+	while (cl->download) {
+		// The bench isn't paced in real time, so hand over a full second's credit
+		if (remote)
+			cl->downloadCredit = cl->rate;
+
+		SV_SendDownload (cl);
+
+		if (remote && cl->netChan.bulkBuff) {
+			numPieces = (int)((cl->netChan.bulkLength + NETCHAN_FRAGMENT_SIZE - 1) / NETCHAN_FRAGMENT_SIZE);
+			wireBytes += (int)cl->netChan.bulkLength + numPieces * (PACKET_HEADER + 6);
+			Mem_Free (cl->netChan.bulkBuff);
+			cl->netChan.bulkBuff = NULL;
+			cl->netChan.bulkLength = 0;
+		}
+		else if (cl->netChan.message.curSize) {
+			wireBytes += (int)cl->netChan.message.curSize + PACKET_HEADER;
+			MSG_Clear (&cl->netChan.message);
+		}
+		else {
+			Com_Printf (PRNT_ERROR, "downloadbench: stalled at %i of %i bytes\n", cl->downloadCount, size);
+			SV_ReleaseDownload (cl);
+			break;
+		}
+
+		// Delivered and acked in one go
+		numRounds++;
+		cl->downloadPending = 0;
+	}
+	time = Sys_UMilliseconds () - start;
+
+	Com_Printf (0, "%s: %i bytes in %i round trips, %i bytes on the wire (%.1f%%), packed in %ums\n",
+		remote ? "remote, fragmented" : "loopback", size, numRounds, wireBytes, wireBytes * 100.0f / size, time);
+	Com_Printf (0, "  RTT bound: %i KB/sec over a 50ms round trip, %i KB/sec over a 100ms one\n",
+		numRounds ? (int)((uint64)size * 20 / numRounds / 1024) : 0,
+		numRounds ? (int)((uint64)size * 10 / numRounds / 1024) : 0);
+}
+
+
+/*
+==================
+SV_DownloadBench_f
+
+Pushes a file, or 5MB of generated data, through SV_SendDownload twice: as
+a loopback client, and as a remote client taking fragmented reliables with
+sv_downloadWindow chunks a round trip. The remote figures are what the RTT
+allows, a client's rate caps them further.
+==================
+*/
+static void SV_DownloadBench_f (void)
+{
+	svClient_t		*cl;
+	svDownload_t	*dl;
+	byte			*data;
+	int				i, size, pass;
+	uint32			start, compTime;
+
+	cl = Mem_PoolAlloc (sizeof (svClient_t), sv_genericPool, 0);
+	Q_strncpyz (cl->name, "downloadbench", sizeof (cl->name));
+	MSG_Init (&cl->netChan.message, cl->netChan.messageBuff, MAX_SV_USABLEMSG);
+	cl->downloadCompress = qTrue;
+
+	// Something about as compressible as a map
+	data = NULL;
+	compTime = 0;
+	size = 5 * 1024 * 1024;
+	if (Cmd_Argc () < 2) {
+		data = Mem_PoolAlloc (size, sv_genericPool, 0);
+		for (i=0 ; i<size ; i++)
+			data[i] = (byte)((i >> 4) ^ (rand () & 0x1f));
+	}
+
+	for (pass=0 ; pass<2 ; pass++) {
+		if (data) {
+			SV_DownloadBenchPass (cl, data, size, (pass == 1));
+			continue;
+		}
+
+		// Each pass holds its own reference, the pass releases it when done
+		dl = SV_AcquireDownload (Cmd_Argv (1));
+		if (!dl) {
+			Com_Printf (PRNT_ERROR, "downloadbench: couldn't load %s\n", Cmd_Argv (1));
+			break;
+		}
+
+		if (sv_downloadPrecompress->intVal && !pass) {
+			start = Sys_UMilliseconds ();
+			SV_PrecompressDownload (dl);
+			Job_Wait (&dl->job);
+			compTime = Sys_UMilliseconds () - start;
+			Com_Printf (0, "precompressed in %ums\n", compTime);
+		}
+
+		cl->downloadCache = dl;
+		SV_DownloadBenchPass (cl, dl->data, dl->size, (pass == 1));
+	}
+
+	if (data)
+		Mem_Free (data);
+	Mem_Free (cl);
+}
+
+
+/*
+==================
+SV_DownloadCommandInit
+==================
+*/
+void SV_DownloadCommandInit (void)
+{
+	Cmd_AddCommand ("downloadcache",	SV_DownloadCache_f,		"Lists the files shared by downloading clients");
+	Cmd_AddCommand ("downloadbench",	SV_DownloadBench_f,		"Measures download throughput for loopback and remote clients");
+}
+
+// ==========================================================================
+
+/*
+==================
+SV_WriteDownloadChunks
+
+Writes up to maxChunks chunks into msg as the client's rate and the room
+allow, keeping reserve bytes free. Chunks are deflated into SVC_ZDOWNLOAD
+when the client asked for it and it actually saves space.
+==================
+*/
+static void SV_WriteDownloadChunks (svClient_t *cl, netMsg_t *msg, int maxChunks, int reserve)
+{
+	svDownload_t		*dl = cl->downloadCache;
+	svDownloadChunk_t	*chunk;
+	byte				zBuff[MAX_SV_USABLEMSG];
+	byte				*data, *zData;
+	int					room, numChunks;
+	int					rawLen, zLen, percent;
+
+	for (numChunks=0 ; numChunks<maxChunks ; numChunks++) {
+		if (cl->downloadCount >= cl->downloadSize || cl->downloadCredit <= 0)
+			break;
+
+		// Command, size, percent and the uncompressed size, and no chunk
+		// bigger than one that would fit a lone message
+		room = (int)(msg->maxSize - msg->curSize) - 6 - reserve;
+		room = min (room, MAX_SV_USABLEMSG - 6 - SV_DOWNLOAD_RESERVE);
+		if (room < 128)
+			break;
+
+		data = cl->download + cl->downloadCount;
+		rawLen = cl->downloadSize - cl->downloadCount;
+		zData = zBuff;
+		zLen = 0;
+
+		if (cl->downloadCompress && dl && SV_DownloadReady (dl)) {
+			chunk = SV_FindDownloadChunk (dl, cl->downloadCount);
+			if (chunk->rawOfs == cl->downloadCount) {
+				if ((chunk->zLen ? chunk->zLen : chunk->rawLen) > room)
+					break;	// wait for an emptier message
+
+				rawLen = chunk->rawLen;
+				zData = dl->zData + chunk->zOfs;
+				zLen = chunk->zLen;
+			}
+			else {
+				// Resumed partway into a chunk, deflate up to the next one
+				rawLen = SV_DeflateChunk (data, chunk->rawOfs + chunk->rawLen - cl->downloadCount, zBuff, room, &zLen);
+			}
+		}
+		else if (cl->downloadCompress) {
+			// No precompressed copy (yet), deflate just what fits
+			rawLen = SV_DeflateChunk (data, rawLen, zBuff, room, &zLen);
+		}
+		else {
+			rawLen = min (rawLen, room);
+		}
+
+		cl->downloadCount += rawLen;
+		percent = (int)((uint64)cl->downloadCount * 100 / cl->downloadSize);
+
+		if (zLen) {
+			MSG_WriteByte (msg, SVC_ZDOWNLOAD);
+			MSG_WriteShort (msg, zLen);
+			MSG_WriteByte (msg, percent);
+			MSG_WriteShort (msg, rawLen);
+			MSG_WriteRaw (msg, zData, zLen);
+			cl->downloadCredit -= zLen + 6;
+		}
+		else {
+			MSG_WriteByte (msg, SVC_DOWNLOAD);
+			MSG_WriteShort (msg, rawLen);
+			MSG_WriteByte (msg, percent);
+			MSG_WriteRaw (msg, data, rawLen);
+			cl->downloadCredit -= rawLen + 4;
+		}
+
+		cl->downloadPending++;
+	}
+}
+
+
+/*
+==================
+SV_SendDownload
+
+The reliable channel only has one message in flight, so a chunk at a time
+through it is stop-and-wait. A client that took fragmented reliables gets
+up to sv_downloadWindow chunks at a time as one paced bulk reliable instead,
+queued behind the one in flight so a window goes out every round trip.
+Anyone else gets what fits in the reliable message.
+==================
+*/
+void SV_SendDownload (svClient_t *cl)
+{
+	static byte	bulkData[SV_DOWNLOAD_BULK];
+	netMsg_t	bulk;
+	int			now, credit;
+	int			oldCount, oldPending, oldCredit;
+
+	if (!cl->download)
+		return;
+
+	// Refill the rate credit, loopback is never rate limited
+	now = Sys_Milliseconds ();
+	if (cl->netChan.remoteAddress.naType == NA_LOOPBACK) {
+		cl->downloadCredit = MAX_SV_USABLEMSG;
+		cl->downloadCreditTime = now;
+	}
+	else {
+		credit = (now - cl->downloadCreditTime) * cl->rate / 1000;
+		if (credit > 0) {
+			cl->downloadCredit = min (cl->downloadCredit + credit, cl->rate);
+			cl->downloadCreditTime = now;
+		}
+	}
+
+	if (cl->netChan.fragments) {
+		// The next window waits until the queued one is on its way
+		if (!cl->netChan.bulkBuff) {
+			oldCount = cl->downloadCount;
+			oldPending = cl->downloadPending;
+			oldCredit = cl->downloadCredit;
+
+			MSG_Init (&bulk, bulkData, sizeof (bulkData));
+			SV_WriteDownloadChunks (cl, &bulk, max (sv_downloadWindow->intVal, 1), 0);
+			if (bulk.curSize && !Netchan_QueueBulk (&cl->netChan, bulk.data, bulk.curSize)) {
+				// Take the window back and send what fits the message
+				cl->downloadCount = oldCount;
+				cl->downloadPending = oldPending;
+				cl->downloadCredit = oldCredit;
+				SV_WriteDownloadChunks (cl, &cl->netChan.message, max (sv_downloadWindow->intVal, 1) - cl->downloadPending, SV_DOWNLOAD_RESERVE);
+			}
+		}
+	}
+	else {
+		SV_WriteDownloadChunks (cl, &cl->netChan.message, max (sv_downloadWindow->intVal, 1) - cl->downloadPending, SV_DOWNLOAD_RESERVE);
+	}
+
+	if (cl->downloadCount != cl->downloadSize)
 		return;
 
-	FS_FreeFile (sv_currentClient->download);
-	sv_currentClient->download = NULL;
+	now -= cl->downloadStart;
+	Com_DevPrintf (0, "Download to %s finished: %i bytes in %ims (%i bytes/sec)\n",
+		cl->name, cl->downloadSize, now, now ? (int)((uint64)cl->downloadSize * 1000 / now) : cl->downloadSize);
+
+	SV_ReleaseDownload (cl);
+}
+
+
+/*
+==================
+SV_NextDownload_f
+
+Each nextdl answers one chunk, which opens a slot in the window
+==================
+*/
+static void SV_NextDownload_f (void)
+{
+	if (sv_currentClient->downloadPending > 0)
+		sv_currentClient->downloadPending--;
+
+	SV_SendDownload (sv_currentClient);
 }
 
 
@@ -308,10 +1055,10 @@ static void SV_BeginDownload_f (void)
 	extern cVar_t	*allow_download_models;
 	extern cVar_t	*allow_download_sounds;
 	extern cVar_t	*allow_download_maps;
-	extern qBool	fs_fileFromPak; // ZOID did file come from pak?
 
-	char	*name;
-	int		offset = 0;
+	svDownload_t	*dl;
+	char			*name;
+	int				offset = 0;
 
 	name = Cmd_Argv (1);
 
@@ -336,23 +1083,16 @@ static void SV_BeginDownload_f (void)
 	}
 
 	if (sv_currentClient->download)
-		FS_FreeFile (sv_currentClient->download);
-
-	sv_currentClient->downloadSize = FS_LoadFile (name, (void **)&sv_currentClient->download, NULL);
-	if (sv_currentClient->downloadSize == 0)
-		sv_currentClient->downloadSize = -1;	// Don't send an empty file
-	sv_currentClient->downloadCount = offset;
-
-	if (offset > sv_currentClient->downloadSize)
-		sv_currentClient->downloadCount = sv_currentClient->downloadSize;
+		SV_ReleaseDownload (sv_currentClient);
 
-	if (!sv_currentClient->download
+	dl = SV_AcquireDownload (name);
+	if (!dl
 		// Special check for maps, if it came from a pak file, don't allow download  ZOID
-		|| (!strncmp (name, "maps/", 5) && fs_fileFromPak)) {
+		|| (!strncmp (name, "maps/", 5) && dl->fromPak)) {
 		Com_DevPrintf (0, "Couldn't download %s to %s\n", name, sv_currentClient->name);
-		if (sv_currentClient->download) {
-			FS_FreeFile (sv_currentClient->download);
-			sv_currentClient->download = NULL;
+		if (dl) {
+			sv_currentClient->downloadCache = dl;
+			SV_ReleaseDownload (sv_currentClient);
 		}
 
 		MSG_WriteByte (&sv_currentClient->netChan.message, SVC_DOWNLOAD);
@@ -361,7 +1101,35 @@ static void SV_BeginDownload_f (void)
 		return;
 	}
 
-	SV_NextDownload_f ();
+	sv_currentClient->downloadCache = dl;
+	sv_currentClient->download = dl->data;
+	sv_currentClient->downloadSize = dl->size;
+	sv_currentClient->downloadCount = offset;
+
+	if (offset > sv_currentClient->downloadSize)
+		sv_currentClient->downloadCount = sv_currentClient->downloadSize;
+	else if (offset < 0)
+		sv_currentClient->downloadCount = 0;
+
+	sv_currentClient->downloadCompress = (Cmd_Argc () > 3 && !strcmp (Cmd_Argv (3), "udp-zlib"));
+	if (sv_currentClient->downloadCompress && sv_downloadPrecompress->intVal)
+		SV_PrecompressDownload (dl);
+	sv_currentClient->downloadPending = 0;
+	sv_currentClient->downloadCredit = MAX_SV_USABLEMSG;
+	sv_currentClient->downloadCreditTime = Sys_Milliseconds ();
+	sv_currentClient->downloadStart = sv_currentClient->downloadCreditTime;
+
+	// Nothing left to send on a finished resume, tell the client it's done
+	if (sv_currentClient->downloadCount == sv_currentClient->downloadSize) {
+		MSG_WriteByte (&sv_currentClient->netChan.message, SVC_DOWNLOAD);
+		MSG_WriteShort (&sv_currentClient->netChan.message, 0);
+		MSG_WriteByte (&sv_currentClient->netChan.message, 100);
+
+		SV_ReleaseDownload (sv_currentClient);
+		return;
+	}
+
+	SV_SendDownload (sv_currentClient);
 	Com_DevPrintf (0, "Downloading %s to %s\n", name, sv_currentClient->name);
 }
 
@@ -677,6 +1445,8 @@ void SV_ExecuteClientMessage (svClient_t *cl)
 			// Malicious users may try using too many string commands
 			if (++stringCmdCount < MAX_STRINGCMDS)
 				SV_ExecuteUserCommand (s);
+			else if (!strcmp (s, "nextdl") && cl->downloadPending > 0)
+				cl->downloadPending--;	// still count the ack, the window is topped up after the packet
 
 			if (cl->state == SVCS_FREE)
 				return;		// Disconnect command
@@ -44,8 +44,80 @@ typedef struct areaNode_s {
 #define AREA_DEPTH	4
 #define AREA_NODES	32
 
-static areaNode_t	sv_areaNodes[AREA_NODES];
-static int			sv_numAreaNodes;
+/*
+** Loose grid: level N cells are (gridSize << N) units across, and an entity
+** goes in the first level whose cells are at least as wide as it is, in the
+** cell holding its center. Queries widen their box by half a cell on each
+** level to pick up entities hanging over a cell edge. The top level is a
+** single cell that takes anything too large or outside the world bounds.
+*/
+#define AREA_GRID_LEVELS	16
+#define AREA_GRID_MAXCELLS	65536	// on the finest level
+
+typedef struct areaCell_s {
+	link_t		trigger_edicts;
+	link_t		solid_edicts;
+} areaCell_t;
+
+typedef struct areaGridLevel_s {
+	float		cellSize;
+	int			width, height;
+	areaCell_t	*cells;
+} areaGridLevel_t;
+
+enum {
+	AREA_INDEX_TREE,
+	AREA_INDEX_GRID,
+
+	AREA_INDEX_MAX
+};
+
+static char *sv_areaIndexNames[AREA_INDEX_MAX] = {
+	"tree",
+	"grid"
+};
+
+typedef struct areaWorld_s {
+	int				index;
+
+	// AREA_INDEX_TREE
+	areaNode_t		nodes[AREA_NODES];
+	int				numNodes;
+
+	// AREA_INDEX_GRID
+	vec3_t			gridMins, gridMaxs;
+	int				numLevels;
+	areaGridLevel_t	levels[AREA_GRID_LEVELS];
+	areaCell_t		*cellMemory;
+
+	// Statistics
+	int				numQueries;
+	int				numVisited;			// nodes or cells looked at
+	int				numTested;			// edict bounds compared
+} areaWorld_t;
+
+static areaWorld_t	sv_areaWorld;
+
+// arearecord/areabench, see the end of this file
+#define AREA_RECORD_IDENT		(('1'<<24)+('N'<<16)+('B'<<8)+'A')	// "ABN1"
+#define AREA_RECORD_MAXQUERIES	4096
+
+typedef struct areaRecordEnt_s {
+	int16			num;
+	int16			solid;
+	vec3_t			absMin, absMax;
+} areaRecordEnt_t;
+
+typedef struct areaRecordQuery_s {
+	vec3_t			mins, maxs;
+	int				areaType;
+} areaRecordQuery_t;
+
+static fileHandle_t			sv_areaRecordFile;
+static int					sv_areaRecordFrames;
+static int					sv_areaRecordDropped;
+static areaRecordQuery_t	sv_areaRecordQueries[AREA_RECORD_MAXQUERIES];
+static int					sv_areaRecordNumQueries;
 
 static float	*sv_areaMins, *sv_areaMaxs;
 static edict_t	**sv_areaList;
@@ -97,14 +169,14 @@ SV_CreateAreaNode
 Builds a uniformly subdivided tree for the given world size
 ===============
 */
-static areaNode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
+static areaNode_t *SV_CreateAreaNode (areaWorld_t *world, int depth, vec3_t mins, vec3_t maxs)
 {
 	areaNode_t	*anode;
 	vec3_t		size;
 	vec3_t		mins1, maxs1, mins2, maxs2;
 
-	anode = &sv_areaNodes[sv_numAreaNodes];
-	sv_numAreaNodes++;
+	anode = &world->nodes[world->numNodes];
+	world->numNodes++;
 
 	ClearLink (&anode->trigger_edicts);
 	ClearLink (&anode->solid_edicts);
@@ -129,13 +201,94 @@ static areaNode_t *SV_CreateAreaNode (int depth, vec3_t mins, vec3_t maxs)
 	
 	maxs1[anode->axis] = mins2[anode->axis] = anode->dist;
 	
-	anode->children[0] = SV_CreateAreaNode (depth+1, mins2, maxs2);
-	anode->children[1] = SV_CreateAreaNode (depth+1, mins1, maxs1);
+	anode->children[0] = SV_CreateAreaNode (world, depth+1, mins2, maxs2);
+	anode->children[1] = SV_CreateAreaNode (world, depth+1, mins1, maxs1);
 
 	return anode;
 }
 
 
+/*
+===============
+SV_CreateAreaGrid
+===============
+*/
+static void SV_CreateAreaGrid (areaWorld_t *world, vec3_t mins, vec3_t maxs)
+{
+	areaGridLevel_t	*level;
+	float			cellSize, extent;
+	int				numCells, i, j;
+	areaCell_t		*cell;
+
+	Vec3Copy (mins, world->gridMins);
+	Vec3Copy (maxs, world->gridMaxs);
+	extent = max (maxs[0] - mins[0], maxs[1] - mins[1]);
+	if (extent < 1)
+		extent = 1;
+
+	// Coarsen the finest level until it fits the cell budget
+	cellSize = sv_areaGridSize->intVal > 8 ? sv_areaGridSize->intVal : 8;
+	while ((extent / cellSize + 1) * (extent / cellSize + 1) > AREA_GRID_MAXCELLS)
+		cellSize *= 2;
+
+	// Lay out the levels, ending with a single cell
+	numCells = 0;
+	for (world->numLevels=0 ; world->numLevels<AREA_GRID_LEVELS ; world->numLevels++) {
+		level = &world->levels[world->numLevels];
+		level->cellSize = cellSize;
+		level->width = (int)ceil ((maxs[0] - mins[0]) / cellSize);
+		level->height = (int)ceil ((maxs[1] - mins[1]) / cellSize);
+		level->width = max (level->width, 1);
+		level->height = max (level->height, 1);
+		numCells += level->width * level->height;
+
+		if (level->width == 1 && level->height == 1) {
+			world->numLevels++;
+			break;
+		}
+		cellSize *= 2;
+	}
+
+	world->cellMemory = Mem_PoolAlloc (sizeof (areaCell_t) * numCells, sv_genericPool, 0);
+
+	cell = world->cellMemory;
+	for (i=0 ; i<world->numLevels ; i++) {
+		level = &world->levels[i];
+		level->cells = cell;
+		for (j=0 ; j<level->width*level->height ; j++, cell++) {
+			ClearLink (&cell->trigger_edicts);
+			ClearLink (&cell->solid_edicts);
+		}
+	}
+}
+
+
+/*
+===============
+SV_InitAreaWorld
+===============
+*/
+static void SV_InitAreaWorld (areaWorld_t *world, int index, vec3_t mins, vec3_t maxs)
+{
+	if (world->cellMemory)
+		Mem_Free (world->cellMemory);
+
+	memset (world, 0, sizeof (areaWorld_t));
+	world->index = index;
+
+	switch (index) {
+	case AREA_INDEX_GRID:
+		SV_CreateAreaGrid (world, mins, maxs);
+		break;
+
+	default:
+		world->index = AREA_INDEX_TREE;
+		SV_CreateAreaNode (world, 0, mins, maxs);
+		break;
+	}
+}
+
+
 /*
 ===============
 SV_ClearWorld
@@ -145,11 +298,15 @@ void SV_ClearWorld (void)
 {
 	vec3_t	mins, maxs;
 
-	memset (sv_areaNodes, 0, sizeof (sv_areaNodes));
-	sv_numAreaNodes = 0;
+	// A capture only replays against the world it was recorded on
+	if (sv_areaRecordFile) {
+		FS_CloseFile (sv_areaRecordFile);
+		sv_areaRecordFile = 0;
+		Com_Printf (PRNT_WARNING, "arearecord: stopped %i frames short by the level change\n", sv_areaRecordFrames);
+	}
 
 	CM_InlineModelBounds (sv.models[1], mins, maxs);
-	SV_CreateAreaNode (0, mins, maxs);
+	SV_InitAreaWorld (&sv_areaWorld, sv_areaIndex->intVal, mins, maxs);
 }
 
 
@@ -168,6 +325,76 @@ void SV_UnlinkEdict (edict_t *ent)
 }
 
 
+/*
+===============
+SV_AreaLink
+
+Files an edict with an up to date abs box under the right node or cell
+===============
+*/
+static void SV_AreaLink (areaWorld_t *world, edict_t *ent)
+{
+	areaNode_t		*node;
+	areaGridLevel_t	*level;
+	areaCell_t		*cell;
+	link_t			*trigger_edicts, *solid_edicts;
+	float			size, center[2];
+	int				i, x, y;
+
+	switch (world->index) {
+	case AREA_INDEX_GRID:
+		center[0] = 0.5f * (ent->absMin[0] + ent->absMax[0]);
+		center[1] = 0.5f * (ent->absMin[1] + ent->absMax[1]);
+		size = max (ent->absMax[0] - ent->absMin[0], ent->absMax[1] - ent->absMin[1]);
+
+		// Anything outside of the world goes to the top
+		i = world->numLevels - 1;
+		if (center[0] >= world->gridMins[0] && center[0] <= world->gridMaxs[0]
+		&& center[1] >= world->gridMins[1] && center[1] <= world->gridMaxs[1]) {
+			for (i=0 ; i<world->numLevels-1 ; i++) {
+				if (size <= world->levels[i].cellSize)
+					break;
+			}
+		}
+
+		level = &world->levels[i];
+		x = (int)((center[0] - world->gridMins[0]) / level->cellSize);
+		y = (int)((center[1] - world->gridMins[1]) / level->cellSize);
+		x = clamp (x, 0, level->width-1);
+		y = clamp (y, 0, level->height-1);
+
+		cell = &level->cells[y*level->width + x];
+		trigger_edicts = &cell->trigger_edicts;
+		solid_edicts = &cell->solid_edicts;
+		break;
+
+	default:
+		// Find the first node that the ent's box crosses
+		node = world->nodes;
+		for ( ; ; ) {
+			if (node->axis == -1)
+				break;
+			if (ent->absMin[node->axis] > node->dist)
+				node = node->children[0];
+			else if (ent->absMax[node->axis] < node->dist)
+				node = node->children[1];
+			else
+				break;	// Crosses the node
+		}
+
+		trigger_edicts = &node->trigger_edicts;
+		solid_edicts = &node->solid_edicts;
+		break;
+	}
+
+	// Link it in
+	if (ent->solid == SOLID_TRIGGER)
+		InsertLinkBefore (&ent->area, trigger_edicts);
+	else
+		InsertLinkBefore (&ent->area, solid_edicts);
+}
+
+
 /*
 ===============
 SV_LinkEdict
@@ -176,7 +403,6 @@ SV_LinkEdict
 #define MAX_TOTAL_ENT_LEAFS		128
 void SV_LinkEdict (edict_t *ent)
 {
-	areaNode_t	*node;
 	int			leafs[MAX_TOTAL_ENT_LEAFS];
 	int			clusters[MAX_TOTAL_ENT_LEAFS];
 	int			num_leafs;
@@ -330,24 +556,7 @@ void SV_LinkEdict (edict_t *ent)
 	if (ent->solid == SOLID_NOT)
 		return;
 
-	// Find the first node that the ent's box crosses
-	node = sv_areaNodes;
-	for ( ; ; ) {
-		if (node->axis == -1)
-			break;
-		if (ent->absMin[node->axis] > node->dist)
-			node = node->children[0];
-		else if (ent->absMax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;	// Crosses the node
-	}
-	
-	// Link it in	
-	if (ent->solid == SOLID_TRIGGER)
-		InsertLinkBefore (&ent->area, &node->trigger_edicts);
-	else
-		InsertLinkBefore (&ent->area, &node->solid_edicts);
+	SV_AreaLink (&sv_areaWorld, ent);
 }
 
 
@@ -356,20 +565,15 @@ void SV_LinkEdict (edict_t *ent)
 SV_AreaEdicts
 ================
 */
-static void SV_AreaEdicts_r (areaNode_t *node)
+static qBool SV_AreaEdictsList (areaWorld_t *world, link_t *start)
 {
-	link_t		*l, *next, *start;
+	link_t		*l, *next;
 	edict_t		*check;
 
-	// Touch linked edicts
-	if (sv_areaType == AREA_SOLID)
-		start = &node->solid_edicts;
-	else
-		start = &node->trigger_edicts;
-
 	for (l=start->next ; l!=start ; l=next) {
 		next = l->next;
 		check = EDICT_FROM_AREA(l);
+		world->numTested++;
 
 		if (check->solid == SOLID_NOT)
 			continue;		// Deactivated
@@ -383,24 +587,80 @@ static void SV_AreaEdicts_r (areaNode_t *node)
 
 		if (sv_areaCount == sv_areaMaxCount) {
 			Com_Printf (0, "SV_AreaEdicts: MAXCOUNT\n");
-			return;
+			return qFalse;
 		}
 
 		sv_areaList[sv_areaCount] = check;
 		sv_areaCount++;
 	}
+
+	return qTrue;
+}
+
+static void SV_AreaEdicts_r (areaWorld_t *world, areaNode_t *node)
+{
+	world->numVisited++;
+
+	// Touch linked edicts
+	if (!SV_AreaEdictsList (world, (sv_areaType == AREA_SOLID) ? &node->solid_edicts : &node->trigger_edicts))
+		return;
 	
 	if (node->axis == -1)
 		return;		// Terminal node
 
 	// Recurse down both sides
 	if (sv_areaMaxs[node->axis] > node->dist)
-		SV_AreaEdicts_r (node->children[0]);
+		SV_AreaEdicts_r (world, node->children[0]);
 	if (sv_areaMins[node->axis] < node->dist)
-		SV_AreaEdicts_r (node->children[1]);
+		SV_AreaEdicts_r (world, node->children[1]);
 }
 
-int SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **list, int maxCount, int areaType)
+static void SV_AreaEdictsGrid (areaWorld_t *world)
+{
+	areaGridLevel_t	*level;
+	areaCell_t		*cell;
+	link_t			*start;
+	float			pad;
+	int				i, x, y;
+	int				x1, y1, x2, y2;
+
+	for (i=0, level=world->levels ; i<world->numLevels ; i++, level++) {
+		if (i == world->numLevels-1) {
+			x1 = y1 = 0;
+			x2 = level->width - 1;
+			y2 = level->height - 1;
+		}
+		else {
+			pad = level->cellSize * 0.5f;
+			x1 = (int)floor ((sv_areaMins[0] - pad - world->gridMins[0]) / level->cellSize);
+			y1 = (int)floor ((sv_areaMins[1] - pad - world->gridMins[1]) / level->cellSize);
+			x2 = (int)floor ((sv_areaMaxs[0] + pad - world->gridMins[0]) / level->cellSize);
+			y2 = (int)floor ((sv_areaMaxs[1] + pad - world->gridMins[1]) / level->cellSize);
+			if (x2 < 0 || y2 < 0 || x1 >= level->width || y1 >= level->height)
+				continue;
+
+			x1 = max (x1, 0);
+			y1 = max (y1, 0);
+			x2 = min (x2, level->width-1);
+			y2 = min (y2, level->height-1);
+		}
+
+		for (y=y1 ; y<=y2 ; y++) {
+			cell = &level->cells[y*level->width + x1];
+			for (x=x1 ; x<=x2 ; x++, cell++) {
+				world->numVisited++;
+
+				start = (sv_areaType == AREA_SOLID) ? &cell->solid_edicts : &cell->trigger_edicts;
+				if (start->next == start)
+					continue;
+				if (!SV_AreaEdictsList (world, start))
+					return;
+			}
+		}
+	}
+}
+
+static int SV_AreaQuery (areaWorld_t *world, vec3_t mins, vec3_t maxs, edict_t **list, int maxCount, int areaType)
 {
 	sv_areaMins = mins;
 	sv_areaMaxs = maxs;
@@ -409,11 +669,38 @@ int SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **list, int maxCount, int a
 	sv_areaMaxCount = maxCount;
 	sv_areaType = areaType;
 
-	SV_AreaEdicts_r (sv_areaNodes);
+	world->numQueries++;
+	if (world->index == AREA_INDEX_GRID)
+		SV_AreaEdictsGrid (world);
+	else
+		SV_AreaEdicts_r (world, world->nodes);
 
 	return sv_areaCount;
 }
 
+static void SV_AreaRecordQuery (vec3_t mins, vec3_t maxs, int areaType)
+{
+	areaRecordQuery_t	*query;
+
+	if (sv_areaRecordNumQueries == AREA_RECORD_MAXQUERIES) {
+		sv_areaRecordDropped++;
+		return;
+	}
+
+	query = &sv_areaRecordQueries[sv_areaRecordNumQueries++];
+	Vec3Copy (mins, query->mins);
+	Vec3Copy (maxs, query->maxs);
+	query->areaType = areaType;
+}
+
+int SV_AreaEdicts (vec3_t mins, vec3_t maxs, edict_t **list, int maxCount, int areaType)
+{
+	if (sv_areaRecordFile)
+		SV_AreaRecordQuery (mins, maxs, areaType);
+
+	return SV_AreaQuery (&sv_areaWorld, mins, maxs, list, maxCount, areaType);
+}
+
 /*
 ===============================================================================
 
@@ -628,3 +915,300 @@ trace_t SV_Trace (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, edict_t *p
 
 	return clip.trace;
 }
+
+
+/*
+==================
+SV_TraceBatch
+
+SV_Trace for many moves at once, out[i] answers reqs[i] and passEdicts may be
+NULL. The world part of every move goes through CM_BoxTraceBatch together,
+then each one is clipped against entities as SV_Trace would. headNode has to
+be 0.
+==================
+*/
+void SV_TraceBatch (const traceReq_t *reqs, edict_t **passEdicts, trace_t *out, int numReqs)
+{
+	moveClip_t	clip;
+	int			i;
+
+	if (!reqs || !out || numReqs <= 0)
+		return;
+
+	// Clip to world
+	CM_BoxTraceBatch (reqs, out, numReqs);
+
+	for (i=0 ; i<numReqs ; i++) {
+		out[i].ent = ge->edicts;
+		if (out[i].fraction == 0)
+			continue;	// Blocked by the world
+
+		memset (&clip, 0, sizeof (moveClip_t));
+		clip.trace = out[i];
+		clip.contentMask = reqs[i].contentMask;
+		clip.start = (float *)reqs[i].start;
+		clip.end = (float *)reqs[i].end;
+		clip.mins = (float *)reqs[i].mins;
+		clip.maxs = (float *)reqs[i].maxs;
+		clip.passEdict = passEdicts ? passEdicts[i] : NULL;
+
+		Vec3Copy (reqs[i].mins, clip.mins2);
+		Vec3Copy (reqs[i].maxs, clip.maxs2);
+
+		// Create the bounding box of the entire move
+		SV_TraceBounds (clip.start, clip.mins2, clip.maxs2, clip.end, clip.boxMins, clip.boxMaxs);
+
+		// Clip to other solid entities
+		SV_ClipMoveToEntities (&clip);
+		out[i] = clip.trace;
+	}
+}
+
+/*
+===============================================================================
+
+	AREA INDEX BENCHMARK
+
+	arearecord captures every linked edict's abs box and every area query
+	for a number of server frames, areabench replays the capture against
+	each area index without needing a map or game loaded.
+
+===============================================================================
+*/
+
+/*
+==================
+SV_AreaRecordFrame
+
+Called at the end of each server frame
+==================
+*/
+void SV_AreaRecordFrame (void)
+{
+	static areaRecordEnt_t	ents[MAX_CS_EDICTS];
+	edict_t					*ent;
+	int						numEnts, e;
+
+	if (!sv_areaRecordFile)
+		return;
+
+	numEnts = 0;
+	for (e=1 ; e<ge->numEdicts && e<MAX_CS_EDICTS ; e++) {
+		ent = EDICT_NUM(e);
+		if (!ent->inUse || !ent->area.prev || ent->solid == SOLID_NOT)
+			continue;
+
+		ents[numEnts].num = e;
+		ents[numEnts].solid = ent->solid;
+		Vec3Copy (ent->absMin, ents[numEnts].absMin);
+		Vec3Copy (ent->absMax, ents[numEnts].absMax);
+		numEnts++;
+	}
+
+	FS_Write (&numEnts, sizeof (int), sv_areaRecordFile);
+	FS_Write (ents, sizeof (areaRecordEnt_t) * numEnts, sv_areaRecordFile);
+	FS_Write (&sv_areaRecordNumQueries, sizeof (int), sv_areaRecordFile);
+	FS_Write (sv_areaRecordQueries, sizeof (areaRecordQuery_t) * sv_areaRecordNumQueries, sv_areaRecordFile);
+	sv_areaRecordNumQueries = 0;
+
+	if (--sv_areaRecordFrames > 0)
+		return;
+
+	FS_CloseFile (sv_areaRecordFile);
+	sv_areaRecordFile = 0;
+	if (sv_areaRecordDropped)
+		Com_Printf (PRNT_WARNING, "arearecord: %i queries over the per-frame limit were dropped\n", sv_areaRecordDropped);
+	Com_Printf (0, "arearecord: done\n");
+}
+
+
+/*
+==================
+SV_AreaRecord_f
+==================
+*/
+static void SV_AreaRecord_f (void)
+{
+	char	name[MAX_OSPATH];
+	vec3_t	mins, maxs;
+	int		ident;
+
+	if (Cmd_Argc () != 3) {
+		Com_Printf (0, "usage: arearecord <name> <frames>\n");
+		return;
+	}
+	if (sv_areaRecordFile) {
+		Com_Printf (0, "arearecord: already recording\n");
+		return;
+	}
+	if (Com_ServerState () != SS_GAME) {
+		Com_Printf (0, "arearecord: you must be in a level to record\n");
+		return;
+	}
+
+	Q_snprintfz (name, sizeof (name), "areas/%s.abn", Cmd_Argv (1));
+	FS_OpenFile (name, &sv_areaRecordFile, FS_MODE_WRITE_BINARY);
+	if (!sv_areaRecordFile) {
+		Com_Printf (PRNT_ERROR, "arearecord: couldn't open %s\n", name);
+		return;
+	}
+
+	sv_areaRecordFrames = atoi (Cmd_Argv (2));
+	if (sv_areaRecordFrames < 1)
+		sv_areaRecordFrames = 1;
+	sv_areaRecordNumQueries = 0;
+	sv_areaRecordDropped = 0;
+
+	// Header is the ident and the world bounds
+	ident = AREA_RECORD_IDENT;
+	CM_InlineModelBounds (sv.models[1], mins, maxs);
+	FS_Write (&ident, sizeof (int), sv_areaRecordFile);
+	FS_Write (mins, sizeof (vec3_t), sv_areaRecordFile);
+	FS_Write (maxs, sizeof (vec3_t), sv_areaRecordFile);
+
+	Com_Printf (0, "arearecord: recording %i frames to %s\n", sv_areaRecordFrames, name);
+}
+
+
+/*
+==================
+SV_AreaBench_f
+==================
+*/
+static void SV_AreaBench_f (void)
+{
+	char				name[MAX_OSPATH];
+	byte				*buffer, *data, *end;
+	edict_t				*ents, *list[MAX_CS_EDICTS];
+	int					*seen;
+	areaWorld_t			*bench;
+	areaRecordEnt_t		*rec;
+	areaRecordQuery_t	*query;
+	vec3_t				mins, maxs;
+	int					fileLen, index, pass, numPasses;
+	int					frame, numFrames, num, i;
+	int					time, numLinks, numFound;
+	int					numQueries, numVisited, numTested;
+
+	if (Cmd_Argc () < 2) {
+		Com_Printf (0, "usage: areabench <name> [passes]\n");
+		return;
+	}
+
+	Q_snprintfz (name, sizeof (name), "areas/%s.abn", Cmd_Argv (1));
+	fileLen = FS_LoadFile (name, (void **)&buffer, NULL);
+	if (!buffer || fileLen < (int)(sizeof (int) + sizeof (vec3_t) * 2)) {
+		Com_Printf (PRNT_ERROR, "areabench: couldn't load %s\n", name);
+		if (buffer)
+			FS_FreeFile (buffer);
+		return;
+	}
+	if (*(int *)buffer != AREA_RECORD_IDENT) {
+		Com_Printf (PRNT_ERROR, "areabench: %s is not an area recording\n", name);
+		FS_FreeFile (buffer);
+		return;
+	}
+
+	memcpy (mins, buffer + sizeof (int), sizeof (vec3_t));
+	memcpy (maxs, buffer + sizeof (int) + sizeof (vec3_t), sizeof (vec3_t));
+	end = buffer + fileLen;
+
+	numPasses = (Cmd_Argc () > 2) ? atoi (Cmd_Argv (2)) : 1;
+	if (numPasses < 1)
+		numPasses = 1;
+
+	bench = Mem_PoolAlloc (sizeof (areaWorld_t), sv_genericPool, 0);
+	ents = Mem_PoolAlloc (sizeof (edict_t) * MAX_CS_EDICTS, sv_genericPool, 0);
+	seen = Mem_PoolAlloc (sizeof (int) * MAX_CS_EDICTS, sv_genericPool, 0);
+
+	numFrames = 0;
+	for (index=0 ; index<AREA_INDEX_MAX ; index++) {
+		numLinks = numFound = 0;
+		numQueries = numVisited = numTested = 0;
+
+		time = Sys_Milliseconds ();
+		for (pass=0 ; pass<numPasses ; pass++) {
+			SV_InitAreaWorld (bench, index, mins, maxs);
+			memset (ents, 0, sizeof (edict_t) * MAX_CS_EDICTS);
+			memset (seen, 0, sizeof (int) * MAX_CS_EDICTS);
+
+			data = buffer + sizeof (int) + sizeof (vec3_t) * 2;
+			for (frame=1 ; data+sizeof (int)<=end ; frame++) {
+				// Move what moved
+				num = *(int *)data;
+				data += sizeof (int);
+				if (num < 0 || data + num * sizeof (areaRecordEnt_t) > end)
+					break;
+
+				for (i=0, rec=(areaRecordEnt_t *)data ; i<num ; i++, rec++) {
+					if (rec->num < 0 || rec->num >= MAX_CS_EDICTS)
+						continue;
+					seen[rec->num] = frame;
+
+					if (ents[rec->num].area.prev
+					&& ents[rec->num].solid == rec->solid
+					&& Vec3Compare (ents[rec->num].absMin, rec->absMin)
+					&& Vec3Compare (ents[rec->num].absMax, rec->absMax))
+						continue;
+
+					if (ents[rec->num].area.prev)
+						SV_UnlinkEdict (&ents[rec->num]);
+					ents[rec->num].solid = rec->solid;
+					Vec3Copy (rec->absMin, ents[rec->num].absMin);
+					Vec3Copy (rec->absMax, ents[rec->num].absMax);
+					SV_AreaLink (bench, &ents[rec->num]);
+					numLinks++;
+				}
+				data += num * sizeof (areaRecordEnt_t);
+
+				// Drop what went away
+				for (i=0 ; i<MAX_CS_EDICTS ; i++) {
+					if (ents[i].area.prev && seen[i] != frame)
+						SV_UnlinkEdict (&ents[i]);
+				}
+
+				// Replay the queries
+				if (data + sizeof (int) > end)
+					break;
+				num = *(int *)data;
+				data += sizeof (int);
+				if (num < 0 || data + num * sizeof (areaRecordQuery_t) > end)
+					break;
+
+				for (i=0, query=(areaRecordQuery_t *)data ; i<num ; i++, query++)
+					numFound += SV_AreaQuery (bench, query->mins, query->maxs, list, MAX_CS_EDICTS, query->areaType);
+				data += num * sizeof (areaRecordQuery_t);
+			}
+
+			numFrames = frame - 1;
+			numQueries += bench->numQueries;
+			numVisited += bench->numVisited;
+			numTested += bench->numTested;
+		}
+		time = Sys_Milliseconds () - time;
+
+		Com_Printf (0, "%-5s %6ims %8i links %8i queries %10i visited %10i tested %10i found\n",
+			sv_areaIndexNames[index], time, numLinks, numQueries, numVisited, numTested, numFound);
+	}
+
+	Com_Printf (0, "areabench: %i frames x %i passes from %s\n", numFrames, numPasses, name);
+
+	if (bench->cellMemory)
+		Mem_Free (bench->cellMemory);
+	Mem_Free (bench);
+	Mem_Free (ents);
+	Mem_Free (seen);
+	FS_FreeFile (buffer);
+}
+
+
+/*
+==================
+SV_WorldCommandInit
+==================
+*/
+void SV_WorldCommandInit (void)
+{
+	Cmd_AddCommand ("arearecord",	SV_AreaRecord_f,	"Records entity boxes and area queries for areabench");
+	Cmd_AddCommand ("areabench",	SV_AreaBench_f,		"Replays an arearecord capture against each area index");
+}
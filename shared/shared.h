@@ -994,6 +994,16 @@ typedef struct trace_s {
 	struct edict_s	*ent;		// not set by CM_*() functions
 } trace_t;
 
+// One entry of a CM_BoxTraceBatch call
+typedef struct traceReq_s {
+	vec3_t			start;
+	vec3_t			end;
+	vec3_t			mins;
+	vec3_t			maxs;
+	int				headNode;	// 0 for the world
+	int				contentMask;
+} traceReq_t;
+
 //
 // m_plane.c
 //
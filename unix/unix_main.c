@@ -40,6 +40,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <errno.h>
 #include <dlfcn.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #include "../common/common.h"
 #include "unix_local.h"
@@ -367,6 +369,27 @@ uint32 Sys_UMilliseconds (void)
 }
 
 
+/*
+================
+Sys_UMicroseconds
+================
+*/
+uint32 Sys_UMicroseconds (void)
+{
+	struct timeval	tp;
+	static int		secbase;
+
+	gettimeofday (&tp, NULL);
+
+	if (!secbase) {
+		secbase = tp.tv_sec;
+		return tp.tv_usec;
+	}
+
+	return (tp.tv_sec - secbase)*1000000 + tp.tv_usec;
+}
+
+
 /*
 ================
 Sys_AppActivate
@@ -388,6 +411,220 @@ void Sys_Mkdir (char *path)
 }
 
 
+/*
+================
+Sys_MapFile
+
+Maps an entire file read-only.
+================
+*/
+void *Sys_MapFile (char *path, size_t *length, void **mapHandle)
+{
+	struct stat	st;
+	void		*base;
+	int			fd;
+
+	*length = 0;
+	*mapHandle = NULL;
+
+	fd = open (path, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat (fd, &st) == -1 || st.st_size <= 0) {
+		close (fd);
+		return NULL;
+	}
+
+	// The mapping keeps its own reference to the file
+	base = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+	if (base == MAP_FAILED)
+		return NULL;
+
+	*length = st.st_size;
+	return base;
+}
+
+
+/*
+================
+Sys_UnmapFile
+================
+*/
+void Sys_UnmapFile (void *base, size_t length, void *mapHandle)
+{
+	if (!base)
+		return;
+
+	munmap (base, length);
+}
+
+/*
+==============================================================================
+
+	THREADING
+
+==============================================================================
+*/
+
+typedef struct unixThread_s {
+	pthread_t			thread;
+	sysThreadFunc_t		func;
+	void				*arg;
+} unixThread_t;
+
+static void *Sys_ThreadProc (void *parm)
+{
+	unixThread_t	*thread = (unixThread_t *)parm;
+
+	thread->func (thread->arg);
+	return NULL;
+}
+
+
+/*
+================
+Sys_CreateThread
+================
+*/
+void *Sys_CreateThread (sysThreadFunc_t func, void *arg)
+{
+	unixThread_t	*thread;
+
+	thread = calloc (1, sizeof (unixThread_t));
+	if (!thread)
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+	if (pthread_create (&thread->thread, NULL, Sys_ThreadProc, thread)) {
+		free (thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+
+/*
+================
+Sys_JoinThread
+================
+*/
+void Sys_JoinThread (void *thread)
+{
+	if (!thread)
+		return;
+
+	pthread_join (((unixThread_t *)thread)->thread, NULL);
+	free (thread);
+}
+
+
+/*
+================
+Sys_CreateMutex
+================
+*/
+void *Sys_CreateMutex (void)
+{
+	pthread_mutex_t		*mutex;
+	pthread_mutexattr_t	attr;
+
+	mutex = malloc (sizeof (pthread_mutex_t));
+	if (!mutex)
+		Sys_Error ("Sys_CreateMutex: out of memory");
+
+	pthread_mutexattr_init (&attr);
+	pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init (mutex, &attr);
+	pthread_mutexattr_destroy (&attr);
+	return mutex;
+}
+
+void Sys_DestroyMutex (void *mutex)
+{
+	if (!mutex)
+		return;
+
+	pthread_mutex_destroy ((pthread_mutex_t *)mutex);
+	free (mutex);
+}
+
+void Sys_LockMutex (void *mutex)
+{
+	pthread_mutex_lock ((pthread_mutex_t *)mutex);
+}
+
+void Sys_UnlockMutex (void *mutex)
+{
+	pthread_mutex_unlock ((pthread_mutex_t *)mutex);
+}
+
+
+/*
+================
+Sys_CreateSemaphore
+================
+*/
+void *Sys_CreateSemaphore (int initialCount)
+{
+	sem_t	*sem;
+
+	sem = malloc (sizeof (sem_t));
+	if (!sem)
+		Sys_Error ("Sys_CreateSemaphore: out of memory");
+
+	sem_init (sem, 0, initialCount);
+	return sem;
+}
+
+void Sys_DestroySemaphore (void *sem)
+{
+	if (!sem)
+		return;
+
+	sem_destroy ((sem_t *)sem);
+	free (sem);
+}
+
+void Sys_PostSemaphore (void *sem)
+{
+	sem_post ((sem_t *)sem);
+}
+
+void Sys_WaitSemaphore (void *sem)
+{
+	while (sem_wait ((sem_t *)sem) == -1 && errno == EINTR) ;
+}
+
+
+/*
+================
+Sys_AtomicAdd
+================
+*/
+int Sys_AtomicAdd (volatile int *value, int add)
+{
+	return __sync_fetch_and_add (value, add);
+}
+
+
+/*
+================
+Sys_NumProcessors
+================
+*/
+int Sys_NumProcessors (void)
+{
+	long	num;
+
+	num = sysconf (_SC_NPROCESSORS_ONLN);
+	return (num < 1) ? 1 : (int)num;
+}
+
+
 /*
 ================
 Sys_SendKeyEvents
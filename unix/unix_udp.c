@@ -21,6 +21,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // unix_udp.c
 //
 
+#ifdef __linux__
+# define _GNU_SOURCE		// recvmmsg/sendmmsg
+# define NET_MMSG
+#endif
+
 #include "../common/common.h"
 #include "unix_local.h"
 
@@ -88,18 +93,18 @@ void NET_NetadrToSockadr (netAdr_t *a, struct sockaddr_in *s)
 	}
 }
 
-char	*NET_AdrToString (netAdr_t a)
+char	*NET_AdrToString (netAdr_t *a)
 {
 	static	char	str[64];
 	
-	switch (a.naType) {
+	switch (a->naType) {
 	case NA_LOOPBACK:
 		Q_snprintfz (str, sizeof (str), "loopback");
 		break;
 
 	case NA_IP:
 		Q_snprintfz (str, sizeof (str), "%i.%i.%i.%i:%i",
-			a.ip[0], a.ip[1], a.ip[2], a.ip[3], ntohs(a.port));
+			a->ip[0], a->ip[1], a->ip[2], a->ip[3], ntohs(a->port));
 		break;
 	}
 
@@ -262,13 +267,221 @@ void NET_SendLoopPacket (int sock, int length, void *data, netAdr_t to)
 	loop->msgs[i].datalen = length;
 }
 
+/*
+=============================================================================
+
+	BATCHED SOCKET I/O
+
+	Where recvmmsg/sendmmsg exist, incoming datagrams are drained into a
+	small ring per socket with one call, and outgoing datagrams queued
+	between NET_BeginSendBatch and NET_FlushSendBatch leave in one call.
+	Everywhere else this falls back to a recvfrom/sendto per packet.
+
+=============================================================================
+*/
+
+#define NET_RECV_BATCH		32
+#define NET_SEND_BATCH		64
+
+typedef struct netPacket_s {
+	struct sockaddr_in	addr;
+	int					len;
+	byte				data[MAX_CL_MSGLEN];
+} netPacket_t;
+
+typedef struct netRecvRing_s {
+	netPacket_t			packets[NET_RECV_BATCH];
+	int					get, count;
+} netRecvRing_t;
+
+typedef struct netSendQueue_s {
+	qBool				active;
+	netPacket_t			packets[NET_SEND_BATCH];
+	int					count;
+} netSendQueue_t;
+
+static netRecvRing_t	net_recvRings[NS_MAX];
+static netSendQueue_t	net_sendQueues[NS_MAX];
+
+/*
+===================
+NET_RecvBatch
+
+Fills the receive ring for a socket, returns the number of packets read
+===================
+*/
+static int NET_RecvBatch (netSrc_t sock, int netSocket, size_t maxSize)
+{
+	netRecvRing_t		*ring = &net_recvRings[sock];
+	netPacket_t			*packet;
+#ifdef NET_MMSG
+	struct mmsghdr		msgs[NET_RECV_BATCH];
+	struct iovec		iovecs[NET_RECV_BATCH];
+#else
+	socklen_t			fromLen;
+#endif
+	int					i, ret;
+
+	if (maxSize > MAX_CL_MSGLEN)
+		maxSize = MAX_CL_MSGLEN;
+
+	ring->get = 0;
+	ring->count = 0;
+
+#ifdef NET_MMSG
+	memset (msgs, 0, sizeof (msgs));
+	for (i=0 ; i<NET_RECV_BATCH ; i++) {
+		packet = &ring->packets[i];
+		iovecs[i].iov_base = packet->data;
+		iovecs[i].iov_len = maxSize;
+		msgs[i].msg_hdr.msg_name = &packet->addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof (packet->addr);
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = recvmmsg (netSocket, msgs, NET_RECV_BATCH, MSG_DONTWAIT, NULL);
+	netStats.sock[sock].recvCalls++;
+	netStats.sock[sock].frameRecvCalls++;
+	if (ret <= 0)
+		return ret;
+
+	for (i=0 ; i<ret ; i++) {
+		packet = &ring->packets[i];
+		packet->len = msgs[i].msg_len;
+		if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+			packet->len = maxSize;
+	}
+#else
+	packet = &ring->packets[0];
+	fromLen = sizeof (packet->addr);
+	ret = recvfrom (netSocket, packet->data, maxSize, 0, (struct sockaddr *)&packet->addr, &fromLen);
+	netStats.sock[sock].recvCalls++;
+	netStats.sock[sock].frameRecvCalls++;
+	if (ret < 0)
+		return ret;
+
+	packet->len = ret;
+	ret = 1;
+#endif
+
+	ring->count = ret;
+	return ret;
+}
+
+
+/*
+===================
+NET_SendBatch
+
+Hands every queued packet for a socket to the OS
+===================
+*/
+static void NET_SendBatch (netSrc_t sock)
+{
+	netSendQueue_t		*queue = &net_sendQueues[sock];
+	netPacket_t			*packet;
+	netAdr_t			to;
+	int					netSocket, sent, ret;
+#ifdef NET_MMSG
+	struct mmsghdr		msgs[NET_SEND_BATCH];
+	struct iovec		iovecs[NET_SEND_BATCH];
+	int					i;
+#endif
+
+	if (!queue->count)
+		return;
+
+	netSocket = ipSockets[sock];
+	if (!netSocket) {
+		queue->count = 0;
+		return;
+	}
+
+#ifdef NET_MMSG
+	memset (msgs, 0, sizeof (msgs));
+	for (i=0 ; i<queue->count ; i++) {
+		packet = &queue->packets[i];
+		iovecs[i].iov_base = packet->data;
+		iovecs[i].iov_len = packet->len;
+		msgs[i].msg_hdr.msg_name = &packet->addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof (packet->addr);
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+#endif
+
+	for (sent=0 ; sent<queue->count ; ) {
+		packet = &queue->packets[sent];
+
+#ifdef NET_MMSG
+		ret = sendmmsg (netSocket, &msgs[sent], queue->count - sent, 0);
+#else
+		ret = sendto (netSocket, packet->data, packet->len, 0, (struct sockaddr *)&packet->addr, sizeof (packet->addr));
+		if (ret != -1)
+			ret = 1;
+#endif
+		netStats.sock[sock].sendCalls++;
+		netStats.sock[sock].frameSendCalls++;
+
+		if (ret <= 0) {
+			// Drop the packet that failed and carry on with the rest
+			NET_SockAdrToNetAdr (&packet->addr, (&to));
+			Com_Printf (0, "NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(), NET_AdrToString (&to));
+			sent++;
+			continue;
+		}
+
+		for ( ; ret>0 ; ret--, sent++) {
+			netStats.sizeOut += queue->packets[sent].len;
+			netStats.packetsOut++;
+		}
+	}
+
+	queue->count = 0;
+}
+
+
+/*
+===================
+NET_BeginSendBatch
+===================
+*/
+void NET_BeginSendBatch (netSrc_t sock)
+{
+	net_sendQueues[sock].active = qTrue;
+}
+
+
+/*
+===================
+NET_FlushSendBatch
+
+Also closes out the per-frame syscall counters
+===================
+*/
+void NET_FlushSendBatch (netSrc_t sock)
+{
+	netSockStats_t	*stats = &netStats.sock[sock];
+
+	NET_SendBatch (sock);
+	net_sendQueues[sock].active = qFalse;
+
+	stats->numFrames++;
+	stats->lastRecvCalls = stats->frameRecvCalls;
+	stats->lastSendCalls = stats->frameSendCalls;
+	stats->peakRecvCalls = max (stats->peakRecvCalls, stats->frameRecvCalls);
+	stats->peakSendCalls = max (stats->peakSendCalls, stats->frameSendCalls);
+	stats->frameRecvCalls = 0;
+	stats->frameSendCalls = 0;
+}
+
 //=============================================================================
 
-qBool NET_GetPacket (int sock, netAdr_t *net_from, netMsg_t *net_message)
+qBool NET_GetPacket (netSrc_t sock, netAdr_t *net_from, netMsg_t *net_message)
 {
-	int 	ret;
-	struct sockaddr_in	from;
-	socklen_t		fromlen;
+	netRecvRing_t	*ring;
+	netPacket_t		*packet;
 	int		net_socket;
 	int		err;
 
@@ -279,44 +492,52 @@ qBool NET_GetPacket (int sock, netAdr_t *net_from, netMsg_t *net_message)
 	if (!net_socket)
 		return qFalse;
 
-	fromlen = sizeof(from);
-	ret = recvfrom (net_socket, net_message->data, net_message->maxSize, 0, (struct sockaddr *)&from, &fromlen);
+	ring = &net_recvRings[sock];
+	for ( ; ; ) {
+		if (ring->get >= ring->count) {
+			if (NET_RecvBatch (sock, net_socket, net_message->maxSize) == -1) {
+				err = errno;
 
-	NET_SockAdrToNetAdr (&from, net_from);
-
-	if (ret == -1) {
-		err = errno;
+				if (err == EWOULDBLOCK || err == ECONNREFUSED)
+					return qFalse;
+				Com_Printf (0, "NET_GetPacket: %s\n", NET_ErrorString());
+				return qFalse;
+			}
+			if (!ring->count)
+				return qFalse;
+		}
 
-		if (err == EWOULDBLOCK || err == ECONNREFUSED)
-			return qFalse;
-		Com_Printf (0, "NET_GetPacket: %s from %s\n", NET_ErrorString(),
-					NET_AdrToString(*net_from));
-		return 0;
-	}
+		packet = &ring->packets[ring->get++];
+		NET_SockAdrToNetAdr (&packet->addr, net_from);
 
-	if (ret == net_message->maxSize) {
-		Com_Printf (0, "Oversize packet from %s\n", NET_AdrToString (*net_from));
-		return qFalse;
+		if (packet->len >= (int)net_message->maxSize || packet->len >= MAX_CL_MSGLEN) {
+			Com_Printf (0, "Oversize packet from %s\n", NET_AdrToString (net_from));
+			continue;
+		}
+		break;
 	}
 
-	netStats.sizeIn += ret;
+	netStats.sizeIn += packet->len;
 	netStats.packetsIn++;
 
-	net_message->curSize = ret;
+	memcpy (net_message->data, packet->data, packet->len);
+	net_message->curSize = packet->len;
 	return qTrue;
 }
 
 //=============================================================================
 
-int NET_SendPacket (int sock, int length, void *data, netAdr_t to)
+int NET_SendPacket (netSrc_t sock, size_t length, void *data, netAdr_t *to)
 {
 	int		ret;
 	struct sockaddr_in	addr;
+	netSendQueue_t		*queue;
+	netPacket_t			*packet;
 	int		net_socket;
 
-	switch (to.naType) {
+	switch (to->naType) {
 	case NA_LOOPBACK:
-		NET_SendLoopPacket (sock, length, data, to);
+		NET_SendLoopPacket (sock, length, data, *to);
 		return 0;
 
 	case NA_BROADCAST:
@@ -332,19 +553,40 @@ int NET_SendPacket (int sock, int length, void *data, netAdr_t to)
 		break;
 
 	default:
-		Com_Error (ERR_FATAL, "NET_SendPacket: bad address type: %d", to.naType);
+		Com_Error (ERR_FATAL, "NET_SendPacket: bad address type: %d", to->naType);
 		break;
 	}
 
-	NET_NetadrToSockadr (&to, &addr);
+	NET_NetadrToSockadr (to, &addr);
+
+	// Queue it up if a batch is open
+	queue = &net_sendQueues[sock];
+	if (queue->active && length <= MAX_CL_MSGLEN) {
+		if (queue->count == NET_SEND_BATCH)
+			NET_SendBatch (sock);
+
+		packet = &queue->packets[queue->count++];
+		packet->addr = addr;
+		packet->len = (int)length;
+		memcpy (packet->data, data, length);
+		return 1;
+	}
+
+	// Too big to queue, what's queued has to go first to keep the order
+	if (queue->active)
+		NET_SendBatch (sock);
 
 	ret = sendto (net_socket, data, length, 0, (struct sockaddr *)&addr, sizeof(addr));
+	netStats.sock[sock].sendCalls++;
+	netStats.sock[sock].frameSendCalls++;
 	if (ret == -1) {
 		Com_Printf (0, "NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(), NET_AdrToString (to));
 		return 0;
 		// FIXME: return -1 for certain errors like in net_wins.c
 	}
 
+	netStats.sizeOut += ret;
+	netStats.packetsOut++;
 	return 1;
 }
 
@@ -371,6 +613,8 @@ int NET_Config (int openFlags)
 		return oldFlags;
 
 	memset (&netStats, 0, sizeof (netStats));
+	memset (net_recvRings, 0, sizeof (net_recvRings));
+	memset (net_sendQueues, 0, sizeof (net_sendQueues));
 
 	if (openFlags == NET_NONE) {
 		oldest = oldFlags;
@@ -547,8 +791,10 @@ NET_Stats_f
 */
 static void NET_Stats_f (void)
 {
-	uint32	now = time(0);
-	uint32	diff = now - netStats.initTime;
+	uint32			now = time(0);
+	uint32			diff = now - netStats.initTime;
+	netSockStats_t	*stats;
+	int				i;
 
 	if (!netStats.initialized) {
 		Com_Printf (0, "Network sockets not up!\n");
@@ -562,6 +808,21 @@ static void NET_Stats_f (void)
 		diff,
 		netStats.sizeIn, netStats.packetsIn, (int)(((netStats.sizeIn * 8) / 1024) / diff),
 		netStats.sizeOut, netStats.packetsOut, (int)((netStats.sizeOut * 8) / 1024) / diff);
+
+	for (i=0 ; i<NS_MAX ; i++) {
+		stats = &netStats.sock[i];
+		if (!stats->numFrames)
+			continue;
+
+		Com_Printf (0, "%s: %i recv and %i send syscalls over %i frames (av: %.2f recv, %.2f send per frame)\n"
+			"%s: last frame: %i recv, %i send; peak: %i recv, %i send\n",
+
+			(i == NS_SERVER) ? "server" : "client",
+			stats->recvCalls, stats->sendCalls, stats->numFrames,
+			(float)stats->recvCalls / stats->numFrames, (float)stats->sendCalls / stats->numFrames,
+			(i == NS_SERVER) ? "server" : "client",
+			stats->lastRecvCalls, stats->lastSendCalls, stats->peakRecvCalls, stats->peakSendCalls);
+	}
 }
 
 
@@ -31,6 +31,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
 #include <direct.h>
 #include <io.h>
 #include <conio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <VersionHelpers.h>
 
 #define MINIMUM_WIN_MEMORY	0x0a00000
@@ -228,6 +230,26 @@ uint32 Sys_UMilliseconds (void)
 }
 
 
+/*
+================
+Sys_UMicroseconds
+================
+*/
+uint32 Sys_UMicroseconds (void)
+{
+	static LARGE_INTEGER	frequency, base;
+	LARGE_INTEGER			now;
+
+	if (!frequency.QuadPart) {
+		QueryPerformanceFrequency (&frequency);
+		QueryPerformanceCounter (&base);
+	}
+
+	QueryPerformanceCounter (&now);
+	return (uint32)((now.QuadPart - base.QuadPart) * 1000000 / frequency.QuadPart);
+}
+
+
 /*
 =================
 Sys_AppActivate
@@ -256,6 +278,244 @@ void Sys_Mkdir (char *path)
 }
 
 
+/*
+================
+Sys_FileTime
+
+returns -1 if not present
+================
+*/
+int Sys_FileTime (char *path)
+{
+	struct _stat	buf;
+
+	if (_stat (path, &buf) == -1)
+		return -1;
+
+	return (int)buf.st_mtime;
+}
+
+
+/*
+================
+Sys_MapFile
+
+Maps an entire file read-only.
+================
+*/
+void *Sys_MapFile (char *path, size_t *length, void **mapHandle)
+{
+	HANDLE	file, mapping;
+	DWORD	sizeHigh, sizeLow;
+	void	*base;
+
+	*length = 0;
+	*mapHandle = NULL;
+
+	file = CreateFile (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL|FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	sizeLow = GetFileSize (file, &sizeHigh);
+	if (sizeHigh || !sizeLow || sizeLow == INVALID_FILE_SIZE) {
+		CloseHandle (file);
+		return NULL;
+	}
+
+	// The mapping object keeps the file open on its own
+	mapping = CreateFileMapping (file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle (file);
+	if (!mapping)
+		return NULL;
+
+	base = MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!base) {
+		CloseHandle (mapping);
+		return NULL;
+	}
+
+	*length = sizeLow;
+	*mapHandle = mapping;
+	return base;
+}
+
+
+/*
+================
+Sys_UnmapFile
+================
+*/
+void Sys_UnmapFile (void *base, size_t length, void *mapHandle)
+{
+	if (!base)
+		return;
+
+	UnmapViewOfFile (base);
+	if (mapHandle)
+		CloseHandle ((HANDLE)mapHandle);
+}
+
+/*
+==============================================================================
+
+	THREADING
+
+==============================================================================
+*/
+
+typedef struct winThread_s {
+	HANDLE				handle;
+	sysThreadFunc_t		func;
+	void				*arg;
+} winThread_t;
+
+static DWORD WINAPI Sys_ThreadProc (LPVOID parm)
+{
+	winThread_t	*thread = (winThread_t *)parm;
+
+	thread->func (thread->arg);
+	return 0;
+}
+
+
+/*
+================
+Sys_CreateThread
+================
+*/
+void *Sys_CreateThread (sysThreadFunc_t func, void *arg)
+{
+	winThread_t	*thread;
+
+	thread = calloc (1, sizeof (winThread_t));
+	if (!thread)
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+	thread->handle = CreateThread (NULL, 0, Sys_ThreadProc, thread, 0, NULL);
+	if (!thread->handle) {
+		free (thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+
+/*
+================
+Sys_JoinThread
+================
+*/
+void Sys_JoinThread (void *thread)
+{
+	if (!thread)
+		return;
+
+	WaitForSingleObject (((winThread_t *)thread)->handle, INFINITE);
+	CloseHandle (((winThread_t *)thread)->handle);
+	free (thread);
+}
+
+
+/*
+================
+Sys_CreateMutex
+
+Critical sections are recursive already.
+================
+*/
+void *Sys_CreateMutex (void)
+{
+	CRITICAL_SECTION	*mutex;
+
+	mutex = malloc (sizeof (CRITICAL_SECTION));
+	if (!mutex)
+		Sys_Error ("Sys_CreateMutex: out of memory");
+
+	InitializeCriticalSection (mutex);
+	return mutex;
+}
+
+void Sys_DestroyMutex (void *mutex)
+{
+	if (!mutex)
+		return;
+
+	DeleteCriticalSection ((CRITICAL_SECTION *)mutex);
+	free (mutex);
+}
+
+void Sys_LockMutex (void *mutex)
+{
+	EnterCriticalSection ((CRITICAL_SECTION *)mutex);
+}
+
+void Sys_UnlockMutex (void *mutex)
+{
+	LeaveCriticalSection ((CRITICAL_SECTION *)mutex);
+}
+
+
+/*
+================
+Sys_CreateSemaphore
+================
+*/
+void *Sys_CreateSemaphore (int initialCount)
+{
+	HANDLE	sem;
+
+	sem = CreateSemaphore (NULL, initialCount, 0x7fffffff, NULL);
+	if (!sem)
+		Sys_Error ("Sys_CreateSemaphore: failed");
+
+	return (void *)sem;
+}
+
+void Sys_DestroySemaphore (void *sem)
+{
+	if (sem)
+		CloseHandle ((HANDLE)sem);
+}
+
+void Sys_PostSemaphore (void *sem)
+{
+	ReleaseSemaphore ((HANDLE)sem, 1, NULL);
+}
+
+void Sys_WaitSemaphore (void *sem)
+{
+	WaitForSingleObject ((HANDLE)sem, INFINITE);
+}
+
+
+/*
+================
+Sys_AtomicAdd
+================
+*/
+int Sys_AtomicAdd (volatile int *value, int add)
+{
+	return (int)InterlockedExchangeAdd ((volatile LONG *)value, (LONG)add);
+}
+
+
+/*
+================
+Sys_NumProcessors
+================
+*/
+int Sys_NumProcessors (void)
+{
+	SYSTEM_INFO	info;
+
+	GetSystemInfo (&info);
+	return (info.dwNumberOfProcessors < 1) ? 1 : (int)info.dwNumberOfProcessors;
+}
+
+
 /*
 ================
 Sys_SendKeyEvents
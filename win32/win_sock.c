@@ -340,6 +340,8 @@ qBool NET_GetPacket (netSrc_t sock, netAdr_t *fromAddr, netMsg_t *message)
 
 	fromLen = sizeof (fromSockAddr);
 	ret = recvfrom (netSocket, (char *)message->data, (int) message->maxSize, 0, (struct sockaddr *)&fromSockAddr, &fromLen);
+	netStats.sock[sock].recvCalls++;
+	netStats.sock[sock].frameRecvCalls++;
 
 	NET_SockAdrToNetAdr (&fromSockAddr, fromAddr);
 
@@ -420,6 +422,8 @@ int NET_SendPacket (netSrc_t sock, size_t length, void *data, netAdr_t *to)
 	NET_NetAdrToSockAdr (to, &addr);
 
 	ret = sendto (netSocket, data, (int) length, 0, &addr, sizeof (addr));
+	netStats.sock[sock].sendCalls++;
+	netStats.sock[sock].frameSendCalls++;
 	if (ret == -1) {
 		int error = WSAGetLastError ();
 
@@ -454,6 +458,37 @@ int NET_SendPacket (netSrc_t sock, size_t length, void *data, netAdr_t *to)
 	return 1;
 }
 
+
+/*
+===================
+NET_BeginSendBatch
+
+Winsock has no sendmmsg equivalent, so packets go out as they're sent
+===================
+*/
+void NET_BeginSendBatch (netSrc_t sock)
+{
+}
+
+
+/*
+===================
+NET_FlushSendBatch
+===================
+*/
+void NET_FlushSendBatch (netSrc_t sock)
+{
+	netSockStats_t	*stats = &netStats.sock[sock];
+
+	stats->numFrames++;
+	stats->lastRecvCalls = stats->frameRecvCalls;
+	stats->lastSendCalls = stats->frameSendCalls;
+	stats->peakRecvCalls = max (stats->peakRecvCalls, stats->frameRecvCalls);
+	stats->peakSendCalls = max (stats->peakSendCalls, stats->frameSendCalls);
+	stats->frameRecvCalls = 0;
+	stats->frameSendCalls = 0;
+}
+
 /*
 =============================================================================
 
@@ -694,8 +729,10 @@ NET_Stats_f
 */
 static void NET_Stats_f (void)
 {
-	uint32	now = time(0);
-	uint32	diff = now - netStats.initTime;
+	uint32			now = time(0);
+	uint32			diff = now - netStats.initTime;
+	netSockStats_t	*stats;
+	int				i;
 
 	if (!netStats.initialized) {
 		Com_Printf (0, "Network sockets not up!\n");
@@ -709,6 +746,21 @@ static void NET_Stats_f (void)
 		diff,
 		netStats.sizeIn, netStats.packetsIn, (int)(((netStats.sizeIn * 8) / 1024) / diff),
 		netStats.sizeOut, netStats.packetsOut, (int)((netStats.sizeOut * 8) / 1024) / diff);
+
+	for (i=0 ; i<NS_MAX ; i++) {
+		stats = &netStats.sock[i];
+		if (!stats->numFrames)
+			continue;
+
+		Com_Printf (0, "%s: %i recv and %i send syscalls over %i frames (av: %.2f recv, %.2f send per frame)\n"
+			"%s: last frame: %i recv, %i send; peak: %i recv, %i send\n",
+
+			(i == NS_SERVER) ? "server" : "client",
+			stats->recvCalls, stats->sendCalls, stats->numFrames,
+			(float)stats->recvCalls / stats->numFrames, (float)stats->sendCalls / stats->numFrames,
+			(i == NS_SERVER) ? "server" : "client",
+			stats->lastRecvCalls, stats->lastSendCalls, stats->peakRecvCalls, stats->peakSendCalls);
+	}
 }
 
 /*